@@ -29,6 +29,18 @@ namespace M {
 class ActivePollGroup : public PollGroup
 {
 public:
+    struct PollIterationStats
+    {
+        // Number of events returned by the poll syscall.
+        Count num_events;
+        // Number of non-blocking poll attempts made in busy-poll mode.
+        Count num_spins;
+        // Time spent busy-polling.
+        Time spin_microsec;
+        // 'true' if the poll syscall has been called with non-zero timeout.
+        bool blocked;
+    };
+
     struct Frontend {
 	// pollIterationBegin is not called when poll() returns (poll timeout/error).
 	void (*pollIterationBegin) (void *cb_data);
@@ -36,6 +48,20 @@ public:
 	// If returns 'true', then there's more work to do in pollIterationEnd(),
 	// and the next poll iteration will be performed with zero timeout.
 	bool (*pollIterationEnd)   (void *cb_data);
+
+        // Optional. Called after pollIterationBegin(). Not all poll groups
+        // report iteration stats.
+        void (*pollIterationStats) (PollIterationStats const * mt_nonnull stats,
+                                    void *cb_data);
+    };
+
+    struct TriggerStatistics
+    {
+        // trigger() calls which resulted in a wakeup syscall.
+        Uint64 num_triggers_issued;
+        // trigger() calls which were coalesced with a pending wakeup
+        // or didn't need one because the poll thread wasn't blocked.
+        Uint64 num_triggers_suppressed;
     };
 
 protected:
@@ -46,6 +72,17 @@ public:
 
     virtual mt_throws Result trigger () = 0;
 
+    virtual void getTriggerStatistics (TriggerStatistics * const mt_nonnull ret_stats)
+    {
+        ret_stats->num_triggers_issued = 0;
+        ret_stats->num_triggers_suppressed = 0;
+    }
+
+    // Returns the number of pollables in the poll group, which is roughly
+    // the number of connections served by the poll group's thread.
+    // Used for load-aware thread selection. Returns 0 if not supported.
+    virtual Count getNumPollables () { return 0; }
+
     void setFrontend (Cb<Frontend> const &frontend)
         { this->frontend = frontend; }
 
@@ -70,6 +107,10 @@ public:
   #include <libmary/epoll_poll_group.h>
 #endif
 
+#if !defined (LIBMARY_PLATFORM_WIN32) && defined (LIBMARY_ENABLE_IO_URING)
+  #include <libmary/io_uring_poll_group.h>
+#endif
+
 
 #endif /* LIBMARY__ACTIVE_POLL_GROUP__H__ */
 
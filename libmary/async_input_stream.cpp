@@ -0,0 +1,70 @@
+/*  LibMary - C++ library for high-performance network servers
+    Copyright (C) 2011-2013 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <libmary/async_input_stream.h>
+
+
+namespace M {
+
+#ifndef LIBMARY_WIN32_IOCP
+mt_throws AsyncIoResult
+AsyncInputStream::readv (struct iovec * const iovs,
+                         Count          const num_iovs,
+                         Size         * const ret_nread)
+{
+    if (ret_nread)
+        *ret_nread = 0;
+
+    Size total_read = 0;
+    for (Count i = 0; i < num_iovs; ++i) {
+        Size nread = 0;
+        AsyncIoResult const res = read (Memory ((Byte*) iovs [i].iov_base, iovs [i].iov_len),
+                                        &nread);
+        total_read += nread;
+        if (ret_nread)
+            *ret_nread = total_read;
+
+        switch (res) {
+            case AsyncIoResult::Normal:
+                if (nread < iovs [i].iov_len)
+                    return AsyncIoResult::Normal;
+                break;
+            case AsyncIoResult::Again:
+                if (total_read > 0)
+                    return AsyncIoResult::Normal_Again;
+                return AsyncIoResult::Again;
+            case AsyncIoResult::Eof:
+                if (total_read > 0)
+                    return AsyncIoResult::Normal_Eof;
+                return AsyncIoResult::Eof;
+            case AsyncIoResult::Normal_Again:
+            case AsyncIoResult::Normal_Eof:
+            case AsyncIoResult::Error:
+                return res;
+            default:
+                unreachable ();
+        }
+    }
+
+    return AsyncIoResult::Normal;
+}
+#endif /* LIBMARY_WIN32_IOCP */
+
+}
+
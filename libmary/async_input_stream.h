@@ -21,6 +21,11 @@
 #define LIBMARY__ASYNC_INPUT_STREAM__H__
 
 
+#include <libmary/types.h>
+#ifndef LIBMARY_PLATFORM_WIN32
+#include <sys/uio.h>
+#endif
+
 #include <libmary/code_referenced.h>
 #include <libmary/exception.h>
 #include <libmary/cb.h>
@@ -51,6 +56,11 @@ public:
     virtual mt_throws AsyncIoResult read (Memory  mem,
 					  Size   *ret_nread) = 0;
 
+    // Scatter read. The default implementation calls read() for each iovec.
+    virtual mt_throws AsyncIoResult readv (struct iovec *iovs,
+                                           Count         num_iovs,
+                                           Size         *ret_nread);
+
     mt_const void setInputFrontend (CbDesc<InputFrontend> const &input_frontend)
         { this->input_frontend = input_frontend; }
 #endif
@@ -17,6 +17,12 @@
 */
 
 
+#include <libmary/types.h>
+#ifndef LIBMARY_PLATFORM_WIN32
+#include <errno.h>
+#include <unistd.h>
+#endif
+
 #include <libmary/async_output_stream.h>
 
 
@@ -77,6 +83,76 @@ AsyncOutputStream::writev (struct iovec * const iovs,
 
     return AsyncIoResult::Normal;
 }
+
+#ifndef LIBMARY_PLATFORM_WIN32
+mt_throws Result
+AsyncOutputStream::enableZeroCopy ()
+{
+    exc_throw (InternalException, InternalException::NotImplemented);
+    return Result::Failure;
+}
+
+void
+AsyncOutputStream::adoptZeroCopyOrphan (ZeroCopyOrphan * const mt_nonnull orphan)
+{
+  // writevZeroCopy() never writes without copying by default,
+  // hence there's nothing to wait for.
+    if (orphan->zeroCopyComplete (0, (Uint32) -1))
+        delete orphan;
+}
+
+mt_throws AsyncIoResult
+AsyncOutputStream::writevZeroCopy (struct iovec * const iovs,
+                                   Count          const num_iovs,
+                                   Size         * const ret_nwritten,
+                                   bool         * const ret_zerocopy,
+                                   Uint32       * const ret_seq)
+{
+    *ret_zerocopy = false;
+    *ret_seq = 0;
+    return writev (iovs, num_iovs, ret_nwritten);
+}
+
+mt_throws AsyncIoResult
+AsyncOutputStream::sendfile (int          const in_fd,
+                             FileOffset   const offset,
+                             Size         const len,
+                             Size       * const ret_nwritten)
+{
+    if (ret_nwritten)
+        *ret_nwritten = 0;
+
+    Byte buf [1 << 14 /* 16 Kb */];
+
+    Size toread = len;
+    if (toread > sizeof (buf))
+        toread = sizeof (buf);
+
+    ssize_t nread;
+    for (;;) {
+        nread = ::pread (in_fd, buf, toread, (off_t) offset);
+        if (nread >= 0)
+            break;
+
+        if (errno == EINTR)
+            continue;
+
+        exc_throw (PosixException, errno);
+        exc_push_ (IoException);
+        return AsyncIoResult::Error;
+    }
+
+    if (nread == 0 && len > 0) {
+      // The file is shorter than expected.
+        exc_throw (InternalException, InternalException::OutOfBounds);
+        return AsyncIoResult::Error;
+    }
+
+    // Data which has not been written will be read again on the next call.
+    return write (ConstMemory (buf, (Size) nread), ret_nwritten);
+}
+#endif
+
 #endif /* LIBMARY_WIN32_IOCP */
 
 }
@@ -29,6 +29,7 @@
 #include <libmary/code_referenced.h>
 #include <libmary/exception.h>
 #include <libmary/cb.h>
+#include <libmary/intrusive_list.h>
 
 
 namespace M {
@@ -49,6 +50,12 @@ public:
 public:
     struct OutputFrontend {
 	void (*processOutput) (void *cb_data);
+
+        // Called when zero-copy writes with sequence numbers from 'first_seq'
+        // to 'last_seq' inclusive have completed (see writevZeroCopy()).
+        void (*zeroCopyComplete) (Uint32  first_seq,
+                                  Uint32  last_seq,
+                                  void   *cb_data);
     };
 
 protected:
@@ -62,6 +69,47 @@ public:
 					    Count         num_iovs,
 					    Size         *ret_nwritten);
 
+  #ifndef LIBMARY_PLATFORM_WIN32
+    // Zero-copy writes of a user of writevZeroCopy() which is going away
+    // before the writes have completed. See adoptZeroCopyOrphan().
+    class ZeroCopyOrphan : public IntrusiveListElement<>
+    {
+    public:
+        // Called for every completion notification. Returns true when all
+        // writes of the orphan have completed. The orphan is deleted then.
+        virtual bool zeroCopyComplete (Uint32 first_seq,
+                                       Uint32 last_seq) = 0;
+
+        virtual ~ZeroCopyOrphan () {}
+    };
+
+    typedef IntrusiveList<ZeroCopyOrphan> ZeroCopyOrphanList;
+
+    // Enables writevZeroCopy(). Fails if zero-copy output is not supported.
+    virtual mt_throws Result enableZeroCopy ();
+
+    // Takes over pending zero-copy writes. The kernel may keep transmitting
+    // written data after the stream is closed, hence the orphan is kept
+    // until its writes complete, possibly longer than the stream itself.
+    virtual void adoptZeroCopyOrphan (ZeroCopyOrphan * mt_nonnull orphan);
+
+    // Same as writev(), but data may be transmitted directly from user memory.
+    // If '*ret_zerocopy' is set to true, then written data must be kept
+    // intact until OutputFrontend::zeroCopyComplete() is called for '*ret_seq'.
+    virtual mt_throws AsyncIoResult writevZeroCopy (struct iovec *iovs,
+                                                    Count         num_iovs,
+                                                    Size         *ret_nwritten,
+                                                    bool         *ret_zerocopy,
+                                                    Uint32       *ret_seq);
+
+    // Writes up to 'len' bytes of file 'in_fd' starting at 'offset'.
+    // The default implementation reads the file with pread() and calls write().
+    virtual mt_throws AsyncIoResult sendfile (int         in_fd,
+                                              FileOffset  offset,
+                                              Size        len,
+                                              Size       *ret_nwritten);
+  #endif
+
     mt_const void setOutputFrontend (CbDesc<OutputFrontend> const &output_frontend)
         { this->output_frontend = output_frontend; }
 #endif
@@ -220,6 +220,48 @@ public:
     }
 };
 
+// Size-wide counter. add() and sub() are implemented with compareAndExchange()
+// of AtomicPointer, since there's no portable glib primitive for that.
+class AtomicSize
+{
+private:
+    AtomicPointer value;
+
+public:
+    void set (Size const value)
+    {
+        this->value.set ((void*) (UintPtr) value);
+    }
+
+    Size get () const
+    {
+        return (Size) (UintPtr) value.get ();
+    }
+
+    void add (Size const a)
+    {
+        for (;;) {
+            void * const old_value = value.get ();
+            if (value.compareAndExchange (old_value, (void*) ((UintPtr) old_value + a)))
+                break;
+        }
+    }
+
+    void sub (Size const a)
+    {
+        for (;;) {
+            void * const old_value = value.get ();
+            if (value.compareAndExchange (old_value, (void*) ((UintPtr) old_value - a)))
+                break;
+        }
+    }
+
+    AtomicSize (Size const value = 0)
+        : value ((void*) (UintPtr) value)
+    {
+    }
+};
+
 #ifdef LIBMARY_MT_SAFE
 extern volatile gint _libMary_dummy_mb_int;
 
@@ -40,6 +40,10 @@ public:
 
 #ifdef LIBMARY_ENABLE_MWRITEV
     virtual int getFd () = 0;
+#elif defined (LIBMARY_ENABLE_IO_URING)
+    // Used for batched output (see DeferredConnectionSenderQueue::setBatchedFlush()).
+    // Connections without a socket return -1 and are written with writev().
+    virtual int getFd () { return -1; }
 #endif
 
     Connection ()
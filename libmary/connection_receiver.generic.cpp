@@ -17,7 +17,13 @@
 */
 
 
+#include <libmary/types.h>
+#ifndef LIBMARY_PLATFORM_WIN32
+#include <sys/uio.h>
+#endif
+
 #include <libmary/log.h>
+#include <libmary/libmary_thread_local.h>
 
 #include <libmary/connection_receiver.h>
 
@@ -26,6 +32,87 @@ namespace M {
 
 static LogGroup libMary_logGroup_msg ("msg", LogLevel::N);
 
+// Free receive buffers are linked through their first bytes.
+class ConnectionReceiver_FreeBuffer
+{
+public:
+    ConnectionReceiver_FreeBuffer *next;
+    Size len;
+};
+
+enum {
+    // Max number of free receive buffers cached by each thread.
+    RecvBufCacheMaxSize = 16
+};
+
+Byte*
+ConnectionReceiver::grabRecvBuffer (Size const len)
+{
+    LibMary_ThreadLocal * const tlocal = libMary_getThreadLocal();
+
+    ConnectionReceiver_FreeBuffer **prv_ptr = &tlocal->recv_buf_cache;
+    while (*prv_ptr) {
+        ConnectionReceiver_FreeBuffer * const free_buf = *prv_ptr;
+        if (free_buf->len == len) {
+            *prv_ptr = free_buf->next;
+            --tlocal->recv_buf_cache_size;
+            return reinterpret_cast <Byte*> (free_buf);
+        }
+
+        prv_ptr = &free_buf->next;
+    }
+
+    Byte * const buf = new (std::nothrow) Byte [len];
+    assert (buf);
+    return buf;
+}
+
+void
+ConnectionReceiver::putRecvBuffer (Byte * const mt_nonnull buf,
+                                   Size   const len)
+{
+    LibMary_ThreadLocal * const tlocal = libMary_getThreadLocal();
+
+    if (len < sizeof (ConnectionReceiver_FreeBuffer)
+        || tlocal->recv_buf_cache_size >= RecvBufCacheMaxSize)
+    {
+        delete[] buf;
+        return;
+    }
+
+    ConnectionReceiver_FreeBuffer * const free_buf = reinterpret_cast <ConnectionReceiver_FreeBuffer*> (buf);
+    free_buf->next = tlocal->recv_buf_cache;
+    free_buf->len = len;
+    tlocal->recv_buf_cache = free_buf;
+    ++tlocal->recv_buf_cache_size;
+}
+
+void
+ConnectionReceiver::releaseThreadBuffers (LibMary_ThreadLocal * const mt_nonnull tlocal)
+{
+    ConnectionReceiver_FreeBuffer *free_buf = tlocal->recv_buf_cache;
+    while (free_buf) {
+        ConnectionReceiver_FreeBuffer * const next_buf = free_buf->next;
+        delete[] reinterpret_cast <Byte*> (free_buf);
+        free_buf = next_buf;
+    }
+
+    tlocal->recv_buf_cache = NULL;
+    tlocal->recv_buf_cache_size = 0;
+}
+
+mt_sync_domain (conn_input_frontend) void
+ConnectionReceiver::releaseIdleRecvBuffer ()
+{
+    if (!recv_buf || recv_accepted_pos != recv_buf_pos)
+        return;
+
+    putRecvBuffer (recv_buf, recv_buf_len);
+    recv_buf = NULL;
+    recv_buf_pos = 0;
+    recv_accepted_pos = 0;
+}
+
 mt_sync_domain (conn_input_frontend) void
 ConnectionReceiver::doProcessInput ()
 {
@@ -35,6 +122,11 @@ ConnectionReceiver::doProcessInput ()
         return;
 
     for (;;) {
+        // The buffer is allocated only when there's data to read and is
+        // returned to the thread's cache once all input has been accepted.
+        if (!recv_buf)
+            recv_buf = grabRecvBuffer (recv_buf_len);
+
 	assert (recv_buf_pos <= recv_buf_len);
 	Size const toread = recv_buf_len - recv_buf_pos;
 
@@ -47,10 +139,12 @@ ConnectionReceiver::doProcessInput ()
 	    switch (io_res) {
 		case AsyncIoResult::Again: {
 		    // TODO if (recv_buf_pos >= recv_buf_len) then error.
+                    releaseIdleRecvBuffer ();
 		    return;
 		} break;
 		case AsyncIoResult::Error: {
 		    logD_ (_func, "read() failed: ", exc->toString());
+                    releaseIdleRecvBuffer ();
 		    if (!error_reported) {
 			error_reported = true;
 			if (frontend && frontend->processError)
@@ -59,6 +153,7 @@ ConnectionReceiver::doProcessInput ()
 		    return;
 		} break;
 		case AsyncIoResult::Eof: {
+                    releaseIdleRecvBuffer ();
 		    if (frontend && frontend->processEof)
 			frontend.call (frontend->processEof);
 		    return;
@@ -103,6 +198,8 @@ ConnectionReceiver::doProcessInput ()
 		break;
 	    case ProcessInputResult::Error:
 //		logD_ (_func, "user's input handler failed");
+                recv_accepted_pos = recv_buf_pos;
+                releaseIdleRecvBuffer ();
 		if (!error_reported) {
 		    error_reported = true;
 		    if (frontend && frontend->processError) {
@@ -122,27 +219,42 @@ ConnectionReceiver::doProcessInput ()
 		    }
 		}
 		// If the buffer is full and the frontend wants more data, then
-		// we fail to serve the client. This should never happen with
-		// properly written frontends.
+		// we fail to serve the client. This happens when the buffer is
+		// too small for the frontend's input, e.g. for a long HTTP header
+		// field, and is reported as an error of the connection.
 		if (recv_buf_pos >= recv_buf_len) {
-		    logF_ (_this_func, "Read buffer is full, frontend should have consumed some data. "
+		    logW_ (_this_func, "Read buffer is full, frontend should have consumed some data. "
 			   "recv_accepted_pos: ", recv_accepted_pos, ", "
 			   "recv_buf_pos: ", recv_buf_pos, ", "
 			   "recv_buf_len: ", recv_buf_len);
-		    unreachable ();
+
+                    recv_accepted_pos = recv_buf_pos;
+                    releaseIdleRecvBuffer ();
+		    if (!error_reported) {
+			error_reported = true;
+			if (frontend && frontend->processError) {
+			    InternalException internal_exc (InternalException::FrontendError);
+			    frontend.call (frontend->processError, /*(*/ &internal_exc /*)*/);
+			}
+		    }
+		    return;
 		}
 		break;
             case ProcessInputResult::InputBlocked:
                 recv_accepted_pos += num_accepted;
+                releaseIdleRecvBuffer ();
                 return;
 	    default:
 		unreachable ();
 	}
 
-	if (io_res == AsyncIoResult::Normal_Again)
+	if (io_res == AsyncIoResult::Normal_Again) {
+            releaseIdleRecvBuffer ();
 	    return;
+        }
 
 	if (io_res == AsyncIoResult::Normal_Eof) {
+            releaseIdleRecvBuffer ();
 	    if (frontend && frontend->processEof)
 		frontend.call (frontend->processEof);
 	    return;
@@ -150,6 +262,228 @@ ConnectionReceiver::doProcessInput ()
     } // for (;;)
 }
 
+mt_sync_domain (conn_input_frontend) void
+ConnectionReceiver::releaseRecvPages ()
+{
+    PagePool::Page *page = recv_pages.first;
+    while (page) {
+        PagePool::Page * const next_page = (page != recv_pages.last ? page->getNextMsgPage() : NULL);
+        page_pool->pageUnref (page);
+        page = next_page;
+    }
+
+    recv_pages.reset ();
+    recv_pages_offset = 0;
+    recv_pages_len = 0;
+}
+
+mt_sync_domain (conn_input_frontend) bool
+ConnectionReceiver::usePageReceiveMode ()
+{
+    // Frontends which don't support page input get the buffered one.
+    return page_pool && (!frontend || frontend->processInputPages);
+}
+
+mt_sync_domain (conn_input_frontend) void
+ConnectionReceiver::doProcessInputPages ()
+{
+    logD (msg, _func_);
+
+    if (block_input || error_reported)
+        return;
+
+    Size const page_size = page_pool->getPageSize();
+
+    for (;;) {
+        // Pages referenced by the frontend are never modified or relinked.
+        // If the last page is shared, unaccepted data is moved to new pages.
+        if (recv_pages.last && recv_pages.last->getRefcount() > 1) {
+            PagePool::PageListHead pages;
+            if (recv_pages_len > 0)
+                page_pool->getFillPagesFromPages (&pages, recv_pages.first, recv_pages_offset, recv_pages_len);
+
+            Size const len = recv_pages_len;
+            releaseRecvPages ();
+            recv_pages = pages;
+            recv_pages_len = len;
+        }
+
+        struct iovec iovs [64];
+        Count num_iovs = 0;
+        Size toread = 0;
+
+        // Appending to the last page if no one else holds a reference to it.
+        PagePool::Page * const last_page = recv_pages.last;
+        bool const append_to_last_page = last_page
+                                         && last_page->getRefcount() == 1
+                                         && last_page->data_len < page_size;
+        if (append_to_last_page) {
+            iovs [0].iov_base = last_page->getData() + last_page->data_len;
+            iovs [0].iov_len  = page_size - last_page->data_len;
+            toread += iovs [0].iov_len;
+            ++num_iovs;
+        }
+
+        PagePool::PageListHead new_pages;
+        if (toread < page_recv_len) {
+            Count num_new_pages = (page_recv_len - toread + page_size - 1) / page_size;
+            if (num_new_pages > sizeof (iovs) / sizeof (iovs [0]) - num_iovs)
+                num_new_pages = sizeof (iovs) / sizeof (iovs [0]) - num_iovs;
+
+            page_pool->getPages (&new_pages, num_new_pages * page_size);
+
+            PagePool::Page *page = new_pages.first;
+            while (page) {
+                iovs [num_iovs].iov_base = page->getData();
+                iovs [num_iovs].iov_len  = page_size;
+                toread += page_size;
+                ++num_iovs;
+
+                page = page->getNextMsgPage();
+            }
+        }
+
+        Size nread = 0;
+        AsyncIoResult const io_res = conn->readv (iovs, num_iovs, &nread);
+        logD (msg, _func, "readv(): ", io_res);
+        switch (io_res) {
+            case AsyncIoResult::Again: {
+                page_pool->msgUnref (new_pages.first);
+                return;
+            } break;
+            case AsyncIoResult::Error: {
+                page_pool->msgUnref (new_pages.first);
+                logD_ (_func, "readv() failed: ", exc->toString());
+                if (!error_reported) {
+                    error_reported = true;
+                    if (frontend && frontend->processError)
+                        frontend.call (frontend->processError, /*(*/ exc /*)*/);
+                }
+                return;
+            } break;
+            case AsyncIoResult::Eof: {
+                page_pool->msgUnref (new_pages.first);
+                if (frontend && frontend->processEof)
+                    frontend.call (frontend->processEof);
+                return;
+            } break;
+            case AsyncIoResult::Normal:
+            case AsyncIoResult::Normal_Again:
+            case AsyncIoResult::Normal_Eof:
+              // No-op
+                break;
+            default:
+                unreachable ();
+        }
+        assert (nread <= toread);
+        recv_pages_len += nread;
+
+        {
+          // Distributing received bytes among the pages.
+
+            Size left = nread;
+            if (append_to_last_page) {
+                Size const len = (left < iovs [0].iov_len ? left : iovs [0].iov_len);
+                last_page->data_len += len;
+                left -= len;
+            }
+
+            while (left > 0) {
+                PagePool::Page * const page = new_pages.first;
+                assert (page);
+                new_pages.first = page->getNextMsgPage();
+
+                page->data_len = (left < page_size ? left : page_size);
+                left -= page->data_len;
+
+                recv_pages.appendPage (page);
+            }
+
+            // Unused pages go back to the pool.
+            page_pool->msgUnref (new_pages.first);
+        }
+
+        logD (msg, _func, "nread: ", nread, ", recv_pages_offset: ", recv_pages_offset, ", recv_pages_len: ", recv_pages_len);
+
+        Size num_accepted;
+        ProcessInputResult res;
+        if (frontend) {
+            assert (frontend->processInputPages);
+            if (!frontend.call_ret<ProcessInputResult> (&res, frontend->processInputPages, /*(*/
+                         recv_pages.first, recv_pages_offset, recv_pages_len, &num_accepted /*)*/))
+            {
+                res = ProcessInputResult::Error;
+                num_accepted = 0;
+            }
+        } else {
+            res = ProcessInputResult::Normal;
+            num_accepted = recv_pages_len;
+        }
+        assert (num_accepted <= recv_pages_len);
+        logD (msg, _func, res);
+
+        {
+          // Releasing accepted pages.
+
+            recv_pages_len -= num_accepted;
+            num_accepted += recv_pages_offset;
+            while (recv_pages.first && num_accepted >= recv_pages.first->data_len) {
+                // Keeping the last page if it is not full yet, so that
+                // subsequent reads could fill it.
+                if (recv_pages.first == recv_pages.last
+                    && recv_pages_len == 0
+                    && recv_pages.first->data_len < page_size
+                    && recv_pages.first->getRefcount() == 1)
+                {
+                    break;
+                }
+
+                // Not touching 'next_msg_page' link, since the page
+                // may be referenced by the frontend.
+                PagePool::Page * const page = recv_pages.first;
+                if (page == recv_pages.last)
+                    recv_pages.reset ();
+                else
+                    recv_pages.first = page->getNextMsgPage();
+
+                num_accepted -= page->data_len;
+                page_pool->pageUnref (page);
+            }
+            recv_pages_offset = num_accepted;
+        }
+
+        switch (res) {
+            case ProcessInputResult::Normal:
+                assert (recv_pages_len == 0);
+                break;
+            case ProcessInputResult::Error:
+                if (!error_reported) {
+                    error_reported = true;
+                    if (frontend && frontend->processError) {
+                        InternalException internal_exc (InternalException::FrontendError);
+                        frontend.call (frontend->processError, /*(*/ &internal_exc /*)*/);
+                    }
+                }
+                return;
+            case ProcessInputResult::Again:
+                break;
+            case ProcessInputResult::InputBlocked:
+                return;
+            default:
+                unreachable ();
+        }
+
+        if (io_res == AsyncIoResult::Normal_Again)
+            return;
+
+        if (io_res == AsyncIoResult::Normal_Eof) {
+            if (frontend && frontend->processEof)
+                frontend.call (frontend->processEof);
+            return;
+        }
+    } // for (;;)
+}
+
 AsyncInputStream::InputFrontend const ConnectionReceiver::conn_input_frontend = {
     processInput,
     processError
@@ -159,7 +493,11 @@ void
 ConnectionReceiver::processInput (void * const _self)
 {
     ConnectionReceiver * const self = static_cast <ConnectionReceiver*> (_self);
-    self->doProcessInput ();
+
+    if (self->usePageReceiveMode ())
+        self->doProcessInputPages ();
+    else
+        self->doProcessInput ();
 }
 
 void
@@ -193,7 +531,11 @@ ConnectionReceiver::unblockInputTask (void * const _self)
     }
 
     self->block_input = false;
-    self->doProcessInput ();
+    if (self->usePageReceiveMode ())
+        self->doProcessInputPages ();
+    else
+        self->doProcessInput ();
+
     return false;
 }
 
@@ -210,6 +552,23 @@ ConnectionReceiver::start ()
         deferred_reg.scheduleTask (&unblock_input_task, false /* permanent */);
 }
 
+mt_const void
+ConnectionReceiver::setPageReceiveMode (PagePool * const mt_nonnull page_pool,
+                                        Size       const recv_len)
+{
+    assert (recv_len > 0);
+
+    this->page_pool = page_pool;
+    this->page_recv_len = recv_len;
+}
+
+mt_const void
+ConnectionReceiver::setRecvBufferSize (Size const recv_buf_len)
+{
+    assert (recv_buf_len > 0);
+    this->recv_buf_len = recv_buf_len;
+}
+
 mt_const void
 ConnectionReceiver::init (AsyncInputStream  * const mt_nonnull conn,
                           DeferredProcessor * const mt_nonnull deferred_processor,
@@ -220,9 +579,6 @@ ConnectionReceiver::init (AsyncInputStream  * const mt_nonnull conn,
 
     deferred_reg.setDeferredProcessor (deferred_processor);
 
-    recv_buf = new (std::nothrow) Byte [recv_buf_len];
-    assert (recv_buf);
-
     conn->setInputFrontend (
             CbDesc<AsyncInputStream::InputFrontend> (&conn_input_frontend, this, getCoderefContainer()));
 }
@@ -233,6 +589,10 @@ ConnectionReceiver::ConnectionReceiver (Object * const coderef_container)
       recv_buf_len      (1 << 16 /* 64 Kb */),
       recv_buf_pos      (0),
       recv_accepted_pos (0),
+      page_pool         (coderef_container),
+      page_recv_len     (0),
+      recv_pages_offset (0),
+      recv_pages_len    (0),
       block_input       (false),
       error_received    (false),
       error_reported    (false)
@@ -245,7 +605,10 @@ ConnectionReceiver::ConnectionReceiver (Object * const coderef_container)
 ConnectionReceiver::~ConnectionReceiver ()
 {
     if (recv_buf)
-        delete[] recv_buf;
+        putRecvBuffer (recv_buf, recv_buf_len);
+
+    if (page_pool)
+        releaseRecvPages ();
 }
 
 }
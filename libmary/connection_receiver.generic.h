@@ -24,11 +24,15 @@
 #include <libmary/receiver.h>
 #include <libmary/async_input_stream.h>
 #include <libmary/code_referenced.h>
+#include <libmary/dep_ref.h>
+#include <libmary/page_pool.h>
 
 
 namespace M {
 
 
+class LibMary_ThreadLocal;
+
 // TODO Rename to AsyncReceiver. It now depends on AsyncInputStream, not on Connection.
 
 // Synchronized externally by the associated AsyncInputStream object.
@@ -41,12 +45,36 @@ private:
 
     mt_const AsyncInputStream *conn;
 
-    mt_const Byte *recv_buf;
-    mt_const Size const recv_buf_len;
+    // Allocated on demand, NULL when there's no unaccepted data.
+    mt_sync_domain (conn_input_frontend) Byte *recv_buf;
+    mt_const Size recv_buf_len;
 
     mt_sync_domain (conn_input_frontend) Size recv_buf_pos;
     mt_sync_domain (conn_input_frontend) Size recv_accepted_pos;
 
+    // Page receive mode: data is read directly into pages from 'page_pool'.
+    mt_const DataDepRef<PagePool> page_pool;
+    mt_const Size page_recv_len;
+
+    // Received data which has not been accepted by the frontend yet.
+    mt_sync_domain (conn_input_frontend) PagePool::PageListHead recv_pages;
+    // Offset of unaccepted data in the first page of 'recv_pages'.
+    mt_sync_domain (conn_input_frontend) Size recv_pages_offset;
+    mt_sync_domain (conn_input_frontend) Size recv_pages_len;
+
+    static Byte* grabRecvBuffer (Size len);
+
+    static void putRecvBuffer (Byte * mt_nonnull buf,
+                               Size   len);
+
+    mt_sync_domain (conn_input_frontend) void releaseIdleRecvBuffer ();
+
+    mt_sync_domain (conn_input_frontend) void releaseRecvPages ();
+
+    mt_sync_domain (conn_input_frontend) bool usePageReceiveMode ();
+
+    mt_sync_domain (conn_input_frontend) void doProcessInputPages ();
+
     mt_sync_domain (conn_input_frontend) bool block_input;
     mt_sync_domain (conn_input_frontend) bool error_received;
     mt_sync_domain (conn_input_frontend) bool error_reported;
@@ -71,10 +99,27 @@ public:
 
     void start ();
 
+    // Sets receive buffer size, 64 Kb by default. If the buffer gets full and
+    // the frontend accepts nothing, then the connection fails with
+    // InternalException::FrontendError. Should be called before init().
+    mt_const void setRecvBufferSize (Size recv_buf_len);
+
+    // Enables zero-copy page receive mode: up to 'recv_len' bytes are read
+    // at once with readv() directly into pages from 'page_pool', and
+    // received data is passed to Frontend::processInputPages().
+    // No receive buffer is allocated in this mode. Frontends which don't
+    // implement processInputPages() get buffered input via processInput().
+    // Should be called before init().
+    mt_const void setPageReceiveMode (PagePool * mt_nonnull page_pool,
+                                      Size      recv_len = 1 << 16 /* 64 Kb */);
+
     mt_const void init (AsyncInputStream  * mt_nonnull conn,
                         DeferredProcessor * mt_nonnull deferred_processor,
                         bool               block_input = false);
 
+    // Frees receive buffers cached by the thread. Called at thread exit.
+    static void releaseThreadBuffers (LibMary_ThreadLocal * mt_nonnull tlocal);
+
      ConnectionReceiver (Object * const coderef_container);
     ~ConnectionReceiver ();
 };
@@ -48,7 +48,8 @@ ConnectionSenderImpl::SenderOverlapped::~SenderOverlapped ()
     while (!msg_iter.done()) {
         Sender::MessageEntry * const msg_entry = msg_iter.next ();
         Sender::MessageEntry_Pages * const msg_pages = static_cast <Sender::MessageEntry_Pages*> (msg_entry);
-        msg_pages->page_pool->msgUnref (msg_pages->first_pending_page);
+        if (!msg_pages->broadcast)
+            msg_pages->page_pool->msgUnref (msg_pages->first_pending_page);
         msg_pages->setFirstPage (NULL);
         Sender::deleteMessageEntry (msg_entry);
     }
@@ -91,6 +92,9 @@ ConnectionSenderImpl::resetSendingState ()
 
     sending_message = true;
     send_header_sent = 0;
+#ifndef LIBMARY_PLATFORM_WIN32
+    send_file_pos = 0;
+#endif
 
     Sender::MessageEntry * const cur_msg = msg_list.getFirst();
 
@@ -111,7 +115,9 @@ ConnectionSenderImpl::popPage (Sender::MessageEntry_Pages * const mt_nonnull msg
     PagePool::Page * const next_page = page->getNextMsgPage();
 
 #ifndef LIBMARY_WIN32_IOCP
-    msg_pages->page_pool->pageUnref (msg_pages->getFirstPage());
+    // Pages of broadcast messages are shared by all recipients.
+    if (!msg_pages->broadcast)
+        msg_pages->page_pool->pageUnref (msg_pages->getFirstPage());
 #endif
 
     msg_pages->msg_offset = 0;
@@ -120,6 +126,47 @@ ConnectionSenderImpl::popPage (Sender::MessageEntry_Pages * const mt_nonnull msg
     msg_pages->setFirstPageNoPending (next_page);
 }
 
+bool
+ConnectionSenderImpl::popSentMessage (Sender::MessageEntry * const mt_nonnull msg_entry)
+{
+  // This is the only place where messages are removed from the queue.
+
+    bool const barrier_reached = enable_processing_barrier && msg_entry == processing_barrier;
+
+    msg_list.remove (msg_entry);
+#ifndef LIBMARY_WIN32_IOCP
+    Sender::deleteMessageEntry (msg_entry);
+#endif
+
+    --num_msg_entries;
+    if (mt_unlikely (send_state == Sender::QueueSoftLimit ||
+                     send_state == Sender::QueueHardLimit))
+    {
+        if (num_msg_entries < soft_msg_limit) {
+            if (overloaded)
+                setSendState (Sender::ConnectionOverloaded);
+            else
+                setSendState (Sender::ConnectionReady);
+        } else
+        if (num_msg_entries < hard_msg_limit)
+            setSendState (Sender::QueueSoftLimit);
+    }
+
+    logD (send, _func, "calling resetSendingState()");
+    resetSendingState ();
+
+    if (mt_unlikely (barrier_reached)) {
+        processing_barrier = NULL;
+
+        if (gotDataToSend())
+            processing_barrier_hit = true;
+
+        return true;
+    }
+
+    return false;
+}
+
 #ifdef LIBMARY_WIN32_IOCP
 #warning TODO Communicate the number of bytes transferred here and compare it with the expected value.
 #warning      Can it be less during normal operation (without I/O errors)?
@@ -136,7 +183,8 @@ ConnectionSenderImpl::outputComplete ()
                 break;
 
             Sender::MessageEntry_Pages * const msg_pages = static_cast <Sender::MessageEntry_Pages*> (msg_entry);
-            msg_pages->page_pool->msgUnref (msg_pages->first_pending_page);
+            if (!msg_pages->broadcast)
+                msg_pages->page_pool->msgUnref (msg_pages->first_pending_page);
             msg_pages->setFirstPage (NULL);
 
             sender_overlapped->pending_msg_list.remove (msg_entry);
@@ -177,7 +225,7 @@ ConnectionSenderImpl::sendPendingMessages ()
     return sendPendingMessages_writev ();
 }
 
-#ifdef LIBMARY_ENABLE_MWRITEV
+#if defined (LIBMARY_ENABLE_MWRITEV) || defined (LIBMARY_ENABLE_IO_URING)
 void
 ConnectionSenderImpl::sendPendingMessages_fillIovs (Count        * const ret_num_iovs,
 						    struct iovec * const ret_iovs,
@@ -208,6 +256,15 @@ ConnectionSenderImpl::sendPendingMessages_fillIovs (Count        * const ret_num
 	return;
     }
 
+#ifndef LIBMARY_PLATFORM_WIN32
+    if (msg_list.getFirst()->type == Sender::MessageEntry::File
+        || zerocopy_enabled)
+    {
+        logD (send, _func, "not a plain writev");
+        return;
+    }
+#endif
+
     sendPendingMessages_vector_fill (ret_num_iovs,
 				     ret_iovs,
 				     IOV_MAX <= max_iovs ? IOV_MAX : max_iovs /* num_iovs */);
@@ -242,7 +299,7 @@ ConnectionSenderImpl::sendPendingMessages_react (AsyncIoResult res,
 	return;
     }
 }
-#endif // LIBMARY_ENABLE_MWRITEV
+#endif // LIBMARY_ENABLE_MWRITEV || LIBMARY_ENABLE_IO_URING
 
 AsyncIoResult
 ConnectionSenderImpl::sendPendingMessages_writev ()
@@ -267,6 +324,26 @@ ConnectionSenderImpl::sendPendingMessages_writev ()
 	    return AsyncIoResult::Normal;
 	}
 
+#ifndef LIBMARY_PLATFORM_WIN32
+        if (msg_list.getFirst()->type == Sender::MessageEntry::File) {
+            AsyncIoResult const res = sendPendingMessages_file ();
+            if (res != AsyncIoResult::Normal)
+                return res;
+
+            continue;
+        }
+
+        if (zerocopy_enabled) {
+            AsyncIoResult res;
+            if (sendPendingMessages_zerocopy (&res)) {
+                if (res != AsyncIoResult::Normal)
+                    return res;
+
+                continue;
+            }
+        }
+#endif
+
 	Count num_iovs = 0;
 
 #ifdef LIBMARY_WIN32_IOCP
@@ -375,6 +452,235 @@ ConnectionSenderImpl::sendPendingMessages_writev ()
     return AsyncIoResult::Normal;
 }
 
+#ifndef LIBMARY_PLATFORM_WIN32
+AsyncIoResult
+ConnectionSenderImpl::sendPendingMessages_file ()
+    mt_throw ((IoException,
+	       InternalException))
+{
+    if (mt_unlikely (enable_processing_barrier
+		     && !processing_barrier))
+    {
+	processing_barrier_hit = true;
+	logD (send, _func, "processing barrier is NULL");
+	return AsyncIoResult::Normal;
+    }
+
+    Sender::MessageEntry_File * const msg_file = static_cast <Sender::MessageEntry_File*> (msg_list.getFirst());
+    assert (send_file_pos < msg_file->len);
+
+    FileSize const left = msg_file->len - send_file_pos;
+    Size const tosend = (left > (FileSize) (Size) -1 ? (Size) -1 : (Size) left);
+
+    Size num_written = 0;
+    AsyncIoResult const res = conn->sendfile (msg_file->fd,
+                                              msg_file->offset + (FileOffset) send_file_pos,
+                                              tosend,
+                                              &num_written);
+    if (res == AsyncIoResult::Error)
+        return AsyncIoResult::Error;
+
+    if (res == AsyncIoResult::Again) {
+        if (send_state == Sender::ConnectionReady)
+            setSendState (Sender::ConnectionOverloaded);
+
+        logD (send, _func, "connection overloaded");
+        overloaded = true;
+        return AsyncIoResult::Again;
+    }
+
+    if (res == AsyncIoResult::Eof) {
+        logD (close, _func, "Eof");
+        return AsyncIoResult::Eof;
+    }
+
+    subPendingBytes (num_written);
+
+    send_file_pos += num_written;
+    if (send_file_pos >= msg_file->len)
+        popSentMessage (msg_file);
+
+    return AsyncIoResult::Normal;
+}
+#endif
+
+#ifndef LIBMARY_PLATFORM_WIN32
+void
+ConnectionSenderImpl::releaseZeroCopyBatch (ZeroCopyBatch * const mt_nonnull batch)
+{
+    ZeroCopyPage * const pages = batch->getPages();
+    for (Count i = 0; i < batch->num_pages; ++i)
+        pages [i].page_pool->pageUnref (pages [i].page);
+
+    batch->~ZeroCopyBatch ();
+    delete[] reinterpret_cast <Byte*> (batch);
+}
+
+void
+ConnectionSenderImpl::releaseZeroCopyBatches (ZeroCopyBatchList * const mt_nonnull batch_list,
+                                              Uint32              const first_seq,
+                                              Uint32              const last_seq)
+{
+    ZeroCopyBatchList::iter iter (*batch_list);
+    while (!batch_list->iter_done (iter)) {
+        ZeroCopyBatch * const batch = batch_list->iter_next (iter);
+        // Sequence numbers wrap around.
+        if (batch->seq - first_seq <= last_seq - first_seq) {
+            batch_list->remove (batch);
+            releaseZeroCopyBatch (batch);
+        }
+    }
+}
+
+bool
+ConnectionSenderImpl::ZeroCopyOrphan::zeroCopyComplete (Uint32 const first_seq,
+                                                        Uint32 const last_seq)
+{
+    releaseZeroCopyBatches (&batch_list, first_seq, last_seq);
+    return batch_list.isEmpty();
+}
+
+ConnectionSenderImpl::ZeroCopyOrphan::~ZeroCopyOrphan ()
+{
+    ZeroCopyBatchList::iter iter (batch_list);
+    while (!batch_list.iter_done (iter)) {
+        ZeroCopyBatch * const batch = batch_list.iter_next (iter);
+        releaseZeroCopyBatch (batch);
+    }
+}
+
+bool
+ConnectionSenderImpl::sendPendingMessages_zerocopy (AsyncIoResult * const mt_nonnull ret_res)
+    mt_throw ((IoException,
+	       InternalException))
+{
+    Sender::MessageEntry * const msg_entry = msg_list.getFirst();
+    if (msg_entry->type != Sender::MessageEntry::Pages)
+        return false;
+
+    if (enable_processing_barrier && !processing_barrier)
+        return false;
+
+    Sender::MessageEntry_Pages * const msg_pages = static_cast <Sender::MessageEntry_Pages*> (msg_entry);
+
+    struct iovec iovs [IOV_MAX];
+    PagePool::Page *iov_pages [IOV_MAX];
+    Count num_iovs = 0;
+    Size total_len = 0;
+    {
+        PagePool::Page *page = msg_pages->getFirstPage();
+        Size offset = send_cur_offset;
+        while (page && num_iovs < IOV_MAX) {
+            if (page->data_len > offset) {
+                iovs [num_iovs].iov_base = page->getData() + offset;
+                iovs [num_iovs].iov_len  = page->data_len - offset;
+                iov_pages [num_iovs] = page;
+                total_len += page->data_len - offset;
+                ++num_iovs;
+            }
+
+            offset = 0;
+            page = page->getNextMsgPage();
+        }
+    }
+
+    if (total_len == 0 || total_len < zerocopy_threshold)
+        return false;
+
+    Size num_written = 0;
+    bool zerocopy = false;
+    Uint32 seq = 0;
+    AsyncIoResult res;
+    if (send_header_sent < msg_pages->header_len) {
+      // Message header lives in the message entry, which is deleted as soon as
+      // the message is sent, so it can't be left to the kernel until zero-copy
+      // completion. The header is written alone with plain writev(), and page
+      // data follows with writevZeroCopy() on the next iteration.
+        struct iovec header_iov;
+        header_iov.iov_base = msg_pages->getHeaderData() + send_header_sent;
+        header_iov.iov_len  = msg_pages->header_len - send_header_sent;
+        res = conn->writev (&header_iov, 1, &num_written);
+    } else {
+        res = conn->writevZeroCopy (iovs, num_iovs, &num_written, &zerocopy, &seq);
+    }
+
+    if (res == AsyncIoResult::Error) {
+        *ret_res = AsyncIoResult::Error;
+        return true;
+    }
+
+    if (res == AsyncIoResult::Again) {
+        if (send_state == Sender::ConnectionReady)
+            setSendState (Sender::ConnectionOverloaded);
+
+        logD (send, _func, "connection overloaded");
+        overloaded = true;
+
+        *ret_res = AsyncIoResult::Again;
+        return true;
+    }
+
+    if (res == AsyncIoResult::Eof) {
+        logD (close, _func, "Eof, num_iovs: ", num_iovs);
+        *ret_res = AsyncIoResult::Eof;
+        return true;
+    }
+
+    if (zerocopy && num_written > 0) {
+        Count num_pages = 0;
+        {
+            Size len = 0;
+            while (len < num_written) {
+                len += iovs [num_pages].iov_len;
+                ++num_pages;
+            }
+        }
+
+        Byte * const buf = new (std::nothrow) Byte [sizeof (ZeroCopyBatch) + sizeof (ZeroCopyPage) * num_pages];
+        assert (buf);
+        ZeroCopyBatch * const batch = new (buf) ZeroCopyBatch;
+        batch->seq = seq;
+        batch->num_pages = num_pages;
+
+        PagePool * const page_pool = msg_pages->getPagePool();
+        ZeroCopyPage * const pages = batch->getPages();
+        for (Count i = 0; i < num_pages; ++i) {
+            pages [i].page_pool = page_pool;
+            pages [i].page = iov_pages [i];
+            page_pool->pageRef (iov_pages [i]);
+        }
+
+        zerocopy_list.append (batch);
+    }
+
+    sendPendingMessages_vector_react (num_written);
+
+    *ret_res = AsyncIoResult::Normal;
+    return true;
+}
+
+void
+ConnectionSenderImpl::zeroCopyComplete (Uint32 const first_seq,
+                                        Uint32 const last_seq)
+{
+    logD (send, _func, "first_seq: ", first_seq, ", last_seq: ", last_seq);
+
+    releaseZeroCopyBatches (&zerocopy_list, first_seq, last_seq);
+}
+
+mt_const void
+ConnectionSenderImpl::enableZeroCopy (Size const threshold)
+{
+    if (!conn->enableZeroCopy ()) {
+        logW_ (_func, "Zero-copy output is not available: ", exc->toString());
+        return;
+    }
+
+    zerocopy_enabled = true;
+    zerocopy_threshold = threshold;
+}
+#endif
+
 void
 ConnectionSenderImpl::sendPendingMessages_vector_fill (Count        * const mt_nonnull ret_num_iovs,
 #ifdef LIBMARY_WIN32_IOCP
@@ -413,6 +719,10 @@ ConnectionSenderImpl::sendPendingMessages_vector_fill (Count        * const mt_n
     bool first_entry = true;
     Count i = 0;
     while (msg_entry) {
+        // File messages are sent separately with sendfile().
+        if (msg_entry->type != Sender::MessageEntry::Pages)
+            break;
+
 	Sender::MessageEntry * const next_msg_entry = msg_list.getNext (msg_entry);
 	Sender::MessageEntry_Pages * const msg_pages = static_cast <Sender::MessageEntry_Pages*> (msg_entry);
 
@@ -575,6 +885,8 @@ ConnectionSenderImpl::sendPendingMessages_vector_react (Size num_written)
 {
     logD (writev, _func_);
 
+    subPendingBytes (num_written);
+
     Sender::MessageEntry *msg_entry = msg_list.getFirst ();
     if (mt_unlikely (!msg_entry)) {
 	logD (writev, _func, "message queue is empty");
@@ -593,6 +905,9 @@ ConnectionSenderImpl::sendPendingMessages_vector_react (Size num_written)
 
     bool first_entry = true;
     while (msg_entry) {
+        if (msg_entry->type != Sender::MessageEntry::Pages)
+            break;
+
 	Sender::MessageEntry * const next_msg_entry = msg_list.getNext (msg_entry);
 	Sender::MessageEntry_Pages * const msg_pages = static_cast <Sender::MessageEntry_Pages*> (msg_entry);
 
@@ -698,40 +1013,8 @@ ConnectionSenderImpl::sendPendingMessages_vector_react (Size num_written)
 	}
 
 	if (msg_sent_completely) {
-	  // This is the only place where messages are removed from the queue.
-
-	    msg_list.remove (msg_entry);
-#ifndef LIBMARY_WIN32_IOCP
-	    Sender::deleteMessageEntry (msg_entry);
-#endif
-
-	    --num_msg_entries;
-	    if (mt_unlikely (send_state == Sender::QueueSoftLimit ||
-			     send_state == Sender::QueueHardLimit))
-	    {
-		if (num_msg_entries < soft_msg_limit) {
-		    if (overloaded)
-			setSendState (Sender::ConnectionOverloaded);
-		    else
-			setSendState (Sender::ConnectionReady);
-		} else
-		if (num_msg_entries < hard_msg_limit)
-		    setSendState (Sender::QueueSoftLimit);
-	    }
-
-	    logD (send, _func, "calling resetSendingState()");
-	    resetSendingState ();
-
-	    if (mt_unlikely (enable_processing_barrier
-			     && msg_entry == processing_barrier))
-	    {
-		processing_barrier = NULL;
-
-		if (gotDataToSend())
-		    processing_barrier_hit = true;
-
+	    if (popSentMessage (msg_entry))
 		break;
-	    }
 	} else {
 	    assert (gotDataToSend());
 #if 0
@@ -810,6 +1093,13 @@ ConnectionSenderImpl::dumpMessage (Sender::MessageEntry * const mt_nonnull msg_e
 
             delete tmp_data;
         } break;
+#ifndef LIBMARY_PLATFORM_WIN32
+        case Sender::MessageEntry::File: {
+            Sender::MessageEntry_File * const msg_file = static_cast <Sender::MessageEntry_File*> (msg_entry);
+            logD (hexdump, _func, "File message: fd ", msg_file->fd, ", "
+                  "offset ", msg_file->offset, ", len ", msg_file->len);
+        } break;
+#endif
         default:
             unreachable ();
     }
@@ -821,14 +1111,28 @@ ConnectionSenderImpl::queueMessage (Sender::MessageEntry * const mt_nonnull msg_
     if (logLevelOn (hexdump, LogLevel::Debug))
         dumpMessage (msg_entry);
 
+    // Message length is only needed for the shared pending bytes counter.
+    // Walking the page chain is skipped when there's no counter, and
+    // broadcast entries use page data length precalculated for all recipients.
+    Size msg_len = 0;
+
     // Don't queue empty messages, so that gotDataToSend() is correct.
     switch (msg_entry->type) {
         case Sender::MessageEntry::Pages: {
             Sender::MessageEntry_Pages * const msg_pages = static_cast <Sender::MessageEntry_Pages*> (msg_entry);
-            if (msg_pages->header_len == 0) {
-                if (msg_pages->getFirstPage() == NULL)
-                    return;
 
+            if (pending_bytes_counter) {
+                if (msg_pages->broadcast)
+                    msg_len = msg_pages->header_len + msg_pages->broadcast->getPagesDataLen();
+                else
+                    msg_len = msg_pages->getTotalMsgLen();
+            }
+
+            bool empty = false;
+            if (msg_pages->header_len == 0) {
+                if (msg_pages->getFirstPage() == NULL) {
+                    empty = true;
+                } else
                 if (msg_pages->getFirstPage()->data_len <= msg_pages->msg_offset) {
                     PagePool::Page *page = msg_pages->getFirstPage()->getNextMsgPage();
                     while (page) {
@@ -838,10 +1142,30 @@ ConnectionSenderImpl::queueMessage (Sender::MessageEntry * const mt_nonnull msg_
                         page = page->getNextMsgPage();
                     }
                     if (!page)
-                        return;
+                        empty = true;
                 }
             }
+
+            if (empty) {
+              // Broadcast entries hold a reference to the shared message,
+              // which should be dropped.
+                if (msg_pages->broadcast)
+                    Sender::deleteMessageEntry (msg_entry);
+
+                return;
+            }
         } break;
+#ifndef LIBMARY_PLATFORM_WIN32
+        case Sender::MessageEntry::File: {
+            Sender::MessageEntry_File * const msg_file = static_cast <Sender::MessageEntry_File*> (msg_entry);
+            if (msg_file->len == 0) {
+                Sender::deleteMessageEntry (msg_entry);
+                return;
+            }
+
+            msg_len = (Size) msg_file->len;
+        } break;
+#endif
         default:
             unreachable ();
     }
@@ -854,6 +1178,9 @@ ConnectionSenderImpl::queueMessage (Sender::MessageEntry * const mt_nonnull msg_
 	setSendState (Sender::QueueSoftLimit);
 
     msg_list.append (msg_entry);
+
+    if (pending_bytes_counter)
+        addPendingBytes (msg_len);
 }
 
 ConnectionSenderImpl::ConnectionSenderImpl (
@@ -872,12 +1199,18 @@ ConnectionSenderImpl::ConnectionSenderImpl (
       send_state         (Sender::ConnectionReady),
       overloaded         (false),
       num_msg_entries    (0),
+      pending_bytes      (0),
       enable_processing_barrier (enable_processing_barrier),
       processing_barrier (NULL),
       processing_barrier_hit (false),
       sending_message    (false),
       send_header_sent   (0),
       send_cur_offset    (0)
+#ifndef LIBMARY_PLATFORM_WIN32
+      , send_file_pos    (0),
+      zerocopy_enabled   (false),
+      zerocopy_threshold (0)
+#endif
 {
 #ifdef LIBMARY_WIN32_IOCP
     sender_overlapped = grab (new (std::nothrow) SenderOverlapped);
@@ -899,6 +1232,22 @@ ConnectionSenderImpl::release ()
             Sender::deleteMessageEntry (msg_entry);
     }
     msg_list.clear ();
+
+    subPendingBytes (pending_bytes);
+
+#ifndef LIBMARY_PLATFORM_WIN32
+    // The kernel may still be transmitting pages of zero-copy writes, even
+    // after the connection is closed. The connection keeps them referenced
+    // until completion notifications arrive.
+    if (!zerocopy_list.isEmpty()) {
+        ZeroCopyOrphan * const orphan = new (std::nothrow) ZeroCopyOrphan;
+        assert (orphan);
+        orphan->batch_list.stealAppend (zerocopy_list.getFirst(), zerocopy_list.getLast());
+        zerocopy_list.clear ();
+
+        conn->adoptZeroCopyOrphan (orphan);
+    }
+#endif
 }
 
 }
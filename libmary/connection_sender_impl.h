@@ -34,6 +34,16 @@ namespace M {
 
 mt_unsafe class ConnectionSenderImpl
 {
+public:
+    // Number of bytes queued by a group of senders which haven't been
+    // written yet. Senders hold references to the counter, so that it
+    // may outlive its creator.
+    class PendingBytesCounter : public Referenced
+    {
+    public:
+        AtomicSize pending_bytes;
+    };
+
 private:
     mt_const bool blocking_mode;
 
@@ -58,6 +68,48 @@ private:
     bool overlapped_pending;
 #endif
 
+#ifndef LIBMARY_PLATFORM_WIN32
+    struct ZeroCopyPage
+    {
+        PagePool       *page_pool;
+        PagePool::Page *page;
+    };
+
+    // Pages of a single zero-copy write which are kept referenced
+    // until the write is completed.
+    class ZeroCopyBatch : public IntrusiveListElement<>
+    {
+    public:
+        Uint32 seq;
+        Count  num_pages;
+
+        ZeroCopyPage* getPages () { return reinterpret_cast <ZeroCopyPage*> (this + 1); }
+    };
+
+    typedef IntrusiveList<ZeroCopyBatch> ZeroCopyBatchList;
+
+    // Pending zero-copy writes handed over to the connection by release().
+    class ZeroCopyOrphan : public AsyncOutputStream::ZeroCopyOrphan
+    {
+    public:
+        ZeroCopyBatchList batch_list;
+
+        bool zeroCopyComplete (Uint32 first_seq,
+                               Uint32 last_seq);
+
+        ~ZeroCopyOrphan ();
+    };
+
+    static void releaseZeroCopyBatch (ZeroCopyBatch * mt_nonnull batch);
+
+    static void releaseZeroCopyBatches (ZeroCopyBatchList * mt_nonnull batch_list,
+                                        Uint32              first_seq,
+                                        Uint32              last_seq);
+
+    // Returns false if the current message should be sent with plain writev().
+    mt_throws bool sendPendingMessages_zerocopy (AsyncIoResult * mt_nonnull ret_res);
+#endif
+
     Sender::SendState send_state;
     // Tracks send state as if there was no *QueueLimit states.
     bool overloaded;
@@ -65,6 +117,30 @@ private:
     Sender::MessageList msg_list;
     Count num_msg_entries;
 
+    // Number of queued bytes which haven't been written yet.
+    // Tracked only when 'pending_bytes_counter' is set.
+    Size pending_bytes;
+    // Shared counter which 'pending_bytes' is added to. May be NULL.
+    mt_const Ref<PendingBytesCounter> pending_bytes_counter;
+
+    void addPendingBytes (Size const num_bytes)
+    {
+        pending_bytes += num_bytes;
+        pending_bytes_counter->pending_bytes.add (num_bytes);
+    }
+
+    void subPendingBytes (Size num_bytes)
+    {
+        if (!pending_bytes_counter)
+            return;
+
+        if (mt_unlikely (num_bytes > pending_bytes))
+            num_bytes = pending_bytes;
+
+        pending_bytes -= num_bytes;
+        pending_bytes_counter->pending_bytes.sub (num_bytes);
+    }
+
     bool enable_processing_barrier;
     Sender::MessageEntry *processing_barrier;
     bool processing_barrier_hit;
@@ -73,6 +149,16 @@ private:
 
     Size send_header_sent;
     Size send_cur_offset;
+#ifndef LIBMARY_PLATFORM_WIN32
+    // Number of bytes sent for the current MessageEntry_File.
+    FileSize send_file_pos;
+
+    mt_const bool zerocopy_enabled;
+    mt_const Size zerocopy_threshold;
+
+    // Written pages waiting for zero-copy completion notifications.
+    ZeroCopyBatchList zerocopy_list;
+#endif
 
     void setSendState (Sender::SendState new_state);
 
@@ -80,6 +166,13 @@ private:
 
     void popPage (Sender::MessageEntry_Pages * mt_nonnull msg_pages);
 
+    // Returns true if processing barrier has been reached.
+    bool popSentMessage (Sender::MessageEntry * mt_nonnull msg_entry);
+
+#ifndef LIBMARY_PLATFORM_WIN32
+    mt_throws AsyncIoResult sendPendingMessages_file ();
+#endif
+
     mt_throws AsyncIoResult sendPendingMessages_writev ();
 
     void sendPendingMessages_vector_fill (Count        * mt_nonnull ret_num_iovs,
@@ -103,9 +196,19 @@ public:
     void outputComplete ();
 #endif
 
+#ifndef LIBMARY_PLATFORM_WIN32
+    void zeroCopyComplete (Uint32 first_seq,
+                           Uint32 last_seq);
+#endif
+
     mt_throws AsyncIoResult sendPendingMessages ();
 
-#ifdef LIBMARY_ENABLE_MWRITEV
+#if defined (LIBMARY_ENABLE_MWRITEV) || defined (LIBMARY_ENABLE_IO_URING)
+    // Fills 'ret_iovs' for a single writev() call, which is issued by the caller.
+    // The outcome should then be reported with sendPendingMessages_react().
+    // '*ret_num_iovs' is left zero if there's nothing to write this way
+    // (file messages and zero-copy output): sendPendingMessages() should be
+    // used then.
     void sendPendingMessages_fillIovs (Count        *ret_num_iovs,
 				       struct iovec *ret_iovs,
 				       Count         max_iovs);
@@ -128,7 +231,12 @@ public:
 
     mt_const void setConnection (Connection * const conn) { this->conn = conn; }
 
-#ifdef LIBMARY_ENABLE_MWRITEV
+    // Makes the sender account the number of bytes it has yet to write
+    // in 'pending_bytes_counter', which may be shared between senders.
+    mt_const void setPendingBytesCounter (PendingBytesCounter * const pending_bytes_counter)
+        { this->pending_bytes_counter = pending_bytes_counter; }
+
+#if defined (LIBMARY_ENABLE_MWRITEV) || defined (LIBMARY_ENABLE_IO_URING)
     Connection* getConnection () { return conn; }
 #endif
 
@@ -143,6 +251,13 @@ public:
         this->blocking_mode = blocking_mode;
     }
 
+#ifndef LIBMARY_PLATFORM_WIN32
+    // Page data of the current message is sent with writevZeroCopy()
+    // if at least 'threshold' bytes are left. Message header is written
+    // separately with plain writev() before that. Should be called after setConnection().
+    mt_const void enableZeroCopy (Size threshold);
+#endif
+
     mt_const void setLimits (Count const soft_msg_limit,
 			     Count const hard_msg_limit)
     {
@@ -29,6 +29,10 @@
 
 #include <libmary/deferred_connection_sender.h>
 
+#ifdef LIBMARY_ENABLE_IO_URING
+  #include <libmary/io_uring_writer.h>
+#endif
+
 
 namespace M {
 
@@ -150,9 +154,22 @@ DeferredConnectionSender::outputIoComplete (Exception  * const exc_,
 {
 #else
 Connection::OutputFrontend const DeferredConnectionSender::conn_output_frontend = {
-    processOutput
+    processOutput,
+    zeroCopyComplete
 };
 
+void
+DeferredConnectionSender::zeroCopyComplete (Uint32   const first_seq,
+                                            Uint32   const last_seq,
+                                            void   * const _self)
+{
+    DeferredConnectionSender * const self = static_cast <DeferredConnectionSender*> (_self);
+
+    self->mutex.lock ();
+    self->conn_sender_impl.zeroCopyComplete (first_seq, last_seq);
+    self->mutex.unlock ();
+}
+
 void
 DeferredConnectionSender::processOutput (void * const _self)
 {
@@ -285,6 +302,7 @@ DeferredConnectionSender::setQueue (DeferredConnectionSenderQueue * const mt_non
 
     // It is safe to use dcs_queue's deferred processor registration.
     conn_sender_impl.init (&frontend, this /* sender */, &dcs_queue->send_reg);
+    conn_sender_impl.setPendingBytesCounter (dcs_queue->pending_bytes_counter);
 }
 
 DeferredConnectionSender::DeferredConnectionSender (Object * const coderef_container)
@@ -317,6 +335,93 @@ DeferredConnectionSender::~DeferredConnectionSender ()
     mutex.unlock();
 }
 
+mt_unlocks (deferred_sender->mutex) void
+DeferredConnectionSenderQueue::completeProcessing (DeferredConnectionSender * const mt_nonnull deferred_sender,
+                                                  AsyncIoResult              const res)
+{
+    if (res == AsyncIoResult::Error ||
+	res == AsyncIoResult::Eof)
+    {
+	logD (sender, _func, "res: ", res);
+
+	deferred_sender->ready_for_output = false;
+
+	// exc is NULL for Eof.
+	if (res == AsyncIoResult::Error) {
+	    logE_ (_func, exc->toString());
+
+	    if (!deferred_sender->closed) {
+		deferred_sender->closed = true;
+
+		ExceptionBuffer * const exc_buf = exc_swap_nounref ();
+
+		deferred_sender->fireClosed_unlocked (exc_buf->getException());
+		if (deferred_sender->frontend && deferred_sender->frontend->closed) {
+		    deferred_sender->mutex.unlock ();
+		    deferred_sender->frontend.call (deferred_sender->frontend->closed,
+						    /*(*/ exc_buf->getException() /*)*/);
+		} else {
+		    deferred_sender->mutex.unlock ();
+		}
+
+		exc_delete (exc_buf);
+	    } else {
+		deferred_sender->mutex.unlock ();
+	    }
+	} else {
+	    if (!deferred_sender->closed) {
+		deferred_sender->closed = true;
+
+		deferred_sender->fireClosed_unlocked (NULL /* exc_buf */);
+		if (deferred_sender->frontend && deferred_sender->frontend->closed) {
+		    deferred_sender->mutex.unlock ();
+		    deferred_sender->frontend.call (deferred_sender->frontend->closed,
+						    /*(*/ static_cast <Exception*> (NULL) /* exc_ */ /*)*/);
+		} else {
+		    deferred_sender->mutex.unlock ();
+		}
+	    } else {
+		deferred_sender->mutex.unlock ();
+	    }
+	}
+
+	{
+	    Object * const coderef_container = deferred_sender->getCoderefContainer();
+	    if (coderef_container)
+		coderef_container->unref ();
+	}
+	return;
+    }
+
+    if (res == AsyncIoResult::Again)
+	deferred_sender->ready_for_output = false;
+    else
+	deferred_sender->ready_for_output = true;
+
+    if (!deferred_sender->conn_sender_impl.processingBarrierHit()) {
+      // At this point, conn_sender_impl has either sent all data, or it has
+      // gotten EAGAIN from writev. In either case, we should have removed
+      // deferred_sender from output_queue.
+
+	mt_unlocks (deferred_sender->mutex) deferred_sender->closeIfNeeded (false /* deferred_event */);
+
+	{
+	    Object * const coderef_container = deferred_sender->getCoderefContainer();
+	    if (coderef_container)
+		coderef_container->unref ();
+	}
+    } else {
+	// TODO I recall thinking that processing barriers are stupid.
+	//      Re-visit this topic.
+
+	// TEST
+	assert (0);
+
+	// TODO toGlobOutputQueue calls trigger(), which is unnecessary here.
+	mt_unlocks (deferred_sender->mutex) deferred_sender->toGlobOutputQueue (false /* add_ref */, true /* unlock */);
+    }
+}
+
 bool
 DeferredConnectionSenderQueue::process (void * const _self)
 {
@@ -369,90 +474,7 @@ DeferredConnectionSenderQueue::process (void * const _self)
 	deferred_sender->conn_sender_impl.markProcessingBarrier ();
 
 	AsyncIoResult const res = deferred_sender->conn_sender_impl.sendPendingMessages ();
-	if (res == AsyncIoResult::Error ||
-	    res == AsyncIoResult::Eof)
-	{
-	    logD (sender, _func, "res: ", res);
-
-	    deferred_sender->ready_for_output = false;
-
-	    // exc is NULL for Eof.
-	    if (res == AsyncIoResult::Error) {
-		logE_ (_func, exc->toString());
-
-                if (!deferred_sender->closed) {
-                    deferred_sender->closed = true;
-
-                    ExceptionBuffer * const exc_buf = exc_swap_nounref ();
-
-                    deferred_sender->fireClosed_unlocked (exc_buf->getException());
-                    if (deferred_sender->frontend && deferred_sender->frontend->closed) {
-                        deferred_sender->mutex.unlock ();
-                        deferred_sender->frontend.call (deferred_sender->frontend->closed,
-                                                        /*(*/ exc_buf->getException() /*)*/);
-                    } else {
-                        deferred_sender->mutex.unlock ();
-                    }
-
-                    exc_delete (exc_buf);
-                } else {
-                    deferred_sender->mutex.unlock ();
-                }
-            } else {
-                if (!deferred_sender->closed) {
-                    deferred_sender->closed = true;
-
-                    deferred_sender->fireClosed_unlocked (NULL /* exc_buf */);
-                    if (deferred_sender->frontend && deferred_sender->frontend->closed) {
-                        deferred_sender->mutex.unlock ();
-                        deferred_sender->frontend.call (deferred_sender->frontend->closed,
-                                                        /*(*/ static_cast <Exception*> (NULL) /* exc_ */ /*)*/);
-                    } else {
-                        deferred_sender->mutex.unlock ();
-                    }
-                } else {
-                    deferred_sender->mutex.unlock ();
-                }
-            }
-
-	    {
-		Object * const coderef_container = deferred_sender->getCoderefContainer();
-		if (coderef_container)
-		    coderef_container->unref ();
-	    }
-	    continue;
-	}
-
-	if (res == AsyncIoResult::Again)
-	    deferred_sender->ready_for_output = false;
-	else
-	    deferred_sender->ready_for_output = true;
-
-	if (!deferred_sender->conn_sender_impl.processingBarrierHit()) {
-	  // At this point, conn_sender_impl has either sent all data, or it has
-	  // gotten EAGAIN from writev. In either case, we should have removed
-	  // deferred_sender from output_queue.
-
-	    mt_unlocks (deferred_sender->mutex) deferred_sender->closeIfNeeded (false /* deferred_event */);
-
-            {
-                Object * const coderef_container = deferred_sender->getCoderefContainer();
-                if (coderef_container)
-                    coderef_container->unref ();
-            }
-	} else {
-            // TODO I recall thinking that processing barriers are stupid.
-            //      Re-visit this topic.
-
-	    // TEST
-	    assert (0);
-
-            // TODO toGlobOutputQueue calls trigger(), which is unnecessary here.
-	    mt_unlocks (deferred_sender->mutex) deferred_sender->toGlobOutputQueue (false /* add_ref */, true /* unlock */);
-
-// Overlaps with (!self->output_queue.isEmpty()) check below.
-//	    extra_iteration_needed = true;
-	}
+	mt_unlocks (deferred_sender->mutex) completeProcessing (deferred_sender, res);
     }
 
     self->queue_mutex.lock ();
@@ -707,6 +729,175 @@ DeferredConnectionSenderQueue::process_mwritev (void *_self)
 }
 #endif /* LIBMARY_ENABLE_MWRITEV */
 
+#ifdef LIBMARY_ENABLE_IO_URING
+namespace {
+    enum {
+        // Maximum number of senders written with a single io_uring_enter() call.
+        BatchedFlush_MaxSenders = 256,
+        // Senders with more data to send write the rest with writev().
+        BatchedFlush_MaxIovsPerSender = 64
+    };
+}
+
+class DeferredConnectionSenderQueue::BatchData
+{
+public:
+    DeferredConnectionSender *senders [BatchedFlush_MaxSenders];
+    // Index of the sender's write in the arrays below, or -1 if the sender
+    // is not written with io_uring.
+    int write_idx [BatchedFlush_MaxSenders];
+
+    int           fds      [BatchedFlush_MaxSenders];
+    struct iovec *iovs     [BatchedFlush_MaxSenders];
+    Count         num_iovs [BatchedFlush_MaxSenders];
+    int           res      [BatchedFlush_MaxSenders];
+
+    struct iovec iovs_heap [BatchedFlush_MaxSenders * BatchedFlush_MaxIovsPerSender];
+};
+
+bool
+DeferredConnectionSenderQueue::process_batched (void * const _self)
+{
+    logD (sender, _func_);
+
+    DeferredConnectionSenderQueue * const self = static_cast <DeferredConnectionSenderQueue*> (_self);
+    BatchData * const batch = self->batch_data;
+
+    ProcessingQueue processing_queue;
+
+    self->queue_mutex.lock ();
+    assert (!self->released);
+
+    if (self->processing) {
+	self->queue_mutex.unlock ();
+	logW_ (_func, "Concurrent invocation");
+	return false;
+    }
+    self->processing = true;
+
+    {
+	OutputQueue::iter iter (self->output_queue);
+	while (!self->output_queue.iter_done (iter)) {
+	    DeferredConnectionSender * const deferred_sender = self->output_queue.iter_next (iter);
+	    processing_queue.append (deferred_sender);
+	    self->output_queue.remove (deferred_sender);
+	}
+    }
+
+    self->queue_mutex.unlock ();
+
+    bool extra_iteration_needed = false;
+
+    ProcessingQueue::iter iter (processing_queue);
+    while (!processing_queue.iter_done (iter)) {
+	Count num_senders = 0;
+	Count num_writes = 0;
+	while (num_senders < BatchedFlush_MaxSenders
+	       && !processing_queue.iter_done (iter))
+	{
+	    DeferredConnectionSender * const deferred_sender = processing_queue.iter_next (iter);
+	    batch->senders [num_senders] = deferred_sender;
+	    batch->write_idx [num_senders] = -1;
+	    ++num_senders;
+
+	    deferred_sender->mutex.lock ();
+
+	    assert (deferred_sender->in_output_queue);
+	    deferred_sender->in_output_queue = false;
+
+	    deferred_sender->conn_sender_impl.markProcessingBarrier ();
+
+	    int const fd = deferred_sender->conn_sender_impl.getConnection()->getFd();
+	    Count num_iovs = 0;
+	    if (fd != -1) {
+		struct iovec * const iovs = batch->iovs_heap + num_writes * BatchedFlush_MaxIovsPerSender;
+		deferred_sender->conn_sender_impl.sendPendingMessages_fillIovs (&num_iovs,
+										iovs,
+										BatchedFlush_MaxIovsPerSender);
+		if (num_iovs) {
+		    batch->fds      [num_writes] = fd;
+		    batch->iovs     [num_writes] = iovs;
+		    batch->num_iovs [num_writes] = num_iovs;
+		    batch->write_idx [num_senders - 1] = (int) num_writes;
+		    ++num_writes;
+		}
+	    }
+
+	    // Senders written with io_uring stay locked until the outcome
+	    // of the write is accounted for.
+	    if (!num_iovs)
+		deferred_sender->mutex.unlock ();
+	}
+
+	if (num_writes) {
+	    if (!self->io_uring_writer->writev (num_writes,
+						batch->fds,
+						batch->iovs,
+						batch->num_iovs,
+						batch->res))
+	    {
+		logE_ (_func, "io_uring writev failed: ", exc->toString());
+		// Nothing has been written, falling back to writev().
+		for (Count i = 0; i < num_writes; ++i)
+		    batch->res [i] = -EAGAIN;
+	    }
+	}
+
+	for (Count i = 0; i < num_senders; ++i) {
+	    int const idx = batch->write_idx [i];
+	    if (idx == -1)
+		continue;
+
+	    DeferredConnectionSender * const deferred_sender = batch->senders [i];
+	    int const res = batch->res [idx];
+	    if (res > 0)
+		deferred_sender->conn_sender_impl.sendPendingMessages_react (AsyncIoResult::Normal, (Size) res);
+
+	    deferred_sender->mutex.unlock ();
+	}
+
+	// Completing senders one by one, so that frontend callbacks are not
+	// called with other senders of the batch locked.
+	for (Count i = 0; i < num_senders; ++i) {
+	    DeferredConnectionSender * const deferred_sender = batch->senders [i];
+	    int const idx = batch->write_idx [i];
+	    int const write_res = (idx != -1 ? batch->res [idx] : 0);
+
+	    deferred_sender->mutex.lock ();
+
+	    AsyncIoResult res;
+	    if (write_res == -EPIPE) {
+		res = AsyncIoResult::Eof;
+	    } else
+	    if (write_res < 0
+		&& write_res != -EAGAIN
+		&& write_res != -EWOULDBLOCK
+		&& write_res != -EINTR)
+	    {
+		exc_throw (PosixException, -write_res);
+		res = AsyncIoResult::Error;
+	    } else {
+		// Sends what's left: the rest of a partial write, file messages
+		// and zero-copy output. On EAGAIN, this makes the connection
+		// request an output readiness notification.
+		res = deferred_sender->conn_sender_impl.sendPendingMessages ();
+	    }
+
+	    mt_unlocks (deferred_sender->mutex) completeProcessing (deferred_sender, res);
+	}
+    }
+
+    self->queue_mutex.lock ();
+    if (!self->output_queue.isEmpty())
+	extra_iteration_needed = true;
+
+    self->processing = false;
+    self->queue_mutex.unlock ();
+
+    return extra_iteration_needed;
+}
+#endif /* LIBMARY_ENABLE_IO_URING */
+
 mt_const void
 DeferredConnectionSenderQueue::setDeferredProcessor (DeferredProcessor * const deferred_processor)
 {
@@ -723,6 +914,25 @@ DeferredConnectionSenderQueue::setDeferredProcessor (DeferredProcessor * const d
 		process, this /* cb_data */, getCoderefContainer());
     }
 
+#ifdef LIBMARY_ENABLE_IO_URING
+    if (batched_flush) {
+	io_uring_writer = new (std::nothrow) IoUringWriter;
+	assert (io_uring_writer);
+	io_uring_writer->setRingSize (BatchedFlush_MaxSenders);
+	if (io_uring_writer->open ()) {
+	    batch_data = new (std::nothrow) BatchData;
+	    assert (batch_data);
+
+	    send_task.cb = CbDesc<DeferredProcessor::TaskCallback> (
+		    process_batched, this /* cb_data */, getCoderefContainer());
+	} else {
+	    logW_ (_func, "io_uring is not available, batched flush disabled: ", exc->toString());
+	    delete io_uring_writer;
+	    io_uring_writer = NULL;
+	}
+    }
+#endif
+
     send_reg.setDeferredProcessor (deferred_processor);
     send_reg.scheduleTask (&send_task, true /* permanent */);
 }
@@ -773,7 +983,13 @@ DeferredConnectionSenderQueue::DeferredConnectionSenderQueue (Object * const cod
     : DependentCodeReferenced (coderef_container),
       deferred_processor (coderef_container),
       processing (false),
-      released (false)
+      released (false),
+      pending_bytes_counter (grab (new (std::nothrow) ConnectionSenderImpl::PendingBytesCounter)),
+      batched_flush (false)
+#ifdef LIBMARY_ENABLE_IO_URING
+      , io_uring_writer (NULL),
+      batch_data (NULL)
+#endif
 {
 }
 
@@ -804,6 +1020,11 @@ DeferredConnectionSenderQueue::~DeferredConnectionSenderQueue ()
 
         queue_mutex.unlock ();
     }
+
+#ifdef LIBMARY_ENABLE_IO_URING
+    delete batch_data;
+    delete io_uring_writer;
+#endif
 }
 
 }
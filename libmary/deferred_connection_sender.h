@@ -33,6 +33,10 @@ namespace M {
 
 class DeferredConnectionSenderQueue;
 
+#ifdef LIBMARY_ENABLE_IO_URING
+class IoUringWriter;
+#endif
+
 class DeferredConnectionSender_OutputQueue_name;
 class DeferredConnectionSender_ProcessingQueue_name;
 
@@ -70,6 +74,10 @@ private:
   mt_iface (Connection::OutputFrontend)
     static Connection::OutputFrontend const conn_output_frontend;
     static void processOutput (void *_self);
+
+    static void zeroCopyComplete (Uint32  first_seq,
+                                  Uint32  last_seq,
+                                  void   *_self);
   mt_iface_end
 #endif
 
@@ -108,6 +116,13 @@ public:
 #endif
     }
 
+#ifndef LIBMARY_PLATFORM_WIN32
+    // Enables zero-copy output (MSG_ZEROCOPY) for messages with at least
+    // 'threshold' bytes of page data. Should be called after setConnection().
+    mt_const void enableZeroCopy (Size const threshold = 1 << 15 /* 32 Kb */)
+        { conn_sender_impl.enableZeroCopy (threshold); }
+#endif
+
     mt_const void setQueue (DeferredConnectionSenderQueue * mt_nonnull dcs_queue);
 
      DeferredConnectionSender (Object *coderef_container);
@@ -134,15 +149,50 @@ private:
 
     mt_mutex (queue_mutex) bool released;
 
+    // Bytes queued by the senders using this queue which haven't been
+    // written yet.
+    mt_const Ref<ConnectionSenderImpl::PendingBytesCounter> pending_bytes_counter;
+
+    mt_const bool batched_flush;
+
+#ifdef LIBMARY_ENABLE_IO_URING
+    class BatchData;
+
+    // Used by process_batched(), which is never called concurrently.
+    mt_const IoUringWriter *io_uring_writer;
+    mt_const BatchData *batch_data;
+#endif
+
+    // Reacts to the outcome of sending pending messages for 'deferred_sender',
+    // which has been taken out of output_queue, and drops the queue's reference.
+    mt_unlocks (deferred_sender->mutex) static void completeProcessing (DeferredConnectionSender * mt_nonnull deferred_sender,
+                                                                        AsyncIoResult res);
+
     static bool process (void *_self);
 
 #ifdef LIBMARY_ENABLE_MWRITEV
     static bool process_mwritev (void *_self);
 #endif
 
+#ifdef LIBMARY_ENABLE_IO_URING
+    static bool process_batched (void *_self);
+#endif
+
 public:
+    // Makes the queue write pending data for many connections with a single
+    // io_uring_enter() syscall instead of calling writev() for every connection.
+    // Has no effect if libmary is built without io_uring support. If io_uring
+    // is not available at run time, the queue falls back to per-connection
+    // writes. Should be called before setDeferredProcessor().
+    mt_const void setBatchedFlush (bool const batched_flush)
+        { this->batched_flush = batched_flush; }
+
     void setDeferredProcessor (DeferredProcessor * const deferred_processor);
 
+    // Used for load-aware thread selection.
+    Size getPendingBytes () const
+        { return pending_bytes_counter->pending_bytes.get (); }
+
     void release ();
 
      DeferredConnectionSenderQueue (Object *coderef_container);
@@ -59,6 +59,22 @@ DeferredProcessor_Registration::scheduleTask (DeferredProcessor_Task * const mt_
     if (!deferred_processor)
         return;
 
+    if (!permanent) {
+      // Lock-free path. If the task is already in 'incoming_tasks', then
+      // it will be scheduled when the stack is drained.
+        if (!task->queued.compareAndExchange (0, 1))
+            return;
+
+        task->incoming_registration = this;
+        if (deferred_processor->pushIncomingTask (task)) {
+          // Triggering the backend once for the whole batch of incoming tasks.
+            if (deferred_processor->backend)
+                deferred_processor->backend.call (deferred_processor->backend->trigger);
+        }
+
+        return;
+    }
+
     deferred_processor->mutex.lock ();
 
     if (task->scheduled ||
@@ -73,36 +89,18 @@ DeferredProcessor_Registration::scheduleTask (DeferredProcessor_Task * const mt_
     task->registration = this;
 
     task->scheduled = true;
-    if (!permanent) {
-	task_list.append (task);
-	task->permanent = false;
-
-	if (scheduled) {
-	    deferred_processor->mutex.unlock ();
-	    return;
-	}
-
-	deferred_processor->registration_list.append (this);
-	scheduled = true;
-
-	deferred_processor->mutex.unlock ();
-
-	if (deferred_processor->backend)
-	    deferred_processor->backend.call (deferred_processor->backend->trigger);
-    } else {
-	permanent_task_list.append (task);
-	task->permanent = true;
+    permanent_task_list.append (task);
+    task->permanent = true;
 
-	if (permanent_scheduled) {
-	    deferred_processor->mutex.unlock ();
-	    return;
-	}
+    if (permanent_scheduled) {
+        deferred_processor->mutex.unlock ();
+        return;
+    }
 
-	deferred_processor->permanent_registration_list.append (this);
-	permanent_scheduled = true;
+    deferred_processor->permanent_registration_list.append (this);
+    permanent_scheduled = true;
 
-	deferred_processor->mutex.unlock ();
-    }
+    deferred_processor->mutex.unlock ();
 }
 
 void
@@ -114,6 +112,9 @@ DeferredProcessor_Registration::revokeTask (DeferredProcessor_Task * const mt_no
 
     deferred_processor->mutex.lock ();
 
+    // The task may be waiting in 'incoming_tasks'.
+    deferred_processor->drainIncomingTasks ();
+
     if (task->permanent &&
 	task->scheduled)
     {
@@ -162,6 +163,8 @@ DeferredProcessor_Registration::release ()
 
     deferred_processor->mutex.lock ();
 
+    deferred_processor->drainIncomingTasks ();
+
     {
 	DeferredProcessor_TaskList::iter iter (task_list);
 	while (!task_list.iter_done (iter)) {
@@ -209,6 +212,64 @@ DeferredProcessor_Registration::release ()
     deferred_processor->mutex.unlock ();
 }
 
+bool
+DeferredProcessor::pushIncomingTask (Task * const mt_nonnull task)
+{
+    for (;;) {
+        Task * const head = static_cast <Task*> (incoming_tasks.get ());
+        task->incoming_next = head;
+        if (incoming_tasks.compareAndExchange (head, task))
+            return head == NULL;
+    }
+}
+
+mt_mutex (mutex) void
+DeferredProcessor::drainIncomingTasks ()
+{
+    Task *head;
+    for (;;) {
+        head = static_cast <Task*> (incoming_tasks.get ());
+        if (!head)
+            return;
+
+        if (incoming_tasks.compareAndExchange (head, NULL))
+            break;
+    }
+
+    // The stack is in LIFO order.
+    Task *fifo_head = NULL;
+    while (head) {
+        Task * const next = head->incoming_next;
+        head->incoming_next = fifo_head;
+        fifo_head = head;
+        head = next;
+    }
+
+    while (fifo_head) {
+        Task * const task = fifo_head;
+        fifo_head = task->incoming_next;
+
+        Registration * const reg = task->incoming_registration;
+        task->incoming_next = NULL;
+        task->incoming_registration = NULL;
+        // From now on, the task may be pushed to 'incoming_tasks' again.
+        task->queued.set (0);
+
+        if (task->scheduled ||
+            task->processing)
+        {
+            assert (task->registration == reg);
+            continue;
+        }
+
+        assert (!task->registration || task->registration == reg);
+        task->registration = reg;
+        task->permanent = false;
+
+        reg->rescheduleTask (task);
+    }
+}
+
 bool
 DeferredProcessor::process ()
 {
@@ -219,6 +280,8 @@ DeferredProcessor::process ()
     assert (!processing);
     processing = true;
 
+    drainIncomingTasks ();
+
     {
 	RegistrationList::iter reg_iter (registration_list);
 	while (!registration_list.iter_done (reg_iter)) {
@@ -294,6 +357,10 @@ DeferredProcessor::process ()
 
     processing = false;
 
+    // Tasks scheduled while we were processing. The backend has been triggered
+    // for them, but we can save a wakeup by requesting an extra iteration.
+    drainIncomingTasks ();
+
     if (force_extra_iteration ||
 	!registration_list.isEmpty())
     {
@@ -22,6 +22,7 @@
 
 
 #include <libmary/types.h>
+#include <libmary/atomic.h>
 #include <libmary/cb.h>
 #include <libmary/intrusive_list.h>
 
@@ -55,15 +56,25 @@ private:
 
     mt_mutex (DeferredProcessor::mutex) DeferredProcessor_Registration *registration;
 
+    // Non-permanent tasks are scheduled without locking DeferredProcessor::mutex:
+    // they are pushed to DeferredProcessor::incoming_tasks lock-free stack first.
+    // 'queued' is 1 while the task is in that stack.
+    AtomicInt queued;
+    DeferredProcessor_Task *incoming_next;
+    DeferredProcessor_Registration *incoming_registration;
+
 public:
     mt_const Cb<DeferredProcessor_TaskCallback> cb;
     mt_const VirtRef self_ref;
 
     DeferredProcessor_Task ()
-        : scheduled    (false),
-          processing   (false),
-          permanent    (false),
-          registration (NULL)
+        : scheduled             (false),
+          processing            (false),
+          permanent             (false),
+          registration          (NULL),
+          queued                (0),
+          incoming_next         (NULL),
+          incoming_registration (NULL)
     {}
 };
 
@@ -155,7 +166,26 @@ private:
     mt_mutex (mutex) bool processing;
     mt_mutex (mutex) TaskList processing_task_list;
 
+    // Lock-free stack of newly scheduled non-permanent tasks, linked via
+    // Task::incoming_next. Multiple producers push tasks with CAS, the stack
+    // is drained as a whole with 'mutex' held.
+    AtomicPointer incoming_tasks;
+
+    // Returns 'true' if the stack was empty, i.e. if the backend
+    // should be triggered.
+    bool pushIncomingTask (Task * mt_nonnull task);
+
+    // Moves tasks from 'incoming_tasks' to their registrations' task lists,
+    // preserving scheduling order.
+    mt_mutex (mutex) void drainIncomingTasks ();
+
 public:
+    // Runs every task which has been scheduled before the call once.
+    // Tasks scheduled by task callbacks or by other threads while process()
+    // is running, including tasks which reschedule themselves, run during
+    // the next call. A task which is scheduled again while it is waiting
+    // for its turn in the current call runs during the next call as well.
+    //
     // Returns 'true' if there are more tasks to process.
     bool process ();
 
@@ -46,6 +46,45 @@ EpollPollGroup::processPollableDeletionQueue ()
     pollable_deletion_queue.clear ();
 }
 
+// Returns the number of events, 0 if busy-polling should stop,
+// or -1 on error.
+mt_sync_domain (poll) mt_throws int
+EpollPollGroup::busyPoll (Time               const spin_start_microsec,
+                          PollIterationStats * const mt_nonnull stats)
+{
+    for (;;) {
+	int const nfds = epoll_wait (efd, events, max_events, 0 /* timeout */);
+        if (nfds == -1) {
+            int const errnum = errno;
+            if (errnum != EINTR) {
+                exc_throw (PosixException, errnum);
+                logF_ (_func, "epoll_wait() failed: ", errnoString (errnum));
+                return -1;
+            }
+        }
+
+        ++stats->num_spins;
+        if (nfds > 0)
+            return nfds;
+
+        mutex.lock ();
+        bool const was_triggered = triggered;
+        mutex.unlock ();
+        if (was_triggered)
+            return 0;
+
+        if (!updateTime ())
+            logE_ (_func, "updateTime() failed: ", exc->toString());
+
+        Time const cur_microsec = getTimeMicroseconds ();
+        if (cur_microsec > spin_start_microsec)
+            stats->spin_microsec = cur_microsec - spin_start_microsec;
+
+        if (stats->spin_microsec >= busy_poll_microsec)
+            return 0;
+    }
+}
+
 mt_throws PollGroup::PollableKey
 EpollPollGroup::addPollable (CbDesc<Pollable> const &pollable,
 			     bool const activate)
@@ -65,6 +104,7 @@ EpollPollGroup::addPollable (CbDesc<Pollable> const &pollable,
 
     mutex.lock ();
     pollable_list.append (pollable_entry);
+    ++num_pollables;
     mutex.unlock ();
 
     if (activate) {
@@ -77,6 +117,7 @@ EpollPollGroup::addPollable (CbDesc<Pollable> const &pollable,
 _failure:
     mutex.lock ();
     pollable_list.remove (pollable_entry);
+    --num_pollables;
     mutex.unlock ();
     delete pollable_entry;
 
@@ -152,6 +193,7 @@ EpollPollGroup::removePollable (PollableKey const mt_nonnull key)
     pollable_entry->valid = false;
     pollable_list.remove (pollable_entry);
     pollable_deletion_queue.append (pollable_entry);
+    --num_pollables;
     mutex.unlock ();
 }
 
@@ -162,7 +204,6 @@ EpollPollGroup::poll (Uint64 const timeout_microsec)
 
     Time const start_microsec = getTimeMicroseconds ();
 
-    struct epoll_event events [4096];
     bool first = true;
     for (;;) {
 	Time cur_microsec = first ? (first = false, start_microsec) : getTimeMicroseconds ();
@@ -193,6 +234,34 @@ EpollPollGroup::poll (Uint64 const timeout_microsec)
 	    timeout = 0;
 	}
 
+        PollIterationStats stats;
+        stats.num_events = 0;
+        stats.num_spins = 0;
+        stats.spin_microsec = 0;
+        stats.blocked = false;
+
+        bool const busy_poll = (timeout != 0 && busy_poll_max_microsec > 0);
+        Time spin_start_microsec = 0;
+        int nfds = 0;
+        if (busy_poll) {
+            if (!updateTime ())
+                logE_ (_func, "updateTime() failed: ", exc->toString());
+
+            spin_start_microsec = getTimeMicroseconds ();
+            nfds = busyPoll (spin_start_microsec, &stats);
+            if (nfds == -1)
+                return Result::Failure;
+
+            if (nfds != 0) {
+                timeout = 0;
+            } else
+            if (timeout > 0) {
+                timeout -= (int) (stats.spin_microsec / 1000);
+                if (timeout <= 0)
+                    timeout = 1;
+            }
+        }
+
         mutex.lock ();
         if (triggered || timeout == 0) {
             block_trigger_pipe = true;
@@ -213,7 +282,15 @@ EpollPollGroup::poll (Uint64 const timeout_microsec)
         }
 #endif
 
-	int const nfds = epoll_wait (efd, events, sizeof (events) / sizeof (events [0]), timeout);
+        // errno is saved right away, before anything else gets a chance
+        // to overwrite it.
+        int wait_errnum = 0;
+        if (!busy_poll || nfds == 0) {
+            stats.blocked = (timeout != 0);
+            nfds = epoll_wait (efd, events, max_events, timeout);
+            if (nfds == -1)
+                wait_errnum = errno;
+        }
 
 #if 0
         if (timeout != 0) {
@@ -227,19 +304,43 @@ EpollPollGroup::poll (Uint64 const timeout_microsec)
 #endif
 
 	if (nfds == -1) {
-	    if (errno == EINTR)
+	    if (wait_errnum == EINTR)
 		continue;
 
-	    exc_throw (PosixException, errno);
-	    logF_ (_func, "epoll_wait() failed: ", errnoString (errno));
+	    exc_throw (PosixException, wait_errnum);
+	    logF_ (_func, "epoll_wait() failed: ", errnoString (wait_errnum));
 	    return Result::Failure;
 	}
 
-	if (nfds < 0 || (Size) nfds > sizeof (events) / sizeof (events [0])) {
+	if (nfds < 0 || (Count) nfds > max_events) {
 	    logF_ (_func, "epoll_wait(): unexpected return value: ", nfds);
 	    return Result::Failure;
 	}
 
+        stats.num_events = (Count) nfds;
+
+        if (busy_poll) {
+            if (stats.blocked) {
+                if (!updateTime ())
+                    logE_ (_func, "updateTime() failed: ", exc->toString());
+
+              // If the event has arrived shortly after we stopped spinning,
+              // then busy-polling for longer would have caught it.
+                Time const cur_microsec = getTimeMicroseconds ();
+                if (nfds > 0
+                    && cur_microsec >= spin_start_microsec
+                    && cur_microsec - spin_start_microsec <= busy_poll_max_microsec)
+                {
+                    busy_poll_microsec = busy_poll_max_microsec;
+                } else {
+                    busy_poll_microsec /= 2;
+                }
+            } else
+            if (nfds > 0) {
+                busy_poll_microsec = busy_poll_max_microsec;
+            }
+        }
+
       // Trigger optimization:
       //
       // After trigger() returns, two events MUST happen:
@@ -270,9 +371,13 @@ EpollPollGroup::poll (Uint64 const timeout_microsec)
 
 	got_deferred_tasks = false;
 
-	if (frontend)
+	if (frontend) {
 	    frontend.call (frontend->pollIterationBegin);
 
+            if (frontend->pollIterationStats)
+                frontend.call (frontend->pollIterationStats, /*(*/ &stats /*)*/);
+        }
+
 	bool trigger_pipe_ready = false;
         for (int i = 0; i < nfds; ++i) {
             PollableEntry * const pollable_entry = static_cast <PollableEntry*> (events [i].data.ptr);
@@ -347,8 +452,8 @@ EpollPollGroup::poll (Uint64 const timeout_microsec)
         if (trigger_pipe_ready) {
 	    logD (epoll, _func, "trigger pipe break");
 
-            if (!commonTriggerPipeRead (trigger_pipe [0])) {
-                logF_ (_func, "commonTriggerPipeRead() failed: ", exc->toString());
+            if (!posix_triggerPipeRead (trigger_pipe [0])) {
+                logF_ (_func, "posix_triggerPipeRead() failed: ", exc->toString());
                 return Result::Failure;
             }
             break;
@@ -386,23 +491,47 @@ EpollPollGroup::trigger ()
 
     mutex.lock ();
     if (triggered) {
+        ++num_triggers_suppressed;
         mutex.unlock ();
         return Result::Success;
     }
     triggered = true;
 
     if (block_trigger_pipe) {
+        ++num_triggers_suppressed;
 	mutex.unlock ();
 	return Result::Success;
     }
+    ++num_triggers_issued;
     mutex.unlock ();
 
-    return commonTriggerPipeWrite (trigger_pipe [1]);
+    return posix_triggerPipeWrite (trigger_pipe [1]);
+}
+
+void
+EpollPollGroup::getTriggerStatistics (TriggerStatistics * const mt_nonnull ret_stats)
+{
+    mutex.lock ();
+    ret_stats->num_triggers_issued = num_triggers_issued;
+    ret_stats->num_triggers_suppressed = num_triggers_suppressed;
+    mutex.unlock ();
+}
+
+Count
+EpollPollGroup::getNumPollables ()
+{
+    mutex.lock ();
+    Count const res = num_pollables;
+    mutex.unlock ();
+    return res;
 }
 
 mt_const mt_throws Result
 EpollPollGroup::open ()
 {
+    events = new (std::nothrow) struct epoll_event [max_events];
+    assert (events);
+
     efd = epoll_create (1 /* size, unused */);
     if (efd == -1) {
 	exc_throw (PosixException, errno);
@@ -411,7 +540,7 @@ EpollPollGroup::open ()
     }
     logD_ (_this_func, "epoll fd: ", efd);
 
-    if (!posix_createNonblockingPipe (&trigger_pipe)) {
+    if (!posix_createTriggerPipe (&trigger_pipe)) {
 	return Result::Failure;
     }
     logD_ (_this_func, "trigger_pipe fd: read ", trigger_pipe [0], ", write ", trigger_pipe [1]);
@@ -442,8 +571,15 @@ EpollPollGroup::EpollPollGroup (Object * const coderef_container)
     : DependentCodeReferenced (coderef_container),
       poll_tlocal (NULL),
       efd (-1),
+      max_events (4096),
+      events (NULL),
+      busy_poll_max_microsec (0),
+      busy_poll_microsec (0),
       triggered (false),
       block_trigger_pipe (true),
+      num_triggers_issued (0),
+      num_triggers_suppressed (0),
+      num_pollables (0),
       // Initializing to 'true' to process deferred tasks scheduled before we
       // enter poll() for the first time.
       got_deferred_tasks (true)
@@ -472,6 +608,8 @@ EpollPollGroup::~EpollPollGroup ()
     }
     mutex.unlock ();
 
+    delete[] events;
+
     if (efd != -1) {
 	for (;;) {
 	    int const res = close (efd);
@@ -489,24 +627,7 @@ EpollPollGroup::~EpollPollGroup ()
 	}
     }
 
-    for (int i = 0; i < 2; ++i) {
-	if (trigger_pipe [i] != -1) {
-	    for (;;) {
-		int const res = close (trigger_pipe [i]);
-		if (res == -1) {
-		    if (errno == EINTR)
-			continue;
-
-		    logE_ (_func, "trigger_pipe[", i, "]: close() failed: ", errnoString (errno));
-		} else
-		if (res != 0) {
-		    logE_ (_func, "trigger_pipe[", i, "]: close(): unexpected return value: ", res);
-		}
-
-		break;
-	    }
-	}
-    }
+    posix_closeTriggerPipe (&trigger_pipe);
 }
 
 }
@@ -30,6 +30,9 @@
 #include <libmary/state_mutex.h>
 
 
+struct epoll_event;
+
+
 namespace M {
 
 class EpollPollGroup : public ActivePollGroup,
@@ -60,10 +63,24 @@ private:
 
     mt_const int efd;
 
+    mt_const Count max_events;
+    mt_const struct epoll_event *events;
+
+    mt_const Time busy_poll_max_microsec;
+    // Current busy-poll duration. Halved every time busy-polling yields
+    // nothing, reset to 'busy_poll_max_microsec' when an event arrives
+    // within that interval.
+    mt_sync_domain (poll) Time busy_poll_microsec;
+
     mt_const int trigger_pipe [2];
     mt_mutex (mutex) bool triggered;
     mt_mutex (mutex) bool block_trigger_pipe;
 
+    mt_mutex (mutex) Uint64 num_triggers_issued;
+    mt_mutex (mutex) Uint64 num_triggers_suppressed;
+
+    mt_mutex (mutex) Count num_pollables;
+
     mt_sync_domain (poll) bool got_deferred_tasks;
 
     mt_mutex (mutex) PollableList pollable_list;
@@ -73,6 +90,9 @@ private:
 
     mt_mutex (mutex) void processPollableDeletionQueue ();
 
+    mt_sync_domain (poll) mt_throws int busyPoll (Time                spin_start_microsec,
+                                                  PollIterationStats * mt_nonnull stats);
+
 public:
   mt_iface (ActivePollgroup)
     mt_iface (PollGroup)
@@ -104,8 +124,26 @@ public:
     mt_throws Result poll (Uint64 timeout_microsec = (Uint64) -1);
 
     mt_throws Result trigger ();
+
+    void getTriggerStatistics (TriggerStatistics * mt_nonnull ret_stats);
+
+    Count getNumPollables ();
   mt_end
 
+    // Maximum number of events to be processed per epoll_wait() call.
+    // Should be called before open().
+    mt_const void setMaxEventsPerWakeup (Count const max_events)
+        { this->max_events = (max_events > 0 ? max_events : 1); }
+
+    // Enables busy-poll mode: before blocking in epoll_wait(), the poll group
+    // polls for events with zero timeout for up to 'busy_poll_max_microsec'.
+    // This trades CPU time for lower wakeup latency. 0 disables busy-polling.
+    mt_const void setBusyPoll (Time const busy_poll_max_microsec)
+    {
+        this->busy_poll_max_microsec = busy_poll_max_microsec;
+        this->busy_poll_microsec = busy_poll_max_microsec;
+    }
+
     mt_const mt_throws Result open ();
 
     mt_const void bindToThread (LibMary_ThreadLocal * const poll_tlocal)
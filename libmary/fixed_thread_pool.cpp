@@ -18,6 +18,7 @@
 
 
 #include <libmary/types.h>
+#include <libmary/util_posix.h>
 #include <libmary/log.h>
 
 
@@ -51,7 +52,11 @@ FixedThreadPool::threadFunc (void * const _self)
 {
     FixedThreadPool * const self = static_cast <FixedThreadPool*> (_self);
 
+    // The thread has already been pinned to its CPU by MultiThread,
+    // see ServerApp::threadFunc().
     Ref<ThreadData> const thread_data = grab (new ThreadData);
+    if (self->thread_page_pool)
+        self->thread_page_pool->prefillThreadCache ();
 
     thread_data->dcs_queue.setDeferredProcessor (&thread_data->deferred_processor);
 
@@ -84,8 +89,20 @@ FixedThreadPool::threadFunc (void * const _self)
     }
 
     self->thread_data_list.append (thread_data);
+    Count const thread_no = ++self->num_started_threads;
     self->mutex.unlock ();
 
+#ifndef LIBMARY_PLATFORM_WIN32
+    {
+        Count cpu = 0;
+        Count numa_node = 0;
+        if (posix_getThreadCpu (&cpu, &numa_node))
+            logI_ (_func, "thread ", thread_no, ": cpu ", cpu, ", numa node ", numa_node);
+    }
+#else
+    (void) thread_no;
+#endif
+
     for (;;) {
 	if (!thread_data->poll_group.poll (thread_data->timers.getSleepTime_microseconds())) {
 	    logE_ (_func, "poll_group.poll() failed: ", exc->toString());
@@ -102,7 +119,8 @@ FixedThreadPool::threadFunc (void * const _self)
 
 ActivePollGroup::Frontend FixedThreadPool::poll_frontend = {
     pollIterationBegin,
-    pollIterationEnd
+    pollIterationEnd,
+    NULL /* pollIterationStats */
 };
 
 void
@@ -203,7 +221,9 @@ FixedThreadPool::FixedThreadPool (Object * const coderef_container,
     : DependentCodeReferenced (coderef_container),
       main_thread_ctx (coderef_container)
 #ifdef LIBMARY_MT_SAFE
-      , thread_selector (NULL)
+      , thread_selector (NULL),
+      thread_page_pool (coderef_container),
+      num_started_threads (0)
 #endif
 {
 #ifdef LIBMARY_MT_SAFE
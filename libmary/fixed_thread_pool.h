@@ -29,6 +29,7 @@
 #include <libmary/active_poll_group.h>
 #include <libmary/deferred_processor.h>
 #include <libmary/deferred_connection_sender.h>
+#include <libmary/page_pool.h>
 #ifdef LIBMARY_MT_SAFE
 #include <libmary/multi_thread.h>
 #endif
@@ -73,6 +74,10 @@ private:
     mt_mutex (mutex) ThreadDataList::Element *thread_selector;
 
     AtomicInt should_stop;
+
+    mt_const DataDepRef<PagePool> thread_page_pool;
+    // Number of threads which have started, used for thread numbering.
+    mt_mutex (mutex) Count num_started_threads;
 #endif
 
     static void firstTimerAdded (void *_thread_ctx);
@@ -110,6 +115,29 @@ public:
 #endif
     }
 
+    // Pins threads to CPUs from 'cpu_list'. See MultiThread::setCpuAffinity().
+    // Should be called before spawn().
+    mt_const mt_throws Result setCpuAffinity (ConstMemory const cpu_list)
+    {
+#ifdef LIBMARY_MT_SAFE
+        return multi_thread->setCpuAffinity (cpu_list);
+#else
+        (void) cpu_list;
+        return Result::Success;
+#endif
+    }
+
+    // Makes every thread prefill its cache of 'page_pool' at startup.
+    // See ServerApp::setThreadPagePool(). Should be called before spawn().
+    mt_const void setThreadPagePool (PagePool * const page_pool)
+    {
+#ifdef LIBMARY_MT_SAFE
+        thread_page_pool = page_pool;
+#else
+        (void) page_pool;
+#endif
+    }
+
     mt_const void setMainThreadContext (ServerThreadContext * const main_thread_ctx)
         { this->main_thread_ctx = main_thread_ctx; }
 
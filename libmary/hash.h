@@ -134,41 +134,116 @@ private:
 	IntrusiveAvlTree< T, Extractor, Comparator, HashName > tree;
     };
 
+    // Number of cells of 'old_table' to be moved to 'hash_table'
+    // with every add() or remove() call during rehashing.
+    enum { RehashStep = 4 };
+
     bool growing;
 
     Cell *hash_table;
     Size  hash_size;
 
+  // When the number of entries exceeds the number of cells, the table is
+  // doubled. The entries are moved from the old table a few cells at a time,
+  // so that no single add() has to pay for the whole rehash.
+
+    // Non-NULL while rehashing.
+    Cell *old_table;
+    Size  old_hash_size;
+    // Cells of 'old_table' below 'rehash_pos' have been moved to 'hash_table'.
+    Size  rehash_pos;
+
+    Size num_entries;
+
     IntrusiveList<T, HashName> node_list;
 
+    Cell* getCell (Uint32 const unrolled_hash) const
+    {
+	if (old_table) {
+	    Size const old_idx = unrolled_hash % old_hash_size;
+	    if (old_idx >= rehash_pos)
+		return &old_table [old_idx];
+	}
+
+	return &hash_table [unrolled_hash % hash_size];
+    }
+
+    void rehashStep ()
+    {
+	Size const end_pos = (old_hash_size - rehash_pos > (Size) RehashStep ?
+				      rehash_pos + RehashStep : old_hash_size);
+	for (; rehash_pos < end_pos; ++rehash_pos) {
+	    Cell * const cell = &old_table [rehash_pos];
+	    while (!cell->tree.isEmpty()) {
+		T * const entry = static_cast <T*> (cell->tree.top);
+		cell->tree.remove (entry);
+		hash_table [entry->unrolled_hash % hash_size].tree.add (entry);
+	    }
+	}
+
+	if (rehash_pos == old_hash_size) {
+	    delete[] old_table;
+	    old_table = NULL;
+	}
+    }
+
+    void startRehash ()
+    {
+	old_table = hash_table;
+	old_hash_size = hash_size;
+	rehash_pos = 0;
+
+	hash_size *= 2;
+	hash_table = new Cell [hash_size];
+
+	rehashStep ();
+    }
+
 public:
     bool isEmpty () const
     {
 	return node_list.isEmpty();
     }
 
+    Size getNumEntries () const
+    {
+	return num_entries;
+    }
+
     void add (T * const entry)
     {
 	Uint32 const unrolled_hash = Hasher::hash (Extractor::getValue (entry));
-	Uint32 const hash = unrolled_hash % hash_size;
 
 	entry->unrolled_hash = unrolled_hash;
-	hash_table [hash].tree.add (entry);
+	getCell (unrolled_hash)->tree.add (entry);
 
 	node_list.append (entry);
+	++num_entries;
 
-	// TODO if (growing) ... then grow.
+	if (old_table)
+	    rehashStep ();
+	else
+	if (growing && num_entries > hash_size)
+	    startRehash ();
     }
 
     void remove (T * const entry)
     {
-	hash_table [entry->unrolled_hash % hash_size].tree.remove (entry);
+	getCell (entry->unrolled_hash)->tree.remove (entry);
 	node_list.remove (entry);
+	--num_entries;
+
+	if (old_table)
+	    rehashStep ();
     }
 
     void clear ()
     {
 	node_list.clear ();
+	num_entries = 0;
+
+	delete[] old_table;
+	old_table = NULL;
 
 	delete[] hash_table;
 	hash_table = new Cell [hash_size];
@@ -178,15 +253,17 @@ public:
     T* lookup (C key)
     {
 	Uint32 const unrolled_hash = Hasher::hash (key);
-	Uint32 const hash = unrolled_hash % hash_size;
-
-	return hash_table [hash].tree.lookup (key);
+	return getCell (unrolled_hash)->tree.lookup (key);
     }
 
     Hash_anybase (Size const initial_hash_size,
 		  bool const growing)
 	: growing (growing),
-	  hash_size (initial_hash_size)
+	  hash_size (initial_hash_size > 0 ? initial_hash_size : 1),
+	  old_table (NULL),
+	  old_hash_size (0),
+	  rehash_pos (0),
+	  num_entries (0)
     {
 	hash_table = new Cell [hash_size];
     }
@@ -204,6 +281,7 @@ public:
 
     ~Hash_anybase ()
     {
+	delete[] old_table;
 	delete[] hash_table;
     }
 
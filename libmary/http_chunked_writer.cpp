@@ -0,0 +1,100 @@
+/*  LibMary - C++ library for high-performance network servers
+    Copyright (C) 2011-2013 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#include <libmary/http_chunked_writer.h>
+
+
+namespace M {
+
+Size
+HttpChunkedWriter::formatChunkHeader (Byte   * const mt_nonnull buf,
+                                      Uint64   const chunk_size)
+{
+    Size pos = 0;
+    if (chunk_data_pending) {
+        buf [pos++] = 13 /* CR */;
+        buf [pos++] = 10 /* LF */;
+    }
+
+    unsigned num_digits = 1;
+    while (num_digits < 16 && (chunk_size >> (num_digits * 4)))
+        ++num_digits;
+
+    for (unsigned i = num_digits; i > 0; --i)
+        buf [pos++] = "0123456789abcdef" [(chunk_size >> ((i - 1) * 4)) & 0xf];
+
+    buf [pos++] = 13 /* CR */;
+    buf [pos++] = 10 /* LF */;
+
+    return pos;
+}
+
+void
+HttpChunkedWriter::sendPages (PagePool::Page * const mt_nonnull first_page,
+                              Size             const msg_offset,
+                              bool             const do_flush)
+{
+    Size const chunk_size = PagePool::countPageListDataLen (first_page, msg_offset);
+    if (chunk_size == 0) {
+      // A chunk of zero size would end the message body.
+        page_pool->msgUnref (first_page);
+        return;
+    }
+
+    Sender::MessageEntry_Pages * const msg_pages = Sender::MessageEntry_Pages::createNew (MaxHeaderLen);
+    msg_pages->header_len = formatChunkHeader (msg_pages->getHeaderData(), chunk_size);
+    msg_pages->page_pool = page_pool;
+    msg_pages->setFirstPage (first_page);
+    msg_pages->msg_offset = msg_offset;
+
+    chunk_data_pending = true;
+
+    sender->sendMessage (msg_pages, do_flush);
+}
+
+void
+HttpChunkedWriter::send (ConstMemory const mem,
+                         bool        const do_flush)
+{
+    if (mem.len() == 0)
+        return;
+
+    PagePool::PageListHead page_list;
+    page_pool->getFillPages (&page_list, mem);
+
+    sendPages (page_list.first, 0 /* msg_offset */, do_flush);
+}
+
+void
+HttpChunkedWriter::sendLastChunk (bool const do_flush)
+{
+    Byte buf [MaxHeaderLen];
+    Size len = formatChunkHeader (buf, 0 /* chunk_size */);
+    // Empty trailer.
+    buf [len++] = 13 /* CR */;
+    buf [len++] = 10 /* LF */;
+
+    chunk_data_pending = false;
+
+    sender->send (page_pool, do_flush, ConstMemory (buf, len));
+}
+
+}
+
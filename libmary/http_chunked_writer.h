@@ -0,0 +1,88 @@
+/*  LibMary - C++ library for high-performance network servers
+    Copyright (C) 2011-2013 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#ifndef LIBMARY__HTTP_CHUNKED_WRITER__H__
+#define LIBMARY__HTTP_CHUNKED_WRITER__H__
+
+
+#include <libmary/types.h>
+#include <libmary/sender.h>
+#include <libmary/page_pool.h>
+
+
+namespace M {
+
+// Sends HTTP message body with chunked transfer encoding, which allows to
+// stream a reply of unknown length without closing the connection.
+// The header of the reply should contain "Transfer-Encoding: chunked".
+//
+// Chunk size lines are sent as headers of page messages, hence chunk data
+// is not copied by sendPages().
+//
+// Not thread-safe.
+class HttpChunkedWriter
+{
+private:
+    mt_const Sender   *sender;
+    mt_const PagePool *page_pool;
+
+    // CRLF which ends chunk data is sent along with the next chunk size line.
+    bool chunk_data_pending;
+
+    // "\r\n" + up to 16 hex digits + "\r\n"
+    enum { MaxHeaderLen = 20 };
+
+    Size formatChunkHeader (Byte   * mt_nonnull buf,
+                            Uint64  chunk_size);
+
+public:
+    // Sends the pages as one chunk. Takes over one reference to every page,
+    // like Sender::sendPages() does.
+    void sendPages (PagePool::Page * mt_nonnull first_page,
+                    Size            msg_offset,
+                    bool            do_flush);
+
+    // Copies @mem to pages and sends it as one chunk.
+    void send (ConstMemory mem,
+               bool        do_flush);
+
+    // Ends the message body. The writer may then be used for the next reply.
+    void sendLastChunk (bool do_flush = true);
+
+    mt_const void init (Sender   * mt_nonnull sender,
+                        PagePool * mt_nonnull page_pool)
+    {
+        this->sender = sender;
+        this->page_pool = page_pool;
+    }
+
+    HttpChunkedWriter ()
+        : sender    (NULL),
+          page_pool (NULL),
+          chunk_data_pending (false)
+    {
+    }
+};
+
+}
+
+
+#endif /* LIBMARY__HTTP_CHUNKED_WRITER__H__ */
+
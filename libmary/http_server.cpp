@@ -35,7 +35,8 @@ static LogGroup libMary_logGroup_http ("http", LogLevel::I);
 Receiver::Frontend const HttpServer::receiver_frontend = {
     processInput,
     processEof,
-    processError
+    processError,
+    processInputPages
 };
 
 Sender::Frontend const HttpServer::sender_frontend = {
@@ -90,8 +91,9 @@ HttpRequest::parseParameters_paramCallback (ConstMemory   const name,
 {
     HttpRequest * const self = static_cast <HttpRequest*> (_self);
 
-    HttpRequest::Parameter * const param = new (std::nothrow) HttpRequest::Parameter;
-    assert (param);
+    HttpRequest::Parameter * const param =
+            new (self->arenaAlloc (sizeof (HttpRequest::Parameter), alignof (HttpRequest::Parameter)))
+                    HttpRequest::Parameter;
     param->name = name;
     param->value = value;
 
@@ -393,17 +395,148 @@ void HttpRequest::parseEntityTagList (ConstMemory       const mem,
     }
 }
 
-HttpRequest::~HttpRequest ()
+Byte*
+HttpRequest::arenaAlloc (Size const len,
+                         Size const alignment)
+{
+    if (len <= ArenaBlockSize)
+        return arena.push_malign (len, alignment);
+
+    Byte * const buf = new (std::nothrow) Byte [sizeof (OversizedBlock) + alignment + len];
+    assert (buf);
+
+    OversizedBlock * const block = reinterpret_cast <OversizedBlock*> (buf);
+    block->next = oversized_blocks;
+    oversized_blocks = block;
+
+    return (Byte*) alignPtr (buf + sizeof (OversizedBlock), alignment);
+}
+
+ConstMemory
+HttpRequest::arenaCopy (ConstMemory const mem)
+{
+    if (mem.len() == 0)
+        return ConstMemory();
+
+    Byte * const buf = arenaAlloc (mem.len(), 1 /* alignment */);
+    memcpy (buf, mem.mem(), mem.len());
+    return ConstMemory (buf, mem.len());
+}
+
+void
+HttpRequest::addHeader (HttpHeaderId const header_id,
+                        ConstMemory  const name,
+                        ConstMemory  const value)
+{
+    if (!last_header_chunk || last_header_chunk->num_entries == HeaderChunk::MaxEntries) {
+        HeaderChunk * const chunk =
+                new (arenaAlloc (sizeof (HeaderChunk), alignof (HeaderChunk))) HeaderChunk;
+        chunk->next = NULL;
+        chunk->num_entries = 0;
+
+        if (last_header_chunk)
+            last_header_chunk->next = chunk;
+        else
+            first_header_chunk = chunk;
+
+        last_header_chunk = chunk;
+    }
+
+    // Name and value are stored together. The buffer is non-NULL even if
+    // both are empty, which tells an empty value from a missing header.
+    Byte * const buf = arenaAlloc (name.len() + value.len(), 1 /* alignment */);
+    memcpy (buf, name.mem(), name.len());
+    memcpy (buf + name.len(), value.mem(), value.len());
+
+    HeaderEntry * const entry = &last_header_chunk->entries [last_header_chunk->num_entries];
+    ++last_header_chunk->num_entries;
+
+    entry->header_id = header_id;
+    entry->name  = ConstMemory (buf, name.len());
+    entry->value = ConstMemory (buf + name.len(), value.len());
+}
+
+ConstMemory
+HttpRequest::getHeader (HttpHeaderId const header_id) const
 {
-    delete[] path;
+    ConstMemory value;
+    for (HeaderChunk const *chunk = first_header_chunk; chunk; chunk = chunk->next) {
+        for (Count i = 0; i < chunk->num_entries; ++i) {
+            if (chunk->entries [i].header_id == header_id)
+                value = chunk->entries [i].value;
+        }
+    }
+
+    return value;
+}
+
+ConstMemory
+HttpRequest::getHeader (ConstMemory const name) const
+{
+    HttpHeaderId const header_id = httpLookupHeaderName (name);
+    if (header_id != HttpHeaderId::Unknown)
+        return getHeader (header_id);
+
+    ConstMemory value;
+    for (HeaderChunk const *chunk = first_header_chunk; chunk; chunk = chunk->next) {
+        for (Count i = 0; i < chunk->num_entries; ++i) {
+            HeaderEntry const &entry = chunk->entries [i];
+            if (entry.header_id == HttpHeaderId::Unknown
+                && httpHeaderNameEqual (entry.name, name))
+            {
+                value = entry.value;
+            }
+        }
+    }
 
+    return value;
+}
+
+void
+HttpRequest::releaseArena ()
+{
     {
 	ParameterHash::iter iter (parameter_hash);
 	while (!parameter_hash.iter_done (iter)) {
 	    Parameter * const param = parameter_hash.iter_next (iter);
-	    delete param;
+            parameter_hash.remove (param);
+            param->~Parameter ();
 	}
     }
+
+    while (oversized_blocks) {
+        OversizedBlock * const next_block = oversized_blocks->next;
+        delete[] reinterpret_cast <Byte*> (oversized_blocks);
+        oversized_blocks = next_block;
+    }
+
+    arena.clear ();
+}
+
+void
+HttpRequest::reset ()
+{
+    releaseArena ();
+
+    request_line   = ConstMemory();
+    method         = ConstMemory();
+    full_path      = ConstMemory();
+    path           = NULL;
+    num_path_elems = 0;
+
+    content_length           = 0;
+    content_length_specified = false;
+    chunked                  = false;
+
+    first_header_chunk = NULL;
+    last_header_chunk  = NULL;
+
+    keepalive = true;
+}
+
+HttpRequest::~HttpRequest ()
+{
+    releaseArena ();
 }
 
 Result
@@ -411,8 +544,8 @@ HttpServer::processRequestLine (Memory const _mem)
 {
     logD (http, _func, "mem: ", _mem);
 
-    cur_req->request_line = grab (new (std::nothrow) String (_mem));
-    ConstMemory const mem = cur_req->request_line->mem();
+    cur_req->request_line = cur_req->arenaCopy (_mem);
+    ConstMemory const mem = cur_req->request_line;
 
     Byte const *path_beg = (Byte const *) memchr (mem.mem(), 32 /* SP */, mem.len());
     if (!path_beg) {
@@ -481,8 +614,9 @@ HttpServer::processRequestLine (Memory const _mem)
     if (cur_req->num_path_elems > 0) {
       // Filling path elements.
 
-	cur_req->path = new (std::nothrow) ConstMemory [cur_req->num_path_elems];
-        assert (cur_req->path);
+	cur_req->path = reinterpret_cast <ConstMemory*> (
+                                cur_req->arenaAlloc (sizeof (ConstMemory) * cur_req->num_path_elems,
+                                                     alignof (ConstMemory)));
 
 	Size path_pos = path_offs;
 	Count index = 0;
@@ -528,12 +662,12 @@ HttpServer::processRequestLine (Memory const _mem)
 }
 
 void
-HttpServer::processHeaderField (ConstMemory const &mem)
+HttpServer::processHeaderField (ConstMemory const &mem,
+                                Size         const colon_pos)
 {
     logD (http, _func, mem);
 
-    Byte const * const header_name_end = (Byte const *) memchr (mem.mem(), ':', mem.len());
-    if (!header_name_end) {
+    if (colon_pos >= mem.len()) {
 	logE_ (_func, "bad header line: ", mem);
         logLock ();
 	hexdump (logs, mem);
@@ -541,15 +675,10 @@ HttpServer::processHeaderField (ConstMemory const &mem)
 	return;
     }
 
-    // TODO allow modifying data by receiver backend (Memory, not ConstMemory).
-
-    Size const header_name_len = header_name_end - mem.mem();
-    for (Size i = 0; i < header_name_len; ++i)
-	// TODO Get rid of this const_cast
-	((Byte*) mem.mem()) [i] = tolower (mem.mem() [i]);
+    Size const header_name_len = colon_pos;
 
     // TODO SP, HT - correct?
-    Byte const *header_value_buf = header_name_end + 1;
+    Byte const *header_value_buf = mem.mem() + colon_pos + 1;
     Size header_value_len = mem.len() - header_name_len - 1;
     while (header_value_len > 0
 	   && (header_value_buf [0] == 32 /* SP */ ||
@@ -562,7 +691,12 @@ HttpServer::processHeaderField (ConstMemory const &mem)
     ConstMemory const header_name (mem.mem(), header_name_len);
     ConstMemory const header_value (header_value_buf, header_value_len);
 
-    if (!compare (header_name, "content-length")) {
+    // Header names are case-insensitive.
+    HttpHeaderId const header_id = httpLookupHeaderName (header_name);
+
+    cur_req->addHeader (header_id, header_name, header_value);
+
+    if (header_id == HttpHeaderId::ContentLength) {
 	recv_content_length = strToUlong (header_value);
         recv_content_length_specified = true;
 
@@ -571,7 +705,33 @@ HttpServer::processHeaderField (ConstMemory const &mem)
 
 	logD (http, _func, "recv_content_length: ", recv_content_length);
     } else
-    if (!compare (header_name, "expect")) {
+    if (header_id == HttpHeaderId::TransferEncoding) {
+      // "chunked" should be the last transfer coding applied. Other codings
+      // are not supported and are left to the frontend. The last
+      // Transfer-Encoding header field has the final coding.
+        recv_chunked = false;
+
+        ConstMemory value = header_value;
+        while (value.len() > 0
+               && (value.mem() [value.len() - 1] == 32 /* SP */ ||
+                   value.mem() [value.len() - 1] ==  9 /* HT */))
+        {
+            value = value.region (0, value.len() - 1);
+        }
+
+        ConstMemory const suffix = "chunked";
+        if (value.len() >= suffix.len()
+            && httpHeaderNameEqual (value.region (value.len() - suffix.len()), suffix)
+            && (value.len() == suffix.len()
+                || value.mem() [value.len() - suffix.len() - 1] == ','
+                || value.mem() [value.len() - suffix.len() - 1] == 32 /* SP */
+                || value.mem() [value.len() - suffix.len() - 1] ==  9 /* HT */))
+        {
+            recv_chunked = true;
+            logD (http, _func, "chunked transfer encoding");
+        }
+    } else
+    if (header_id == HttpHeaderId::Expect) {
 	if (!compare (header_value, "100-continue")) {
             if (sender && page_pool) {
                 logD (http, _func, "responding to 100-continue");
@@ -591,15 +751,6 @@ HttpServer::processHeaderField (ConstMemory const &mem)
                     logW_ (_this_func, "PagePool is not set");
             }
 	}
-    } else
-    if (!compare (header_name, "accept-language")) {
-        cur_req->accept_language = grab (new (std::nothrow) String (header_value));
-    } else
-    if (!compare (header_name, "if-modified-since")) {
-        cur_req->if_modified_since = grab (new (std::nothrow) String (header_value));
-    } else
-    if (!compare (header_name, "if-none-match")) {
-        cur_req->if_none_match = grab (new (std::nothrow) String (header_value));
     }
 }
 
@@ -632,14 +783,23 @@ HttpServer::receiveRequestLine (Memory const _mem,
 
 	Size cr_pos;
 	for (;;) {
-	    Byte const * const cr_ptr = (Byte const *) memchr (mem.mem() + recv_pos, 13 /* CR */, mem.len() - recv_pos);
-	    if (!cr_ptr) {
+	  // Looking for CR, and for ':' in header fields in the same pass.
+
+	    bool const want_colon = (req_state == RequestState::HeaderField && !recv_colon_found);
+	    Size colon_offs;
+	    Size const cr_offs = httpScanLine (mem.region (recv_pos), want_colon ? &colon_offs : NULL);
+	    if (want_colon && colon_offs < cr_offs) {
+		recv_colon_found = true;
+		recv_colon_pos = recv_pos + colon_offs;
+	    }
+
+	    if (cr_offs == mem.len() - recv_pos) {
 		recv_pos = mem.len();
 		logD (http, _func, "returning Again #1, recv_pos: ", recv_pos);
 		return Receiver::ProcessInputResult::Again;
 	    }
 
-	    cr_pos = cr_ptr - mem.mem();
+	    cr_pos = recv_pos + cr_offs;
 	    // We need LF and one non-SP symbol to determine header field end.
 	    // Also we want to look 2 symbols ahead to detect end of message headers.
 	    // This means that we need 3 symbols of lookahead.
@@ -671,17 +831,38 @@ HttpServer::receiveRequestLine (Memory const _mem,
 	    logD (http, _func, "calling processRequestLine()");
 	    processRequestLine (mem.region (0, cr_pos));
 	    req_state = RequestState::HeaderField;
-	} else
-	    processHeaderField (mem.region (0, cr_pos));
+	} else {
+	    processHeaderField (mem.region (0, cr_pos), recv_colon_found ? recv_colon_pos : cr_pos);
+	}
 
 	Size const next_pos = cr_pos + 2;
 	*ret_accepted = field_offs + next_pos;
 
 	recv_pos = 0;
+	recv_colon_found = false;
 
 	if (mem.mem() [cr_pos + 2] == 13 /* CR */ &&
 	    mem.mem() [cr_pos + 3] == 10 /* LF */)
 	{
+	    if (cur_req->getHeader (HttpHeaderId::TransferEncoding).mem()) {
+		if (!recv_chunked && !client_mode) {
+		  // The length of a request body with a final transfer coding
+		  // other than "chunked" cannot be determined (RFC 7230, 3.3.3).
+		    logW (http, _func, "unsupported transfer coding: ",
+			  cur_req->getHeader (HttpHeaderId::TransferEncoding));
+		    return Receiver::ProcessInputResult::Error;
+		}
+
+	      // Transfer-Encoding overrides Content-Length (RFC 7230, 3.3.3).
+	      // A response with a final coding other than "chunked" is read
+	      // until the connection is closed.
+		recv_content_length = 0;
+		recv_content_length_specified = false;
+		cur_req->content_length = 0;
+		cur_req->content_length_specified = false;
+		cur_req->chunked = recv_chunked;
+	    }
+
 	    if (frontend && frontend->request)
 		frontend.call (frontend->request, /*(*/ cur_req /*)*/);
 
@@ -697,13 +878,181 @@ HttpServer::receiveRequestLine (Memory const _mem,
     unreachable ();
 }
 
+Receiver::ProcessInputResult
+HttpServer::receiveChunkedBody (Memory   const mem,
+                                Size   * const mt_nonnull ret_accepted,
+                                bool   * const mt_nonnull ret_body_done)
+{
+    *ret_accepted = 0;
+    *ret_body_done = false;
+
+    Size pos = 0;
+    while (pos < mem.len()) {
+        if (recv_chunk_state == ChunkState::ChunkData) {
+            Size toprocess = mem.len() - pos;
+            if (toprocess > recv_chunk_size)
+                toprocess = (Size) recv_chunk_size;
+
+            Size accepted = toprocess;
+            if (frontend && frontend->messageBody) {
+                frontend.call (frontend->messageBody, /*(*/
+                        cur_req,
+                        Memory (mem.mem() + pos, toprocess),
+                        false /* end_of_request */,
+                        &accepted /*)*/);
+                assert (accepted <= toprocess);
+            }
+
+            pos += accepted;
+            recv_chunk_size -= accepted;
+            *ret_accepted = pos;
+
+            if (accepted < toprocess) {
+                logD (http, _func, "chunk data was not processed in full");
+                return Receiver::ProcessInputResult::Again;
+            }
+
+            if (recv_chunk_size == 0)
+                recv_chunk_state = ChunkState::ChunkDataCr;
+
+            continue;
+        }
+
+        Byte const c = mem.mem() [pos];
+        ++pos;
+
+        switch (recv_chunk_state) {
+            case ChunkState::ChunkSize: {
+                Uint32 digit;
+                if (c >= '0' && c <= '9')
+                    digit = c - '0';
+                else
+                if (c >= 'a' && c <= 'f')
+                    digit = c - 'a' + 10;
+                else
+                if (c >= 'A' && c <= 'F')
+                    digit = c - 'A' + 10;
+                else {
+                    if (recv_chunk_size_digits == 0)
+                        goto _bad_chunk;
+
+                    if (c == 13 /* CR */)
+                        recv_chunk_state = ChunkState::ChunkSizeLf;
+                    else
+                    if (c == ';' || c == 32 /* SP */ || c == 9 /* HT */)
+                        recv_chunk_state = ChunkState::ChunkExtension;
+                    else
+                        goto _bad_chunk;
+
+                    break;
+                }
+
+                if (recv_chunk_size >> 60)
+                    goto _bad_chunk;
+
+                recv_chunk_size = (recv_chunk_size << 4) | digit;
+                ++recv_chunk_size_digits;
+            } break;
+            case ChunkState::ChunkExtension: {
+              // Chunk extensions are ignored.
+                if (c == 13 /* CR */)
+                    recv_chunk_state = ChunkState::ChunkSizeLf;
+            } break;
+            case ChunkState::ChunkSizeLf: {
+                if (c != 10 /* LF */)
+                    goto _bad_chunk;
+
+                logD (http, _func, "chunk size: ", recv_chunk_size);
+                recv_chunk_size_digits = 0;
+                if (recv_chunk_size == 0)
+                    recv_chunk_state = ChunkState::TrailerStart;
+                else
+                    recv_chunk_state = ChunkState::ChunkData;
+            } break;
+            case ChunkState::ChunkDataCr: {
+                if (c != 13 /* CR */)
+                    goto _bad_chunk;
+
+                recv_chunk_state = ChunkState::ChunkDataLf;
+            } break;
+            case ChunkState::ChunkDataLf: {
+                if (c != 10 /* LF */)
+                    goto _bad_chunk;
+
+                recv_chunk_state = ChunkState::ChunkSize;
+            } break;
+            case ChunkState::TrailerStart: {
+                if (c == 13 /* CR */)
+                    recv_chunk_state = ChunkState::LastLf;
+                else
+                    recv_chunk_state = ChunkState::TrailerField;
+            } break;
+            case ChunkState::TrailerField: {
+              // Trailer fields are ignored.
+                if (c == 13 /* CR */)
+                    recv_chunk_state = ChunkState::TrailerFieldLf;
+            } break;
+            case ChunkState::TrailerFieldLf: {
+                if (c != 10 /* LF */)
+                    goto _bad_chunk;
+
+                recv_chunk_state = ChunkState::TrailerStart;
+            } break;
+            case ChunkState::LastLf: {
+                if (c != 10 /* LF */)
+                    goto _bad_chunk;
+
+                logD (http, _func, "chunked message body processed in full");
+
+                *ret_accepted = pos;
+                *ret_body_done = true;
+
+                if (frontend && frontend->messageBody) {
+                    Size dummy_accepted = 0;
+                    frontend.call (frontend->messageBody, /*(*/
+                            cur_req,
+                            Memory(),
+                            true /* end_of_request */,
+                            &dummy_accepted /*)*/);
+                }
+
+                return Receiver::ProcessInputResult::Normal;
+            } break;
+            default:
+                unreachable ();
+        }
+
+        *ret_accepted = pos;
+    }
+
+    return Receiver::ProcessInputResult::Again;
+
+_bad_chunk:
+    logW (http, _func, "bad chunked message body");
+    return Receiver::ProcessInputResult::Error;
+}
+
 void
 HttpServer::resetRequestState ()
 {
     recv_pos = 0;
     recv_content_length = 0;
     recv_content_length_specified = false;
+    recv_colon_found = false;
+    recv_chunked = false;
+    recv_chunk_state = ChunkState::ChunkSize;
+    recv_chunk_size = 0;
+    recv_chunk_size_digits = 0;
+
+    // Reusing the request object to avoid allocations for the next request
+    // on the connection. HttpRequest is single-threaded (StReferenced), hence
+    // the reference count tells reliably if the frontend has kept a reference.
+    if (cur_req && cur_req->getRefCount() == 1) {
+        cur_req->reset ();
+        spare_req = cur_req;
+    }
     cur_req = NULL;
+
     req_state = RequestState::RequestLine;
 }
 
@@ -730,7 +1079,12 @@ HttpServer::processInput (Memory const &_mem,
 		logD (http, _func, "RequestState::RequestLine");
 	    case RequestState::HeaderField: {
 		if (!self->cur_req) {
-		    self->cur_req = st_grab (new (std::nothrow) HttpRequest (self->client_mode));
+                    if (self->spare_req) {
+                        self->cur_req = self->spare_req;
+                        self->spare_req = NULL;
+                    } else {
+                        self->cur_req = st_grab (new (std::nothrow) HttpRequest (self->client_mode));
+                    }
 		    self->cur_req->client_addr = self->client_addr;
 		}
 
@@ -743,6 +1097,10 @@ HttpServer::processInput (Memory const &_mem,
 
 		mem = mem.region (line_accepted);
 
+		if (self->recv_chunked) {
+		    self->recv_pos = 0;
+		    self->req_state = RequestState::ChunkedBody;
+		} else
 		if ((self->client_mode && !self->recv_content_length_specified)
                     || self->recv_content_length > 0)
                 {
@@ -797,6 +1155,17 @@ HttpServer::processInput (Memory const &_mem,
 
                 self->resetRequestState ();
 	    } break;
+	    case RequestState::ChunkedBody: {
+		bool body_done;
+		Size accepted;
+		Receiver::ProcessInputResult const res = self->receiveChunkedBody (mem, &accepted, &body_done);
+		*ret_accepted += accepted;
+		if (!body_done)
+		    return res;
+
+		mem = mem.region (accepted);
+		self->resetRequestState ();
+	    } break;
 	    default:
 		unreachable ();
 	}
@@ -804,6 +1173,128 @@ HttpServer::processInput (Memory const &_mem,
     unreachable ();
 }
 
+Receiver::ProcessInputResult
+HttpServer::processInputPages (PagePool::Page * const first_page,
+                               Size             const msg_offset,
+                               Size             const msg_len,
+                               Size           * const mt_nonnull ret_accepted,
+                               void           * const _self)
+{
+    logD (http, _func, msg_len, " bytes");
+
+    HttpServer * const self = static_cast <HttpServer*> (_self);
+
+    // Longest request line or header field which may span page boundaries.
+    Size const max_joined_len = 1 << 16 /* 64 Kb */;
+
+    *ret_accepted = 0;
+
+    PagePool::Page *page = first_page;
+    Size offs = msg_offset;
+    Size left = msg_len;
+    // Number of unaccepted bytes which have been passed to processInput()
+    // already. More than that should be passed for the parser to progress.
+    Size seen = 0;
+    while (left > 0) {
+        while (offs >= page->data_len) {
+            offs -= page->data_len;
+            page = page->getNextMsgPage();
+        }
+
+        if ((self->req_state == RequestState::RequestLine ||
+             self->req_state == RequestState::HeaderField)
+            && self->recv_pos > seen)
+        {
+            seen = self->recv_pos;
+        }
+
+        Size page_len = page->data_len - offs;
+        if (page_len > left)
+            page_len = left;
+
+        Memory mem;
+        if (seen < page_len) {
+            mem = Memory (page->getData() + offs, page_len);
+        } else {
+          // A header field spans page boundaries. Copying it to contiguous
+          // memory up to the end of the page with new data.
+
+            if (seen >= max_joined_len) {
+                logW (http, _func, "HTTP header field is too long");
+                return Receiver::ProcessInputResult::Error;
+            }
+
+            Size join_len = 0;
+            {
+                PagePool::Page *cur_page = page;
+                Size cur_offs = offs;
+                while (join_len <= seen) {
+                    join_len += cur_page->data_len - cur_offs;
+                    cur_page = cur_page->getNextMsgPage();
+                    cur_offs = 0;
+                }
+
+                if (join_len > left)
+                    join_len = left;
+            }
+
+            if (self->join_buf_size < join_len) {
+                delete[] self->join_buf;
+                self->join_buf = new (std::nothrow) Byte [join_len];
+                assert (self->join_buf);
+                self->join_buf_size = join_len;
+            }
+
+            {
+                PagePool::Page *cur_page = page;
+                Size cur_offs = offs;
+                Size pos = 0;
+                while (pos < join_len) {
+                    Size len = cur_page->data_len - cur_offs;
+                    if (len > join_len - pos)
+                        len = join_len - pos;
+
+                    memcpy (self->join_buf + pos, cur_page->getData() + cur_offs, len);
+                    pos += len;
+
+                    cur_page = cur_page->getNextMsgPage();
+                    cur_offs = 0;
+                }
+            }
+
+            mem = Memory (self->join_buf, join_len);
+        }
+
+        Size accepted;
+        Receiver::ProcessInputResult const res = processInput (mem, &accepted, self);
+        *ret_accepted += accepted;
+        offs += accepted;
+        left -= accepted;
+
+        if (res != Receiver::ProcessInputResult::Again)
+            return res;
+
+        if (accepted == mem.len()) {
+            seen = 0;
+            continue;
+        }
+
+        // Only incomplete header fields are worth retrying with more data.
+        // Partially accepted message body means that the frontend wants
+        // to wait.
+        if ((self->req_state != RequestState::RequestLine &&
+             self->req_state != RequestState::HeaderField)
+            || left == mem.len() - accepted)
+        {
+            return Receiver::ProcessInputResult::Again;
+        }
+
+        seen = mem.len() - accepted;
+    }
+
+    return Receiver::ProcessInputResult::Again;
+}
+
 void
 HttpServer::processEof (void * const _self)
 {
@@ -859,5 +1350,10 @@ HttpServer::senderClosed (Exception * const exc_,
 	self->frontend.call (self->frontend->closed, /*(*/ self->cur_req, exc_ /*)*/);
 }
 
+HttpServer::~HttpServer ()
+{
+    delete[] join_buf;
+}
+
 }
 
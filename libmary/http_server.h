@@ -30,6 +30,8 @@
 #include <libmary/receiver.h>
 #include <libmary/code_referenced.h>
 #include <libmary/util_net.h>
+#include <libmary/vstack.h>
+#include <libmary/http_tokenizer.h>
 
 
 namespace M {
@@ -70,9 +72,45 @@ private:
 		  MemoryComparator<> >
 	    ParameterHash;
 
+    // Parsing artifacts which can't point into the receive buffer
+    // are stored in this arena, which is cleared in reset().
+    // Request line is accepted and taken out of the receive buffer
+    // before header fields are parsed, hence it is copied as well.
+    class OversizedBlock
+    {
+    public:
+        OversizedBlock *next;
+    };
+
+    // Header fields of the request, in the order of arrival.
+    // Names and values are copied to the arena.
+    class HeaderEntry
+    {
+    public:
+        HttpHeaderId header_id;
+        ConstMemory  name;
+        ConstMemory  value;
+    };
+
+    class HeaderChunk
+    {
+    public:
+        enum { MaxEntries = 16 };
+
+        HeaderChunk *next;
+        Count num_entries;
+        HeaderEntry entries [MaxEntries];
+    };
+
+    enum { ArenaBlockSize = 4096 };
+
+    VStack arena;
+    // Allocations which don't fit in an arena block.
+    OversizedBlock *oversized_blocks;
+
     bool client_mode;
 
-    Ref<String> request_line;
+    ConstMemory request_line;
     ConstMemory method;
     ConstMemory full_path;
     ConstMemory *path;
@@ -82,30 +120,59 @@ private:
     IpAddress   client_addr;
     Uint64      content_length;
     bool        content_length_specified;
-    Ref<String> accept_language;
-    Ref<String> if_modified_since;
-    Ref<String> if_none_match;
+    // "Transfer-Encoding: chunked"
+    bool        chunked;
+
+    HeaderChunk *first_header_chunk;
+    HeaderChunk *last_header_chunk;
 
     ParameterHash parameter_hash;
 
     bool keepalive;
 
+    Byte* arenaAlloc (Size len,
+                      Size alignment);
+
+    ConstMemory arenaCopy (ConstMemory mem);
+
+    void addHeader (HttpHeaderId header_id,
+                    ConstMemory  name,
+                    ConstMemory  value);
+
+    void releaseArena ();
+
+    // Prepares the object to be reused for the next request on the same
+    // connection. Memory allocated for the previous request is retained.
+    void reset ();
+
 public:
-    ConstMemory getRequestLine     () const { return request_line ? request_line->mem() : ConstMemory(); }
+    ConstMemory getRequestLine     () const { return request_line; }
     ConstMemory getMethod          () const { return method; }
     ConstMemory getFullPath        () const { return full_path; }
     Count       getNumPathElems    () const { return num_path_elems; }
     IpAddress   getClientAddress   () const { return client_addr; }
     Uint64      getContentLength   () const { return content_length; }
     bool        getContentLengthSpecified () const { return content_length_specified; }
-    ConstMemory getAcceptLanguage  () const { return accept_language ? accept_language->mem()   : ConstMemory(); }
-    ConstMemory getIfModifiedSince () const { return if_modified_since ? if_modified_since->mem() : ConstMemory(); }
-    ConstMemory getIfNoneMatch     () const { return if_none_match   ? if_none_match->mem()     : ConstMemory(); }
+    // Message body is sent with chunked transfer encoding. It is decoded
+    // by HttpServer, and getContentLength() is 0 in this case.
+    bool        getChunked         () const { return chunked; }
+    ConstMemory getAcceptLanguage  () const { return getHeader (HttpHeaderId::AcceptLanguage); }
+    ConstMemory getIfModifiedSince () const { return getHeader (HttpHeaderId::IfModifiedSince); }
+    ConstMemory getIfNoneMatch     () const { return getHeader (HttpHeaderId::IfNoneMatch); }
+
+    // Returns the value of the last header field with the given name:
+    // a repeated header field overrides the previous ones.
+    // Header names are case-insensitive.
+    // If ret.mem() == NULL, then there's no such header field.
+    // If ret.len() == 0, then the header field has empty value.
+    ConstMemory getHeader (HttpHeaderId header_id) const;
+
+    ConstMemory getHeader (ConstMemory name) const;
 
     void setKeepalive (bool const keepalive) { this->keepalive = keepalive; }
     bool getKeepalive () const { return keepalive; }
 
-    bool hasBody () const { return (client_mode && !getContentLengthSpecified()) || getContentLength() > 0; }
+    bool hasBody () const { return chunked || (client_mode && !getContentLengthSpecified()) || getContentLength() > 0; }
 
     ConstMemory getPath (Count const index) const
     {
@@ -157,11 +224,16 @@ public:
                                     List<EntityTag> * mt_nonnull ret_etags);
 
     HttpRequest (bool const client_mode)
-	: client_mode    (client_mode),
+	: arena          (ArenaBlockSize),
+          oversized_blocks (NULL),
+          client_mode    (client_mode),
           path           (NULL),
 	  num_path_elems (0),
 	  content_length (0),
           content_length_specified (false),
+          chunked        (false),
+          first_header_chunk (NULL),
+          last_header_chunk  (NULL),
 	  keepalive      (true)
     {
     }
@@ -196,7 +268,8 @@ private:
 	enum Value {
 	    RequestLine,
 	    HeaderField,
-	    MessageBody
+	    MessageBody,
+	    ChunkedBody
 	};
 	operator Value () const { return value; }
 	RequestState (Value const value) : value (value) {}
@@ -205,6 +278,29 @@ private:
 	Value value;
     };
 
+    // Position in chunked message body.
+    class ChunkState
+    {
+    public:
+	enum Value {
+	    ChunkSize,
+	    ChunkExtension,
+	    ChunkSizeLf,
+	    ChunkData,
+	    ChunkDataCr,
+	    ChunkDataLf,
+	    TrailerStart,
+	    TrailerField,
+	    TrailerFieldLf,
+	    LastLf
+	};
+	operator Value () const { return value; }
+	ChunkState (Value const value) : value (value) {}
+	ChunkState () {}
+    private:
+	Value value;
+    };
+
     mt_const Cb<Frontend> frontend;
 
     mt_const DataDepRef<Receiver> receiver;
@@ -218,6 +314,9 @@ private:
     AtomicInt input_blocked;
 
     StRef<HttpRequest> cur_req;
+    // Request object of the previous request, reused for the next one
+    // if nobody else holds a reference to it.
+    StRef<HttpRequest> spare_req;
 
     RequestState req_state;
     // Number of bytes received for message body / request line / header field.
@@ -225,15 +324,40 @@ private:
     // What the "Content-Length" HTTP header said for the current request.
     Size recv_content_length;
     bool recv_content_length_specified;
+    // Whether ':' has been found in the header field being received,
+    // and its position relative to the start of the field.
+    bool recv_colon_found;
+    Size recv_colon_pos;
+    // "Transfer-Encoding: chunked" has been received for the current request.
+    bool recv_chunked;
+    ChunkState recv_chunk_state;
+    // Size of the current chunk while parsing chunk-size,
+    // then the number of chunk data bytes left.
+    Uint64 recv_chunk_size;
+    Count recv_chunk_size_digits;
+
+    // Page receive mode: request line and header fields which span page
+    // boundaries are copied here to be parsed as contiguous memory.
+    // Message body is passed to the frontend directly from the pages.
+    Byte *join_buf;
+    Size join_buf_size;
 
     Result processRequestLine (Memory mem);
 
-    void processHeaderField (ConstMemory const &mem);
+    // @colon_pos is mem.len() if there's no ':' in the field.
+    void processHeaderField (ConstMemory const &mem,
+                             Size               colon_pos);
 
     Receiver::ProcessInputResult receiveRequestLine (Memory _mem,
 						     Size * mt_nonnull ret_accepted,
 						     bool * mt_nonnull ret_header_parsed);
 
+    // Feeds chunk data to Frontend::messageBody. *ret_body_done is set to true
+    // when the last chunk and the trailer have been received.
+    Receiver::ProcessInputResult receiveChunkedBody (Memory  mem,
+                                                     Size   * mt_nonnull ret_accepted,
+                                                     bool   * mt_nonnull ret_body_done);
+
     void resetRequestState ();
 
   mt_iface (Receiver::Frontend)
@@ -243,6 +367,12 @@ private:
 						      Size * mt_nonnull ret_accepted,
 						      void *_self);
 
+    static Receiver::ProcessInputResult processInputPages (PagePool::Page *first_page,
+                                                           Size            msg_offset,
+                                                           Size            msg_len,
+                                                           Size           * mt_nonnull ret_accepted,
+                                                           void           *_self);
+
     static void processEof (void *_self);
 
     static void processError (Exception *exc_,
@@ -292,8 +422,18 @@ public:
 	  req_state (RequestState::RequestLine),
 	  recv_pos (0),
 	  recv_content_length (0),
-          recv_content_length_specified (false)
+          recv_content_length_specified (false),
+          recv_colon_found (false),
+          recv_colon_pos (0),
+          recv_chunked (false),
+          recv_chunk_state (ChunkState::ChunkSize),
+          recv_chunk_size (0),
+          recv_chunk_size_digits (0),
+          join_buf (NULL),
+          join_buf_size (0)
     {}
+
+    ~HttpServer ();
 };
 
 }
@@ -32,6 +32,7 @@ static LogGroup libMary_logGroup_http_service ("http_service", LogLevel::N);
 
 HttpService::HttpConnection::HttpConnection ()
     : valid (true),
+      acceptor      (NULL),
       tcp_conn      (this),
       conn_sender   (this),
       conn_receiver (this),
@@ -51,15 +52,220 @@ HttpService::HttpConnection::~HttpConnection ()
 	delete[] preassembly_buf;
 }
 
+namespace {
+    // Binary search in an array of edges sorted by name.
+    template <class T>
+    T const * findRouteEdge (T           const * const edges,
+                             Count               const num_edges,
+                             ConstMemory const &name)
+    {
+        Count left = 0;
+        Count right = num_edges;
+        while (left < right) {
+            Count const middle = left + (right - left) / 2;
+            ComparisonResult const res = compare (edges [middle].name, name);
+            if (res == ComparisonResult::Equal)
+                return &edges [middle];
+
+            if (res == ComparisonResult::Less)
+                left = middle + 1;
+            else
+                right = middle;
+        }
+
+        return NULL;
+    }
+
+    // There's a handful of edges per node, insertion sort is good enough.
+    template <class T>
+    void sortRouteEdges (T     * const edges,
+                         Count   const num_edges)
+    {
+        for (Count i = 1; i < num_edges; ++i) {
+            T const edge = edges [i];
+            Count j = i;
+            while (j > 0 && compare (edges [j - 1].name, edge.name) == ComparisonResult::Greater) {
+                edges [j] = edges [j - 1];
+                --j;
+            }
+            edges [j] = edge;
+        }
+    }
+
+}
+
+HttpService::HandlerEntry*
+HttpService::RouteTable::lookup (HttpRequest * const mt_nonnull req) const
+{
+  // Searching for a handler with the longest matching path.
+  //
+  //     /a/b/c/  - last path element should be empty;
+  //     /a/b/c   - last path element is "c".
+
+    Node const *node = &nodes [0];
+    Count const num_path_els = req->getNumPathElems();
+    for (Count i = 0; i < num_path_els; ++i) {
+	ConstMemory const path_el = req->getPath (i);
+	Edge const * const edge = findRouteEdge (edges + node->first_edge, node->num_edges, path_el);
+	if (!edge) {
+	    HandlerEdge const * const handler_edge =
+		    findRouteEdge (handler_edges + node->first_handler_edge, node->num_handler_edges, path_el);
+	    if (handler_edge)
+		return handler_edge->handler;
+
+	    // We could add a trailing slash to the path and redirect the client.
+	    // This would make both "http://a.b/c" and "http://a.b/c/" work.
+	    return node->default_handler;
+	}
+
+	node = &nodes [edge->node_idx];
+    }
+
+    return node->default_handler;
+}
+
+void
+HttpService::RouteTable::measure (Namespace * const mt_nonnull nsp,
+				  Count     * const mt_nonnull ret_num_nodes,
+				  Count     * const mt_nonnull ret_num_edges,
+				  Count     * const mt_nonnull ret_num_handler_edges)
+{
+    ++*ret_num_nodes;
+
+    {
+	Namespace::NamespaceHash::iter iter (nsp->namespace_hash);
+	while (!nsp->namespace_hash.iter_done (iter)) {
+	    Namespace::NamespaceHash::EntryKey const nsp_key = nsp->namespace_hash.iter_next (iter);
+	    ++*ret_num_edges;
+	    measure (nsp_key.getData(), ret_num_nodes, ret_num_edges, ret_num_handler_edges);
+	}
+    }
+
+    {
+	Namespace::HandlerHash::iter iter (nsp->handler_hash);
+	while (!nsp->handler_hash.iter_done (iter)) {
+	    nsp->handler_hash.iter_next (iter);
+	    ++*ret_num_handler_edges;
+	}
+    }
+}
+
+// Edges of a node occupy a contiguous range, which is reserved before
+// descending into child namespaces.
+void
+HttpService::RouteTable::fill (Namespace * const mt_nonnull nsp,
+			       Count       const node_idx,
+			       Count     * const mt_nonnull next_node_idx,
+			       Count     * const mt_nonnull next_edge_idx,
+			       Count     * const mt_nonnull next_handler_edge_idx)
+{
+    Node * const node = &nodes [node_idx];
+
+    node->first_handler_edge = *next_handler_edge_idx;
+    node->num_handler_edges = 0;
+    node->default_handler = NULL;
+    {
+	Namespace::HandlerHash::iter iter (nsp->handler_hash);
+	while (!nsp->handler_hash.iter_done (iter)) {
+	    ConstMemory const name = nsp->handler_hash.iter_next (iter).getKey();
+	    // If there are several handlers with the same name, then the one
+	    // which handler_hash.lookup() returns wins, like it used to.
+	    HandlerEntry * const handler = nsp->handler_hash.lookup (name).getDataPtr();
+
+	    HandlerEdge * const handler_edge = &handler_edges [node->first_handler_edge + node->num_handler_edges];
+	    ++node->num_handler_edges;
+	    handler_edge->name = name;
+	    handler_edge->handler = handler;
+
+	    if (name.len() == 0)
+		node->default_handler = handler;
+	}
+    }
+    *next_handler_edge_idx += node->num_handler_edges;
+    sortRouteEdges (handler_edges + node->first_handler_edge, node->num_handler_edges);
+
+    node->first_edge = *next_edge_idx;
+    node->num_edges = 0;
+    {
+	Namespace::NamespaceHash::iter iter (nsp->namespace_hash);
+	while (!nsp->namespace_hash.iter_done (iter)) {
+	    Namespace::NamespaceHash::EntryKey const nsp_key = nsp->namespace_hash.iter_next (iter);
+
+	    Edge * const edge = &edges [node->first_edge + node->num_edges];
+	    ++node->num_edges;
+	    edge->name = nsp_key.getKey();
+	    edge->node_idx = *next_node_idx;
+	    ++*next_node_idx;
+	}
+    }
+    *next_edge_idx += node->num_edges;
+
+    {
+	Namespace::NamespaceHash::iter iter (nsp->namespace_hash);
+	for (Count i = 0; i < node->num_edges; ++i) {
+	    Namespace::NamespaceHash::EntryKey const nsp_key = nsp->namespace_hash.iter_next (iter);
+	    fill (nsp_key.getData(),
+		  edges [node->first_edge + i].node_idx,
+		  next_node_idx,
+		  next_edge_idx,
+		  next_handler_edge_idx);
+	}
+    }
+    sortRouteEdges (edges + node->first_edge, node->num_edges);
+}
+
+HttpService::RouteTable*
+HttpService::RouteTable::compile (Namespace * const mt_nonnull root_namespace)
+{
+    Count num_nodes = 0;
+    Count num_edges = 0;
+    Count num_handler_edges = 0;
+    measure (root_namespace, &num_nodes, &num_edges, &num_handler_edges);
+
+    RouteTable * const table = new (std::nothrow) RouteTable;
+    assert (table);
+    table->nodes = new (std::nothrow) Node [num_nodes];
+    assert (table->nodes);
+    table->edges = new (std::nothrow) Edge [num_edges];
+    assert (table->edges);
+    table->handler_edges = new (std::nothrow) HandlerEdge [num_handler_edges];
+    assert (table->handler_edges);
+
+    Count next_node_idx = 1;
+    Count next_edge_idx = 0;
+    Count next_handler_edge_idx = 0;
+    table->fill (root_namespace, 0 /* node_idx */, &next_node_idx, &next_edge_idx, &next_handler_edge_idx);
+    assert (next_node_idx == num_nodes
+	    && next_edge_idx == num_edges
+	    && next_handler_edge_idx == num_handler_edges);
+
+    return table;
+}
+
+HttpService::RouteTable::RouteTable ()
+    : prev_table    (NULL),
+      nodes         (NULL),
+      edges         (NULL),
+      handler_edges (NULL)
+{
+}
+
+HttpService::RouteTable::~RouteTable ()
+{
+    delete[] nodes;
+    delete[] edges;
+    delete[] handler_edges;
+}
+
 mt_mutex (mutex) void
 HttpService::releaseHttpConnection (HttpConnection * const mt_nonnull http_conn)
 {
     if (http_conn->conn_keepalive_timer) {
-	timers->deleteTimer (http_conn->conn_keepalive_timer);
+	http_conn->acceptor->timers->deleteTimer (http_conn->conn_keepalive_timer);
 	http_conn->conn_keepalive_timer = NULL;
     }
 
-    poll_group->removePollable (http_conn->pollable_key);
+    http_conn->acceptor->poll_group->removePollable (http_conn->pollable_key);
 }
 
 void
@@ -115,46 +321,29 @@ HttpService::httpRequest (HttpRequest * const mt_nonnull req,
     http_conn->cur_handler = NULL;
     http_conn->cur_msg_data = NULL;
 
-    self->mutex.lock ();
-
-    if (self->no_keepalive_conns)
+    if (self->no_keepalive_conns.get ())
 	req->setKeepalive (false);
 
+    // 'conn_keepalive_timer' is changed either in the thread of the connection,
+    // or when HttpService is being destroyed, which can't happen while we're
+    // holding 'self'.
     if (http_conn->conn_keepalive_timer) {
 #warning fix race
         // FIXME Race condition: the timer might have just expired
         //       and an assertion in Timers::restartTimer() will be hit.
-        self->timers->restartTimer (http_conn->conn_keepalive_timer);
+        http_conn->acceptor->timers->restartTimer (http_conn->conn_keepalive_timer);
     }
 
-  // Searching for a handler with the longest matching path.
-  //
-  //     /a/b/c/  - last path element should be empty;
-  //     /a/b/c   - last path element is "c".
-
-    Namespace *cur_namespace = &self->root_namespace;
-    Count const num_path_els = req->getNumPathElems();
-    ConstMemory handler_path_el;
-    for (Count i = 0; i < num_path_els; ++i) {
-	ConstMemory const path_el = req->getPath (i);
-	Namespace::NamespaceHash::EntryKey const namespace_key = cur_namespace->namespace_hash.lookup (path_el);
-	if (!namespace_key) {
-	    handler_path_el = path_el;
-	    break;
-	}
-
-	cur_namespace = namespace_key.getData();
-	assert (cur_namespace);
-    }
-
-    Namespace::HandlerHash::EntryKey handler_key = cur_namespace->handler_hash.lookup (handler_path_el);
-    if (!handler_key) {
-	handler_key = cur_namespace->handler_hash.lookup (ConstMemory());
-	// We could add a trailing slash to the path and redirect the client.
-	// This would make both "http://a.b/c" and "http://a.b/c/" work.
+    HandlerEntry *handler = NULL;
+    {
+        // Handler entries and route tables are never deleted during lifetime
+        // of HttpService, hence no extra references are needed. This may change
+        // in the future, in which case we'll need a grace period for readers.
+        RouteTable const * const route_table = static_cast <RouteTable const *> (self->route_table.get ());
+        if (route_table)
+            handler = route_table->lookup (req);
     }
-    if (!handler_key) {
-	self->mutex.unlock ();
+    if (!handler) {
 	logD (http_service, _func, "No suitable handler found");
 
 	ConstMemory const reply_body = "404 Not Found";
@@ -179,12 +368,6 @@ HttpService::httpRequest (HttpRequest * const mt_nonnull req,
 
 	return;
     }
-    HandlerEntry * const handler = handler_key.getDataPtr();
-
-    // Note: We count on the fact that handler entries are never removed during
-    // lifetime of HttpService. This may change in the future, in which case
-    // we'll have to add an extra reference to handler entry here.
-    self->mutex.unlock ();
 
     http_conn->cur_handler = handler;
     logD (http_service, _func, "http_conn->cur_handler: 0x", fmt_hex, (UintPtr) http_conn->cur_handler);
@@ -448,15 +631,15 @@ HttpService::httpClosed (HttpRequest * const req,
 }
 
 bool
-HttpService::acceptOneConnection ()
+HttpService::acceptOneConnection (Acceptor * const mt_nonnull acceptor)
 {
     HttpConnection * const http_conn = new (std::nothrow) HttpConnection;
     assert (http_conn);
 
     IpAddress client_addr;
     {
-	TcpServer::AcceptResult const res = tcp_server.accept (&http_conn->tcp_conn,
-							       &client_addr);
+	TcpServer::AcceptResult const res = acceptor->tcp_server.accept (&http_conn->tcp_conn,
+									 &client_addr);
 	if (res == TcpServer::AcceptResult::Error) {
 	    http_conn->unref ();
 	    logE_ (_func, exc->toString());
@@ -474,6 +657,7 @@ HttpService::acceptOneConnection ()
     logD_ (_func, "accepted, http_conn 0x", fmt_hex, (UintPtr) http_conn, " client ", fmt_def, client_addr);
 
     http_conn->weak_http_service = this;
+    http_conn->acceptor = acceptor;
 
     http_conn->cur_handler = NULL;
     http_conn->cur_msg_data = NULL;
@@ -482,10 +666,19 @@ HttpService::acceptOneConnection ()
     http_conn->preassembly_buf_size = 0;
     http_conn->preassembled_len = 0;
 
-    http_conn->conn_sender.init (deferred_processor);
+    http_conn->conn_sender.init (acceptor->deferred_processor);
     http_conn->conn_sender.setConnection (&http_conn->tcp_conn);
+    if (page_recv_mode) {
+        if (recv_buf_len)
+            http_conn->conn_receiver.setPageReceiveMode (page_pool, recv_buf_len);
+        else
+            http_conn->conn_receiver.setPageReceiveMode (page_pool);
+    } else
+    if (recv_buf_len) {
+        http_conn->conn_receiver.setRecvBufferSize (recv_buf_len);
+    }
     http_conn->conn_receiver.init (&http_conn->tcp_conn,
-                                   deferred_processor);
+                                   acceptor->deferred_processor);
 
     http_conn->http_server.init (
             CbDesc<HttpServer::Frontend> (&http_frontend, http_conn, http_conn),
@@ -495,7 +688,7 @@ HttpService::acceptOneConnection ()
             client_addr);
 
     mutex.lock ();
-    http_conn->pollable_key = poll_group->addPollable (http_conn->tcp_conn.getPollable());
+    http_conn->pollable_key = acceptor->poll_group->addPollable (http_conn->tcp_conn.getPollable());
     if (!http_conn->pollable_key) {
 	mutex.unlock ();
 
@@ -510,12 +703,12 @@ HttpService::acceptOneConnection ()
 	// monitor connection's activity. Currently, this is an overly
 	// simplistic oneshot cutter, like a ticking bomb for every client.
 	http_conn->conn_keepalive_timer =
-                timers->addTimer_microseconds (CbDesc<Timers::TimerCallback> (connKeepaliveTimerExpired,
-                                                                              http_conn,
-                                                                              http_conn),
-                                               keepalive_timeout_microsec,
-                                               false /* periodical */,
-                                               false /* auto_delete */);
+                acceptor->timers->addTimer_microseconds (CbDesc<Timers::TimerCallback> (connKeepaliveTimerExpired,
+                                                                                        http_conn,
+                                                                                        http_conn),
+                                                         keepalive_timeout_microsec,
+                                                         false /* periodical */,
+                                                         false /* auto_delete */);
     }
 
     conn_list.append (http_conn);
@@ -530,18 +723,31 @@ TcpServer::Frontend const HttpService::tcp_server_frontend = {
 };
 
 void
-HttpService::accepted (void *_self)
+HttpService::accepted (void *_acceptor)
 {
-    HttpService * const self = static_cast <HttpService*> (_self);
+    Acceptor * const acceptor = static_cast <Acceptor*> (_acceptor);
+    HttpService * const self = acceptor->http_service;
 
     logD (http_service, _func_);
 
     for (;;) {
-	if (!self->acceptOneConnection ())
+	if (!self->acceptOneConnection (acceptor))
 	    break;
     }
 }
 
+void
+HttpService::releaseAcceptor (Acceptor * const mt_nonnull acceptor)
+{
+    mutex.lock ();
+    PollGroup::PollableKey const pollable_key = acceptor->pollable_key;
+    acceptor->pollable_key = NULL;
+    mutex.unlock ();
+
+    if (pollable_key)
+        acceptor->poll_group->removePollable (pollable_key);
+}
+
 mt_mutex (mutex) void
 HttpService::addHttpHandler_rec (CbDesc<HttpHandler> const &cb,
 				 ConstMemory   const path_,
@@ -603,29 +809,40 @@ HttpService::addHttpHandler (CbDesc<HttpHandler> const &cb,
 			preassembly_limit,
 			parse_body_params,
 			&root_namespace); 
+
+    RouteTable * const new_table = RouteTable::compile (&root_namespace);
+    new_table->prev_table = static_cast <RouteTable*> (route_table.get ());
+    route_table.set (new_table);
     mutex.unlock ();
 }
 
 mt_throws Result
 HttpService::bind (IpAddress const &addr)
 {
-    if (!tcp_server.bind (addr))
+    if (!main_acceptor.tcp_server.bind (addr))
 	return Result::Failure;
 
+    bind_addr = addr;
     return Result::Success;
 }
 
 mt_throws Result
 HttpService::start ()
 {
-    if (!tcp_server.listen ())
+    if (!main_acceptor.tcp_server.listen ())
 	return Result::Failure;
 
-    // TODO Remove pollable when done.
-    if (!poll_group->addPollable (tcp_server.getPollable()))
+    mutex.lock ();
+    assert (!main_acceptor.pollable_key);
+    main_acceptor.pollable_key =
+            main_acceptor.poll_group->addPollable (main_acceptor.tcp_server.getPollable());
+    if (!main_acceptor.pollable_key) {
+        mutex.unlock ();
 	return Result::Failure;
+    }
+    mutex.unlock ();
 
-    if (!tcp_server.start ()) {
+    if (!main_acceptor.tcp_server.start ()) {
         logF_ (_func, "tcp_server.start() failed: ", exc->toString());
         return Result::Failure;
     }
@@ -633,16 +850,119 @@ HttpService::start ()
     return Result::Success;
 }
 
+mt_const void
+HttpService::setReusePort (bool const reuse_port)
+{
+    this->reuse_port = reuse_port;
+    main_acceptor.tcp_server.setReusePort (reuse_port);
+}
+
+mt_throws Result
+HttpService::addThreadAcceptor (ServerThreadContext * const mt_nonnull thread_ctx)
+{
+    if (!reuse_port) {
+        exc_throw (InternalException, InternalException::BadInput);
+        logE_ (_func, "SO_REUSEPORT is not enabled, see setReusePort()");
+        return Result::Failure;
+    }
+
+    Acceptor * const acceptor = new (std::nothrow) Acceptor (getCoderefContainer());
+    assert (acceptor);
+    acceptor->http_service       = this;
+    acceptor->poll_group         = thread_ctx->getPollGroup();
+    acceptor->timers             = thread_ctx->getTimers();
+    acceptor->deferred_processor = thread_ctx->getDeferredProcessor();
+
+    // Index of the acceptor in 'thread_acceptor_list', starting with 1.
+    Count acceptor_no = 0;
+
+    acceptor->tcp_server.setReusePort (true);
+    acceptor->tcp_server.setAcceptBatchSize (accept_batch_size);
+    if (!acceptor->tcp_server.open ())
+        goto _failure;
+
+    acceptor->tcp_server.init (CbDesc<TcpServer::Frontend> (&tcp_server_frontend, acceptor, getCoderefContainer()),
+                               thread_ctx->getDeferredProcessor(),
+                               thread_ctx->getTimers());
+
+    if (!acceptor->tcp_server.bind (bind_addr))
+        goto _failure;
+
+    if (!acceptor->tcp_server.listen ())
+        goto _failure;
+
+    mutex.lock ();
+    acceptor->pollable_key = acceptor->poll_group->addPollable (acceptor->tcp_server.getPollable());
+    if (!acceptor->pollable_key) {
+        mutex.unlock ();
+        goto _failure;
+    }
+    thread_acceptor_list.append (acceptor);
+    ++num_thread_acceptors;
+    acceptor_no = num_thread_acceptors;
+    mutex.unlock ();
+
+    if (accept_stat_prefix) {
+        acceptor->tcp_server.enableStat (
+                catenateStrings (accept_stat_prefix->mem(),
+                                 makeString ("acceptor", acceptor_no, "_")->mem())->mem());
+    }
+
+    if (!acceptor->tcp_server.start ()) {
+        logF_ (_func, "tcp_server.start() failed: ", exc->toString());
+        return Result::Failure;
+    }
+
+    logD (http_service, _func, "added acceptor 0x", fmt_hex, (UintPtr) acceptor);
+    return Result::Success;
+
+_failure:
+    delete acceptor;
+    return Result::Failure;
+}
+
+mt_throws Result
+HttpService::enableCpuSteering (Count const num_sockets)
+{
+    return main_acceptor.tcp_server.attachCpuSteeringFilter (num_sockets);
+}
+
+mt_const void
+HttpService::setAcceptBatchSize (Count const accept_batch_size)
+{
+    this->accept_batch_size = accept_batch_size;
+    main_acceptor.tcp_server.setAcceptBatchSize (accept_batch_size);
+}
+
+mt_const void
+HttpService::enableAcceptStat (ConstMemory const stat_prefix)
+{
+    accept_stat_prefix = grab (new (std::nothrow) String (stat_prefix));
+    main_acceptor.tcp_server.enableStat (stat_prefix);
+}
+
 void
 HttpService::setConfigParams (Time const keepalive_timeout_microsec,
                               bool const no_keepalive_conns)
 {
     mutex.lock ();
     this->keepalive_timeout_microsec = keepalive_timeout_microsec;
-    this->no_keepalive_conns = no_keepalive_conns;
+    this->no_keepalive_conns.set (no_keepalive_conns ? 1 : 0);
     mutex.unlock ();
 }
 
+mt_const void
+HttpService::setRecvBufferSize (Size const recv_buf_len)
+{
+    this->recv_buf_len = recv_buf_len;
+}
+
+mt_const void
+HttpService::setPageReceiveMode (bool const page_recv_mode)
+{
+    this->page_recv_mode = page_recv_mode;
+}
+
 mt_throws Result
 HttpService::init (PollGroup         * const mt_nonnull poll_group,
 		   Timers            * const mt_nonnull timers,
@@ -651,47 +971,78 @@ HttpService::init (PollGroup         * const mt_nonnull poll_group,
 		   Time                const keepalive_timeout_microsec,
 		   bool                const no_keepalive_conns)
 {
-    this->poll_group         = poll_group;
-    this->timers             = timers;
-    this->deferred_processor = deferred_processor;
-    this->page_pool          = page_pool;
+    main_acceptor.http_service       = this;
+    main_acceptor.poll_group         = poll_group;
+    main_acceptor.timers             = timers;
+    main_acceptor.deferred_processor = deferred_processor;
+
+    this->page_pool = page_pool;
 
     this->keepalive_timeout_microsec = keepalive_timeout_microsec;
-    this->no_keepalive_conns = no_keepalive_conns;
+    this->no_keepalive_conns.set (no_keepalive_conns ? 1 : 0);
 
-    if (!tcp_server.open ())
+    if (!main_acceptor.tcp_server.open ())
 	return Result::Failure;
 
-    tcp_server.init (CbDesc<TcpServer::Frontend> (&tcp_server_frontend, this, getCoderefContainer()),
-                     deferred_processor,
-                     timers);
+    main_acceptor.tcp_server.init (CbDesc<TcpServer::Frontend> (&tcp_server_frontend, &main_acceptor, getCoderefContainer()),
+                                   deferred_processor,
+                                   timers);
 
     return Result::Success;
 }
 
 HttpService::HttpService (Object * const coderef_container)
     : DependentCodeReferenced (coderef_container),
-      poll_group         (coderef_container),
-      timers             (coderef_container),
-      deferred_processor (coderef_container),
       page_pool          (coderef_container),
+      reuse_port         (false),
+      accept_batch_size  (0),
+      main_acceptor      (coderef_container),
+      num_thread_acceptors (0),
+      recv_buf_len       (0),
+      page_recv_mode     (false),
       keepalive_timeout_microsec (0),
-      no_keepalive_conns (false),
-      tcp_server (coderef_container)
+      no_keepalive_conns (0),
+      route_table        (NULL)
 {
 }
 
 HttpService::~HttpService ()
 {
-  StateMutexLock l (&mutex);
+    releaseAcceptor (&main_acceptor);
+
+    mutex.lock ();
 
   // TODO Call remaining messageBody() callbacks to release callers' resources.
 
-    ConnectionList::iter iter (conn_list);
-    while (!conn_list.iter_done (iter)) {
-	HttpConnection * const http_conn = conn_list.iter_next (iter);
-	releaseHttpConnection (http_conn);
-	http_conn->unref ();
+    {
+        ConnectionList::iter iter (conn_list);
+        while (!conn_list.iter_done (iter)) {
+            HttpConnection * const http_conn = conn_list.iter_next (iter);
+            releaseHttpConnection (http_conn);
+            http_conn->unref ();
+        }
+    }
+
+    AcceptorList acceptor_list;
+    acceptor_list.stealAppend (thread_acceptor_list.getFirst(), thread_acceptor_list.getLast());
+    thread_acceptor_list.clear ();
+
+    mutex.unlock ();
+
+    {
+        AcceptorList::iter iter (acceptor_list);
+        while (!acceptor_list.iter_done (iter)) {
+            Acceptor * const acceptor = acceptor_list.iter_next (iter);
+            releaseAcceptor (acceptor);
+            delete acceptor;
+        }
+    }
+
+    RouteTable *table = static_cast <RouteTable*> (route_table.get ());
+    while (table) {
+        RouteTable * const prev_table = table->prev_table;
+        delete table;
+        table = prev_table;
     }
 }
 
@@ -27,6 +27,7 @@
 #include <libmary/timers.h>
 #include <libmary/tcp_server.h>
 #include <libmary/poll_group.h>
+#include <libmary/server_context.h>
 #include <libmary/immediate_connection_sender.h>
 #include <libmary/connection_receiver.h>
 #include <libmary/http_server.h>
@@ -104,6 +105,68 @@ private:
 	HandlerHash handler_hash;
     };
 
+    // Immutable snapshot of the namespace tree, which is used to look up
+    // handlers in httpRequest() without locking 'mutex'. Child namespaces
+    // and handlers of every node are stored in arrays sorted by name.
+    // A new table is compiled and published each time a handler is added.
+    class RouteTable
+    {
+    public:
+	struct Edge
+	{
+	    ConstMemory name;
+	    Count node_idx;
+	};
+
+	struct HandlerEdge
+	{
+	    ConstMemory name;
+	    HandlerEntry *handler;
+	};
+
+	struct Node
+	{
+	    Count first_edge;
+	    Count num_edges;
+	    Count first_handler_edge;
+	    Count num_handler_edges;
+	    // Handler with an empty name, if any.
+	    HandlerEntry *default_handler;
+	};
+
+	// The table which was published before this one. Readers may still be
+	// walking old tables, so those are kept until HttpService is destroyed.
+	// Handlers are normally added once at startup, which makes this cheap.
+	RouteTable *prev_table;
+
+	Node        *nodes;
+	Edge        *edges;
+	HandlerEdge *handler_edges;
+
+	// Returns the handler with the longest matching path, or NULL.
+	HandlerEntry* lookup (HttpRequest * mt_nonnull req) const;
+
+	static void measure (Namespace * mt_nonnull nsp,
+			     Count     * mt_nonnull ret_num_nodes,
+			     Count     * mt_nonnull ret_num_edges,
+			     Count     * mt_nonnull ret_num_handler_edges);
+
+	void fill (Namespace * mt_nonnull nsp,
+		   Count      node_idx,
+		   Count     * mt_nonnull next_node_idx,
+		   Count     * mt_nonnull next_edge_idx,
+		   Count     * mt_nonnull next_handler_edge_idx);
+
+	// Namespace names and handler entries are referenced, not copied.
+	// They should be kept unchanged while the table is in use.
+	static RouteTable* compile (Namespace * mt_nonnull root_namespace);
+
+	 RouteTable ();
+	~RouteTable ();
+    };
+
+    class Acceptor;
+
     class HttpConnection : public Object,
 			   public IntrusiveListElement<>
     {
@@ -112,6 +175,9 @@ private:
 
 	WeakDepRef<HttpService> weak_http_service;
 
+        // The connection is serviced by the thread of the acceptor.
+        mt_const Acceptor *acceptor;
+
 	TcpConnection tcp_conn;
 	ImmediateConnectionSender conn_sender;
 	ConnectionReceiver conn_receiver;
@@ -139,21 +205,64 @@ private:
 	~HttpConnection ();
     };
 
-    mt_const DataDepRef<PollGroup>         poll_group;
-    mt_const DataDepRef<Timers>            timers;
-    mt_const DataDepRef<DeferredProcessor> deferred_processor;
-    mt_const DataDepRef<PagePool>          page_pool;
+    // A listening socket along with the thread which services it
+    // and the connections accepted on it.
+    class Acceptor : public IntrusiveListElement<>
+    {
+    public:
+        mt_const HttpService *http_service;
+
+        mt_const DataDepRef<PollGroup>         poll_group;
+        mt_const DataDepRef<Timers>            timers;
+        mt_const DataDepRef<DeferredProcessor> deferred_processor;
+
+        TcpServer tcp_server;
+        mt_mutex (HttpService::mutex) PollGroup::PollableKey pollable_key;
+
+        Acceptor (Object * const coderef_container)
+            : http_service       (NULL),
+              poll_group         (coderef_container),
+              timers             (coderef_container),
+              deferred_processor (coderef_container),
+              tcp_server         (coderef_container),
+              pollable_key       (NULL)
+        {
+        }
+    };
 
-    mt_mutex (mutex) Time keepalive_timeout_microsec;
-    mt_mutex (mutex) bool no_keepalive_conns;
+    typedef IntrusiveList<Acceptor> AcceptorList;
+
+    mt_const DataDepRef<PagePool> page_pool;
+
+    mt_const bool reuse_port;
+    mt_const Count accept_batch_size;
+    mt_const IpAddress bind_addr;
+
+    // Accepts connections in the thread passed to init().
+    Acceptor main_acceptor;
+    // SO_REUSEPORT listening sockets added with addThreadAcceptor().
+    mt_mutex (mutex) AcceptorList thread_acceptor_list;
+    mt_mutex (mutex) Count num_thread_acceptors;
+
+    // Set by enableAcceptStat(), NULL if accept statistics are disabled.
+    mt_const Ref<String> accept_stat_prefix;
 
-    TcpServer tcp_server;
+    mt_const Size recv_buf_len;
+    mt_const bool page_recv_mode;
+
+    mt_mutex (mutex) Time keepalive_timeout_microsec;
+    // Boolean. Set with 'mutex' locked, read without locking in httpRequest().
+    AtomicInt no_keepalive_conns;
 
     typedef IntrusiveList<HttpConnection> ConnectionList;
     mt_mutex (mutex) ConnectionList conn_list;
 
     mt_mutex (mutex) Namespace root_namespace;
 
+    // RouteTable compiled from 'root_namespace'. Published with 'mutex' locked,
+    // read without locking in httpRequest().
+    AtomicPointer route_table;
+
     mt_mutex (mutex) void releaseHttpConnection (HttpConnection * mt_nonnull http_conn);
     mt_mutex (mutex) void destroyHttpConnection (HttpConnection * mt_nonnull http_conn);
 
@@ -179,14 +288,16 @@ private:
 			    void        *cb_data);
   mt_iface_end
 
-    bool acceptOneConnection ();
+    bool acceptOneConnection (Acceptor * mt_nonnull acceptor);
 
   mt_iface (TcpServer::Frontend)
     static TcpServer::Frontend const tcp_server_frontend;
 
-    static void accepted (void *_self);
+    static void accepted (void *_acceptor);
   mt_iface_end
 
+    void releaseAcceptor (Acceptor * mt_nonnull acceptor);
+
     mt_mutex (mutex) void addHttpHandler_rec (CbDesc<HttpHandler> const &cb,
 					      ConstMemory  path,
 					      bool         preassembly,
@@ -205,9 +316,51 @@ public:
 
     mt_throws Result start ();
 
+    // Makes listening sockets use SO_REUSEPORT, which allows to add more
+    // listening sockets with addThreadAcceptor(). Should be called before init().
+    mt_const void setReusePort (bool reuse_port);
+
+    // Adds a SO_REUSEPORT listening socket bound to the same address, which
+    // is serviced by the thread of @thread_ctx. Connections accepted on that
+    // socket are handled by that thread, and the kernel balances incoming
+    // connections between listening sockets. This is meant to be called once
+    // for every server thread, e.g. from ServerApp::Events::threadContextStarted.
+    // Should be called after bind().
+    mt_throws Result addThreadAcceptor (ServerThreadContext * mt_nonnull thread_ctx);
+
+    // Steers new connections to the listening socket with index equal to
+    // the number of the CPU which received the connection request (modulo
+    // @num_sockets). The main socket has index 0, thread acceptors follow
+    // in the order they were added. Should be called after bind().
+    // See TcpServer::attachCpuSteeringFilter().
+    mt_throws Result enableCpuSteering (Count num_sockets);
+
+    // Limits the number of connections accepted in a row by every listening
+    // socket. See TcpServer::setAcceptBatchSize(). Should be called before init().
+    mt_const void setAcceptBatchSize (Count accept_batch_size);
+
+    // Publishes accept statistics of listening sockets via Stat.
+    // See TcpServer::enableStat(). Parameters of the main socket are prefixed
+    // with @stat_prefix, and parameters of the N-th socket added with
+    // addThreadAcceptor() are prefixed with @stat_prefix + "acceptorN_".
+    // Should be called after bind() and before addThreadAcceptor().
+    mt_const void enableAcceptStat (ConstMemory stat_prefix);
+
     void setConfigParams (Time keepalive_timeout_microsec,
                           bool no_keepalive_conns);
 
+    // Sets receive buffer size for client connections. Buffers are
+    // allocated only while there's unprocessed input. Connections sending
+    // a request line or a header field longer than the buffer are closed.
+    // Should be called before start().
+    mt_const void setRecvBufferSize (Size recv_buf_len);
+
+    // Makes client connections read input directly into pages from the page
+    // pool passed to init(). Message bodies are then passed to HttpHandler
+    // from the received pages. See ConnectionReceiver::setPageReceiveMode().
+    // Should be called before start().
+    mt_const void setPageReceiveMode (bool page_recv_mode);
+
     mt_throws Result init (PollGroup         * mt_nonnull poll_group,
 			   Timers            * mt_nonnull timers,
                            DeferredProcessor * mt_nonnull deferred_processor,
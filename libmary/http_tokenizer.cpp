@@ -0,0 +1,253 @@
+/*  LibMary - C++ library for high-performance network servers
+    Copyright (C) 2011-2013 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+
+#include <libmary/types.h>
+#include <string.h>
+
+#if defined (__GNUC__) && defined (__x86_64__)
+  #define LIBMARY__HTTP_TOKENIZER__X86
+  #include <immintrin.h>
+#endif
+
+#include <libmary/log.h>
+
+#include <libmary/http_tokenizer.h>
+
+
+namespace M {
+
+namespace {
+    struct KnownHeader
+    {
+        HttpHeaderId::Value id;
+        char const *name;
+    };
+}
+
+static KnownHeader const known_headers [] = {
+    { HttpHeaderId::Host,             "host"              },
+    { HttpHeaderId::Connection,       "connection"        },
+    { HttpHeaderId::KeepAlive,        "keep-alive"        },
+    { HttpHeaderId::ContentLength,    "content-length"    },
+    { HttpHeaderId::ContentType,      "content-type"      },
+    { HttpHeaderId::ContentRange,     "content-range"     },
+    { HttpHeaderId::TransferEncoding, "transfer-encoding" },
+    { HttpHeaderId::Te,               "te"                },
+    { HttpHeaderId::Expect,           "expect"            },
+    { HttpHeaderId::Accept,           "accept"            },
+    { HttpHeaderId::AcceptEncoding,   "accept-encoding"   },
+    { HttpHeaderId::AcceptLanguage,   "accept-language"   },
+    { HttpHeaderId::IfModifiedSince,  "if-modified-since" },
+    { HttpHeaderId::IfNoneMatch,      "if-none-match"     },
+    { HttpHeaderId::IfRange,          "if-range"          },
+    { HttpHeaderId::Range,            "range"             },
+    { HttpHeaderId::CacheControl,     "cache-control"     },
+    { HttpHeaderId::Pragma,           "pragma"            },
+    { HttpHeaderId::Cookie,           "cookie"            },
+    { HttpHeaderId::Referer,          "referer"           },
+    { HttpHeaderId::Origin,           "origin"            },
+    { HttpHeaderId::UserAgent,        "user-agent"        },
+    { HttpHeaderId::Authorization,    "authorization"     },
+    { HttpHeaderId::Upgrade,          "upgrade"           },
+    { HttpHeaderId::SecWebSocketKey,  "sec-websocket-key" },
+    { HttpHeaderId::XForwardedFor,    "x-forwarded-for"   },
+    { HttpHeaderId::XRealIp,          "x-real-ip"         },
+    { HttpHeaderId::Date,             "date"              },
+    { HttpHeaderId::Via,              "via"               }
+};
+
+enum { HeaderHashSize = 64 };
+
+static HttpHeaderId::Value header_hash [HeaderHashSize];
+static ConstMemory header_names [HttpHeaderId::NumIds];
+
+static inline Byte toLowerAscii (Byte const c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+// Perfect hash for the names in 'known_headers', which are at least 2 bytes long.
+// Collisions are checked for in libMary_httpTokenizerInit().
+static inline Uint32 headerNameHash (ConstMemory const name)
+{
+    Byte const * const buf = name.mem();
+    Size const len = name.len();
+    return ((Uint32) len
+            + (Uint32) (buf [len - 2] | 0x20) * 3
+            + (Uint32) (buf [0]       | 0x20) * 23) & (HeaderHashSize - 1);
+}
+
+HttpHeaderId
+httpLookupHeaderName (ConstMemory const name)
+{
+    if (name.len() < 2)
+        return HttpHeaderId::Unknown;
+
+    HttpHeaderId::Value const id = header_hash [headerNameHash (name)];
+    if (id == HttpHeaderId::Unknown)
+        return HttpHeaderId::Unknown;
+
+    ConstMemory const known_name = header_names [id];
+    if (known_name.len() != name.len())
+        return HttpHeaderId::Unknown;
+
+    for (Size i = 0; i < name.len(); ++i) {
+        if (toLowerAscii (name.mem() [i]) != known_name.mem() [i])
+            return HttpHeaderId::Unknown;
+    }
+
+    return id;
+}
+
+ConstMemory
+httpHeaderName (HttpHeaderId const id)
+{
+    return header_names [id];
+}
+
+bool
+httpHeaderNameEqual (ConstMemory const left,
+                     ConstMemory const right)
+{
+    if (left.len() != right.len())
+        return false;
+
+    for (Size i = 0; i < left.len(); ++i) {
+        if (toLowerAscii (left.mem() [i]) != toLowerAscii (right.mem() [i]))
+            return false;
+    }
+
+    return true;
+}
+
+static Byte const * findCrOrColon_scalar (Byte const *buf,
+                                          Byte const * const end)
+{
+    for (; buf < end; ++buf) {
+        if (*buf == 13 /* CR */ || *buf == ':')
+            return buf;
+    }
+
+    return end;
+}
+
+#ifdef LIBMARY__HTTP_TOKENIZER__X86
+// SSE2 is always there on x86_64. It does better than PCMPESTRI from SSE4.2
+// when looking for two characters only.
+static Byte const * findCrOrColon_sse2 (Byte const *buf,
+                                        Byte const * const end)
+{
+    __m128i const cr    = _mm_set1_epi8 (13 /* CR */);
+    __m128i const colon = _mm_set1_epi8 (':');
+
+    while (end - buf >= 16) {
+        __m128i const data = _mm_loadu_si128 ((__m128i const *) buf);
+        unsigned const mask = (unsigned) _mm_movemask_epi8 (
+                _mm_or_si128 (_mm_cmpeq_epi8 (data, cr), _mm_cmpeq_epi8 (data, colon)));
+        if (mask)
+            return buf + __builtin_ctz (mask);
+
+        buf += 16;
+    }
+
+    return findCrOrColon_scalar (buf, end);
+}
+
+__attribute__ ((target ("avx2")))
+static Byte const * findCrOrColon_avx2 (Byte const *buf,
+                                        Byte const * const end)
+{
+    __m256i const cr    = _mm256_set1_epi8 (13 /* CR */);
+    __m256i const colon = _mm256_set1_epi8 (':');
+
+    while (end - buf >= 32) {
+        __m256i const data = _mm256_loadu_si256 ((__m256i const *) buf);
+        unsigned const mask = (unsigned) _mm256_movemask_epi8 (
+                _mm256_or_si256 (_mm256_cmpeq_epi8 (data, cr), _mm256_cmpeq_epi8 (data, colon)));
+        if (mask)
+            return buf + __builtin_ctz (mask);
+
+        buf += 32;
+    }
+
+    return findCrOrColon_sse2 (buf, end);
+}
+#endif
+
+// Selected in libMary_httpTokenizerInit().
+static Byte const * (*findCrOrColon) (Byte const *buf,
+                                      Byte const *end) = findCrOrColon_scalar;
+
+Size
+httpScanLine (ConstMemory   const mem,
+              Size        * const ret_colon_offs)
+{
+    Byte const * const buf = mem.mem();
+    Byte const * const end = buf + mem.len();
+
+    Byte const *pos = buf;
+    if (ret_colon_offs) {
+        *ret_colon_offs = mem.len();
+
+        Byte const * const ptr = findCrOrColon (buf, end);
+        if (ptr == end)
+            return mem.len();
+
+        if (*ptr == 13 /* CR */)
+            return ptr - buf;
+
+        *ret_colon_offs = ptr - buf;
+        pos = ptr + 1;
+    }
+
+    // The rest of the line is scanned for CR only, which memchr() does well.
+    Byte const * const cr_ptr = (Byte const *) memchr (pos, 13 /* CR */, end - pos);
+    if (!cr_ptr)
+        return mem.len();
+
+    return cr_ptr - buf;
+}
+
+void libMary_httpTokenizerInit ()
+{
+    for (Count i = 0; i < sizeof (known_headers) / sizeof (known_headers [0]); ++i) {
+        KnownHeader const &header = known_headers [i];
+        ConstMemory const name (header.name, strlen (header.name));
+        header_names [header.id] = name;
+
+        Uint32 const hash = headerNameHash (name);
+        if (header_hash [hash] != HttpHeaderId::Unknown)
+            logF_ (_func, "hash collision: \"", name, "\" and \"", header_names [header_hash [hash]], "\"");
+        assert (header_hash [hash] == HttpHeaderId::Unknown);
+
+        header_hash [hash] = header.id;
+    }
+
+#ifdef LIBMARY__HTTP_TOKENIZER__X86
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx2"))
+        findCrOrColon = findCrOrColon_avx2;
+    else
+        findCrOrColon = findCrOrColon_sse2;
+#endif
+}
+
+}
+
@@ -0,0 +1,97 @@
+/*  LibMary - C++ library for high-performance network servers
+    Copyright (C) 2011-2013 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef LIBMARY__HTTP_TOKENIZER__H__
+#define LIBMARY__HTTP_TOKENIZER__H__
+
+
+#include <libmary/types.h>
+
+
+namespace M {
+
+// Header fields which are recognized by httpLookupHeaderName().
+class HttpHeaderId
+{
+public:
+    enum Value {
+        Unknown = 0,
+        Host,
+        Connection,
+        KeepAlive,
+        ContentLength,
+        ContentType,
+        ContentRange,
+        TransferEncoding,
+        Te,
+        Expect,
+        Accept,
+        AcceptEncoding,
+        AcceptLanguage,
+        IfModifiedSince,
+        IfNoneMatch,
+        IfRange,
+        Range,
+        CacheControl,
+        Pragma,
+        Cookie,
+        Referer,
+        Origin,
+        UserAgent,
+        Authorization,
+        Upgrade,
+        SecWebSocketKey,
+        XForwardedFor,
+        XRealIp,
+        Date,
+        Via,
+        NumIds
+    };
+    operator Value () const { return value; }
+    HttpHeaderId (Value const value) : value (value) {}
+    HttpHeaderId () {}
+private:
+    Value value;
+};
+
+// Case-insensitive. Takes a single table lookup and a comparison.
+HttpHeaderId httpLookupHeaderName (ConstMemory name);
+
+// Returns lowercase header name, or an empty string for HttpHeaderId::Unknown.
+ConstMemory httpHeaderName (HttpHeaderId id);
+
+// Case-insensitive comparison of header names.
+bool httpHeaderNameEqual (ConstMemory left,
+                          ConstMemory right);
+
+// Returns offset of the first CR in @mem, or mem.len() if there's none.
+//
+// If @ret_colon_offs is non-NULL, then ':' is searched for in the same pass,
+// and offset of the first ':' preceding the CR (or mem.len() if there's none)
+// is returned in *ret_colon_offs.
+//
+// Uses AVX2 or SSE2 when available.
+Size httpScanLine (ConstMemory  mem,
+                   Size        *ret_colon_offs);
+
+}
+
+
+#endif /* LIBMARY__HTTP_TOKENIZER__H__ */
+
@@ -68,9 +68,22 @@ ImmediateConnectionSender::outputIoComplete (Exception  * const exc_,
 {
 #else
 Connection::OutputFrontend const ImmediateConnectionSender::conn_output_frontend = {
-    processOutput
+    processOutput,
+    zeroCopyComplete
 };
 
+void
+ImmediateConnectionSender::zeroCopyComplete (Uint32   const first_seq,
+                                             Uint32   const last_seq,
+                                             void   * const _self)
+{
+    ImmediateConnectionSender * const self = static_cast <ImmediateConnectionSender*> (_self);
+
+    self->mutex.lock ();
+    self->conn_sender_impl.zeroCopyComplete (first_seq, last_seq);
+    self->mutex.unlock ();
+}
+
 void
 ImmediateConnectionSender::processOutput (void * const _self)
 {
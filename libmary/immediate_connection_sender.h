@@ -53,6 +53,10 @@ private:
   mt_iface (Connection::OutputFrontend)
     static Connection::OutputFrontend const conn_output_frontend;
     static void processOutput (void *_self);
+
+    static void zeroCopyComplete (Uint32  first_seq,
+                                  Uint32  last_seq,
+                                  void   *_self);
   mt_iface_end
 #endif
 
@@ -92,6 +96,13 @@ public:
 #endif
     }
 
+#ifndef LIBMARY_PLATFORM_WIN32
+    // Enables zero-copy output (MSG_ZEROCOPY) for messages with at least
+    // 'threshold' bytes of page data. Should be called after setConnection().
+    mt_const void enableZeroCopy (Size const threshold = 1 << 15 /* 32 Kb */)
+        { conn_sender_impl.enableZeroCopy (threshold); }
+#endif
+
     void init (DeferredProcessor * const mt_nonnull deferred_processor)
     {
         deferred_reg.setDeferredProcessor (deferred_processor);
@@ -0,0 +1,723 @@
+/*  LibMary - C++ library for high-performance network servers
+    Copyright (C) 2011-2013 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <libmary/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <poll.h>
+#include <endian.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+
+#include <libmary/util_posix.h>
+#include <libmary/log.h>
+
+#include <libmary/io_uring_poll_group.h>
+
+
+namespace M {
+
+static LogGroup libMary_logGroup_io_uring ("io_uring", LogLevel::I);
+
+namespace {
+    // Special 'user_data' values. PollableEntry pointers never take these.
+    enum {
+        UserData_TriggerPipe = 0,
+        // Completions of poll removal requests are not interesting.
+        UserData_Ignore      = 1
+    };
+}
+
+mt_mutex (mutex) void
+IoUringPollGroup::processPollableDeletionQueue ()
+{
+    PollableDeletionQueue::iter iter (pollable_deletion_queue);
+    while (!pollable_deletion_queue.iter_done (iter)) {
+	PollableEntry * const pollable_entry = pollable_deletion_queue.iter_next (iter);
+        // The kernel may still report events for the entry until its poll
+        // request is terminated.
+        if (pollable_entry->poll_armed)
+            continue;
+
+        pollable_deletion_queue.remove (pollable_entry);
+	delete pollable_entry;
+    }
+}
+
+mt_mutex (mutex) mt_throws struct io_uring_sqe*
+IoUringPollGroup::getSqe ()
+{
+    unsigned const tail = *sq_tail;
+    if (tail - __atomic_load_n (sq_head, __ATOMIC_ACQUIRE) >= sq_ring_entries) {
+      // Submission queue is full, flushing it.
+        if (!ringEnter (false /* get_events */, 0 /* timeout_microsec */))
+            return NULL;
+
+        if (tail - __atomic_load_n (sq_head, __ATOMIC_ACQUIRE) >= sq_ring_entries) {
+            exc_throw (InternalException, InternalException::BackendError);
+            logE_ (_func, "submission queue overflow");
+            return NULL;
+        }
+    }
+
+    struct io_uring_sqe * const sqe = &sqes [tail & sq_ring_mask];
+    memset (sqe, 0, sizeof (*sqe));
+    return sqe;
+}
+
+mt_mutex (mutex) mt_throws Result
+IoUringPollGroup::queuePollAdd (int     const fd,
+                                Uint32  const poll_events,
+                                UintPtr const user_data)
+{
+    struct io_uring_sqe * const sqe = getSqe ();
+    if (!sqe)
+        return Result::Failure;
+
+    sqe->opcode = IORING_OP_POLL_ADD;
+    sqe->fd = fd;
+#if __BYTE_ORDER == __BIG_ENDIAN
+    sqe->poll32_events = (poll_events << 16) | (poll_events >> 16);
+#else
+    sqe->poll32_events = poll_events;
+#endif
+    // Multishot poll requests stay armed after posting a completion.
+    sqe->len = IORING_POLL_ADD_MULTI;
+    sqe->user_data = user_data;
+
+    __atomic_store_n (sq_tail, *sq_tail + 1, __ATOMIC_RELEASE);
+    return Result::Success;
+}
+
+mt_mutex (mutex) mt_throws Result
+IoUringPollGroup::queuePollRemove (UintPtr const user_data)
+{
+    struct io_uring_sqe * const sqe = getSqe ();
+    if (!sqe)
+        return Result::Failure;
+
+    sqe->opcode = IORING_OP_POLL_REMOVE;
+    sqe->fd = -1;
+    sqe->addr = user_data;
+    sqe->user_data = UserData_Ignore;
+
+    __atomic_store_n (sq_tail, *sq_tail + 1, __ATOMIC_RELEASE);
+    return Result::Success;
+}
+
+mt_throws Result
+IoUringPollGroup::ringEnter (bool const get_events,
+                             Time const timeout_microsec)
+{
+    unsigned flags = 0;
+    unsigned min_complete = 0;
+    void *arg = NULL;
+    size_t arg_len = 0;
+
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg ext_arg;
+    if (get_events) {
+        // GETEVENTS also makes the kernel flush overflown completions
+        // into the completion queue.
+        flags |= IORING_ENTER_GETEVENTS;
+
+        if (timeout_microsec != 0)
+            min_complete = 1;
+
+        if (timeout_microsec != 0 && timeout_microsec != (Time) -1) {
+            ts.tv_sec  = timeout_microsec / 1000000;
+            ts.tv_nsec = (timeout_microsec % 1000000) * 1000;
+
+            memset (&ext_arg, 0, sizeof (ext_arg));
+            ext_arg.ts = (Uint64) (UintPtr) &ts;
+
+            flags |= IORING_ENTER_EXT_ARG;
+            arg = &ext_arg;
+            arg_len = sizeof (ext_arg);
+        }
+    }
+
+    for (;;) {
+        // Note that the kernel doesn't wait for completions if fewer entries
+        // than 'to_submit' have been submitted (e.g. when another thread
+        // has submitted them concurrently). poll() simply retries then.
+        unsigned const to_submit = __atomic_load_n (sq_tail, __ATOMIC_ACQUIRE)
+                                           - __atomic_load_n (sq_head, __ATOMIC_ACQUIRE);
+
+        long const res = syscall (__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_len);
+        if (res == -1) {
+            if (errno == EINTR) {
+                if (min_complete > 0)
+                    return Result::Success;
+
+                continue;
+            }
+
+            // ETIME: timeout expired.
+            // EBUSY, EAGAIN: completion queue is full, we should reap completions.
+            if (errno == ETIME || errno == EBUSY || errno == EAGAIN)
+                return Result::Success;
+
+            exc_throw (PosixException, errno);
+            logF_ (_func, "io_uring_enter() failed: ", errnoString (errno));
+            return Result::Failure;
+        }
+
+        break;
+    }
+
+    return Result::Success;
+}
+
+mt_throws PollGroup::PollableKey
+IoUringPollGroup::addPollable (CbDesc<Pollable> const &pollable,
+                               bool const activate)
+{
+    PollableEntry * const pollable_entry = new (std::nothrow) PollableEntry;
+    assert (pollable_entry);
+
+    logD (io_uring, _func, "0x", fmt_hex, (UintPtr) this, ": "
+	  "pollable_entry: 0x", fmt_hex, (UintPtr) pollable_entry, ", "
+	  "cb_data: 0x", fmt_hex, (UintPtr) pollable.cb_data);
+
+    pollable_entry->io_uring_poll_group = this;
+    pollable_entry->pollable = pollable;
+    // We're making an unsafe call, assuming that the pollable is available.
+    pollable_entry->fd = pollable->getFd (pollable.cb_data);
+    pollable_entry->valid = true;
+    pollable_entry->poll_armed = false;
+
+    mutex.lock ();
+    pollable_list.append (pollable_entry);
+    ++num_pollables;
+    mutex.unlock ();
+
+    if (activate) {
+	if (!doActivate (pollable_entry))
+	    goto _failure;
+    }
+
+    return pollable_entry;
+
+_failure:
+    mutex.lock ();
+    pollable_list.remove (pollable_entry);
+    --num_pollables;
+    mutex.unlock ();
+    delete pollable_entry;
+
+    return NULL;
+}
+
+mt_throws Result
+IoUringPollGroup::doActivate (PollableEntry * const mt_nonnull pollable_entry)
+{
+    logD (io_uring, _func, "0x", fmt_hex, (UintPtr) this, ": "
+	  "pollable_entry: 0x", fmt_hex, (UintPtr) pollable_entry);
+
+    mutex.lock ();
+    if (!queuePollAdd (pollable_entry->fd,
+                       POLLIN | POLLOUT | POLLRDHUP | POLLERR | POLLHUP,
+                       (UintPtr) pollable_entry))
+    {
+        mutex.unlock ();
+        logE_ (_func, "queuePollAdd() failed: ", exc->toString());
+        return Result::Failure;
+    }
+    pollable_entry->poll_armed = true;
+    mutex.unlock ();
+
+  // The request is submitted with the next io_uring_enter() call in poll().
+  // Poll requests report the current state of the fd when armed, which gives
+  // us initial input and output events without waiting for an edge.
+
+    if (!trigger ()) {
+	logF_ (_func, "trigger() failed: ", exc->toString());
+	return Result::Failure;
+    }
+
+    return Result::Success;
+}
+
+mt_throws Result
+IoUringPollGroup::activatePollable (PollableKey const mt_nonnull key)
+{
+    PollableEntry * const pollable_entry = static_cast <PollableEntry*> ((void*) key);
+
+    logD (io_uring, _func, "0x", fmt_hex, (UintPtr) this, ": "
+	  "pollable_entry: 0x", fmt_hex, (UintPtr) pollable_entry);
+
+    return doActivate (pollable_entry);
+}
+
+void
+IoUringPollGroup::removePollable (PollableKey const mt_nonnull key)
+{
+    PollableEntry * const pollable_entry = static_cast <PollableEntry*> ((void*) key);
+
+    logD (io_uring, _func, "pollable_entry: 0x", fmt_hex, (UintPtr) pollable_entry);
+
+    mutex.lock ();
+    bool const submit = pollable_entry->poll_armed;
+    if (pollable_entry->poll_armed) {
+        if (!queuePollRemove ((UintPtr) pollable_entry))
+            logF_ (_func, "queuePollRemove() failed: ", exc->toString());
+    }
+
+    pollable_entry->valid = false;
+    pollable_list.remove (pollable_entry);
+    pollable_deletion_queue.append (pollable_entry);
+    --num_pollables;
+
+    // A pending poll request holds a reference to the file. Submitting
+    // the removal right away, so that closing the fd takes effect immediately.
+    // This is done with 'mutex' held to avoid racing with other threads
+    // which are queueing requests.
+    if (submit) {
+        if (!ringEnter (false /* get_events */, 0 /* timeout_microsec */))
+            logF_ (_func, "ringEnter() failed: ", exc->toString());
+    }
+    mutex.unlock ();
+}
+
+mt_throws Result
+IoUringPollGroup::poll (Uint64 const timeout_microsec)
+{
+    logD (io_uring, _func, "timeout: ", timeout_microsec);
+
+    Time const start_microsec = getTimeMicroseconds ();
+
+    bool first = true;
+    for (;;) {
+	Time cur_microsec = first ? (first = false, start_microsec) : getTimeMicroseconds ();
+        if (cur_microsec < start_microsec)
+            cur_microsec = start_microsec;
+
+	Time const elapsed_microsec = cur_microsec - start_microsec;
+
+	Time timeout;
+	if (!got_deferred_tasks) {
+	    if (timeout_microsec != (Uint64) -1) {
+		if (timeout_microsec > elapsed_microsec)
+                    timeout = timeout_microsec - elapsed_microsec;
+		else
+		    timeout = 0;
+	    } else {
+		timeout = (Time) -1;
+	    }
+	} else {
+	    // We've got deferred tasks to process, hence we shouldn't block.
+	    timeout = 0;
+	}
+
+        mutex.lock ();
+        if (triggered || timeout == 0) {
+            block_trigger_pipe = true;
+            timeout = 0;
+        } else {
+            block_trigger_pipe = false;
+        }
+        mutex.unlock ();
+
+        // Submitting pending poll requests and waiting for completions
+        // in a single syscall.
+        if (!ringEnter (true /* get_events */, timeout)) {
+            logF_ (_func, "ringEnter() failed: ", exc->toString());
+            return Result::Failure;
+        }
+
+      // See EpollPollGroup::poll() for the description of trigger optimization.
+
+        // This lock() acts as a memory barrier which ensures that we see
+        // valid contents of PollableEntry objects.
+        mutex.lock ();
+        block_trigger_pipe = true;
+        bool const was_triggered = triggered;
+        triggered = false;
+        mutex.unlock ();
+
+	got_deferred_tasks = false;
+
+	if (frontend)
+	    frontend.call (frontend->pollIterationBegin);
+
+	bool trigger_pipe_ready = false;
+
+        unsigned head = *cq_head;
+        unsigned const tail = __atomic_load_n (cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe const * const cqe = &cqes [head & cq_ring_mask];
+            UintPtr const user_data = (UintPtr) cqe->user_data;
+            Int32   const res       = cqe->res;
+            Uint32  const cqe_flags = cqe->flags;
+
+            ++head;
+            __atomic_store_n (cq_head, head, __ATOMIC_RELEASE);
+
+            if (user_data == UserData_Ignore)
+                continue;
+
+            // Multishot poll requests may be terminated by the kernel
+            // (e.g. on completion queue overflow). Such requests are re-armed.
+            bool const terminated = !(cqe_flags & IORING_CQE_F_MORE);
+
+            if (user_data == UserData_TriggerPipe) {
+                if (res > 0 && (res & POLLIN))
+                    trigger_pipe_ready = true;
+
+                if (res < 0 || (res & (POLLHUP | POLLRDHUP | POLLERR)))
+                    logF_ (_func, "Trigger pipe error: ", res);
+
+                if (terminated && res >= 0) {
+                    mutex.lock ();
+                    if (!queuePollAdd (trigger_pipe [0], POLLIN | POLLRDHUP, UserData_TriggerPipe))
+                        logF_ (_func, "queuePollAdd() failed (trigger pipe): ", exc->toString());
+                    mutex.unlock ();
+                }
+
+                continue;
+            }
+
+            PollableEntry * const pollable_entry = (PollableEntry*) user_data;
+
+            if (terminated) {
+                mutex.lock ();
+                pollable_entry->poll_armed = false;
+                if (pollable_entry->valid && res >= 0) {
+                    if (queuePollAdd (pollable_entry->fd,
+                                      POLLIN | POLLOUT | POLLRDHUP | POLLERR | POLLHUP,
+                                      (UintPtr) pollable_entry))
+                    {
+                        pollable_entry->poll_armed = true;
+                    } else {
+                        logE_ (_func, "queuePollAdd() failed: ", exc->toString());
+                    }
+                }
+                mutex.unlock ();
+            }
+
+            if (res < 0) {
+                if (res != -ECANCELED) {
+                    logE_ (_func, "poll request failed: ", errnoString (-res));
+                    pollable_entry->pollable.call (
+                            pollable_entry->pollable->processEvents, /*(*/ (Uint32) PollGroup::Error /*)*/);
+                }
+
+                continue;
+            }
+
+            Uint32 event_flags = 0;
+
+            if (res & POLLIN)
+                event_flags |= PollGroup::Input;
+
+            if (res & POLLOUT)
+                event_flags |= PollGroup::Output;
+
+            if (res & POLLHUP ||
+                res & POLLRDHUP)
+            {
+                event_flags |= PollGroup::Hup;
+            }
+
+            if (res & POLLERR)
+                event_flags |= PollGroup::Error;
+
+            if (event_flags) {
+                logD (io_uring, _this_func, "pollable_entry: 0x", fmt_hex, (UintPtr) pollable_entry, ", "
+                      "events: 0x", event_flags, " ",
+                      (event_flags & PollGroup::Input  ? "I" : ""),
+                      (event_flags & PollGroup::Output ? "O" : ""),
+                      (event_flags & PollGroup::Error  ? "E" : ""),
+                      (event_flags & PollGroup::Hup    ? "H" : ""));
+
+                pollable_entry->pollable.call (
+                        pollable_entry->pollable->processEvents, /*(*/ event_flags /*)*/);
+            }
+        } // while (head != tail)
+
+	if (frontend) {
+	    bool extra_iteration_needed = false;
+	    frontend.call_ret (&extra_iteration_needed, frontend->pollIterationEnd);
+	    if (extra_iteration_needed)
+		got_deferred_tasks = true;
+	}
+
+        mutex.lock ();
+	processPollableDeletionQueue ();
+        mutex.unlock ();
+
+        if (trigger_pipe_ready) {
+	    logD (io_uring, _func, "trigger pipe break");
+
+            if (!posix_triggerPipeRead (trigger_pipe [0])) {
+                logF_ (_func, "posix_triggerPipeRead() failed: ", exc->toString());
+                return Result::Failure;
+            }
+            break;
+        }
+
+        if (was_triggered) {
+	    logD (io_uring, _func, "trigger break");
+            break;
+        }
+
+	if (elapsed_microsec >= timeout_microsec) {
+	  // Timeout expired.
+	    break;
+	}
+    } // for (;;)
+
+    return Result::Success;
+}
+
+mt_throws Result
+IoUringPollGroup::trigger ()
+{
+    mutex.lock ();
+    if (triggered) {
+        ++num_triggers_suppressed;
+        mutex.unlock ();
+        return Result::Success;
+    }
+    triggered = true;
+
+    if (block_trigger_pipe) {
+        ++num_triggers_suppressed;
+	mutex.unlock ();
+	return Result::Success;
+    }
+    ++num_triggers_issued;
+    mutex.unlock ();
+
+    return posix_triggerPipeWrite (trigger_pipe [1]);
+}
+
+void
+IoUringPollGroup::getTriggerStatistics (TriggerStatistics * const mt_nonnull ret_stats)
+{
+    mutex.lock ();
+    ret_stats->num_triggers_issued = num_triggers_issued;
+    ret_stats->num_triggers_suppressed = num_triggers_suppressed;
+    mutex.unlock ();
+}
+
+Count
+IoUringPollGroup::getNumPollables ()
+{
+    mutex.lock ();
+    Count const res = num_pollables;
+    mutex.unlock ();
+    return res;
+}
+
+mt_const mt_throws Result
+IoUringPollGroup::open ()
+{
+    struct io_uring_params params;
+    memset (&params, 0, sizeof (params));
+    params.flags = IORING_SETUP_CLAMP | IORING_SETUP_CQSIZE;
+    params.cq_entries = ring_size * 4;
+
+    {
+        long const res = syscall (__NR_io_uring_setup, (unsigned) ring_size, &params);
+        if (res == -1) {
+            exc_throw (PosixException, errno);
+            logF_ (_func, "io_uring_setup() failed: ", errnoString (errno));
+            return Result::Failure;
+        }
+        ring_fd = (int) res;
+    }
+    logD_ (_this_func, "io_uring fd: ", ring_fd, ", "
+           "sq_entries: ", params.sq_entries, ", cq_entries: ", params.cq_entries);
+
+    if (!(params.features & IORING_FEAT_EXT_ARG)) {
+        exc_throw (InternalException, InternalException::NotImplemented);
+        logF_ (_func, "io_uring: IORING_FEAT_EXT_ARG is not supported by the kernel");
+        return Result::Failure;
+    }
+
+    sq_ring_len = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+    cq_ring_len = params.cq_off.cqes  + params.cq_entries * sizeof (struct io_uring_cqe);
+    bool const single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        if (cq_ring_len > sq_ring_len)
+            sq_ring_len = cq_ring_len;
+        cq_ring_len = sq_ring_len;
+    }
+
+    sq_ring_ptr = mmap (NULL, sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring_ptr == MAP_FAILED) {
+        sq_ring_ptr = NULL;
+        exc_throw (PosixException, errno);
+        logF_ (_func, "mmap() failed (sq ring): ", errnoString (errno));
+        return Result::Failure;
+    }
+
+    if (single_mmap) {
+        cq_ring_ptr = sq_ring_ptr;
+    } else {
+        cq_ring_ptr = mmap (NULL, cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring_ptr == MAP_FAILED) {
+            cq_ring_ptr = NULL;
+            exc_throw (PosixException, errno);
+            logF_ (_func, "mmap() failed (cq ring): ", errnoString (errno));
+            return Result::Failure;
+        }
+    }
+
+    sqes_len = params.sq_entries * sizeof (struct io_uring_sqe);
+    {
+        void * const ptr = mmap (NULL, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (ptr == MAP_FAILED) {
+            exc_throw (PosixException, errno);
+            logF_ (_func, "mmap() failed (sqes): ", errnoString (errno));
+            return Result::Failure;
+        }
+        sqes = (struct io_uring_sqe*) ptr;
+    }
+
+    {
+        Byte * const sq_base = (Byte*) sq_ring_ptr;
+        sq_head         = (unsigned*) (sq_base + params.sq_off.head);
+        sq_tail         = (unsigned*) (sq_base + params.sq_off.tail);
+        sq_ring_mask    = *(unsigned*) (sq_base + params.sq_off.ring_mask);
+        sq_ring_entries = *(unsigned*) (sq_base + params.sq_off.ring_entries);
+
+        // Submission queue entries are always used in order, hence the index
+        // array is filled once.
+        unsigned * const sq_array = (unsigned*) (sq_base + params.sq_off.array);
+        for (unsigned i = 0; i < sq_ring_entries; ++i)
+            sq_array [i] = i;
+
+        Byte * const cq_base = (Byte*) cq_ring_ptr;
+        cq_head      = (unsigned*) (cq_base + params.cq_off.head);
+        cq_tail      = (unsigned*) (cq_base + params.cq_off.tail);
+        cq_ring_mask = *(unsigned*) (cq_base + params.cq_off.ring_mask);
+        cqes         = (struct io_uring_cqe*) (cq_base + params.cq_off.cqes);
+    }
+
+    if (!posix_createTriggerPipe (&trigger_pipe)) {
+	return Result::Failure;
+    }
+    logD_ (_this_func, "trigger_pipe fd: read ", trigger_pipe [0], ", write ", trigger_pipe [1]);
+
+    mutex.lock ();
+    if (!queuePollAdd (trigger_pipe [0], POLLIN | POLLRDHUP, UserData_TriggerPipe)) {
+        mutex.unlock ();
+        logF_ (_func, "queuePollAdd() failed (trigger pipe): ", exc->toString());
+        return Result::Failure;
+    }
+    mutex.unlock ();
+
+    return Result::Success;
+}
+
+void
+IoUringPollGroup::releaseRing ()
+{
+    if (sqes)
+        munmap (sqes, sqes_len);
+
+    if (cq_ring_ptr && cq_ring_ptr != sq_ring_ptr)
+        munmap (cq_ring_ptr, cq_ring_len);
+
+    if (sq_ring_ptr)
+        munmap (sq_ring_ptr, sq_ring_len);
+
+    if (ring_fd != -1) {
+	for (;;) {
+	    int const res = close (ring_fd);
+	    if (res == -1) {
+		if (errno == EINTR)
+		    continue;
+
+		logE_ (_func, "close() failed (ring_fd): ", errnoString (errno));
+	    } else
+	    if (res != 0) {
+		logE_ (_func, "close() (ring_fd): unexpected return value: ", res);
+	    }
+
+	    break;
+	}
+    }
+}
+
+IoUringPollGroup::IoUringPollGroup (Object * const coderef_container)
+    : DependentCodeReferenced (coderef_container),
+      poll_tlocal (NULL),
+      ring_size (1024),
+      ring_fd (-1),
+      sq_ring_ptr (NULL),
+      sq_ring_len (0),
+      cq_ring_ptr (NULL),
+      cq_ring_len (0),
+      sqes (NULL),
+      sqes_len (0),
+      sq_head (NULL),
+      sq_tail (NULL),
+      sq_ring_mask (0),
+      sq_ring_entries (0),
+      cq_head (NULL),
+      cq_tail (NULL),
+      cq_ring_mask (0),
+      cqes (NULL),
+      triggered (false),
+      block_trigger_pipe (true),
+      num_triggers_issued (0),
+      num_triggers_suppressed (0),
+      num_pollables (0),
+      // Initializing to 'true' to process deferred tasks scheduled before we
+      // enter poll() for the first time.
+      got_deferred_tasks (true)
+{
+    trigger_pipe [0] = -1;
+    trigger_pipe [1] = -1;
+}
+
+IoUringPollGroup::~IoUringPollGroup ()
+{
+    // Closing the ring first: this cancels all poll requests.
+    releaseRing ();
+
+    mutex.lock ();
+    {
+	PollableList::iter iter (pollable_list);
+	while (!pollable_list.iter_done (iter)) {
+	    PollableEntry * const pollable_entry = pollable_list.iter_next (iter);
+	    delete pollable_entry;
+	}
+    }
+
+    {
+	PollableDeletionQueue::iter iter (pollable_deletion_queue);
+	while (!pollable_deletion_queue.iter_done (iter)) {
+	    PollableEntry * const pollable_entry = pollable_deletion_queue.iter_next (iter);
+	    delete pollable_entry;
+	}
+    }
+    mutex.unlock ();
+
+    posix_closeTriggerPipe (&trigger_pipe);
+}
+
+}
+
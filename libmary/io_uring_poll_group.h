@@ -0,0 +1,186 @@
+/*  LibMary - C++ library for high-performance network servers
+    Copyright (C) 2011-2013 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef LIBMARY__IO_URING_POLL_GROUP__H__
+#define LIBMARY__IO_URING_POLL_GROUP__H__
+
+
+#include <libmary/types.h>
+#include <libmary/libmary_thread_local.h>
+#include <libmary/cb.h>
+#include <libmary/intrusive_list.h>
+#include <libmary/active_poll_group.h>
+#include <libmary/code_referenced.h>
+#include <libmary/state_mutex.h>
+
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+
+namespace M {
+
+// Poll group based on io_uring multishot poll requests.
+// Pollable registrations and removals are queued in the submission ring
+// and are submitted together with waiting for events, in a single syscall.
+class IoUringPollGroup : public ActivePollGroup,
+                         public DependentCodeReferenced
+{
+private:
+    StateMutex mutex;
+
+    class PollableList_name;
+    class PollableDeletionQueue_name;
+
+    class PollableEntry : public IntrusiveListElement<PollableList_name>,
+			  public IntrusiveListElement<PollableDeletionQueue_name>
+    {
+    public:
+	mt_const IoUringPollGroup *io_uring_poll_group;
+
+	mt_const Cb<Pollable> pollable;
+	mt_const int fd;
+
+	mt_mutex (IoUringPollGroup::mutex) bool valid;
+
+        // 'true' while there's a poll request for the entry in the ring.
+        // The entry may be deleted only after the request has been terminated.
+        mt_mutex (IoUringPollGroup::mutex) bool poll_armed;
+    };
+
+    typedef IntrusiveList<PollableEntry, PollableList_name> PollableList;
+    typedef IntrusiveList<PollableEntry, PollableDeletionQueue_name> PollableDeletionQueue;
+
+    mt_const LibMary_ThreadLocal *poll_tlocal;
+
+    mt_const Count ring_size;
+    mt_const int ring_fd;
+
+    mt_const void *sq_ring_ptr;
+    mt_const Size  sq_ring_len;
+    mt_const void *cq_ring_ptr;
+    mt_const Size  cq_ring_len;
+    mt_const struct io_uring_sqe *sqes;
+    mt_const Size sqes_len;
+
+    mt_const unsigned *sq_head;
+    mt_const unsigned *sq_tail;
+    mt_const unsigned  sq_ring_mask;
+    mt_const unsigned  sq_ring_entries;
+
+    mt_const unsigned *cq_head;
+    mt_const unsigned *cq_tail;
+    mt_const unsigned  cq_ring_mask;
+    mt_const struct io_uring_cqe *cqes;
+
+    mt_const int trigger_pipe [2];
+    mt_mutex (mutex) bool triggered;
+    mt_mutex (mutex) bool block_trigger_pipe;
+
+    mt_mutex (mutex) Uint64 num_triggers_issued;
+    mt_mutex (mutex) Uint64 num_triggers_suppressed;
+
+    mt_mutex (mutex) Count num_pollables;
+
+    mt_sync_domain (poll) bool got_deferred_tasks;
+
+    mt_mutex (mutex) PollableList pollable_list;
+    mt_mutex (mutex) PollableDeletionQueue pollable_deletion_queue;
+
+    mt_mutex (mutex) mt_throws struct io_uring_sqe* getSqe ();
+
+    mt_mutex (mutex) mt_throws Result queuePollAdd (int       fd,
+                                                    Uint32    poll_events,
+                                                    UintPtr   user_data);
+
+    mt_mutex (mutex) mt_throws Result queuePollRemove (UintPtr user_data);
+
+    // Submits queued requests. If 'get_events' is true, then flushes overflown
+    // completions and waits for a completion for at most 'timeout_microsec',
+    // or indefinitely if the timeout is (Time) -1.
+    // 'mutex' must be held when submitting without 'get_events'. The poll
+    // thread enters the ring for events without locking, which is fine since
+    // it only reads the submission queue tail.
+    mt_throws Result ringEnter (bool get_events,
+                                Time timeout_microsec);
+
+    mt_throws Result doActivate (PollableEntry * mt_nonnull pollable_entry);
+
+    mt_mutex (mutex) void processPollableDeletionQueue ();
+
+    void releaseRing ();
+
+public:
+  mt_iface (ActivePollgroup)
+    mt_iface (PollGroup)
+      mt_throws PollableKey addPollable (CbDesc<Pollable> const &pollable,
+					 bool activate = true);
+
+      mt_throws Result activatePollable (PollableKey mt_nonnull key);
+
+      mt_throws Result addPollable_beforeConnect (CbDesc<Pollable> const & /* pollable */,
+                                                  PollableKey * const /* ret_key */)
+          { return Result::Success; }
+
+      mt_throws Result addPollable_afterConnect (CbDesc<Pollable> const &pollable,
+                                                 PollableKey * const ret_key)
+      {
+          PollableKey const key = addPollable (pollable, true /* activate */);
+          if (!key)
+              return Result::Failure;
+
+          if (ret_key)
+              *ret_key = key;
+
+          return Result::Success;
+      }
+
+      void removePollable (PollableKey mt_nonnull key);
+    mt_end
+
+    mt_throws Result poll (Uint64 timeout_microsec = (Uint64) -1);
+
+    mt_throws Result trigger ();
+
+    void getTriggerStatistics (TriggerStatistics * mt_nonnull ret_stats);
+
+    Count getNumPollables ();
+  mt_end
+
+    // Sets the number of submission queue entries. Completion queue is made
+    // 4 times larger. Multishot poll requests are terminated and re-armed when
+    // the completion queue overflows, hence it should fit events for all
+    // active pollables. Should be called before open().
+    mt_const void setRingSize (Count const ring_size)
+        { this->ring_size = ring_size; }
+
+    mt_const mt_throws Result open ();
+
+    mt_const void bindToThread (LibMary_ThreadLocal * const poll_tlocal)
+        { this->poll_tlocal = poll_tlocal; }
+
+     IoUringPollGroup (Object *coderef_container);
+    ~IoUringPollGroup ();
+};
+
+}
+
+
+#endif /* LIBMARY__IO_URING_POLL_GROUP__H__ */
+
@@ -0,0 +1,283 @@
+/*  LibMary - C++ library for high-performance network servers
+    Copyright (C) 2011-2013 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#include <libmary/types.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <linux/io_uring.h>
+
+#include <libmary/util_posix.h>
+#include <libmary/log.h>
+
+#include <libmary/io_uring_writer.h>
+
+
+namespace M {
+
+static LogGroup libMary_logGroup_io_uring_writer ("io_uring_writer", LogLevel::I);
+
+mt_throws Result
+IoUringWriter::writevChunk (Count                const num_fds,
+                            int          const * const fds,
+                            struct iovec * const * const iovs,
+                            Count        const * const num_iovs,
+                            int                * const ret_res)
+{
+    // Completions of earlier chunks which have been abandoned are told apart
+    // by the chunk sequence number in the upper half of 'user_data'.
+    ++chunk_seq;
+
+    unsigned const old_tail = *sq_tail;
+    for (Count i = 0; i < num_fds; ++i) {
+        struct io_uring_sqe * const sqe = &sqes [(old_tail + i) & sq_ring_mask];
+        memset (sqe, 0, sizeof (*sqe));
+
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = fds [i];
+        sqe->addr = (Uint64) (UintPtr) iovs [i];
+        sqe->len = num_iovs [i];
+        // Writing at the current position, like writev() does.
+        sqe->off = (Uint64) -1;
+        sqe->user_data = ((Uint64) chunk_seq << 32) | i;
+
+        // Reported if the request doesn't complete for some reason.
+        ret_res [i] = -EIO;
+    }
+    __atomic_store_n (sq_tail, old_tail + num_fds, __ATOMIC_RELEASE);
+
+    Count num_complete = 0;
+    while (num_complete < num_fds) {
+        unsigned const to_submit = (old_tail + num_fds) - __atomic_load_n (sq_head, __ATOMIC_ACQUIRE);
+
+        long const res = syscall (__NR_io_uring_enter, ring_fd, to_submit, (unsigned) (num_fds - num_complete),
+                                  IORING_ENTER_GETEVENTS, NULL, (size_t) 0);
+        if (res == -1
+            && errno != EINTR
+            // EBUSY, EAGAIN: completion queue is full, we should reap completions.
+            && errno != EBUSY
+            && errno != EAGAIN)
+        {
+            int const err = errno;
+
+            if (__atomic_load_n (sq_head, __ATOMIC_ACQUIRE) == old_tail) {
+              // Nothing has been submitted, the chunk may be retried with plain writev().
+                __atomic_store_n (sq_tail, old_tail, __ATOMIC_RELEASE);
+
+                exc_throw (PosixException, err);
+                logE_ (_func, "io_uring_enter() failed: ", errnoString (err));
+                return Result::Failure;
+            }
+
+          // Some of the writes may have been performed. Their outcome is unknown
+          // and is reported as EIO.
+            logE_ (_func, "io_uring_enter() failed after submission: ", errnoString (err));
+            break;
+        }
+
+        unsigned head = *cq_head;
+        unsigned const tail = __atomic_load_n (cq_tail, __ATOMIC_ACQUIRE);
+        while (head != tail) {
+            struct io_uring_cqe * const cqe = &cqes [head & cq_ring_mask];
+            if ((Uint32) (cqe->user_data >> 32) == chunk_seq) {
+                ret_res [(Uint32) cqe->user_data] = cqe->res;
+                ++num_complete;
+            }
+            ++head;
+        }
+        __atomic_store_n (cq_head, head, __ATOMIC_RELEASE);
+    }
+
+    return Result::Success;
+}
+
+mt_throws Result
+IoUringWriter::writev (Count                const num_fds,
+                       int          const * const fds,
+                       struct iovec * const * const iovs,
+                       Count        const * const num_iovs,
+                       int                * const ret_res)
+{
+    logD (io_uring_writer, _func, "num_fds: ", num_fds);
+
+    Count pos = 0;
+    while (pos < num_fds) {
+        Count chunk_size = num_fds - pos;
+        if (chunk_size > sq_ring_entries)
+            chunk_size = sq_ring_entries;
+
+        if (!writevChunk (chunk_size, fds + pos, iovs + pos, num_iovs + pos, ret_res + pos)) {
+            if (pos == 0)
+                return Result::Failure;
+
+          // Earlier chunks have been written. Reporting the rest as not written.
+            for (Count i = pos; i < num_fds; ++i)
+                ret_res [i] = -EAGAIN;
+
+            break;
+        }
+
+        pos += chunk_size;
+    }
+
+    return Result::Success;
+}
+
+mt_const mt_throws Result
+IoUringWriter::open ()
+{
+    struct io_uring_params params;
+    memset (&params, 0, sizeof (params));
+    params.flags = IORING_SETUP_CLAMP;
+
+    {
+        long const res = syscall (__NR_io_uring_setup, (unsigned) ring_size, &params);
+        if (res == -1) {
+            exc_throw (PosixException, errno);
+            logE_ (_func, "io_uring_setup() failed: ", errnoString (errno));
+            return Result::Failure;
+        }
+        ring_fd = (int) res;
+    }
+    logD (io_uring_writer, _this_func, "io_uring fd: ", ring_fd, ", "
+          "sq_entries: ", params.sq_entries, ", cq_entries: ", params.cq_entries);
+
+    sq_ring_len = params.sq_off.array + params.sq_entries * sizeof (unsigned);
+    cq_ring_len = params.cq_off.cqes  + params.cq_entries * sizeof (struct io_uring_cqe);
+    bool const single_mmap = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_mmap) {
+        if (cq_ring_len > sq_ring_len)
+            sq_ring_len = cq_ring_len;
+        cq_ring_len = sq_ring_len;
+    }
+
+    sq_ring_ptr = mmap (NULL, sq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+    if (sq_ring_ptr == MAP_FAILED) {
+        sq_ring_ptr = NULL;
+        exc_throw (PosixException, errno);
+        logE_ (_func, "mmap() failed (sq ring): ", errnoString (errno));
+        return Result::Failure;
+    }
+
+    if (single_mmap) {
+        cq_ring_ptr = sq_ring_ptr;
+    } else {
+        cq_ring_ptr = mmap (NULL, cq_ring_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+        if (cq_ring_ptr == MAP_FAILED) {
+            cq_ring_ptr = NULL;
+            exc_throw (PosixException, errno);
+            logE_ (_func, "mmap() failed (cq ring): ", errnoString (errno));
+            return Result::Failure;
+        }
+    }
+
+    sqes_len = params.sq_entries * sizeof (struct io_uring_sqe);
+    {
+        void * const ptr = mmap (NULL, sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+        if (ptr == MAP_FAILED) {
+            exc_throw (PosixException, errno);
+            logE_ (_func, "mmap() failed (sqes): ", errnoString (errno));
+            return Result::Failure;
+        }
+        sqes = (struct io_uring_sqe*) ptr;
+    }
+
+    {
+        Byte * const sq_base = (Byte*) sq_ring_ptr;
+        sq_head         = (unsigned*) (sq_base + params.sq_off.head);
+        sq_tail         = (unsigned*) (sq_base + params.sq_off.tail);
+        sq_ring_mask    = *(unsigned*) (sq_base + params.sq_off.ring_mask);
+        sq_ring_entries = *(unsigned*) (sq_base + params.sq_off.ring_entries);
+
+        // Submission queue entries are always used in order, hence the index
+        // array is filled once.
+        unsigned * const sq_array = (unsigned*) (sq_base + params.sq_off.array);
+        for (unsigned i = 0; i < sq_ring_entries; ++i)
+            sq_array [i] = i;
+
+        Byte * const cq_base = (Byte*) cq_ring_ptr;
+        cq_head      = (unsigned*) (cq_base + params.cq_off.head);
+        cq_tail      = (unsigned*) (cq_base + params.cq_off.tail);
+        cq_ring_mask = *(unsigned*) (cq_base + params.cq_off.ring_mask);
+        cqes         = (struct io_uring_cqe*) (cq_base + params.cq_off.cqes);
+    }
+
+    return Result::Success;
+}
+
+void
+IoUringWriter::releaseRing ()
+{
+    if (sqes)
+        munmap (sqes, sqes_len);
+
+    if (cq_ring_ptr && cq_ring_ptr != sq_ring_ptr)
+        munmap (cq_ring_ptr, cq_ring_len);
+
+    if (sq_ring_ptr)
+        munmap (sq_ring_ptr, sq_ring_len);
+
+    if (ring_fd != -1) {
+	for (;;) {
+	    int const res = close (ring_fd);
+	    if (res == -1) {
+		if (errno == EINTR)
+		    continue;
+
+		logE_ (_func, "close() failed (ring_fd): ", errnoString (errno));
+	    } else
+	    if (res != 0) {
+		logE_ (_func, "close() (ring_fd): unexpected return value: ", res);
+	    }
+
+	    break;
+	}
+    }
+}
+
+IoUringWriter::IoUringWriter ()
+    : ring_size (256),
+      ring_fd (-1),
+      sq_ring_ptr (NULL),
+      sq_ring_len (0),
+      cq_ring_ptr (NULL),
+      cq_ring_len (0),
+      sqes (NULL),
+      sqes_len (0),
+      sq_head (NULL),
+      sq_tail (NULL),
+      sq_ring_mask (0),
+      sq_ring_entries (0),
+      cq_head (NULL),
+      cq_tail (NULL),
+      cq_ring_mask (0),
+      cqes (NULL),
+      chunk_seq (0)
+{
+}
+
+IoUringWriter::~IoUringWriter ()
+{
+    releaseRing ();
+}
+
+}
+
@@ -0,0 +1,104 @@
+/*  LibMary - C++ library for high-performance network servers
+    Copyright (C) 2011-2013 Dmitry Shatrov
+
+    This library is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Lesser General Public
+    License as published by the Free Software Foundation; either
+    version 2.1 of the License, or (at your option) any later version.
+
+    This library is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    Lesser General Public License for more details.
+
+    You should have received a copy of the GNU Lesser General Public
+    License along with this library; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+*/
+
+
+#ifndef LIBMARY__IO_URING_WRITER__H__
+#define LIBMARY__IO_URING_WRITER__H__
+
+
+#include <libmary/types.h>
+
+#include <sys/uio.h>
+
+
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+
+namespace M {
+
+// Performs writev() for many file descriptors with a single io_uring_enter()
+// syscall. This is a portable replacement for libMary_mwritev(), which
+// requires a custom kernel module.
+//
+// File descriptors are expected to be in non-blocking mode: the kernel then
+// completes every request inline, returning -EAGAIN instead of waiting.
+//
+// Not thread-safe: an IoUringWriter should be used by one thread at a time.
+class IoUringWriter
+{
+private:
+    mt_const Count ring_size;
+    mt_const int ring_fd;
+
+    mt_const void *sq_ring_ptr;
+    mt_const Size  sq_ring_len;
+    mt_const void *cq_ring_ptr;
+    mt_const Size  cq_ring_len;
+    mt_const struct io_uring_sqe *sqes;
+    mt_const Size sqes_len;
+
+    mt_const unsigned *sq_head;
+    mt_const unsigned *sq_tail;
+    mt_const unsigned  sq_ring_mask;
+    mt_const unsigned  sq_ring_entries;
+
+    mt_const unsigned *cq_head;
+    mt_const unsigned *cq_tail;
+    mt_const unsigned  cq_ring_mask;
+    mt_const struct io_uring_cqe *cqes;
+
+    Uint32 chunk_seq;
+
+    // Submits 'num_fds' requests, which should fit in the submission queue,
+    // and reaps their completions.
+    mt_throws Result writevChunk (Count               num_fds,
+                                  int          const *fds,
+                                  struct iovec * const *iovs,
+                                  Count        const *num_iovs,
+                                  int                *ret_res);
+
+    void releaseRing ();
+
+public:
+    // Calls writev (fds [i], iovs [i], num_iovs [i]) for every i below
+    // 'num_fds'. The outcome of each call is stored in ret_res [i]: the number
+    // of bytes written, or a negated errno value. Returns Result::Failure only
+    // if the batch as a whole could not be processed.
+    mt_throws Result writev (Count               num_fds,
+                             int          const *fds,
+                             struct iovec * const *iovs,
+                             Count        const *num_iovs,
+                             int                *ret_res);
+
+    // Sets the number of submission queue entries, which is the maximum
+    // number of writes per syscall. Should be called before open().
+    mt_const void setRingSize (Count const ring_size)
+        { this->ring_size = ring_size; }
+
+    mt_const mt_throws Result open ();
+
+     IoUringWriter ();
+    ~IoUringWriter ();
+};
+
+}
+
+
+#endif /* LIBMARY__IO_URING_WRITER__H__ */
+
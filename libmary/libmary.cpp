@@ -35,6 +35,7 @@
 namespace M {
 
 void libMary_platformInit ();
+void libMary_httpTokenizerInit ();
 
 #ifdef LIBMARY_MT_SAFE
 volatile gint _libMary_dummy_mb_int = 0;
@@ -89,6 +90,8 @@ void libMaryInit ()
     libMary_mwritevInit ();
 #endif
 
+    libMary_httpTokenizerInit ();
+
     randomSetSeed ((Uint32) getTime());
 }
 
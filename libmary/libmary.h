@@ -116,9 +116,15 @@
   #ifdef LIBMARY_ENABLE_EPOLL
     #include <libmary/epoll_poll_group.h>
   #endif
+  #ifdef LIBMARY_ENABLE_IO_URING
+    #include <libmary/io_uring_poll_group.h>
+    #include <libmary/io_uring_writer.h>
+  #endif
 #endif
 
+#include <libmary/http_tokenizer.h>
 #include <libmary/http_server.h>
+#include <libmary/http_chunked_writer.h>
 #include <libmary/http_client.h>
 #include <libmary/http_service.h>
 
@@ -23,6 +23,8 @@
 //#include <cstdio>
 
 #include <libmary/exception.h>
+#include <libmary/page_pool.h>
+#include <libmary/connection_receiver.h>
 
 #include <libmary/libmary_thread_local.h>
 
@@ -69,7 +71,12 @@ LibMary_ThreadLocal::LibMary_ThreadLocal ()
       time_log_frac (0),
 
       saved_unixtime (0),
-      saved_monotime (0)
+      saved_monotime (0),
+
+      page_pool_caches (NULL),
+
+      recv_buf_cache (NULL),
+      recv_buf_cache_size (0)
 
 #ifdef LIBMARY_PLATFORM_WIN32
       ,
@@ -120,6 +127,11 @@ LibMary_ThreadLocal::~LibMary_ThreadLocal ()
     }
 
     delete[] strerr_buf;
+
+    ConnectionReceiver::releaseThreadBuffers (this);
+
+    // Pages may be released during exceptions cleanup, hence this goes last.
+    PagePool::releaseThreadCaches (this);
 }
 
 #ifdef LIBMARY_MT_SAFE
@@ -60,6 +60,9 @@ class Exception;
 class CodeReferenced;
 class Object;
 
+class PagePool_ThreadCache;
+class ConnectionReceiver_FreeBuffer;
+
 #ifdef LIBMARY_ENABLE_MWRITEV
 // DeferredConnectionSender's mwritev data.
 class LibMary_MwritevData
@@ -113,6 +116,13 @@ public:
 
     char timezone_str [5];
 
+    // Per-thread page caches, one for each PagePool used by the thread.
+    PagePool_ThreadCache *page_pool_caches;
+
+    // Free ConnectionReceiver's receive buffers.
+    ConnectionReceiver_FreeBuffer *recv_buf_cache;
+    Count recv_buf_cache_size;
+
 #ifdef LIBMARY_PLATFORM_WIN32
     DWORD prv_win_time_dw;
     Time win_time_offs;
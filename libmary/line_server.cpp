@@ -28,7 +28,8 @@ namespace M {
 Receiver::Frontend const LineServer::receiver_frontend = {
     processInput,
     processEof,
-    processError
+    processError,
+    NULL /* processInputPages */
 };
 
 Receiver::ProcessInputResult
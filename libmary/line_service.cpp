@@ -62,6 +62,8 @@ LineService::acceptOneConnection ()
 	assert (res == TcpServer::AcceptResult::Accepted);
     }
 
+    if (recv_buf_len)
+        line_conn->conn_receiver.setRecvBufferSize (recv_buf_len);
     line_conn->conn_receiver.init (&line_conn->tcp_conn,
                                    thread_ctx->getDeferredProcessor());
     line_conn->line_server.init (&line_conn->conn_receiver,
@@ -143,6 +145,12 @@ LineService::closed (void * const _line_conn)
     self->mutex.unlock ();
 }
 
+mt_const void
+LineService::setRecvBufferSize (Size const recv_buf_len)
+{
+    this->recv_buf_len = recv_buf_len;
+}
+
 mt_throws Result
 LineService::init (ServerContext    * const mt_nonnull server_ctx,
                    CbDesc<Frontend>   const &frontend,
@@ -206,6 +214,7 @@ LineService::start ()
 LineService::LineService (Object * const coderef_container)
     : DependentCodeReferenced (coderef_container),
       max_line_len (4096),
+      recv_buf_len (0),
       thread_ctx (coderef_container),
       tcp_server (coderef_container)
 {
@@ -70,6 +70,7 @@ private:
     typedef LineConnection::LineConnectionList LineConnectionList;
 
     mt_const Size max_line_len;
+    mt_const Size recv_buf_len;
 
     mt_const DataDepRef<ServerThreadContext> thread_ctx;
 
@@ -106,6 +107,10 @@ public:
 
     mt_throws Result start ();
 
+    // Sets receive buffer size for client connections. Should be called
+    // before start().
+    mt_const void setRecvBufferSize (Size recv_buf_len);
+
     mt_throws Result init (ServerContext          * mt_nonnull server_ctx,
                            CbDesc<Frontend> const &frontend,
                            Size                    max_line_len = 4096);
@@ -18,6 +18,8 @@
 
 
 #include <libmary/log.h>
+#include <libmary/util_str.h>
+#include <libmary/util_posix.h>
 
 #include <libmary/multi_thread.h>
 
@@ -45,8 +47,26 @@ MultiThread::wrapperThreadFunc (void *_self)
     }
 
     Cb<Thread::ThreadFunc> const tmp_cb = self->thread_cb;
+
+    bool pin = false;
+    Count cpu = 0;
+    if (self->num_cpus) {
+        pin = true;
+        cpu = self->cpus [self->num_placed_threads % self->num_cpus];
+        ++self->num_placed_threads;
+    }
     self->mutex.unlock ();
 
+#ifndef LIBMARY_PLATFORM_WIN32
+    if (pin) {
+        if (!posix_setThreadCpu (cpu))
+            logE_ (_func, "could not pin thread to cpu ", cpu, ": ", exc->toString());
+    }
+#else
+    (void) pin;
+    (void) cpu;
+#endif
+
     tmp_cb.call_ ();
 
     self->mutex.lock ();
@@ -133,5 +153,91 @@ MultiThread::setThreadFunc (CbDesc<Thread::ThreadFunc> const &cb)
     this->thread_cb = cb;
 }
 
+// Parses 'cpu_list' into 'ret_cpus' and returns the number of CPUs in the list.
+// 'ret_cpus' may be NULL.
+static mt_throws Result parseCpuList (ConstMemory   const cpu_list,
+                                      Count       * const ret_cpus,
+                                      Count       * const mt_nonnull ret_num_cpus)
+{
+    Count num_cpus = 0;
+
+    Byte const * const list_end = cpu_list.mem() + cpu_list.len();
+    Byte const *cur = cpu_list.mem();
+    while (cur < list_end) {
+        Byte const *item_end = cur;
+        while (item_end < list_end && *item_end != ',')
+            ++item_end;
+
+        Byte const *dash = cur;
+        while (dash < item_end && *dash != '-')
+            ++dash;
+
+        Uint32 first = 0;
+        Uint32 last  = 0;
+        if (!strToUint32_safe (ConstMemory (cur, dash - cur), &first, 10))
+            goto _bad_input;
+
+        if (dash < item_end) {
+            if (!strToUint32_safe (ConstMemory (dash + 1, item_end - (dash + 1)), &last, 10))
+                goto _bad_input;
+        } else {
+            last = first;
+        }
+
+        // Arbitrary sanity limit.
+        if (first > last || last >= 65536)
+            goto _bad_input;
+
+        for (Uint32 i = first; i <= last; ++i) {
+            if (ret_cpus)
+                ret_cpus [num_cpus] = i;
+
+            ++num_cpus;
+        }
+
+        cur = item_end + 1;
+    }
+
+    *ret_num_cpus = num_cpus;
+    return Result::Success;
+
+_bad_input:
+    exc_throw (InternalException, InternalException::BadInput);
+    logE_ (_func, "bad cpu list: ", cpu_list);
+    return Result::Failure;
+}
+
+mt_throws Result
+MultiThread::setCpuAffinity (ConstMemory const cpu_list)
+{
+    Count new_num_cpus = 0;
+    if (!parseCpuList (cpu_list, NULL /* ret_cpus */, &new_num_cpus))
+        return Result::Failure;
+
+    Count *new_cpus = NULL;
+    if (new_num_cpus) {
+        new_cpus = new (std::nothrow) Count [new_num_cpus];
+        assert (new_cpus);
+        if (!parseCpuList (cpu_list, new_cpus, &new_num_cpus))
+            unreachable ();
+    }
+
+    mutex.lock ();
+    Count * const old_cpus = cpus;
+    cpus = new_cpus;
+    num_cpus = new_num_cpus;
+    num_placed_threads = 0;
+    mutex.unlock ();
+
+    delete[] old_cpus;
+
+    return Result::Success;
+}
+
+MultiThread::~MultiThread ()
+{
+    delete[] cpus;
+}
+
 }
 
@@ -46,6 +46,12 @@ private:
 
     mt_mutex (mutex) bool abort_spawn;
 
+    // CPUs to pin threads to, see setCpuAffinity().
+    mt_mutex (mutex) Count *cpus;
+    mt_mutex (mutex) Count num_cpus;
+    // Number of threads which have been assigned a CPU.
+    mt_mutex (mutex) Count num_placed_threads;
+
     static void wrapperThreadFunc (void *_thread_data);
 
 public:
@@ -63,14 +69,28 @@ public:
     // Thread callback is reset when the thread exits.
     void setThreadFunc (CbDesc<Thread::ThreadFunc> const &cb);
 
+    // Pins every spawned thread to a single CPU from 'cpu_list', which is
+    // a list of CPU numbers and ranges like "0-3,8,10-11". CPUs are assigned
+    // to threads in turn, in the order the threads start. Pinning happens
+    // before the thread function is called, hence memory which the thread
+    // function allocates and touches first is placed on the local NUMA node
+    // (with the kernel's default first-touch policy). Empty 'cpu_list'
+    // disables pinning. Should be called before spawn(). Linux-only.
+    mt_throws Result setCpuAffinity (ConstMemory cpu_list);
+
     MultiThread (Count num_threads = 1,
 		 CbDesc<Thread::ThreadFunc> const &thread_cb = CbDesc<Thread::ThreadFunc> ())
 	: thread_cb (thread_cb),
 	  num_threads (num_threads),
 	  num_active_threads (0),
-	  abort_spawn (false)
+	  abort_spawn (false),
+          cpus (NULL),
+          num_cpus (0),
+          num_placed_threads (0)
     {
     }
+
+    ~MultiThread ();
 };
 
 }
@@ -20,9 +20,18 @@
 #include <libmary/types.h>
 #include <new>
 #include <cstdio>
+#include <cstring>
+
+#ifndef LIBMARY_PLATFORM_WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
 
 #include <libmary/log.h>
 #include <libmary/util_dev.h>
+#include <libmary/libmary_thread_local.h>
+#include <libmary/stat.h>
 
 #include <libmary/page_pool.h>
 
@@ -31,6 +40,55 @@ namespace M {
 
 static LogGroup libMary_logGroup_pool ("pool", LogLevel::I);
 
+Mutex PagePool::thread_cache_mutex;
+
+// A large mmap'ed memory area which pages are carved out of.
+class PagePool_Arena
+{
+public:
+    Byte *mem;
+
+    mt_mutex (PagePool::arena_mutex) PagePool::Page *first_free_page;
+    mt_mutex (PagePool::arena_mutex) Count num_free_pages;
+
+    // Arenas which have free pages are linked together.
+    mt_mutex (PagePool::arena_mutex) PagePool_Arena *next_partial;
+    mt_mutex (PagePool::arena_mutex) PagePool_Arena *prv_partial;
+};
+
+// Accessed without locking by the owning thread only, except for
+// 'next_in_pool' and 'prv_in_pool', which are protected by PagePool::mutex.
+class PagePool_ThreadCache
+{
+public:
+    // NULL if the pool has been destroyed.
+    PagePool *page_pool;
+
+    // Spare pages linked via Page::next_pool_page.
+    PagePool::Page *first_page;
+    Count num_pages;
+
+    Count num_refills;
+    Count num_flushes;
+
+    PagePool_ThreadCache *next_in_thread;
+
+    mt_mutex (PagePool::mutex) PagePool_ThreadCache *next_in_pool;
+    mt_mutex (PagePool::mutex) PagePool_ThreadCache *prv_in_pool;
+
+    PagePool_ThreadCache ()
+        : page_pool      (NULL),
+          first_page     (NULL),
+          num_pages      (0),
+          num_refills    (0),
+          num_flushes    (0),
+          next_in_thread (NULL),
+          next_in_pool   (NULL),
+          prv_in_pool    (NULL)
+    {
+    }
+};
+
 void
 PagePool::PageListArray::doGetSet (Size        offset,
 				   Byte       * const data_get,
@@ -122,34 +180,425 @@ PagePool::PageListArray::set (Size const offset,
     doGetSet (offset, NULL /* data_get */, mem.mem() /* data_set */, mem.len(), false /* get */);
 }
 
-mt_mutex (mutex) PagePool::Page*
-PagePool::grabPage ()
+#ifndef LIBMARY_PLATFORM_WIN32
+mt_mutex (arena_mutex) PagePool_Arena*
+PagePool::createArena ()
 {
-    Page *page;
-    if (!first_spare_page) {
-        // Default page refcount is 1.
-        page = new (new (std::nothrow) Byte [sizeof (Page) + page_size]) Page;
-        assert (page);
+    int mmap_flags = MAP_PRIVATE | MAP_ANONYMOUS;
+  #ifdef MAP_HUGETLB
+    if (arena_huge_pages == ArenaHugePages::HugeTlb)
+        mmap_flags |= MAP_HUGETLB;
+  #endif
+
+    void *mem = mmap (NULL, arena_size, PROT_READ | PROT_WRITE, mmap_flags, -1 /* fd */, 0 /* offset */);
+  #ifdef MAP_HUGETLB
+    if (mem == MAP_FAILED && (mmap_flags & MAP_HUGETLB)) {
+        // Falling back to transparent huge pages if no huge pages are reserved
+        // in the system. Not trying MAP_HUGETLB again for subsequent arenas.
+        logW_ (_func, "mmap(MAP_HUGETLB) failed: ", errnoString (errno));
+        arena_huge_pages = ArenaHugePages::Advise;
+        mem = mmap (NULL, arena_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1 /* fd */, 0 /* offset */);
+    }
+  #endif
+    if (mem == MAP_FAILED) {
+        logF_ (_func, "mmap() failed: ", errnoString (errno));
+        abort ();
+    }
+
+  #ifdef MADV_HUGEPAGE
+    if (arena_huge_pages != ArenaHugePages::None) {
+        if (madvise (mem, arena_size, MADV_HUGEPAGE) == -1)
+            logD (pool, _func, "madvise(MADV_HUGEPAGE) failed: ", errnoString (errno));
+    }
+  #endif
+
+    PagePool_Arena * const arena = new (std::nothrow) PagePool_Arena;
+    assert (arena);
+
+    arena->mem = (Byte*) mem;
+    arena->num_free_pages = pages_per_arena;
+
+    // Page headers are cache line-aligned: 'mem' is aligned to a system page
+    // boundary, and 'page_stride' is a multiple of the cache line size.
+    Page *prv_page = NULL;
+    for (Count i = pages_per_arena; i > 0; --i) {
+        Page * const page = new (arena->mem + (i - 1) * page_stride) Page (0);
+        page->arena = arena;
+        page->next_pool_page = prv_page;
+        prv_page = page;
+    }
+    arena->first_free_page = prv_page;
+
+    arena->prv_partial = NULL;
+    arena->next_partial = first_partial_arena;
+    if (first_partial_arena)
+        first_partial_arena->prv_partial = arena;
+    first_partial_arena = arena;
+
+    ++num_arenas;
+
+    logD (pool, _func, "new arena 0x", fmt_hex, (UintPtr) arena->mem);
+
+    return arena;
+}
+
+mt_mutex (arena_mutex) void
+PagePool::unlinkPartialArena (PagePool_Arena * const mt_nonnull arena)
+{
+    if (arena->prv_partial)
+        arena->prv_partial->next_partial = arena->next_partial;
+    else
+        first_partial_arena = arena->next_partial;
 
+    if (arena->next_partial)
+        arena->next_partial->prv_partial = arena->prv_partial;
+}
+#endif
+
+PagePool::Page*
+PagePool::allocPages (Count   const num_pages_to_alloc,
+                      Page  * const next_page)
+{
+    // Spare pages have zero refcount.
+    Page *first_page = next_page;
+
+#ifndef LIBMARY_PLATFORM_WIN32
+    if (pages_per_arena) {
+        arena_mutex.lock ();
+        for (Count i = 0; i < num_pages_to_alloc; ++i) {
+            PagePool_Arena *arena = first_partial_arena;
+            if (!arena)
+                arena = createArena ();
+
+            Page * const page = arena->first_free_page;
+            arena->first_free_page = page->next_pool_page;
+            --arena->num_free_pages;
+            if (arena->num_free_pages == 0)
+                unlinkPartialArena (arena);
+
+            page->next_pool_page = first_page;
+            first_page = page;
+        }
+        arena_mutex.unlock ();
+
+        return first_page;
+    }
+#endif
+
+    for (Count i = 0; i < num_pages_to_alloc; ++i) {
+        Page * const page = new (new (std::nothrow) Byte [sizeof (Page) + page_size]) Page (0);
+        assert (page);
         logD (pool, _func, "new page 0x", fmt_hex, (UintPtr) page);
 
-        ++num_pages;
-    } else {
-        page = first_spare_page;
-        first_spare_page = first_spare_page->next_pool_page;
+        page->next_pool_page = first_page;
+        first_page = page;
+    }
+
+    return first_page;
+}
+
+void
+PagePool::freePages (Page  *first_page,
+                     Count  num_pages_to_free)
+{
+#ifndef LIBMARY_PLATFORM_WIN32
+    if (pages_per_arena) {
+        // Arenas with no pages in use are given back to the OS.
+        PagePool_Arena *first_arena_to_unmap = NULL;
+
+        arena_mutex.lock ();
+        for (Count i = 0; i < num_pages_to_free; ++i) {
+            assert (first_page);
+            Page * const page = first_page;
+            first_page = first_page->next_pool_page;
+
+            PagePool_Arena * const arena = page->arena;
+            page->next_pool_page = arena->first_free_page;
+            arena->first_free_page = page;
+            ++arena->num_free_pages;
+
+            if (arena->num_free_pages == 1) {
+                arena->prv_partial = NULL;
+                arena->next_partial = first_partial_arena;
+                if (first_partial_arena)
+                    first_partial_arena->prv_partial = arena;
+                first_partial_arena = arena;
+            }
+
+            if (arena->num_free_pages == pages_per_arena) {
+                unlinkPartialArena (arena);
+                arena->next_partial = first_arena_to_unmap;
+                first_arena_to_unmap = arena;
+
+                assert (num_arenas > 0);
+                --num_arenas;
+            }
+        }
+        arena_mutex.unlock ();
+
+        while (first_arena_to_unmap) {
+            PagePool_Arena * const arena = first_arena_to_unmap;
+            first_arena_to_unmap = arena->next_partial;
+
+            logD (pool, _func, "unmapping arena 0x", fmt_hex, (UintPtr) arena->mem);
+            if (munmap (arena->mem, arena_size) == -1)
+                logE_ (_func, "munmap() failed: ", errnoString (errno));
+
+            delete arena;
+        }
+
+        return;
+    }
+#endif
+
+    for (Count i = 0; i < num_pages_to_free; ++i) {
+        assert (first_page);
+        Page * const page = first_page;
+        first_page = first_page->next_pool_page;
+
+        logD (pool, _func, "freeing page 0x", fmt_hex, (UintPtr) page);
+
+        page->~Page();
+        delete[] (Byte*) page;
+    }
+}
+
+PagePool_ThreadCache*
+PagePool::getThreadCache ()
+{
+    LibMary_ThreadLocal * const tlocal = libMary_getThreadLocal();
+
+    PagePool_ThreadCache *cache = tlocal->page_pool_caches;
+    while (cache) {
+        if (cache->page_pool == this)
+            return cache;
+
+        cache = cache->next_in_thread;
+    }
+
+    return createThreadCache (tlocal);
+}
+
+PagePool_ThreadCache*
+PagePool::createThreadCache (LibMary_ThreadLocal * const mt_nonnull tlocal)
+{
+    PagePool_ThreadCache * const cache = new (std::nothrow) PagePool_ThreadCache;
+    assert (cache);
 
-        pageRef (page);
+    cache->page_pool = this;
+    cache->next_in_thread = tlocal->page_pool_caches;
+    tlocal->page_pool_caches = cache;
 
-        logD (pool, _func, "spare page 0x", fmt_hex, (UintPtr) page);
+    mutex.lock ();
+    cache->prv_in_pool = NULL;
+    cache->next_in_pool = first_thread_cache;
+    if (first_thread_cache)
+        first_thread_cache->prv_in_pool = cache;
+    first_thread_cache = cache;
+    mutex.unlock ();
+
+    logD (pool, _func, "new thread cache 0x", fmt_hex, (UintPtr) cache);
+
+    return cache;
+}
+
+void
+PagePool::refillThreadCache (PagePool_ThreadCache * const mt_nonnull cache)
+{
+    Count num_taken = 0;
+
+    mutex.lock ();
+    while (num_taken < thread_cache_batch && first_spare_page) {
+        Page * const page = first_spare_page;
+        first_spare_page = page->next_pool_page;
 
-        assert (stats.num_spare_pages > 0);
-        --stats.num_spare_pages;
+        page->next_pool_page = cache->first_page;
+        cache->first_page = page;
+        ++num_taken;
     }
+    assert (num_spare_pages >= num_taken);
+    num_spare_pages -= num_taken;
+
+    Count const num_new = thread_cache_batch - num_taken;
+    num_pages += num_new;
+    updateLegacyStats ();
+    mutex.unlock ();
+
+    // New pages are allocated with 'mutex' unlocked.
+    cache->first_page = allocPages (num_new, cache->first_page);
+
+    cache->num_pages += thread_cache_batch;
+    ++cache->num_refills;
+}
+
+void
+PagePool::prefillThreadCache ()
+{
+    if (thread_cache_size == 0)
+        return;
 
-    page->next_msg_page = NULL;
+    PagePool_ThreadCache * const cache = getThreadCache ();
+    if (cache->num_pages >= thread_cache_batch)
+        return;
 
-    ++stats.num_busy_pages;
-    return page;
+    Count const num_new = thread_cache_batch - cache->num_pages;
+
+    mutex.lock ();
+    num_pages += num_new;
+    updateLegacyStats ();
+    mutex.unlock ();
+
+    Page * const old_first_page = cache->first_page;
+    cache->first_page = allocPages (num_new, cache->first_page);
+    cache->num_pages += num_new;
+
+    for (Page *page = cache->first_page; page != old_first_page; page = page->next_pool_page)
+        memset (page->getData(), 0, page_size);
+}
+
+void
+PagePool::flushThreadCache (PagePool_ThreadCache * const mt_nonnull cache,
+                            Count                  const num_pages_to_flush)
+{
+    if (num_pages_to_flush == 0)
+        return;
+
+    assert (num_pages_to_flush <= cache->num_pages);
+
+    Page * const first_page = cache->first_page;
+    Page *last_page = first_page;
+    for (Count i = 1; i < num_pages_to_flush; ++i)
+        last_page = last_page->next_pool_page;
+
+    cache->first_page = last_page->next_pool_page;
+    cache->num_pages -= num_pages_to_flush;
+    ++cache->num_flushes;
+
+    mutex.lock ();
+    depotPutPages (first_page, last_page, num_pages_to_flush);
+}
+
+mt_unlocks (mutex) void
+PagePool::depotPutPages (Page  * const first_page,
+                         Page  * const last_page,
+                         Count   const num_pages_to_put)
+{
+    // Keeping at most 'high_watermark' spare pages in the depot,
+    // the rest is freed with 'mutex' unlocked.
+    Count num_to_keep = 0;
+    if (num_spare_pages < high_watermark)
+        num_to_keep = high_watermark - num_spare_pages;
+
+    if (num_to_keep > num_pages_to_put)
+        num_to_keep = num_pages_to_put;
+
+    Page *page_to_free = first_page;
+    if (num_to_keep > 0) {
+        Page *last_kept = first_page;
+        for (Count i = 1; i < num_to_keep; ++i)
+            last_kept = last_kept->next_pool_page;
+
+        page_to_free = (last_kept != last_page ? last_kept->next_pool_page : NULL);
+
+        last_kept->next_pool_page = first_spare_page;
+        first_spare_page = first_page;
+        num_spare_pages += num_to_keep;
+    }
+
+    Count const num_to_free = num_pages_to_put - num_to_keep;
+    assert (num_pages >= num_to_free);
+    num_pages -= num_to_free;
+    updateLegacyStats ();
+    mutex.unlock ();
+
+    freePages (page_to_free, num_to_free);
+}
+
+Count
+PagePool::takeCachedPages (PagePool_ThreadCache  * const mt_nonnull cache,
+                           Count                   const num_pages_to_take,
+                           Page                 ** const mt_nonnull first_page)
+{
+    Count num_taken = 0;
+    while (num_taken < num_pages_to_take && cache->first_page) {
+        Page * const page = cache->first_page;
+        cache->first_page = page->next_pool_page;
+        --cache->num_pages;
+
+        page->next_pool_page = *first_page;
+        *first_page = page;
+        ++num_taken;
+    }
+
+    return num_taken;
+}
+
+void
+PagePool::grabPages (PageListHead * const mt_nonnull page_list,
+                     Count          const num_pages_to_grab)
+{
+    if (num_pages_to_grab == 0)
+        return;
+
+    Page *first_page = NULL;
+    Count num_grabbed = 0;
+
+    if (thread_cache_size) {
+        PagePool_ThreadCache * const cache = getThreadCache ();
+        num_grabbed = takeCachedPages (cache, num_pages_to_grab, &first_page);
+        if (num_grabbed < num_pages_to_grab) {
+          // The cache is refilled with a single batch. The part of a bulk grab
+          // which is larger than a batch is taken from the depot directly.
+            Count const num_rest = num_pages_to_grab - num_grabbed;
+            Count const num_direct = (num_rest > thread_cache_batch ? num_rest - thread_cache_batch : 0);
+
+            refillThreadCache (cache);
+            num_grabbed += takeCachedPages (cache, num_rest - num_direct, &first_page);
+        }
+    }
+
+    if (num_grabbed < num_pages_to_grab) {
+        Count const num_rest = num_pages_to_grab - num_grabbed;
+        Count num_taken = 0;
+
+        mutex.lock ();
+        while (num_taken < num_rest && first_spare_page) {
+            Page * const page = first_spare_page;
+            first_spare_page = page->next_pool_page;
+
+            page->next_pool_page = first_page;
+            first_page = page;
+            ++num_taken;
+        }
+        assert (num_spare_pages >= num_taken);
+        num_spare_pages -= num_taken;
+
+        Count const num_new = num_rest - num_taken;
+        num_pages += num_new;
+        updateLegacyStats ();
+        mutex.unlock ();
+
+        // New pages are allocated with 'mutex' unlocked.
+        first_page = allocPages (num_new, first_page);
+    }
+
+    Page *page = first_page;
+    while (page) {
+        page->refcount.set (1);
+        page->data_len = 0;
+        page->next_msg_page = page->next_pool_page;
+
+        if (!page->next_pool_page) {
+            if (page_list->last)
+                page_list->last->next_msg_page = first_page;
+            else
+                page_list->first = first_page;
+
+            page_list->last = page;
+        }
+
+        page = page->next_pool_page;
+    }
 }
 
 void
@@ -181,25 +630,13 @@ PagePool::doGetPages (PageListHead * const mt_nonnull page_list,
     if (cur_data_len == 0)
         return;
 
-    mutex.lock ();
+    // All pages are grabbed at once, then filled with no locks held.
+    Page * const prv_last_page = page_list->last;
+    grabPages (page_list, (cur_data_len + page_size - 1) / page_size);
+
+    Page *page = (prv_last_page ? prv_last_page->next_msg_page : page_list->first);
     while (cur_data_len > 0) {
-        // TODO Grab all pages with mutex locked, then unlock the mutex, then do memcpy.
-        //      Don't forget about proper synchronization for memcpy.
-        //
-        //      It'd also be better to decide how many pages are needed and malloc them
-        //      in advance before locking 'mutex' (bulk grab).
-	Page * const page = grabPage ();
-	{
-	  // Dealing with the linked list.
-
-	    if (!page_list->first)
-		page_list->first = page;
-
-	    if (page_list->last)
-		page_list->last->next_msg_page = page;
-
-	    page_list->last = page;
-	}
+        assert (page);
 
 	Size const tocopy = (cur_data_len <= page_size ? cur_data_len : page_size);
 
@@ -209,8 +646,9 @@ PagePool::doGetPages (PageListHead * const mt_nonnull page_list,
 	page->data_len = tocopy;
 	cur_data += tocopy;
 	cur_data_len -= tocopy;
+
+        page = page->next_msg_page;
     }
-    mutex.unlock ();
 }
 
 void
@@ -261,20 +699,12 @@ PagePool::getFillPagesFromPages (PageListHead * const mt_nonnull page_list,
     if (from_len == 0)
         return;
 
-    mutex.lock ();
-    while (from_len > 0) {
-        Page * const page = grabPage ();
-	{
-	  // Dealing with the linked list.
-
-	    if (!page_list->first)
-		page_list->first = page;
-
-	    if (page_list->last)
-		page_list->last->next_msg_page = page;
+    Page * const prv_last_page = page_list->last;
+    grabPages (page_list, (from_len + page_size - 1) / page_size);
 
-	    page_list->last = page;
-	}
+    Page *page = (prv_last_page ? prv_last_page->next_msg_page : page_list->first);
+    while (from_len > 0) {
+        assert (page);
 
         Size tocopy = page_size;
         if (tocopy > from_len)
@@ -293,8 +723,9 @@ PagePool::getFillPagesFromPages (PageListHead * const mt_nonnull page_list,
             assert (from_page || from_len == 0);
             from_offset = 0;
         }
+
+        page = page->next_msg_page;
     }
-    mutex.unlock ();
 }
 
 void
@@ -319,31 +750,23 @@ PagePool::pageUnref (Page * const mt_nonnull page)
     if (!page->refcount.decAndTest ())
 	return;
 
-    mutex.lock ();
-
-    assert (stats.num_busy_pages > 0);
-    --stats.num_busy_pages;
+    if (thread_cache_size) {
+        PagePool_ThreadCache * const cache = getThreadCache ();
 
-    if (stats.num_spare_pages < min_pages) {
-	logD (pool, _func, "num_pages: ", num_pages, ", spare page 0x", fmt_hex, (UintPtr) page);
+        page->next_pool_page = cache->first_page;
+        cache->first_page = page;
+        ++cache->num_pages;
 
-	page->next_pool_page = first_spare_page;
-	first_spare_page = page;
-	++stats.num_spare_pages;
-    } else {
-	logD (pool, _func, "num_pages: ", num_pages, ", freeing page 0x", fmt_hex, (UintPtr) page);
-
-	assert (num_pages > 0);
-	--num_pages;
-	mutex.unlock ();
-
-	page->~Page();
-	delete[] (Byte*) page;
+        if (cache->num_pages > thread_cache_size)
+            flushThreadCache (cache, cache->num_pages - (thread_cache_size - thread_cache_batch));
 
-	return;
+        return;
     }
 
-    mutex.unlock ();
+    page->next_pool_page = NULL;
+
+    mutex.lock ();
+    depotPutPages (page, page, 1 /* num_pages_to_put */);
 }
 
 void
@@ -376,37 +799,289 @@ PagePool::msgUnref (Page * const first_page)
 void
 PagePool::setMinPages (Count const min_pages)
 {
+    setWatermarks (min_pages, min_pages);
+}
+
+void
+PagePool::setWatermarks (Count const low_watermark,
+                         Count const high_watermark)
+{
+    assert (low_watermark <= high_watermark);
+
     mutex.lock ();
 
-    this->min_pages = min_pages;
+    this->min_pages = low_watermark;
+    this->high_watermark = high_watermark;
 
-    while (stats.num_spare_pages < min_pages) {
-        Page * const page =
-                new (new (std::nothrow) Byte [sizeof (Page) + page_size]) Page (0);
-        assert (page);
+    if (num_spare_pages < min_pages) {
+        Count const num_new = min_pages - num_spare_pages;
+        first_spare_page = allocPages (num_new, first_spare_page);
 
-        page->next_pool_page = first_spare_page;
-        first_spare_page = page;
+        num_spare_pages += num_new;
+        num_pages += num_new;
+    }
+
+    depotTrim (high_watermark);
+}
 
-        ++stats.num_spare_pages;
-        ++num_pages;
+mt_unlocks (mutex) Count
+PagePool::depotTrim (Count const max_spare_pages)
+{
+    if (num_spare_pages <= max_spare_pages) {
+        updateLegacyStats ();
+        mutex.unlock ();
+        return 0;
     }
 
-    while (stats.num_spare_pages > min_pages) {
-        assert (first_spare_page && num_pages);
+    Count const num_to_free = num_spare_pages - max_spare_pages;
 
-        Page * const page = first_spare_page;
+    Page * const page_to_free = first_spare_page;
+    for (Count i = 0; i < num_to_free; ++i) {
+        assert (first_spare_page);
         first_spare_page = first_spare_page->next_pool_page;
+    }
 
-        page->~Page();
-        delete[] (Byte*) page;
+    assert (num_pages >= num_to_free);
+    num_spare_pages -= num_to_free;
+    num_pages -= num_to_free;
+    num_trimmed_pages += num_to_free;
+    updateLegacyStats ();
+    mutex.unlock ();
+
+    logD (pool, _func, "freeing ", num_to_free, " spare pages");
+    freePages (page_to_free, num_to_free);
+
+    return num_to_free;
+}
+
+Count
+PagePool::trim ()
+{
+    mutex.lock ();
+    return depotTrim (min_pages);
+}
 
-        assert (stats.num_spare_pages > 0);
-        --stats.num_spare_pages;
-        --num_pages;
+Count
+PagePool::trimTo (Count const max_spare_pages)
+{
+    mutex.lock ();
+    return depotTrim (max_spare_pages);
+}
+
+void
+PagePool::trimTimerTick (void * const _self)
+{
+    PagePool * const self = static_cast <PagePool*> (_self);
+
+    // Freeing half of the pages above the low watermark on every tick,
+    // so that the reserve shrinks gradually after a traffic spike.
+    self->mutex.lock ();
+    Count max_spare_pages = self->num_spare_pages;
+    if (max_spare_pages > self->min_pages)
+        max_spare_pages -= (max_spare_pages - self->min_pages + 1) / 2;
+
+    self->depotTrim (max_spare_pages);
+
+    self->updateStat ();
+}
+
+void
+PagePool::startTrimTimer (Timers * const mt_nonnull timers,
+                          Time     const interval_sec)
+{
+    assert (!trim_timer);
+
+    this->timers = timers;
+    trim_timer = timers->addTimer (CbDesc<Timers::TimerCallback> (trimTimerTick, this, getCoderefContainer()),
+                                   interval_sec,
+                                   true  /* periodical */,
+                                   false /* auto_delete */);
+}
+
+void
+PagePool::stopTrimTimer ()
+{
+    if (trim_timer) {
+        timers->deleteTimer (trim_timer);
+        trim_timer = NULL;
     }
+}
 
+mt_const void
+PagePool::enableStat (ConstMemory const stat_prefix)
+{
+    Stat * const stat = getStat();
+
+    stat_spare_pages = stat->createParam (catenateStrings (stat_prefix, "spare_pages")->mem(),
+                                          "Spare pages in the shared page pool depot",
+                                          Stat::ParamType_Int64, 0, 0.0);
+    stat_cached_pages = stat->createParam (catenateStrings (stat_prefix, "cached_pages")->mem(),
+                                           "Spare pages in per-thread page caches",
+                                           Stat::ParamType_Int64, 0, 0.0);
+    stat_busy_pages = stat->createParam (catenateStrings (stat_prefix, "busy_pages")->mem(),
+                                         "Pages in use",
+                                         Stat::ParamType_Int64, 0, 0.0);
+    stat_reserve_size = stat->createParam (catenateStrings (stat_prefix, "reserve_size")->mem(),
+                                           "Memory held by spare pages, bytes",
+                                           Stat::ParamType_Int64, 0, 0.0);
+
+    stat_enabled = true;
+}
+
+void
+PagePool::updateStat ()
+{
+    if (!stat_enabled)
+        return;
+
+    Statistics stats;
+    getStatistics (&stats);
+
+    Stat * const stat = getStat();
+    stat->setInt (stat_spare_pages,  (Int64) stats.num_spare_pages);
+    stat->setInt (stat_cached_pages, (Int64) stats.num_cached_pages);
+    stat->setInt (stat_busy_pages,   (Int64) stats.num_busy_pages);
+    stat->setInt (stat_reserve_size, (Int64) stats.reserve_size);
+}
+
+mt_const void
+PagePool::setThreadCacheSize (Count const cache_size,
+                              Count const batch_size)
+{
+    assert (cache_size == 0 || (batch_size > 0 && batch_size <= cache_size));
+
+    thread_cache_size  = cache_size;
+    thread_cache_batch = batch_size;
+}
+
+mt_const void
+PagePool::setArenaAllocation (Size           const arena_size,
+                              ArenaHugePages const huge_pages)
+{
+#ifndef LIBMARY_PLATFORM_WIN32
+    Size const cache_line_size = 64;
+    Size const huge_page_size = 2 * 1024 * 1024;
+
+    mutex.lock ();
+    assert (num_pages == num_spare_pages && !first_thread_cache);
+
+    // Initial spare pages are re-allocated from arenas.
+    freePages (first_spare_page, num_spare_pages);
+
+    Size const os_page_size = (huge_pages == ArenaHugePages::None ? (Size) getpagesize() : huge_page_size);
+
+    this->arena_huge_pages = huge_pages;
+    this->page_stride = (sizeof (Page) + page_size + cache_line_size - 1) / cache_line_size * cache_line_size;
+    this->arena_size = (arena_size + os_page_size - 1) / os_page_size * os_page_size;
+    if (this->arena_size < page_stride)
+        this->arena_size = (page_stride + os_page_size - 1) / os_page_size * os_page_size;
+
+    this->pages_per_arena = this->arena_size / page_stride;
+
+    first_spare_page = allocPages (num_spare_pages, NULL /* next_page */);
+
+    mutex.unlock ();
+#else
+    (void) arena_size;
+    (void) huge_pages;
+#endif
+}
+
+void
+PagePool::getStatistics (Statistics * const mt_nonnull ret_stats)
+{
+    mutex.lock ();
+
+    ret_stats->num_spare_pages   = num_spare_pages;
+    ret_stats->num_cached_pages  = 0;
+    ret_stats->num_thread_caches = 0;
+
+    // Thread cache counters are updated by their threads without locking,
+    // hence the resulting numbers are approximate.
+    PagePool_ThreadCache *cache = first_thread_cache;
+    while (cache) {
+        ret_stats->num_cached_pages += cache->num_pages;
+        ++ret_stats->num_thread_caches;
+        cache = cache->next_in_pool;
+    }
+
+    Count const num_free_pages = num_spare_pages + ret_stats->num_cached_pages;
+    ret_stats->num_busy_pages = (num_pages > num_free_pages ? num_pages - num_free_pages : 0);
+
+    ret_stats->reserve_size      = num_free_pages * page_size;
+    ret_stats->low_watermark     = min_pages;
+    ret_stats->high_watermark    = high_watermark;
+    ret_stats->num_trimmed_pages = num_trimmed_pages;
+
+    mutex.unlock ();
+
+    arena_mutex.lock ();
+    ret_stats->num_arenas = num_arenas;
+    arena_mutex.unlock ();
+}
+
+Count
+PagePool::getThreadCacheStatistics (ThreadCacheStatistics * const ret_stats,
+                                    Count                   const max_stats)
+{
+    Count num_caches = 0;
+
+    mutex.lock ();
+    PagePool_ThreadCache *cache = first_thread_cache;
+    while (cache) {
+        if (ret_stats && num_caches < max_stats) {
+            ThreadCacheStatistics * const stats = &ret_stats [num_caches];
+            stats->num_cached_pages = cache->num_pages;
+            stats->num_refills      = cache->num_refills;
+            stats->num_flushes      = cache->num_flushes;
+        }
+
+        ++num_caches;
+        cache = cache->next_in_pool;
+    }
     mutex.unlock ();
+
+    return num_caches;
+}
+
+void
+PagePool::releaseThreadCaches (LibMary_ThreadLocal * const mt_nonnull tlocal)
+{
+    PagePool_ThreadCache *cache = tlocal->page_pool_caches;
+    tlocal->page_pool_caches = NULL;
+
+    // The pool may be destroyed concurrently. ~PagePool() clears
+    // 'cache->page_pool' with 'thread_cache_mutex' held.
+    thread_cache_mutex.lock ();
+    while (cache) {
+        PagePool_ThreadCache * const next_cache = cache->next_in_thread;
+
+        // 'page_pool' is NULL if the pool has been destroyed already.
+        if (PagePool * const self = cache->page_pool) {
+            Page * const first_page = cache->first_page;
+            Page *last_page = first_page;
+            if (last_page) {
+                while (last_page->next_pool_page)
+                    last_page = last_page->next_pool_page;
+            }
+
+            self->mutex.lock ();
+
+            if (cache->prv_in_pool)
+                cache->prv_in_pool->next_in_pool = cache->next_in_pool;
+            else
+                self->first_thread_cache = cache->next_in_pool;
+
+            if (cache->next_in_pool)
+                cache->next_in_pool->prv_in_pool = cache->prv_in_pool;
+
+            self->depotPutPages (first_page, last_page, cache->num_pages);
+        }
+
+        delete cache;
+        cache = next_cache;
+    }
+    thread_cache_mutex.unlock ();
 }
 
 PagePool::PagePool (Object * const coderef_container,
@@ -415,53 +1090,77 @@ PagePool::PagePool (Object * const coderef_container,
     : DependentCodeReferenced (coderef_container),
       page_size (page_size),
       min_pages (min_pages),
+      high_watermark (min_pages),
+      thread_cache_size  (64),
+      thread_cache_batch (16),
       num_pages (min_pages),
-      first_spare_page (NULL)
+      num_spare_pages (min_pages),
+      first_spare_page (NULL),
+      first_thread_cache (NULL),
+      num_trimmed_pages (0),
+      arena_huge_pages (ArenaHugePages::None),
+      pages_per_arena (0),
+      page_stride (0),
+      arena_size (0),
+      first_partial_arena (NULL),
+      num_arenas (0),
+      timers (NULL),
+      stat_enabled (false)
 {
-    Page *prv_page = NULL;
-    for (Count i = 0; i < min_pages; ++i) {
-//	fprintf (stderr, "allocating %lu bytes #%lu\n",
-//		 (unsigned long) (sizeof (Page) + page_size), (unsigned long) i);
-
-	Page * const page =
-                new (new (std::nothrow) Byte [sizeof (Page) + page_size]) Page (0 /* TODO: Set to 1 for testing (should be 0) */);
-	assert (page);
-	if (!first_spare_page)
-	    first_spare_page = page;
-
-	if (prv_page)
-	    prv_page->next_pool_page = page;
-
-	prv_page = page;
-    }
-    if (prv_page)
-	prv_page->next_pool_page = NULL;
+    memset (&stats, 0, sizeof (stats));
 
-    stats.num_busy_pages = 0;
-    stats.num_spare_pages = min_pages;
+    first_spare_page = allocPages (min_pages, NULL /* next_page */);
+    updateLegacyStats ();
 }
 
 PagePool::~PagePool ()
 {
+    stopTrimTimer ();
+
+    thread_cache_mutex.lock ();
     mutex.lock ();
 
-    if (stats.num_busy_pages) {
-	logW_ (_func, stats.num_busy_pages, " busy pages lost");
-	// Not freeing any pages (debugging mode).
-	return;
+    Count num_cached_pages = 0;
+    {
+        PagePool_ThreadCache *cache = first_thread_cache;
+        while (cache) {
+            num_cached_pages += cache->num_pages;
+            cache = cache->next_in_pool;
+        }
     }
 
-    Page *cur_page = first_spare_page;
-    while (cur_page) {
-	Page * const next_page = cur_page->next_pool_page;
+    // Not freeing any pages if some of them are lost (debugging mode).
+    bool const pages_lost = (num_pages > num_spare_pages + num_cached_pages);
+    if (pages_lost)
+	logW_ (_func, num_pages - num_spare_pages - num_cached_pages, " busy pages lost");
+
+    // Detaching thread caches. The pool should not be in use by any thread
+    // at this point, but the threads which have used it may be exiting.
+    {
+        PagePool_ThreadCache *cache = first_thread_cache;
+        while (cache) {
+            PagePool_ThreadCache * const next_cache = cache->next_in_pool;
 
-	cur_page->~Page();
-	delete[] (Byte*) cur_page;
+            if (!pages_lost)
+                freePages (cache->first_page, cache->num_pages);
 
-	cur_page = next_page;
+            cache->first_page = NULL;
+            cache->num_pages = 0;
+            cache->page_pool = NULL;
+
+            cache = next_cache;
+        }
+        first_thread_cache = NULL;
     }
 
+    if (!pages_lost)
+        freePages (first_spare_page, num_spare_pages);
+
+    first_spare_page = NULL;
+    num_spare_pages = 0;
+
     mutex.unlock ();
+    thread_cache_mutex.unlock ();
 }
 
 void
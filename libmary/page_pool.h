@@ -26,13 +26,25 @@
 #include <libmary/atomic.h>
 #include <libmary/mutex.h>
 #include <libmary/output_stream.h>
+#include <libmary/timers.h>
+#include <libmary/stat.h>
 
 
 namespace M {
 
-// TODO Per-thread page pools. When a page is released in a given thread,
-//      it is put into page pool of that thread, which may be different
-//      from the one we took the page from.
+class LibMary_ThreadLocal;
+
+// Per-thread page magazine. Defined in page_pool.cpp.
+class PagePool_ThreadCache;
+
+// mmap'ed memory area for page allocation. Defined in page_pool.cpp.
+class PagePool_Arena;
+
+// Pages are taken from and released to per-thread caches (magazines) without
+// locking. A cache is refilled from/flushed to the shared spare page list
+// ("depot") in batches of 'thread_cache_batch' pages with 'mutex' held.
+// When a page is released in a given thread, it is put into the cache
+// of that thread, which may be different from the one we took the page from.
 
 // TODO PagePool should be referenced while there's any referenced page.
 //      This also means that PagePools should be independent objects,
@@ -56,10 +68,13 @@ public:
 	Page *next_pool_page;
 	Page *next_msg_page;
 
+        // NULL for heap-allocated pages.
+        PagePool_Arena *arena;
+
 	Page& operator = (Page const &);
 	Page (Page const &);
 
-	Page (int const refcount = 1) : refcount (refcount) {}
+	Page (int const refcount = 1) : refcount (refcount), arena (NULL) {}
 
     public:
 	Size data_len;
@@ -99,6 +114,17 @@ public:
             appendList (&pages);
         }
 
+        void appendPage (Page * const mt_nonnull page)
+        {
+            page->next_msg_page = NULL;
+            if (last)
+                last->next_msg_page = page;
+            else
+                first = page;
+
+            last = page;
+        }
+
 	bool isEmpty () const
 	{
 	    return first == NULL;
@@ -236,29 +262,159 @@ public:
 
     struct Statistics
     {
+        // Spare pages in the shared depot.
 	Count num_spare_pages;
 	Count num_busy_pages;
+        // Spare pages held in per-thread caches.
+        Count num_cached_pages;
+        Count num_thread_caches;
+        // Number of mmap'ed arenas (see setArenaAllocation()).
+        Count num_arenas;
+
+        // Memory held by spare pages (both in the depot and in thread caches).
+        Size  reserve_size;
+        Count low_watermark;
+        Count high_watermark;
+        // Total number of spare pages freed by trimming.
+        Count num_trimmed_pages;
+    };
+
+    class ArenaHugePages
+    {
+    public:
+        enum Value {
+            // Regular system pages.
+            None,
+            // Transparent huge pages via madvise (MADV_HUGEPAGE).
+            Advise,
+            // MAP_HUGETLB with a fallback to regular pages.
+            HugeTlb
+        };
+        operator Value () const { return value; }
+        ArenaHugePages (Value const value) : value (value) {}
+        ArenaHugePages () {}
+    private:
+        Value value;
+    };
+
+    struct ThreadCacheStatistics
+    {
+        Count num_cached_pages;
+        // Number of batches taken from the depot.
+        Count num_refills;
+        // Number of batches returned to the depot.
+        Count num_flushes;
     };
 
 private:
     mt_const Size const page_size;
-    mt_const Count min_pages;
 
-    Count num_pages;
+    // Low watermark: the depot is never trimmed below 'min_pages'.
+    mt_mutex (mutex) Count min_pages;
+    // High watermark: spare pages above 'high_watermark' are freed
+    // as soon as they are returned to the depot. Pages between the low and
+    // the high watermarks are freed gradually by the trim timer.
+    mt_mutex (mutex) Count high_watermark;
+
+    // Zero 'thread_cache_size' disables per-thread caches.
+    mt_const Count thread_cache_size;
+    mt_const Count thread_cache_batch;
+
+    mt_mutex (mutex) Count num_pages;
+    mt_mutex (mutex) Count num_spare_pages;
+
+    mt_mutex (mutex) Page *first_spare_page;
+
+    mt_mutex (mutex) PagePool_ThreadCache *first_thread_cache;
+
+    mt_mutex (mutex) Count num_trimmed_pages;
+
+    // Arena allocation backend. Zero 'pages_per_arena' means that pages
+    // are allocated on the heap one by one.
+    Mutex arena_mutex;
+    mt_mutex (arena_mutex) ArenaHugePages arena_huge_pages;
+    mt_const Count pages_per_arena;
+    mt_const Size  page_stride;
+    mt_const Size  arena_size;
+
+    mt_mutex (arena_mutex) PagePool_Arena *first_partial_arena;
+    mt_mutex (arena_mutex) Count num_arenas;
+
+    mt_mutex (arena_mutex) PagePool_Arena* createArena ();
+    mt_mutex (arena_mutex) void unlinkPartialArena (PagePool_Arena * mt_nonnull arena);
+
+    // Returns 'num_pages_to_alloc' new spare pages prepended to 'next_page'
+    // list (linked with 'next_pool_page').
+    Page* allocPages (Count  num_pages_to_alloc,
+                      Page  *next_page);
+
+    void freePages (Page  *first_page,
+                    Count  num_pages_to_free);
 
-    Page *first_spare_page;
+    PagePool_ThreadCache* getThreadCache ();
+    PagePool_ThreadCache* createThreadCache (LibMary_ThreadLocal * mt_nonnull tlocal);
 
-    mt_mutex (mutex) Page* grabPage ();
+    void refillThreadCache (PagePool_ThreadCache * mt_nonnull cache);
+
+    // Moves up to 'num_pages_to_take' pages from the cache to the front
+    // of '*first_page' list. Returns the number of pages taken.
+    static Count takeCachedPages (PagePool_ThreadCache  * mt_nonnull cache,
+                                  Count                  num_pages_to_take,
+                                  Page                 ** mt_nonnull first_page);
+
+    void flushThreadCache (PagePool_ThreadCache * mt_nonnull cache,
+                           Count                 num_pages_to_flush);
+
+    mt_unlocks (mutex) void depotPutPages (Page  *first_page,
+                                           Page  *last_page,
+                                           Count  num_pages_to_put);
+
+    mt_const Timers *timers;
+    mt_const Timers::TimerKey trim_timer;
+
+    mt_const bool stat_enabled;
+    mt_const Stat::ParamKey stat_spare_pages;
+    mt_const Stat::ParamKey stat_cached_pages;
+    mt_const Stat::ParamKey stat_busy_pages;
+    mt_const Stat::ParamKey stat_reserve_size;
+
+    mt_unlocks (mutex) Count depotTrim (Count max_spare_pages);
+
+    mt_mutex (mutex) void updateLegacyStats ()
+    {
+        stats.num_spare_pages = num_spare_pages;
+        stats.num_busy_pages  = num_pages - num_spare_pages;
+    }
+
+    // Protects PagePool_ThreadCache::page_pool links against concurrent
+    // pool destruction and thread exit. Locked before PagePool::mutex.
+    static Mutex thread_cache_mutex;
+
+    static void trimTimerTick (void *_self);
+
+    // Appends 'num_pages_to_grab' empty pages to 'page_list'.
+    void grabPages (PageListHead * mt_nonnull page_list,
+                    Count         num_pages_to_grab);
 
     void doGetPages (PageListHead * mt_nonnull page_list,
 		     ConstMemory const &mem,
 		     bool fill);
 
 public:
+    // Deprecated in favor of getStatistics(). Only 'num_spare_pages' and
+    // 'num_busy_pages' are maintained. They are updated whenever the shared
+    // depot changes, and pages held in per-thread caches are counted as busy.
     Statistics stats;
 
     Size getPageSize () const { return page_size; }
 
+    void getStatistics (Statistics * mt_nonnull ret_stats);
+
+    // Fills at most 'max_stats' entries of 'ret_stats' with statistics
+    // for individual thread caches. Returns the total number of thread caches.
+    Count getThreadCacheStatistics (ThreadCacheStatistics *ret_stats,
+                                    Count                  max_stats);
+
     void getFillPages (PageListHead * mt_nonnull page_list,
 		       ConstMemory const &mem);
 
@@ -284,8 +440,56 @@ public:
 	pl_outs.print (args...);
     }
 
+    // Sets both the low and the high watermarks to 'min_pages'.
     void setMinPages (Count min_pages);
 
+    void setWatermarks (Count low_watermark,
+                        Count high_watermark);
+
+    // Frees spare pages in the depot above the low watermark.
+    // Returns the number of pages freed.
+    Count trim ();
+
+    // Frees spare pages in the depot above 'max_spare_pages', possibly
+    // going below the low watermark (e.g. under memory pressure).
+    // Returns the number of pages freed.
+    Count trimTo (Count max_spare_pages);
+
+    // Periodically trims the depot towards the low watermark.
+    mt_const void startTrimTimer (Timers * mt_nonnull timers,
+                                  Time    interval_sec);
+
+    void stopTrimTimer ();
+
+    // Publishes pool statistics through Stat with parameter names
+    // prefixed with 'stat_prefix'. Parameters are updated on every trim
+    // timer tick and on explicit calls to updateStat().
+    mt_const void enableStat (ConstMemory stat_prefix);
+
+    void updateStat ();
+
+    // Should be called before the pool is used. Zero 'cache_size' disables
+    // per-thread caches.
+    mt_const void setThreadCacheSize (Count cache_size,
+                                      Count batch_size);
+
+    // Makes the pool carve pages out of mmap'ed arenas of 'arena_size' bytes.
+    // Page headers are aligned to cache lines. Arenas are unmapped when all
+    // of their pages are freed, i.e. when spare pages go past 'min_pages'.
+    // Should be called before the pool is used.
+    mt_const void setArenaAllocation (Size           arena_size,
+                                      ArenaHugePages huge_pages = ArenaHugePages::None);
+
+    // Fills the calling thread's cache with a batch of newly allocated pages
+    // and touches their memory, so that it is faulted in on the thread's
+    // NUMA node. Meant to be called once at thread startup, after the thread
+    // has been pinned to a CPU. Does nothing if thread caches are disabled.
+    void prefillThreadCache ();
+
+    // Called on thread exit: returns all pages cached by the thread
+    // to their pools.
+    static void releaseThreadCaches (LibMary_ThreadLocal * mt_nonnull tlocal);
+
     PagePool (Object *coderef_container,
               Size    page_size,
 	      Count   min_pages);
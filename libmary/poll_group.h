@@ -145,7 +145,13 @@ namespace M {
   #if defined (LIBMARY_USE_SELECT)
     class SelectPollGroup;
     typedef SelectPollGroup DefaultPollGroup;
-  #elif defined (LIBMARY_USE_POLL) || !defined (LIBMARY_ENABLE_EPOLL)
+  #elif defined (LIBMARY_USE_POLL)
+    class PollPollGroup;
+    typedef PollPollGroup DefaultPollGroup;
+  #elif defined (LIBMARY_ENABLE_IO_URING)
+    class IoUringPollGroup;
+    typedef IoUringPollGroup DefaultPollGroup;
+  #elif !defined (LIBMARY_ENABLE_EPOLL)
     class PollPollGroup;
     typedef PollPollGroup DefaultPollGroup;
   #else
@@ -165,7 +165,8 @@ PollPollGroup::poll (Uint64 const timeout_microsec)
 	selected_list.clear ();
 
 	Count cur_num_pollables = 1;
-	struct pollfd pollfds [num_pollables];
+	// +1 for the trigger pipe.
+	struct pollfd pollfds [num_pollables + 1];
 
 	pollfds [0].fd = trigger_pipe [0];
 	pollfds [0].events = POLLIN;
@@ -346,8 +347,8 @@ PollPollGroup::poll (Uint64 const timeout_microsec)
 	}
 
         if (trigger_pipe_ready) {
-            if (!commonTriggerPipeRead (trigger_pipe [0])) {
-                logF_ (_func, "commonTriggerPipeRead() failed: ", exc->toString());
+            if (!posix_triggerPipeRead (trigger_pipe [0])) {
+                logF_ (_func, "posix_triggerPipeRead() failed: ", exc->toString());
                 return Result::Failure;
             }
             break;
@@ -380,18 +381,21 @@ mt_unlocks (mutex) mt_throws Result
 PollPollGroup::doTrigger ()
 {
     if (triggered) {
+        ++num_triggers_suppressed;
 	mutex.unlock ();
 	return Result::Success;
     }
     triggered = true;
 
     if (block_trigger_pipe) {
+        ++num_triggers_suppressed;
         mutex.unlock ();
         return Result::Success;
     }
+    ++num_triggers_issued;
     mutex.unlock ();
 
-    return commonTriggerPipeWrite (trigger_pipe [1]);
+    return posix_triggerPipeWrite (trigger_pipe [1]);
 }
 
 mt_throws Result
@@ -400,6 +404,7 @@ PollPollGroup::trigger ()
     if (poll_tlocal && poll_tlocal == libMary_getThreadLocal()) {
 	mutex.lock ();
 	triggered = true;
+        ++num_triggers_suppressed;
 	mutex.unlock ();
 	return Result::Success;
     }
@@ -408,10 +413,28 @@ PollPollGroup::trigger ()
     return mt_unlocks (mutex) doTrigger ();
 }
 
+void
+PollPollGroup::getTriggerStatistics (TriggerStatistics * const mt_nonnull ret_stats)
+{
+    mutex.lock ();
+    ret_stats->num_triggers_issued = num_triggers_issued;
+    ret_stats->num_triggers_suppressed = num_triggers_suppressed;
+    mutex.unlock ();
+}
+
+Count
+PollPollGroup::getNumPollables ()
+{
+    mutex.lock ();
+    Count const res = num_pollables;
+    mutex.unlock ();
+    return res;
+}
+
 mt_throws Result
 PollPollGroup::open ()
 {
-    if (!posix_createNonblockingPipe (&trigger_pipe))
+    if (!posix_createTriggerPipe (&trigger_pipe))
 	return Result::Failure;
 
     return Result::Success;
@@ -423,6 +446,8 @@ PollPollGroup::PollPollGroup (Object * const coderef_container)
       num_pollables (0),
       triggered (false),
       block_trigger_pipe (true),
+      num_triggers_issued (0),
+      num_triggers_suppressed (0),
       // Initializing to 'true' to process deferred tasks scheduled before we
       // enter poll() for the first time.
       got_deferred_tasks (true)
@@ -453,24 +478,7 @@ PollPollGroup::~PollPollGroup ()
     }
     mutex.unlock ();
 
-    for (int i = 0; i < 2; ++i) {
-	if (trigger_pipe [i] != -1) {
-	    for (;;) {
-		int const res = close (trigger_pipe [i]);
-		if (res == -1) {
-		    if (errno == EINTR)
-			continue;
-
-		    logE_ (_func, "trigger_pipe[", i, "]: close() failed: ", errnoString (errno));
-		} else
-		if (res != 0) {
-		    logE_ (_func, "trigger_pipe[", i, "]: close(): unexpected return value: ", res);
-		}
-
-		break;
-	    }
-	}
-    }
+    posix_closeTriggerPipe (&trigger_pipe);
 }
 
 }
@@ -71,6 +71,9 @@ private:
     mt_mutex (mutex) bool triggered;
     mt_mutex (mutex) bool block_trigger_pipe;
 
+    mt_mutex (mutex) Uint64 num_triggers_issued;
+    mt_mutex (mutex) Uint64 num_triggers_suppressed;
+
     mt_sync_domain (poll) bool got_deferred_tasks;
 
   mt_iface (PollGroup::Feedback)
@@ -113,6 +116,10 @@ public:
     mt_throws Result poll (Uint64 timeout_microsec = (Uint64) -1);
 
     mt_throws Result trigger ();
+
+    void getTriggerStatistics (TriggerStatistics * mt_nonnull ret_stats);
+
+    Count getNumPollables ();
   mt_end
 
     mt_throws Result open ();
@@ -25,6 +25,7 @@
 #include <libmary/code_referenced.h>
 #include <libmary/cb.h>
 #include <libmary/exception.h>
+#include <libmary/page_pool.h>
 
 
 namespace M {
@@ -68,6 +69,18 @@ public:
 
 	void (*processError) (Exception *exc_,
 			      void      *cb_data);
+
+        // Called instead of processInput() in page receive mode
+        // (see ConnectionReceiver::setPageReceiveMode()). Received data
+        // is 'msg_len' bytes starting at 'msg_offset' in 'first_page'.
+        // Pages belong to the receiver; the frontend may keep any of them
+        // by reference with PagePool::pageRef() or msgRef().
+        // May be NULL, in which case input is passed to processInput().
+        ProcessInputResult (*processInputPages) (PagePool::Page *first_page,
+                                                 Size            msg_offset,
+                                                 Size            msg_len,
+                                                 Size           *ret_accepted,
+                                                 void           *cb_data);
     };
 
 protected:
@@ -127,6 +127,8 @@ SelectPollGroup::addPollable (CbDesc<Pollable> const &pollable,
     else
 	inactive_pollable_list.append (pollable_entry);
 
+    ++num_pollables;
+
     if (activate
 	&& !(poll_tlocal && poll_tlocal == libMary_getThreadLocal()))
     {
@@ -172,6 +174,7 @@ SelectPollGroup::removePollable (PollableKey const mt_nonnull key)
 	inactive_pollable_list.remove (pollable_entry);
     }
     pollable_entry->unref ();
+    --num_pollables;
     mutex.unlock ();
 }
 
@@ -413,8 +416,8 @@ SelectPollGroup::poll (Uint64 const timeout_microsec)
 	}
 
         if (FD_ISSET (trigger_pipe [0], &rfds)) {
-            if (!commonTriggerPipeRead (trigger_pipe [0])) {
-                logF_ (_func, "commonTriggerPipeRead() failed: ", exc->toString());
+            if (!posix_triggerPipeRead (trigger_pipe [0])) {
+                logF_ (_func, "posix_triggerPipeRead() failed: ", exc->toString());
                 return Result::Failure;
             }
             break;
@@ -447,18 +450,21 @@ mt_unlocks (mutex) mt_throws Result
 SelectPollGroup::doTrigger ()
 {
     if (triggered) {
+        ++num_triggers_suppressed;
 	mutex.unlock ();
 	return Result::Success;
     }
     triggered = true;
 
     if (block_trigger_pipe) {
+        ++num_triggers_suppressed;
         mutex.unlock ();
         return Result::Success;
     }
+    ++num_triggers_issued;
     mutex.unlock ();
 
-    return commonTriggerPipeWrite (trigger_pipe [1]);
+    return posix_triggerPipeWrite (trigger_pipe [1]);
 }
 
 mt_throws Result
@@ -469,6 +475,7 @@ SelectPollGroup::trigger ()
     if (poll_tlocal && poll_tlocal == libMary_getThreadLocal()) {
 	mutex.lock ();
 	triggered = true;
+        ++num_triggers_suppressed;
 	mutex.unlock ();
 	return Result::Success;
     }
@@ -477,12 +484,30 @@ SelectPollGroup::trigger ()
     return mt_unlocks (mutex) doTrigger ();
 }
 
+void
+SelectPollGroup::getTriggerStatistics (TriggerStatistics * const mt_nonnull ret_stats)
+{
+    mutex.lock ();
+    ret_stats->num_triggers_issued = num_triggers_issued;
+    ret_stats->num_triggers_suppressed = num_triggers_suppressed;
+    mutex.unlock ();
+}
+
+Count
+SelectPollGroup::getNumPollables ()
+{
+    mutex.lock ();
+    Count const res = num_pollables;
+    mutex.unlock ();
+    return res;
+}
+
 mt_throws Result
 SelectPollGroup::open ()
 {
     logD (select, _func_);
 
-    if (!posix_createNonblockingPipe (&trigger_pipe))
+    if (!posix_createTriggerPipe (&trigger_pipe))
 	return Result::Failure;
 
     return Result::Success;
@@ -493,6 +518,9 @@ SelectPollGroup::SelectPollGroup (Object * const coderef_container)
       poll_tlocal (NULL),
       triggered (false),
       block_trigger_pipe (true),
+      num_triggers_issued (0),
+      num_triggers_suppressed (0),
+      num_pollables (0),
       // Initializing to 'true' to process deferred tasks scheduled before we
       // enter poll() for the first time.
       got_deferred_tasks (true)
@@ -525,24 +553,7 @@ SelectPollGroup::~SelectPollGroup ()
     }
     mutex.unlock ();
 
-    for (int i = 0; i < 2; ++i) {
-	if (trigger_pipe [i] != -1) {
-	    for (;;) {
-		int const res = close (trigger_pipe [i]);
-		if (res == -1) {
-		    if (errno == EINTR)
-			continue;
-
-		    logE_ (_func, "trigger_pipe[", i, "]: close() failed: ", errnoString (errno));
-		} else
-		if (res != 0) {
-		    logE_ (_func, "trigger_pipe[", i, "]: close(): unexpected return value: ", res);
-		}
-
-		break;
-	    }
-	}
-    }
+    posix_closeTriggerPipe (&trigger_pipe);
 }
 
 }
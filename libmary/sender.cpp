@@ -17,7 +17,15 @@
 */
 
 
+#include <libmary/types.h>
+#include <string.h>
+#ifndef LIBMARY_PLATFORM_WIN32
+#include <errno.h>
+#include <unistd.h>
+#endif
+
 #include <libmary/log.h>
+#include <libmary/util_str.h>
 
 #include <libmary/sender.h>
 
@@ -62,23 +70,91 @@ Sender::MessageEntry_Pages::createNew (Size const max_header_len)
 #endif
 }
 
+void
+Sender::BroadcastMessage::unref (Count const num_refs)
+{
+    if (refcount.fetchAdd (-(int) num_refs) != (int) num_refs)
+        return;
+
+    page_pool->msgUnref (first_page);
+
+    this->~BroadcastMessage ();
+    delete[] (Byte*) this;
+}
+
+Sender::MessageEntry_Pages*
+Sender::BroadcastMessage::createEntry (ConstMemory const header)
+{
+    assert (!released);
+    assert (header.len() <= max_header_len);
+
+    if (num_entries >= max_entries)
+        return NULL;
+
+    MessageEntry_Pages * const msg_pages = new (getEntryBuf (num_entries)) MessageEntry_Pages;
+    ++num_entries;
+
+    msg_pages->header_len = header.len();
+    if (header.len())
+        memcpy (msg_pages->getHeaderData(), header.mem(), header.len());
+
+    msg_pages->setFirstPage (first_page);
+    msg_pages->msg_offset = msg_offset;
 #ifdef LIBMARY_SENDER_VSLAB
+    msg_pages->vslab_key = NULL;
+#endif
+    msg_pages->broadcast = this;
+
+    return msg_pages;
+}
+
 void
-Sender::deleteMessageEntry (MessageEntry * const mt_nonnull msg_entry)
+Sender::BroadcastMessage::release ()
 {
-    MessageEntry_Pages * const msg_pages = static_cast <MessageEntry_Pages*> (msg_entry);
+    assert (!released);
+    released = true;
 
-    msg_pages->page_pool->msgUnref (msg_pages->first_page);
-    if (msg_pages->vslab_key) {
-  #ifdef LIBMARY_MT_SAFE
-      MutexLock msg_vslab_l (&msg_vslab_mutex);
-  #endif
-        msg_vslab.free (msg_pages->vslab_key);
-    } else {
-        delete[] (Byte*) msg_pages;
-    }
+    // Dropping the references held for the entries which have not been taken.
+    unref (max_entries - num_entries + 1);
 }
-#else
+
+Sender::BroadcastMessage*
+Sender::BroadcastMessage::createNew (PagePool       * const mt_nonnull page_pool,
+                                     PagePool::Page * const first_page,
+                                     Size             const msg_offset,
+                                     Count            const max_entries,
+                                     Size             const max_header_len)
+{
+    Size const entry_size = (sizeof (MessageEntry_Pages) + max_header_len + 15) & ~(Size) 15;
+
+    Byte * const buf = new (std::nothrow) Byte [getBaseSize() + max_entries * entry_size];
+    assert (buf);
+
+    BroadcastMessage * const broadcast_msg = new (buf) BroadcastMessage;
+    broadcast_msg->refcount.set ((int) max_entries + 1);
+    broadcast_msg->page_pool = page_pool;
+    broadcast_msg->first_page = first_page;
+    broadcast_msg->msg_offset = msg_offset;
+    broadcast_msg->pages_data_len = PagePool::countPageListDataLen (first_page, msg_offset);
+    broadcast_msg->max_header_len = max_header_len;
+    broadcast_msg->max_entries = max_entries;
+    broadcast_msg->entry_size = entry_size;
+    broadcast_msg->num_entries = 0;
+    broadcast_msg->released = false;
+
+    return broadcast_msg;
+}
+
+#ifndef LIBMARY_PLATFORM_WIN32
+Sender::MessageEntry_File*
+Sender::MessageEntry_File::createNew ()
+{
+    MessageEntry_File * const msg_file = new (std::nothrow) MessageEntry_File;
+    assert (msg_file);
+    return msg_file;
+}
+#endif
+
 void
 Sender::deleteMessageEntry (MessageEntry * const mt_nonnull msg_entry)
 {
@@ -87,14 +163,42 @@ Sender::deleteMessageEntry (MessageEntry * const mt_nonnull msg_entry)
     switch (msg_entry->type) {
 	case MessageEntry::Pages: {
 	    MessageEntry_Pages * const msg_pages = static_cast <MessageEntry_Pages*> (msg_entry);
+            if (msg_pages->broadcast) {
+              // The entry lives in the broadcast message's buffer.
+                BroadcastMessage * const broadcast_msg = msg_pages->broadcast;
+                msg_pages->~MessageEntry_Pages ();
+                broadcast_msg->unref ();
+                break;
+            }
+
 	    msg_pages->page_pool->msgUnref (msg_pages->first_page);
+#ifdef LIBMARY_SENDER_VSLAB
+            if (msg_pages->vslab_key) {
+  #ifdef LIBMARY_MT_SAFE
+                MutexLock msg_vslab_l (&msg_vslab_mutex);
+  #endif
+                msg_vslab.free (msg_pages->vslab_key);
+            } else {
+                delete[] (Byte*) msg_pages;
+            }
+#else
 	    delete[] (Byte*) msg_pages;
+#endif
 	} break;
+#ifndef LIBMARY_PLATFORM_WIN32
+        case MessageEntry::File: {
+            MessageEntry_File * const msg_file = static_cast <MessageEntry_File*> (msg_entry);
+            if (msg_file->close_fd) {
+                if (::close (msg_file->fd) == -1)
+                    logE_ (_func, "close() failed: ", errnoString (errno));
+            }
+            delete msg_file;
+        } break;
+#endif
 	default:
 	    unreachable ();
     }
 }
-#endif
 
 namespace {
     struct InformClosed_Data
@@ -85,7 +85,8 @@ public:
     {
     public:
 	enum Type {
-	    Pages
+	    Pages,
+	    File
 	};
 
 	Type const type;
@@ -98,25 +99,30 @@ public:
 
     static void deleteMessageEntry (MessageEntry * mt_nonnull msg_entry);
 
+    class BroadcastMessage;
+
     class MessageEntry_Pages : public MessageEntry
     {
 	friend void Sender::deleteMessageEntry (MessageEntry * mt_nonnull msg_entry);
+	friend class BroadcastMessage;
 #ifdef LIBMARY_SENDER_VSLAB
 	friend class VSlab<MessageEntry_Pages>;
 #endif
 
     private:
         MessageEntry_Pages ()
-            : MessageEntry (MessageEntry::Pages)
+            : MessageEntry (MessageEntry::Pages),
 #ifdef LIBMARY_WIN32_IOCP
-              , first_pending_page (NULL)
+              first_pending_page (NULL),
 #endif
+              broadcast (NULL)
         {}
 
 	~MessageEntry_Pages () {}
 
     public:
 	Size header_len;
+	// NULL for broadcast message entries, see getPagePool().
 	CodeDepRef<PagePool> page_pool;
 
     private:
@@ -145,6 +151,13 @@ public:
 	VSlab<MessageEntry_Pages>::AllocKey vslab_key;
 #endif
 
+        // Non-NULL if the entry belongs to a broadcast message. Pages of such
+        // entries are owned by the broadcast message and are not unrefed
+        // by the sender as they are sent.
+        BroadcastMessage *broadcast;
+
+        PagePool* getPagePool () const;
+
 	Byte* getHeaderData () const
 	    { return (Byte*) this + sizeof (*this); }
 
@@ -157,6 +170,99 @@ public:
 	static MessageEntry_Pages* createNew (Size max_header_len = 0);
     };
 
+    // A message sent to many senders. The page chain is referenced once for
+    // all recipients, and message entries are preallocated together with
+    // the message, so that queueing it to a sender takes neither page
+    // refcounting nor locking of shared allocators. Every recipient may get
+    // a small header of its own (e.g. with a per-connection stream id).
+    //
+    // Usage: createNew(), createEntry() + sendMessage() for every recipient,
+    // then release(). Entries should be created by one thread at a time.
+    class BroadcastMessage
+    {
+	friend void Sender::deleteMessageEntry (MessageEntry * mt_nonnull msg_entry);
+	friend class MessageEntry_Pages;
+
+    private:
+        // Holds a reference for every entry, including the ones not taken yet,
+        // plus the reference of the creator.
+        AtomicInt refcount;
+
+        mt_const CodeDepRef<PagePool> page_pool;
+        mt_const PagePool::Page *first_page;
+        mt_const Size msg_offset;
+        // Length of page data, without per-recipient headers.
+        mt_const Size pages_data_len;
+
+        mt_const Size max_header_len;
+        mt_const Count max_entries;
+        mt_const Size entry_size;
+
+        Count num_entries;
+        bool released;
+
+        Byte* getEntryBuf (Count const idx)
+            { return (Byte*) this + getBaseSize() + idx * entry_size; }
+
+        static Size getBaseSize ()
+            { return (sizeof (BroadcastMessage) + 15) & ~(Size) 15; }
+
+        void unref (Count num_refs = 1);
+
+        BroadcastMessage () {}
+        ~BroadcastMessage () {}
+
+    public:
+        // Returns a message entry for one more recipient with 'header'
+        // (at most 'max_header_len' bytes) in front of the page data, or NULL
+        // if all 'max_entries' entries have been taken. The entry should be
+        // passed to Sender::sendMessage().
+        MessageEntry_Pages* createEntry (ConstMemory header = ConstMemory());
+
+        Count getNumEntries () const { return num_entries; }
+
+        Size getPagesDataLen () const { return pages_data_len; }
+
+        // Drops the creator's reference. The message is deleted when all
+        // of its entries have been sent or dropped by the senders.
+        // No entries may be created after release().
+        void release ();
+
+        // Takes ownership of the page chain starting at 'first_page'
+        // (one reference to each page, as sendPages() does).
+        static BroadcastMessage* createNew (PagePool       * mt_nonnull page_pool,
+                                            PagePool::Page *first_page,
+                                            Size            msg_offset,
+                                            Count           max_entries,
+                                            Size            max_header_len = 0);
+    };
+
+#ifndef LIBMARY_PLATFORM_WIN32
+    // 'len' bytes of file 'fd' starting at 'offset', sent with sendfile()
+    // without copying file data to userspace.
+    class MessageEntry_File : public MessageEntry
+    {
+	friend void Sender::deleteMessageEntry (MessageEntry * mt_nonnull msg_entry);
+
+    private:
+        MessageEntry_File ()
+            : MessageEntry (MessageEntry::File)
+        {}
+
+        ~MessageEntry_File () {}
+
+    public:
+        int fd;
+        // If 'true', then 'fd' is closed when the message is released.
+        bool close_fd;
+
+        FileOffset offset;
+        FileSize len;
+
+        static MessageEntry_File* createNew ();
+    };
+#endif
+
 #ifdef LIBMARY_SENDER_VSLAB
     typedef VSlab<MessageEntry_Pages> MsgVSlab;
     static MsgVSlab msg_vslab;
@@ -272,6 +378,38 @@ public:
         sendMessage (msg_pages, do_flush);
     }
 
+    // Queues an entry of 'broadcast_msg' with per-recipient 'header'.
+    // Returns false if the message has no spare entries left.
+    bool sendBroadcast (BroadcastMessage * const mt_nonnull broadcast_msg,
+                        ConstMemory        const header,
+                        bool               const do_flush)
+    {
+        MessageEntry_Pages * const msg_pages = broadcast_msg->createEntry (header);
+        if (!msg_pages)
+            return false;
+
+        sendMessage (msg_pages, do_flush);
+        return true;
+    }
+
+#ifndef LIBMARY_PLATFORM_WIN32
+    // If 'close_fd' is true, then the sender takes ownership of 'fd'.
+    void sendFile (int        const fd,
+                   FileOffset const offset,
+                   FileSize   const len,
+                   bool       const close_fd,
+                   bool       const do_flush)
+    {
+        MessageEntry_File * const msg_file = MessageEntry_File::createNew ();
+        msg_file->fd = fd;
+        msg_file->close_fd = close_fd;
+        msg_file->offset = offset;
+        msg_file->len = len;
+
+        sendMessage (msg_file, do_flush);
+    }
+#endif
+
     mt_const void setFrontend (CbDesc<Frontend> const &frontend)
         { this->frontend = frontend; }
 
@@ -280,6 +418,15 @@ public:
     {}
 };
 
+inline PagePool*
+Sender::MessageEntry_Pages::getPagePool () const
+{
+    if (broadcast)
+        return broadcast->page_pool;
+
+    return page_pool;
+}
+
 }
 
 
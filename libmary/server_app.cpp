@@ -22,6 +22,7 @@
 
 #include <libmary/deferred_connection_sender.h>
 #include <libmary/util_time.h>
+#include <libmary/util_posix.h>
 #include <libmary/log.h>
 
 #include <libmary/server_app.h>
@@ -35,35 +36,126 @@ LogGroup libMary_logGroup_server_app ("server_app", LogLevel::I);
 
 ActivePollGroup::Frontend ServerApp::poll_frontend = {
     pollIterationBegin,
-    pollIterationEnd
+    pollIterationEnd,
+    NULL /* pollIterationStats */
 };
 
 CodeDepRef<ServerThreadContext>
 ServerApp::SA_ServerContext::selectThreadContext ()
 {
 #ifdef LIBMARY_MT_SAFE
-    ServerThreadContext *thread_ctx;
-
   StateMutexLock l (&server_app->mutex);
 
-    if (server_app->thread_selector) {
-	thread_ctx = &server_app->thread_selector->data->thread_ctx;
-	server_app->thread_selector = server_app->thread_selector->next;
-    } else {
-	if (!server_app->thread_data_list.isEmpty()) {
-	    thread_ctx = &server_app->thread_data_list.getFirst()->thread_ctx;
-	    server_app->thread_selector = server_app->thread_data_list.getFirstElement()->next;
-	} else {
-	    thread_ctx = &server_app->main_thread_ctx;
-	}
+    if (server_app->thread_data_list.isEmpty())
+        return &server_app->main_thread_ctx;
+
+    ThreadData *thread_data;
+    switch (server_app->thread_selection_policy) {
+        case ThreadSelection_LeastConnections:
+        case ThreadSelection_LeastPendingBytes:
+            thread_data = server_app->selectLeastLoadedThread ();
+            break;
+        case ThreadSelection_PowerOfTwoChoices:
+            thread_data = server_app->selectPowerOfTwoChoices ();
+            break;
+        default:
+            thread_data = server_app->selectNextThread ();
     }
 
-    return thread_ctx;
+    return &thread_data->thread_ctx;
 #else
     return &server_app->main_thread_ctx;
 #endif // LIBMARY_MT_SAFE
 }
 
+#ifdef LIBMARY_MT_SAFE
+mt_mutex (mutex) ServerApp::ThreadData*
+ServerApp::selectNextThread ()
+{
+    if (!thread_selector)
+        thread_selector = thread_data_list.getFirstElement();
+
+    ThreadData * const thread_data = thread_selector->data;
+    thread_selector = thread_selector->next;
+    return thread_data;
+}
+
+mt_mutex (mutex) ServerApp::ThreadData*
+ServerApp::selectLeastLoadedThread ()
+{
+    // Starting from the round-robin position, so that the threads with equal
+    // load are selected in turn.
+    if (!thread_selector)
+        thread_selector = thread_data_list.getFirstElement();
+
+    ThreadDataList::Element * const first_el = thread_selector;
+    ThreadDataList::Element *el = first_el;
+
+    ThreadData *best_thread = NULL;
+    Uint64 best_load = 0;
+    do {
+        ThreadData * const thread_data = el->data;
+
+        Uint64 load;
+        if (thread_selection_policy == ThreadSelection_LeastPendingBytes)
+            load = thread_data->dcs_queue.getPendingBytes();
+        else
+            load = thread_data->poll_group.getNumPollables();
+
+        if (!best_thread || load < best_load) {
+            best_thread = thread_data;
+            best_load = load;
+        }
+
+        el = el->next;
+        if (!el)
+            el = thread_data_list.getFirstElement();
+    } while (el != first_el);
+
+    thread_selector = first_el->next;
+    return best_thread;
+}
+
+mt_mutex (mutex) ServerApp::ThreadData*
+ServerApp::selectPowerOfTwoChoices ()
+{
+    Count const num_threads = thread_data_list.getNumElements();
+    if (num_threads == 1)
+        return thread_data_list.getFirst();
+
+    // xorshift32
+    selection_rand ^= selection_rand << 13;
+    selection_rand ^= selection_rand >> 17;
+    selection_rand ^= selection_rand << 5;
+
+    Count const idx_a = selection_rand % num_threads;
+    // 'idx_b' is always different from 'idx_a'.
+    Count const idx_b = (idx_a + 1 + (selection_rand >> 16) % (num_threads - 1)) % num_threads;
+
+    ThreadData *thread_a = NULL;
+    ThreadData *thread_b = NULL;
+    {
+        Count i = 0;
+        ThreadDataList::iter iter (thread_data_list);
+        while (!thread_data_list.iter_done (iter)) {
+            ThreadData * const thread_data = thread_data_list.iter_next (iter)->data;
+            if (i == idx_a)
+                thread_a = thread_data;
+            if (i == idx_b)
+                thread_b = thread_data;
+
+            ++i;
+        }
+    }
+    assert (thread_a && thread_b);
+
+    if (thread_b->poll_group.getNumPollables() < thread_a->poll_group.getNumPollables())
+        return thread_b;
+
+    return thread_a;
+}
+#endif // LIBMARY_MT_SAFE
+
 CodeDepRef<ServerThreadContext>
 ServerApp::SA_ServerContext::getMainThreadContext ()
 {
@@ -73,16 +165,21 @@ ServerApp::SA_ServerContext::getMainThreadContext ()
 void
 ServerApp::informThreadStarted (Events * const events,
                                 void   * const cb_data,
-                                void   * const /* inform_data */)
+                                void   * const _thread_ctx)
 {
+    ServerThreadContext * const thread_ctx = static_cast <ServerThreadContext*> (_thread_ctx);
+
     if (events->threadStarted)
         events->threadStarted (cb_data);
+
+    if (events->threadContextStarted)
+        events->threadContextStarted (thread_ctx, cb_data);
 }
 
 void
-ServerApp::fireThreadStarted ()
+ServerApp::fireThreadStarted (ServerThreadContext * const mt_nonnull thread_ctx)
 {
-    event_informer.informAll (informThreadStarted, NULL /* inform_cb_data */);
+    event_informer.informAll (informThreadStarted, thread_ctx /* inform_cb_data */);
 }
 
 void
@@ -111,6 +208,46 @@ ServerApp::pollIterationEnd (void * const _thread_ctx)
     return thread_ctx->getDeferredProcessor()->process ();
 }
 
+void
+ServerApp::reportThreadPlacement (Count const thread_no)
+{
+#ifndef LIBMARY_PLATFORM_WIN32
+    Count cpu = 0;
+    Count numa_node = 0;
+    if (!posix_getThreadCpu (&cpu, &numa_node))
+        return;
+
+    logI (server_app, _func, "thread ", thread_no, ": cpu ", cpu, ", numa node ", numa_node);
+
+    if (stat_enabled) {
+        Stat * const stat = getStat();
+        Ref<String> const thread_prefix =
+                catenateStrings (stat_prefix->mem(), makeString ("thread", thread_no, "_")->mem());
+
+        Stat::ParamKey const cpu_param =
+                stat->createParam (catenateStrings (thread_prefix->mem(), "cpu")->mem(),
+                                   "CPU the thread runs on",
+                                   Stat::ParamType_Int64, 0, 0.0);
+        Stat::ParamKey const numa_node_param =
+                stat->createParam (catenateStrings (thread_prefix->mem(), "numa_node")->mem(),
+                                   "NUMA node of the thread's CPU",
+                                   Stat::ParamType_Int64, 0, 0.0);
+
+        stat->setInt (cpu_param,       (Int64) cpu);
+        stat->setInt (numa_node_param, (Int64) numa_node);
+    }
+#else
+    (void) thread_no;
+#endif
+}
+
+mt_const void
+ServerApp::enableStat (ConstMemory const stat_prefix)
+{
+    this->stat_prefix = grab (new (std::nothrow) String (stat_prefix));
+    stat_enabled = true;
+}
+
 static void deferred_processor_trigger (void * const _active_poll_group)
 {
     ActivePollGroup * const active_poll_group = static_cast <ActivePollGroup*> (_active_poll_group);
@@ -127,6 +264,7 @@ ServerApp::init ()
     if (!poll_group.open ())
 	return Result::Failure;
 
+    dcs_queue.setBatchedFlush (batched_flush);
     dcs_queue.setDeferredProcessor (&deferred_processor);
 
     main_thread_ctx.init (&timers,
@@ -156,8 +294,15 @@ ServerApp::threadFunc (void * const _self)
 {
     ServerApp * const self = static_cast <ServerApp*> (_self);
 
+    // The thread has already been pinned to its CPU by MultiThread,
+    // hence per-thread state allocated here is local to the thread's NUMA node.
     Ref<ThreadData> const thread_data = grab (new ThreadData);
+    if (self->thread_page_pool)
+        self->thread_page_pool->prefillThreadCache ();
 
+    Count thread_no;
+
+    thread_data->dcs_queue.setBatchedFlush (self->batched_flush);
     thread_data->dcs_queue.setDeferredProcessor (&thread_data->deferred_processor);
 
     thread_data->thread_ctx.init (&thread_data->timers,
@@ -191,9 +336,12 @@ ServerApp::threadFunc (void * const _self)
     }
 
     self->thread_data_list.append (thread_data);
+    thread_no = ++self->num_started_threads;
     self->mutex.unlock ();
 
-    self->fireThreadStarted ();
+    self->reportThreadPlacement (thread_no);
+
+    self->fireThreadStarted (&thread_data->thread_ctx);
 
     for (;;) {
 	if (!thread_data->poll_group.poll (thread_data->timers.getSleepTime_microseconds())) {
@@ -217,6 +365,8 @@ ServerApp::run ()
 {
     poll_group.bindToThread (libMary_getThreadLocal());
 
+    reportThreadPlacement (0 /* thread_no */);
+
 #ifdef LIBMARY_MT_SAFE
     if (!multi_thread->spawn (true /* joinable */)) {
 	logE_ (_func, "multi_thread->spawn() failed: ", exc->toString());
@@ -252,6 +402,11 @@ ServerApp::stop ()
 {
     should_stop.set (1);
 
+    // stop() may be called from another thread while the main thread is idle,
+    // e.g. when connections are accepted by per-thread SO_REUSEPORT sockets.
+    if (!poll_group.trigger ())
+        logE_ (_func, "poll_group.trigger() failed: ", exc->toString());
+
 #ifdef LIBMARY_MT_SAFE
     mutex.lock ();
 
@@ -298,8 +453,14 @@ ServerApp::ServerApp (Object * const coderef_container,
       deferred_processor (coderef_container),
       dcs_queue          (coderef_container)
 #ifdef LIBMARY_MT_SAFE
-      , thread_selector (NULL)
+      , thread_selector (NULL),
+      thread_selection_policy (ThreadSelection_RoundRobin),
+      selection_rand (0x2545f491),
+      thread_page_pool (coderef_container),
+      num_started_threads (0)
 #endif
+      , batched_flush (false),
+      stat_enabled (false)
 {
 #ifdef LIBMARY_MT_SAFE
     multi_thread = grab (new MultiThread (
@@ -28,6 +28,8 @@
 #include <libmary/active_poll_group.h>
 #include <libmary/deferred_processor.h>
 #include <libmary/deferred_connection_sender.h>
+#include <libmary/page_pool.h>
+#include <libmary/stat.h>
 #include <libmary/server_context.h>
 
 #ifdef LIBMARY_MT_SAFE
@@ -46,6 +48,28 @@ public:
     struct Events
     {
         void (*threadStarted) (void *cb_data);
+
+        // Called in every new thread along with threadStarted, gives access
+        // to the thread's context. Optional, may be NULL.
+        void (*threadContextStarted) (ServerThreadContext * mt_nonnull thread_ctx,
+                                      void *cb_data);
+    };
+
+    // Policies for ServerContext::selectThreadContext().
+    enum ThreadSelectionPolicy
+    {
+        // Threads are selected in turn. This is the default.
+        ThreadSelection_RoundRobin = 0,
+        // The thread with the least number of connections (pollables
+        // in the thread's poll group) is selected.
+        ThreadSelection_LeastConnections,
+        // The thread with the least number of bytes waiting to be sent
+        // by its DeferredConnectionSenderQueue is selected.
+        ThreadSelection_LeastPendingBytes,
+        // Two random threads are compared by the number of connections,
+        // and the less loaded one is selected. This avoids sending all new
+        // connections to the same thread when the counters lag behind.
+        ThreadSelection_PowerOfTwoChoices
     };
 
 private:
@@ -108,15 +132,38 @@ private:
     typedef List< Ref<ThreadData> > ThreadDataList;
     mt_mutex (mutex) ThreadDataList thread_data_list;
     mt_mutex (mutex) ThreadDataList::Element *thread_selector;
+
+    mt_const ThreadSelectionPolicy thread_selection_policy;
+    // State of the pseudo-random generator for ThreadSelection_PowerOfTwoChoices.
+    mt_mutex (mutex) Uint32 selection_rand;
+
+    mt_mutex (mutex) ThreadData* selectNextThread ();
+
+    mt_mutex (mutex) ThreadData* selectLeastLoadedThread ();
+
+    mt_mutex (mutex) ThreadData* selectPowerOfTwoChoices ();
+
+    mt_const DataDepRef<PagePool> thread_page_pool;
+    // Number of worker threads which have started, used for thread numbering.
+    mt_mutex (mutex) Count num_started_threads;
 #endif
 
+    mt_const bool batched_flush;
+
+    mt_const bool stat_enabled;
+    mt_const Ref<String> stat_prefix;
+
+    // Logs the CPU and the NUMA node of the calling thread and publishes them
+    // via Stat. Thread number 0 is the main thread.
+    void reportThreadPlacement (Count thread_no);
+
     AtomicInt should_stop;
 
     static void informThreadStarted (Events *events,
                                      void   *cb_data,
                                      void   *inform_data);
 
-    void fireThreadStarted ();
+    void fireThreadStarted (ServerThreadContext * mt_nonnull thread_ctx);
 
     static void firstTimerAdded (void *_active_poll_group);
 
@@ -155,6 +202,53 @@ public:
 #endif
     }
 
+    // Pins worker threads to CPUs from 'cpu_list' ("0-3,8"), one CPU
+    // per thread. Per-thread state is allocated after pinning, which makes
+    // it local to the thread's NUMA node. See MultiThread::setCpuAffinity().
+    // Should be called before run().
+    mt_const mt_throws Result setCpuAffinity (ConstMemory const cpu_list)
+    {
+#ifdef LIBMARY_MT_SAFE
+        return multi_thread->setCpuAffinity (cpu_list);
+#else
+        (void) cpu_list;
+        return Result::Success;
+#endif
+    }
+
+    // Makes every worker thread prefill its cache of 'page_pool' at startup,
+    // so that the cached pages are local to the thread's NUMA node.
+    // See PagePool::prefillThreadCache(). Should be called before run().
+    mt_const void setThreadPagePool (PagePool * const page_pool)
+    {
+#ifdef LIBMARY_MT_SAFE
+        thread_page_pool = page_pool;
+#else
+        (void) page_pool;
+#endif
+    }
+
+    // Publishes the CPU and the NUMA node of every thread via Stat
+    // as "<stat_prefix>thread<N>_cpu" and "<stat_prefix>thread<N>_numa_node",
+    // where the main thread has number 0. Should be called before run().
+    mt_const void enableStat (ConstMemory stat_prefix);
+
+    // Makes the main thread and worker threads flush their connections with
+    // batched io_uring writes. See DeferredConnectionSenderQueue::setBatchedFlush().
+    // Should be called before init().
+    mt_const void setBatchedFlush (bool const batched_flush)
+        { this->batched_flush = batched_flush; }
+
+    // Should be called before run().
+    mt_const void setThreadSelectionPolicy (ThreadSelectionPolicy const policy)
+    {
+#ifdef LIBMARY_MT_SAFE
+        thread_selection_policy = policy;
+#else
+        (void) policy;
+#endif
+    }
+
     void release ();
 
     ServerApp (Object *coderef_container,
@@ -26,6 +26,11 @@
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <sys/sendfile.h>
+#include <linux/errqueue.h>
+#endif
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 
@@ -46,10 +51,31 @@
 #endif
 
 
+#if defined (__linux__) && defined (SO_ZEROCOPY) && defined (MSG_ZEROCOPY) && defined (SO_EE_ORIGIN_ZEROCOPY)
+  #define LIBMARY__TCP_CONNECTION__ZEROCOPY
+#endif
+
+
 namespace M {
 
 static LogGroup libMary_logGroup_tcp_conn ("tcp_conn", LogLevel::I);
 
+#ifdef LIBMARY__TCP_CONNECTION__ZEROCOPY
+// Socket of a destroyed connection which is kept open until zero-copy writes
+// on it complete.
+class TcpConnection_OrphanSocket : public IntrusiveListElement<>
+{
+public:
+    int fd;
+    AsyncOutputStream::ZeroCopyOrphanList orphans;
+};
+
+typedef IntrusiveList<TcpConnection_OrphanSocket> TcpConnection_OrphanSocketList;
+
+static Mutex orphan_socket_mutex;
+static mt_mutex (orphan_socket_mutex) TcpConnection_OrphanSocketList orphan_socket_list;
+#endif
+
 #ifdef LIBMARY_TCP_CONNECTION_NUM_INSTANCES
 AtomicInt TcpConnection::num_instances;
 #endif
@@ -169,6 +195,10 @@ TcpConnection::processEvents (Uint32   const event_flags,
     }
 
     if (event_flags & PollGroup::Error) {
+        // With zero-copy output, error events are mostly completion notifications.
+        if (self->zerocopy_enabled && !self->processErrorQueue ())
+            return;
+
 	logD_ (_func, "0x", fmt_hex, (UintPtr) self, " Error");
 	if (self->input_frontend && self->input_frontend->processError) {
 	    // TODO getsockopt SO_ERROR + fill PosixException
@@ -187,6 +217,118 @@ TcpConnection::processEvents (Uint32   const event_flags,
     }
 }
 
+// Receives zero-copy completion notifications from the error queue of 'fd'
+// and passes them to 'complete'. Returns true if there's an actual socket error.
+static bool
+recvZeroCopyCompletions (int    const fd,
+                         void (* const complete) (Uint32  first_seq,
+                                                  Uint32  last_seq,
+                                                  void   *cb_data),
+                         void * const cb_data)
+{
+    bool got_error = false;
+
+#ifdef LIBMARY__TCP_CONNECTION__ZEROCOPY
+    for (;;) {
+        char control [256];
+
+        struct msghdr msg;
+        memset (&msg, 0, sizeof (msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof (control);
+
+        ssize_t const res = recvmsg (fd, &msg, MSG_ERRQUEUE);
+        if (res == -1) {
+            if (errno == EINTR)
+                continue;
+
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                logE_ (_func, "recvmsg() failed: ", errnoString (errno));
+                got_error = true;
+            }
+
+            break;
+        }
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (&msg); cmsg; cmsg = CMSG_NXTHDR (&msg, cmsg)) {
+            if (!(cmsg->cmsg_level == SOL_IP   && cmsg->cmsg_type == IP_RECVERR) &&
+                !(cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))
+            {
+                continue;
+            }
+
+            struct sock_extended_err serr;
+            memcpy (&serr, CMSG_DATA (cmsg), sizeof (serr));
+            if (serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+                got_error = true;
+                continue;
+            }
+
+            complete (serr.ee_info, serr.ee_data, cb_data);
+        }
+    }
+#else
+    (void) fd;
+    (void) complete;
+    (void) cb_data;
+#endif
+
+    return got_error;
+}
+
+static void
+completeZeroCopyOrphans (AsyncOutputStream::ZeroCopyOrphanList * const mt_nonnull orphans,
+                         Uint32                                  const first_seq,
+                         Uint32                                  const last_seq)
+{
+    AsyncOutputStream::ZeroCopyOrphanList::iter iter (*orphans);
+    while (!orphans->iter_done (iter)) {
+        AsyncOutputStream::ZeroCopyOrphan * const orphan = orphans->iter_next (iter);
+        if (orphan->zeroCopyComplete (first_seq, last_seq)) {
+            orphans->remove (orphan);
+            delete orphan;
+        }
+    }
+}
+
+void
+TcpConnection::zeroCopyComplete (Uint32   const first_seq,
+                                 Uint32   const last_seq,
+                                 void   * const _self)
+{
+    TcpConnection * const self = static_cast <TcpConnection*> (_self);
+
+    // The frontend goes first: if it is handing its writes over with
+    // adoptZeroCopyOrphan() concurrently, then the orphan is in the list
+    // by the time the frontend's call returns.
+    if (self->output_frontend && self->output_frontend->zeroCopyComplete)
+        self->output_frontend.call (self->output_frontend->zeroCopyComplete, /*(*/ first_seq, last_seq /*)*/);
+
+    self->zerocopy_orphan_mutex.lock ();
+    completeZeroCopyOrphans (&self->zerocopy_orphans, first_seq, last_seq);
+    self->zerocopy_orphan_mutex.unlock ();
+}
+
+mt_sync_domain (pollable) bool
+TcpConnection::processErrorQueue ()
+{
+    bool got_error = recvZeroCopyCompletions (fd, zeroCopyComplete, this);
+
+    if (!got_error) {
+        int opt_val = 0;
+        socklen_t opt_len = sizeof (opt_val);
+        if (getsockopt (fd, SOL_SOCKET, SO_ERROR, &opt_val, &opt_len) == -1) {
+            logE_ (_func, "getsockopt() failed: ", errnoString (errno));
+            got_error = true;
+        } else
+        if (opt_val != 0) {
+            got_error = true;
+        }
+    }
+
+    return got_error;
+}
+
 int
 TcpConnection::getFd (void *_self)
 {
@@ -254,6 +396,57 @@ TcpConnection::read (Memory   const mem,
     return AsyncIoResult::Normal;
 }
 
+AsyncIoResult
+TcpConnection::readv (struct iovec * const iovs,
+                      Count          const num_iovs,
+                      Size         * const ret_nread)
+    mt_throw ((IoException,
+	       InternalException))
+{
+    if (ret_nread)
+	*ret_nread = 0;
+
+    Size len = 0;
+    for (Count i = 0; i < num_iovs; ++i)
+        len += iovs [i].iov_len;
+
+    ssize_t const res = ::readv (fd, iovs, num_iovs);
+    if (res == -1) {
+	if (errno == EAGAIN || errno == EWOULDBLOCK) {
+	    requestInput ();
+	    return AsyncIoResult::Again;
+	}
+
+	if (errno == EINTR)
+	    return AsyncIoResult::Normal;
+
+	exc_throw (PosixException, errno);
+	exc_push_ (IoException);
+	return AsyncIoResult::Error;
+    } else
+    if (res < 0) {
+	exc_throw (InternalException, InternalException::BackendMalfunction);
+	return AsyncIoResult::Error;
+    } else
+    if (res == 0) {
+	return AsyncIoResult::Eof;
+    }
+
+    if (ret_nread)
+	*ret_nread = (Size) res;
+
+    if ((Size) res < len) {
+	if (hup_received) {
+	    return AsyncIoResult::Normal_Eof;
+	} else {
+	    requestInput ();
+	    return AsyncIoResult::Normal_Again;
+	}
+    }
+
+    return AsyncIoResult::Normal;
+}
+
 AsyncIoResult
 TcpConnection::write (ConstMemory   const mem,
 		      Size        * const ret_nwritten)
@@ -378,6 +571,149 @@ TcpConnection::writev (struct iovec * const iovs,
     return AsyncIoResult::Normal;
 }
 
+mt_throws Result
+TcpConnection::enableZeroCopy ()
+{
+#ifdef LIBMARY__TCP_CONNECTION__ZEROCOPY
+    int opt_val = 1;
+    if (setsockopt (fd, SOL_SOCKET, SO_ZEROCOPY, &opt_val, sizeof (opt_val)) == -1) {
+        exc_throw (PosixException, errno);
+        exc_push (InternalException, InternalException::BackendError);
+        return Result::Failure;
+    }
+
+    zerocopy_enabled = true;
+    return Result::Success;
+#else
+    exc_throw (InternalException, InternalException::NotImplemented);
+    return Result::Failure;
+#endif
+}
+
+void
+TcpConnection::adoptZeroCopyOrphan (ZeroCopyOrphan * const mt_nonnull orphan)
+{
+    zerocopy_orphan_mutex.lock ();
+    zerocopy_orphans.append (orphan);
+    zerocopy_orphan_mutex.unlock ();
+}
+
+mt_throws AsyncIoResult
+TcpConnection::writevZeroCopy (struct iovec * const iovs,
+                               Count          const num_iovs,
+                               Size         * const ret_nwritten,
+                               bool         * const ret_zerocopy,
+                               Uint32       * const ret_seq)
+{
+    *ret_zerocopy = false;
+    *ret_seq = 0;
+
+#ifdef LIBMARY__TCP_CONNECTION__ZEROCOPY
+    if (!zerocopy_enabled)
+        return writev (iovs, num_iovs, ret_nwritten);
+
+    if (ret_nwritten)
+	*ret_nwritten = 0;
+
+    struct msghdr msg;
+    memset (&msg, 0, sizeof (msg));
+    msg.msg_iov = iovs;
+    msg.msg_iovlen = num_iovs;
+
+    ssize_t const res = sendmsg (fd, &msg, MSG_ZEROCOPY | MSG_NOSIGNAL);
+    if (res == -1) {
+	if (errno == EAGAIN || errno == EWOULDBLOCK) {
+	    requestOutput ();
+	    return AsyncIoResult::Again;
+	}
+
+	if (errno == EINTR)
+	    return AsyncIoResult::Normal;
+
+	if (errno == EPIPE)
+	    return AsyncIoResult::Eof;
+
+        // Out of locked memory for pinned pages: falling back to copying.
+        if (errno == ENOBUFS)
+            return writev (iovs, num_iovs, ret_nwritten);
+
+	exc_throw (PosixException, errno);
+	exc_push_ (IoException);
+	return AsyncIoResult::Error;
+    } else
+    if (res < 0) {
+	exc_throw (InternalException, InternalException::BackendMalfunction);
+	return AsyncIoResult::Error;
+    }
+
+    if (res > 0) {
+        *ret_zerocopy = true;
+        *ret_seq = zerocopy_seq;
+        ++zerocopy_seq;
+    }
+
+    if (ret_nwritten)
+	*ret_nwritten = (Size) res;
+
+    return AsyncIoResult::Normal;
+#else
+    return writev (iovs, num_iovs, ret_nwritten);
+#endif
+}
+
+#ifdef __linux__
+mt_throws AsyncIoResult
+TcpConnection::sendfile (int          const in_fd,
+                         FileOffset   const offset,
+                         Size         const len,
+                         Size       * const ret_nwritten)
+{
+    if (ret_nwritten)
+	*ret_nwritten = 0;
+
+    Size tosend;
+    if (len > SSIZE_MAX)
+	tosend = SSIZE_MAX;
+    else
+	tosend = len;
+
+    off_t off = (off_t) offset;
+    ssize_t const res = ::sendfile (fd, in_fd, &off, tosend);
+    if (res == -1) {
+	if (errno == EAGAIN || errno == EWOULDBLOCK) {
+	    requestOutput ();
+	    return AsyncIoResult::Again;
+	}
+
+	if (errno == EINTR)
+	    return AsyncIoResult::Normal;
+
+	if (errno == EPIPE)
+	    return AsyncIoResult::Eof;
+
+	exc_throw (PosixException, errno);
+	exc_push_ (IoException);
+	return AsyncIoResult::Error;
+    } else
+    if (res < 0) {
+	exc_throw (InternalException, InternalException::BackendMalfunction);
+	return AsyncIoResult::Error;
+    }
+
+    if (res == 0 && tosend > 0) {
+      // The file is shorter than expected.
+	exc_throw (InternalException, InternalException::OutOfBounds);
+	return AsyncIoResult::Error;
+    }
+
+    if (ret_nwritten)
+	*ret_nwritten = (Size) res;
+
+    return AsyncIoResult::Normal;
+}
+#endif
+
+
 #if 0
 mt_throws Result
 TcpConnection::close ()
@@ -517,11 +853,67 @@ TcpConnection::connect (IpAddress const addr)
     return ConnectResult_InProgress;
 }
 
+static void
+closeFd (int const fd)
+{
+    for (;;) {
+        int const res = ::close (fd);
+        if (res == -1) {
+            if (errno == EINTR)
+                continue;
+
+            logE_ (_func, "close() failed: ", errnoString (errno));
+        } else
+        if (res != 0) {
+            logE_ (_func, "close(): unexpected return value: ", res);
+        }
+
+        break;
+    }
+}
+
+#ifdef LIBMARY__TCP_CONNECTION__ZEROCOPY
+static void
+orphanSocketZeroCopyComplete (Uint32   const first_seq,
+                              Uint32   const last_seq,
+                              void   * const _sock)
+{
+    TcpConnection_OrphanSocket * const sock = static_cast <TcpConnection_OrphanSocket*> (_sock);
+    completeZeroCopyOrphans (&sock->orphans, first_seq, last_seq);
+}
+
+// Orphan sockets are checked for completions whenever a connection
+// is destroyed.
+static void
+reapOrphanSockets ()
+{
+    orphan_socket_mutex.lock ();
+
+    TcpConnection_OrphanSocketList::iter iter (orphan_socket_list);
+    while (!orphan_socket_list.iter_done (iter)) {
+        TcpConnection_OrphanSocket * const sock = orphan_socket_list.iter_next (iter);
+
+        recvZeroCopyCompletions (sock->fd, orphanSocketZeroCopyComplete, sock);
+        if (sock->orphans.isEmpty()) {
+            logD (tcp_conn, _func, "closing orphan socket ", sock->fd);
+
+            orphan_socket_list.remove (sock);
+            closeFd (sock->fd);
+            delete sock;
+        }
+    }
+
+    orphan_socket_mutex.unlock ();
+}
+#endif
+
 TcpConnection::TcpConnection (Object * const coderef_container)
     : DependentCodeReferenced (coderef_container),
       fd (-1),
       connected    (false),
-      hup_received (false)
+      hup_received (false),
+      zerocopy_enabled (false),
+      zerocopy_seq     (0)
 {
 #ifdef LIBMARY_TCP_CONNECTION_NUM_INSTANCES
     fprintf (stderr, " TcpConnection(): 0x%lx, num_instances: %d\n",
@@ -538,22 +930,29 @@ TcpConnection::~TcpConnection ()
 	     (int) (num_instances.fetchAdd (-1) - 1));
 #endif
 
-    if (fd != -1) {
-	for (;;) {
-	    int const res = ::close (fd);
-	    if (res == -1) {
-		if (errno == EINTR)
-		    continue;
+#ifdef LIBMARY__TCP_CONNECTION__ZEROCOPY
+    if (fd != -1 && !zerocopy_orphans.isEmpty()) {
+      // The kernel may still be transmitting data of zero-copy writes.
+      // Keeping the socket open to get completion notifications for them.
+      // The connection should have been removed from its poll group by now.
+        TcpConnection_OrphanSocket * const sock = new (std::nothrow) TcpConnection_OrphanSocket;
+        assert (sock);
+        sock->fd = fd;
+        sock->orphans.stealAppend (zerocopy_orphans.getFirst(), zerocopy_orphans.getLast());
+        zerocopy_orphans.clear ();
+
+        orphan_socket_mutex.lock ();
+        orphan_socket_list.append (sock);
+        orphan_socket_mutex.unlock ();
+
+        fd = -1;
+    }
 
-		logE_ (_func, "close() failed: ", errnoString (errno));
-	    } else
-	    if (res != 0) {
-		logE_ (_func, "close(): unexpected return value: ", res);
-	    }
+    reapOrphanSockets ();
+#endif
 
-	    break;
-	}
-    }
+    if (fd != -1)
+        closeFd (fd);
 }
 
 }
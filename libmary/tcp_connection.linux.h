@@ -25,6 +25,7 @@
 #include <libmary/connection.h>
 #include <libmary/poll_group.h>
 #include <libmary/util_net.h>
+#include <libmary/mutex.h>
 #include <libmary/debug.h>
 
 
@@ -56,6 +57,24 @@ private:
     Cb<Frontend> frontend;
     Cb<PollGroup::Feedback> feedback;
 
+    mt_const bool zerocopy_enabled;
+    // Sequence number of the next zero-copy write.
+    // Synchronized by the user of writevZeroCopy().
+    Uint32 zerocopy_seq;
+
+    Mutex zerocopy_orphan_mutex;
+    // Zero-copy writes of released senders which haven't completed yet.
+    // The socket is kept open until they complete (see ~TcpConnection()).
+    mt_mutex (zerocopy_orphan_mutex) ZeroCopyOrphanList zerocopy_orphans;
+
+    static void zeroCopyComplete (Uint32  first_seq,
+                                  Uint32  last_seq,
+                                  void   *_self);
+
+    // Processes zero-copy completion notifications from the socket's error
+    // queue. Returns true if there's an actual socket error.
+    mt_sync_domain (pollable) bool processErrorQueue ();
+
     void requestInput ()
     {
 	if (feedback && feedback->requestInput)
@@ -85,6 +104,10 @@ public:
     mt_iface (AsyncInputStream)
       mt_throws AsyncIoResult read (Memory  mem,
 				    Size   *ret_nread);
+
+      mt_throws AsyncIoResult readv (struct iovec *iovs,
+                                     Count         num_iovs,
+                                     Size         *ret_nread);
     mt_iface_end
 
     mt_iface (AsyncOutputStream)
@@ -94,6 +117,23 @@ public:
       mt_throws AsyncIoResult writev (struct iovec *iovs,
 				      Count         num_iovs,
 				      Size         *ret_nwritten);
+
+      mt_throws Result enableZeroCopy ();
+
+      void adoptZeroCopyOrphan (ZeroCopyOrphan * mt_nonnull orphan);
+
+      mt_throws AsyncIoResult writevZeroCopy (struct iovec *iovs,
+                                              Count         num_iovs,
+                                              Size         *ret_nwritten,
+                                              bool         *ret_zerocopy,
+                                              Uint32       *ret_seq);
+
+#ifdef __linux__
+      mt_throws AsyncIoResult sendfile (int         in_fd,
+                                        FileOffset  offset,
+                                        Size        len,
+                                        Size       *ret_nwritten);
+#endif
     mt_iface_end
 
 #if 0
@@ -103,7 +143,7 @@ public:
     mt_throws Result close ();
 #endif
 
-#ifdef LIBMARY_ENABLE_MWRITEV
+#if defined (LIBMARY_ENABLE_MWRITEV) || defined (LIBMARY_ENABLE_IO_URING)
     int getFd () { return fd; }
 #endif
   mt_iface_end
@@ -19,12 +19,17 @@
 
 #include <libmary/types.h>
 
+#include <stdlib.h>
+#include <string.h>
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netinet/tcp.h>
+#ifdef __linux__
+  #include <linux/filter.h>
+#endif
 
 #include <libmary/log.h>
 #include <libmary/util_net.h>
@@ -53,8 +58,10 @@ TcpServer::processEvents (Uint32   const event_flags,
 	logE_ (_self_func, "PollGroup::Output");
 
     if (event_flags & PollGroup::Input) {
+        self->beginAcceptBatch ();
 	if (self->frontend)
 	    self->frontend.call (self->frontend->accepted);
+        self->endAcceptBatch ();
     }
 
     if (event_flags & PollGroup::Error)
@@ -85,8 +92,45 @@ TcpServer::acceptRetryTimerTick (void * const _self)
     self->accept_retry_timer_set = false;
     self->accept_retry_mutex.unlock ();
 
+    self->beginAcceptBatch ();
+    if (self->frontend)
+        self->frontend.call (self->frontend->accepted);
+    self->endAcceptBatch ();
+}
+
+// Continues accepting connections which were left in the accept queue
+// after the batch limit had been reached. The poll group is edge-triggered,
+// so we won't get another Input event for those connections.
+bool
+TcpServer::acceptTask (void * const _self)
+{
+    TcpServer * const self = static_cast <TcpServer*> (_self);
+
+    self->beginAcceptBatch ();
     if (self->frontend)
         self->frontend.call (self->frontend->accepted);
+    self->endAcceptBatch ();
+
+    return false /* Do not reschedule */;
+}
+
+mt_sync_domain (pollable) void
+TcpServer::beginAcceptBatch ()
+{
+    accept_budget = accept_batch_size;
+}
+
+mt_sync_domain (pollable) void
+TcpServer::endAcceptBatch ()
+{
+    if (accepted_in_batch == 0)
+        return;
+
+    stat_mutex.lock ();
+    num_accepted += accepted_in_batch;
+    stat_mutex.unlock ();
+
+    accepted_in_batch = 0;
 }
 
 mt_throws Result
@@ -135,6 +179,28 @@ TcpServer::open ()
 	}
     }
 
+    if (reuse_port) {
+#ifdef SO_REUSEPORT
+	int opt_val = 1;
+	int const res = setsockopt (fd, SOL_SOCKET, SO_REUSEPORT, &opt_val, sizeof (opt_val));
+	if (res == -1) {
+	    exc_throw (PosixException, errno);
+	    exc_push (InternalException, InternalException::BackendError);
+	    logE_ (_this_func, "setsockopt() failed (SO_REUSEPORT): ", errnoString (errno));
+	    return Result::Failure;
+	} else
+	if (res != 0) {
+	    exc_throw (InternalException, InternalException::BackendMalfunction);
+	    logE_ (_this_func, "setsockopt (SO_REUSEPORT): unexpected return value: ", res);
+	    return Result::Failure;
+	}
+#else
+	exc_throw (InternalException, InternalException::NotImplemented);
+	logE_ (_this_func, "SO_REUSEPORT is not supported");
+	return Result::Failure;
+#endif
+    }
+
     return Result::Success;
 }
 
@@ -142,6 +208,21 @@ mt_throws TcpServer::AcceptResult
 TcpServer::accept (TcpConnection * const mt_nonnull tcp_connection,
 		   IpAddress     * const ret_addr)
 {
+    if (accept_batch_size) {
+        if (accept_budget == 0) {
+            stat_mutex.lock ();
+            ++num_batch_limit_hits;
+            stat_mutex.unlock ();
+
+          // The rest of the accept queue is drained on the next iteration
+          // of the poll loop.
+            deferred_reg.scheduleTask (&accept_task, false /* permanent */);
+            return AcceptResult::NotAccepted;
+        }
+
+        --accept_budget;
+    }
+
     int conn_fd;
     for (;;) {
         conn_fd = -1;
@@ -151,7 +232,13 @@ TcpServer::accept (TcpConnection * const mt_nonnull tcp_connection,
 	struct sockaddr_in client_addr;
 	socklen_t client_addr_len = sizeof (client_addr);
 
+#ifdef __linux__
+        // accept4() saves two fcntl() calls per connection.
+	conn_fd = ::accept4 (fd, (struct sockaddr*) &client_addr, &client_addr_len,
+                             SOCK_NONBLOCK | SOCK_CLOEXEC);
+#else
 	conn_fd = ::accept (fd, (struct sockaddr*) &client_addr, &client_addr_len);
+#endif
 	if (conn_fd == -1) {
 	    if (   errno == EINTR /* || errno == ERESTARTSYS */
 		|| errno == EPROTO
@@ -188,6 +275,10 @@ TcpServer::accept (TcpConnection * const mt_nonnull tcp_connection,
                 logE_ (_this_func, "accept() failed: ", errnoString (errno));
             }
 
+            stat_mutex.lock ();
+            ++num_accept_errors;
+            stat_mutex.unlock ();
+
             // For EMFILE and friends, we just wait for better times, which is 
             // the right thing to do.
             // For other (unknown) errors, we wait just for extra safety,
@@ -214,6 +305,7 @@ TcpServer::accept (TcpConnection * const mt_nonnull tcp_connection,
 	if (ret_addr)
 	    setIpAddress (&client_addr, ret_addr);
 
+#ifndef __linux__
         {
             int flags = fcntl (conn_fd, F_GETFL, 0);
             if (flags == -1) {
@@ -232,6 +324,7 @@ TcpServer::accept (TcpConnection * const mt_nonnull tcp_connection,
                 goto _failure;
             }
         }
+#endif
 
         {
             int opt_val = 1;
@@ -268,6 +361,7 @@ TcpServer::accept (TcpConnection * const mt_nonnull tcp_connection,
 #endif /* __linux__ */
 
         tcp_connection->setFd (conn_fd);
+        ++accepted_in_batch;
         return AcceptResult::Accepted;
 
 _failure:
@@ -334,10 +428,221 @@ TcpServer::listen ()
     return Result::Success;
 }
 
+mt_throws Result
+TcpServer::attachCpuSteeringFilter (Count const num_sockets)
+{
+    assert (num_sockets > 0);
+
+#if defined (__linux__) && defined (SO_ATTACH_REUSEPORT_CBPF)
+    struct sock_filter code [] = {
+        // A = id of the current CPU
+        { BPF_LD  | BPF_W | BPF_ABS, 0, 0, (__u32) (SKF_AD_OFF + SKF_AD_CPU) },
+        // A = A % num_sockets
+        { BPF_ALU | BPF_MOD | BPF_K, 0, 0, (__u32) num_sockets },
+        // Return A as the index of the socket.
+        { BPF_RET | BPF_A, 0, 0, 0 }
+    };
+
+    struct sock_fprog prog;
+    prog.len = sizeof (code) / sizeof (code [0]);
+    prog.filter = code;
+
+    int const res = setsockopt (fd, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &prog, sizeof (prog));
+    if (res == -1) {
+	exc_throw (PosixException, errno);
+	exc_push (InternalException, InternalException::BackendError);
+	logE_ (_this_func, "setsockopt() failed (SO_ATTACH_REUSEPORT_CBPF): ", errnoString (errno));
+	return Result::Failure;
+    } else
+    if (res != 0) {
+	exc_throw (InternalException, InternalException::BackendMalfunction);
+	logE_ (_this_func, "setsockopt (SO_ATTACH_REUSEPORT_CBPF): unexpected return value: ", res);
+	return Result::Failure;
+    }
+
+    return Result::Success;
+#else
+    exc_throw (InternalException, InternalException::NotImplemented);
+    logE_ (_this_func, "SO_ATTACH_REUSEPORT_CBPF is not supported");
+    return Result::Failure;
+#endif
+}
+
 mt_throws Result
 TcpServer::start ()
     { return Result::Success; }
 
+#ifdef __linux__
+// Finds TcpExt counters 'name_a' and 'name_b' in /proc/net/netstat.
+// The file consists of pairs of lines: "TcpExt: <names>" followed by
+// "TcpExt: <values>".
+static void
+getTcpExtCounters (ConstMemory   const name_a,
+                   ConstMemory   const name_b,
+                   Uint64      * const mt_nonnull ret_a,
+                   Uint64      * const mt_nonnull ret_b)
+{
+    *ret_a = 0;
+    *ret_b = 0;
+
+    int const netstat_fd = ::open ("/proc/net/netstat", O_RDONLY | O_CLOEXEC);
+    if (netstat_fd == -1)
+        return;
+
+    char buf [16384];
+    Size len = 0;
+    for (;;) {
+        if (len >= sizeof (buf) - 1)
+            break;
+
+        ssize_t const res = ::read (netstat_fd, buf + len, sizeof (buf) - 1 - len);
+        if (res == -1) {
+            if (errno == EINTR)
+                continue;
+
+            break;
+        }
+
+        if (res == 0)
+            break;
+
+        len += (Size) res;
+    }
+    buf [len] = 0;
+
+    while (::close (netstat_fd) == -1 && errno == EINTR);
+
+    ConstMemory const prefix = "TcpExt:";
+
+    char *names = strstr (buf, "TcpExt:");
+    if (!names)
+        return;
+
+    char * const names_end = strchr (names, '\n');
+    if (!names_end)
+        return;
+
+    char *values = names_end + 1;
+    if (strncmp (values, (char const *) prefix.mem(), prefix.len()))
+        return;
+
+    names  += prefix.len();
+    values += prefix.len();
+    for (;;) {
+        while (*names == ' ')
+            ++names;
+        while (*values == ' ')
+            ++values;
+
+        if (names >= names_end || *values == 0 || *values == '\n')
+            break;
+
+        char const * const name = names;
+        while (names < names_end && *names != ' ')
+            ++names;
+        ConstMemory const cur_name ((Byte const *) name, (Size) (names - name));
+
+        Uint64 const value = (Uint64) strtoull (values, &values, 10);
+
+        if (equal (cur_name, name_a))
+            *ret_a = value;
+        else
+        if (equal (cur_name, name_b))
+            *ret_b = value;
+    }
+}
+#endif /* __linux__ */
+
+void
+TcpServer::getAcceptStatistics (AcceptStatistics * const mt_nonnull ret_stats)
+{
+    stat_mutex.lock ();
+    ret_stats->num_accepted         = num_accepted;
+    ret_stats->num_batch_limit_hits = num_batch_limit_hits;
+    ret_stats->num_accept_errors    = num_accept_errors;
+    stat_mutex.unlock ();
+
+    ret_stats->queue_len = 0;
+    ret_stats->queue_max = 0;
+    ret_stats->listen_overflows = 0;
+    ret_stats->listen_drops = 0;
+
+#ifdef __linux__
+    {
+      // For listening sockets, tcpi_unacked is the current length
+      // of the accept queue, and tcpi_sacked is its maximum length.
+        struct tcp_info info;
+        socklen_t info_len = sizeof (info);
+        if (getsockopt (fd, IPPROTO_TCP, TCP_INFO, &info, &info_len) == 0) {
+            ret_stats->queue_len = (Count) info.tcpi_unacked;
+            ret_stats->queue_max = (Count) info.tcpi_sacked;
+        }
+    }
+
+    getTcpExtCounters ("ListenOverflows",
+                       "ListenDrops",
+                       &ret_stats->listen_overflows,
+                       &ret_stats->listen_drops);
+#endif
+}
+
+void
+TcpServer::statTimerTick (void * const _self)
+{
+    TcpServer * const self = static_cast <TcpServer*> (_self);
+
+    AcceptStatistics stats;
+    self->getAcceptStatistics (&stats);
+
+    Stat * const stat = getStat();
+    stat->setInt (self->stat_accepted,         (Int64) stats.num_accepted);
+    stat->setInt (self->stat_batch_limit_hits, (Int64) stats.num_batch_limit_hits);
+    stat->setInt (self->stat_accept_errors,    (Int64) stats.num_accept_errors);
+    stat->setInt (self->stat_queue_len,        (Int64) stats.queue_len);
+    stat->setInt (self->stat_queue_max,        (Int64) stats.queue_max);
+    stat->setInt (self->stat_listen_overflows, (Int64) stats.listen_overflows);
+    stat->setInt (self->stat_listen_drops,     (Int64) stats.listen_drops);
+}
+
+mt_const void
+TcpServer::enableStat (ConstMemory const stat_prefix,
+                       Time        const update_interval_millisec)
+{
+    assert (!stat_enabled);
+
+    Stat * const stat = getStat();
+
+    stat_accepted = stat->createParam (catenateStrings (stat_prefix, "accepted")->mem(),
+                                       "Number of accepted connections",
+                                       Stat::ParamType_Int64, 0, 0.0);
+    stat_batch_limit_hits = stat->createParam (catenateStrings (stat_prefix, "accept_batch_limit_hits")->mem(),
+                                               "Number of times accepting was postponed by the batch limit",
+                                               Stat::ParamType_Int64, 0, 0.0);
+    stat_accept_errors = stat->createParam (catenateStrings (stat_prefix, "accept_errors")->mem(),
+                                            "Number of accept() errors",
+                                            Stat::ParamType_Int64, 0, 0.0);
+    stat_queue_len = stat->createParam (catenateStrings (stat_prefix, "accept_queue_len")->mem(),
+                                        "Connections waiting in the accept queue",
+                                        Stat::ParamType_Int64, 0, 0.0);
+    stat_queue_max = stat->createParam (catenateStrings (stat_prefix, "accept_queue_max")->mem(),
+                                        "Maximum length of the accept queue",
+                                        Stat::ParamType_Int64, 0, 0.0);
+    stat_listen_overflows = stat->createParam (catenateStrings (stat_prefix, "listen_overflows")->mem(),
+                                               "Accept queue overflows, system-wide",
+                                               Stat::ParamType_Int64, 0, 0.0);
+    stat_listen_drops = stat->createParam (catenateStrings (stat_prefix, "listen_drops")->mem(),
+                                           "Dropped connection requests, system-wide",
+                                           Stat::ParamType_Int64, 0, 0.0);
+
+    stat_enabled = true;
+
+    stat_timer = timers->addTimer_microseconds (
+                         CbDesc<Timers::TimerCallback> (statTimerTick, this, getCoderefContainer()),
+                         update_interval_millisec * 1000,
+                         true  /* periodical */,
+                         false /* auto_delete */);
+}
+
 #if 0
 mt_throws Result
 TcpServer::close ()
@@ -375,12 +680,14 @@ TcpServer::close ()
 
 void
 TcpServer::init (CbDesc<Frontend> const &frontend,
-                 DeferredProcessor * const mt_nonnull /* deferred_processor */,
+                 DeferredProcessor * const mt_nonnull deferred_processor,
                  Timers            * const mt_nonnull timers,
                  Time                const accept_retry_timeout_millisec)
 {
     assert (timers);
 
+    deferred_reg.setDeferredProcessor (deferred_processor);
+
     this->frontend = frontend;
     this->timers = timers;
     this->accept_retry_timeout_millisec = accept_retry_timeout_millisec;
@@ -390,13 +697,25 @@ TcpServer::TcpServer (Object * const coderef_container)
     : DependentCodeReferenced (coderef_container),
       accept_retry_timeout_millisec (1000),
       timers (coderef_container),
+      reuse_port (false),
+      accept_batch_size (0),
       fd (-1),
-      accept_retry_timer_set (false)
+      accept_budget (0),
+      accepted_in_batch (0),
+      accept_retry_timer_set (false),
+      num_accepted (0),
+      num_batch_limit_hits (0),
+      num_accept_errors (0),
+      stat_enabled (false)
 {
+    accept_task.cb = CbDesc<DeferredProcessor::TaskCallback> (acceptTask, this, coderef_container);
 }
 
 TcpServer::~TcpServer ()
 {
+    if (stat_timer)
+        timers->deleteTimer (stat_timer);
+
     if (fd != -1) {
 	for (;;) {
 	    int const res = ::close (fd);
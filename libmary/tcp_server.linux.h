@@ -25,6 +25,8 @@
 #include <libmary/exception.h>
 #include <libmary/poll_group.h>
 #include <libmary/timers.h>
+#include <libmary/deferred_processor.h>
+#include <libmary/stat.h>
 #include <libmary/tcp_connection.h>
 
 
@@ -38,13 +40,48 @@ public:
 	void (*accepted) (void *cb_data);
     };
 
+    struct AcceptStatistics
+    {
+        // Total number of accepted connections.
+        Uint64 num_accepted;
+        // Number of times accepting was postponed because the batch limit
+        // has been reached. See setAcceptBatchSize().
+        Uint64 num_batch_limit_hits;
+        // Number of accept() errors like EMFILE, after which we wait
+        // for accept_retry_timeout before accepting again.
+        Uint64 num_accept_errors;
+
+        // Current length of the accept queue and its limit.
+        // Linux-only (TCP_INFO), zero otherwise.
+        Count queue_len;
+        Count queue_max;
+
+        // System-wide number of connection requests dropped because of accept
+        // queue overflows (ListenOverflows and ListenDrops from /proc/net/netstat).
+        // Linux-only, zero otherwise.
+        Uint64 listen_overflows;
+        Uint64 listen_drops;
+    };
+
 private:
     mt_const Time accept_retry_timeout_millisec;
 
     mt_const DataDepRef<Timers> timers;
 
+    mt_const bool reuse_port;
+    mt_const Count accept_batch_size;
+
     int fd;
 
+    // Number of connections which may be accepted before accepting
+    // is postponed till the next poll iteration.
+    mt_sync_domain (pollable) Count accept_budget;
+    // Connections accepted since the last update of 'num_accepted'.
+    mt_sync_domain (pollable) Uint64 accepted_in_batch;
+
+    DeferredProcessor::Task accept_task;
+    DeferredProcessor::Registration deferred_reg;
+
     Cb<Frontend> frontend;
     Cb<PollGroup::Feedback> feedback;
 
@@ -77,7 +114,44 @@ private:
 
     static void acceptRetryTimerTick (void *_data);
 
+    static bool acceptTask (void *_self);
+
+    mt_sync_domain (pollable) void beginAcceptBatch ();
+
+    mt_sync_domain (pollable) void endAcceptBatch ();
+
+    StateMutex stat_mutex;
+    mt_mutex (stat_mutex) Uint64 num_accepted;
+    mt_mutex (stat_mutex) Uint64 num_batch_limit_hits;
+    mt_mutex (stat_mutex) Uint64 num_accept_errors;
+
+    mt_const bool stat_enabled;
+    mt_const Stat::ParamKey stat_accepted;
+    mt_const Stat::ParamKey stat_batch_limit_hits;
+    mt_const Stat::ParamKey stat_accept_errors;
+    mt_const Stat::ParamKey stat_queue_len;
+    mt_const Stat::ParamKey stat_queue_max;
+    mt_const Stat::ParamKey stat_listen_overflows;
+    mt_const Stat::ParamKey stat_listen_drops;
+    mt_const Timers::TimerKey stat_timer;
+
+    static void statTimerTick (void *_self);
+
 public:
+    // Enables SO_REUSEPORT for the listening socket, which allows several
+    // sockets to be bound to the same address. The kernel balances incoming
+    // connections between them. Should be called before open().
+    mt_const void setReusePort (bool const reuse_port)
+        { this->reuse_port = reuse_port; }
+
+    // Limits the number of connections accepted per readiness event
+    // of the listening socket. The rest of pending connections is accepted
+    // on the next poll iteration, so that a storm of incoming connections
+    // does not starve established ones. 0 means no limit (the default).
+    // Should be called before init().
+    mt_const void setAcceptBatchSize (Count const accept_batch_size)
+        { this->accept_batch_size = accept_batch_size; }
+
     mt_throws Result open ();
 
     class AcceptResult
@@ -104,8 +178,25 @@ public:
     // Should only be called once.
     mt_throws Result listen ();
 
+    // For SO_REUSEPORT sockets. Attaches a BPF program to the group of sockets
+    // bound to the same address, which steers a new connection to the socket
+    // with index (cpu % num_sockets), where 'cpu' is the CPU which processed
+    // the incoming SYN. Sockets are indexed in the order they were bound.
+    // This keeps connections local to the CPU if every listening socket
+    // is serviced by a thread pinned to the corresponding CPU.
+    // Should be called after bind(). Linux-only.
+    mt_throws Result attachCpuSteeringFilter (Count num_sockets);
+
     mt_throws Result start ();
 
+    void getAcceptStatistics (AcceptStatistics * mt_nonnull ret_stats);
+
+    // Publishes AcceptStatistics via Stat with names prefixed with 'stat_prefix'.
+    // The values are updated every 'update_interval_millisec' by a timer.
+    // Should be called after init() and listen().
+    mt_const void enableStat (ConstMemory stat_prefix,
+                              Time        update_interval_millisec = 1000);
+
 //    // TODO Questionable: there's no synchronization for "fd = -1" assignment.
 //    mt_throws Result close ();
 
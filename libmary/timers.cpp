@@ -27,6 +27,34 @@ namespace M {
 
 namespace {
 LogGroup libMary_logGroup_timers ("timers", LogLevel::I);
+
+// Rounds up, so that a timer never fires earlier than requested.
+Uint64 timeToTick (Time const time_microseconds)
+{
+    return time_microseconds / Timers::TickMicroseconds
+           + (time_microseconds % Timers::TickMicroseconds ? 1 : 0);
+}
+
+Time tickToTime (Uint64 const tick)
+{
+    if (tick > (Time) -1 / Timers::TickMicroseconds)
+        return (Time) -1;
+
+    return tick * Timers::TickMicroseconds;
+}
+
+// Index of the lowest bit set in a non-zero mask.
+unsigned lowestBit (Uint64 const mask)
+{
+#ifdef __GNUC__
+    return (unsigned) __builtin_ctzll (mask);
+#else
+    unsigned i = 0;
+    while (!(mask & ((Uint64) 1 << i)))
+        ++i;
+    return i;
+#endif
+}
 }
 
 void
@@ -38,6 +66,168 @@ Timers::subscriberDeletionCallback (void * const _timer)
     timers->doDeleteTimer (timer);
 }
 
+mt_mutex (mutex) Timers::Timer*
+Timers::allocTimer ()
+{
+    if (!timer_pool.isEmpty ()) {
+        Timer * const timer = timer_pool.getFirst ();
+        timer_pool.remove (timer);
+        --timer_pool_size;
+        return timer;
+    }
+
+    Timer * const timer = new (std::nothrow) Timer (this);
+    assert (timer);
+    return timer;
+}
+
+mt_mutex (mutex) bool
+Timers::checkTimerKey (TimerKey const timer_key)
+{
+    if (mt_unlikely (timer_key.generation != timer_key->generation)) {
+        logW_ (_func, "stale timer key 0x", fmt_hex, (UintPtr) (Timer*) timer_key, ", "
+               "generation ", fmt_def, timer_key.generation, ", "
+               "current ", timer_key->generation);
+        return false;
+    }
+
+    return true;
+}
+
+void
+Timers::releaseTimer (Timer * const mt_nonnull timer)
+{
+  // Releasing the callback may lead to object deletion, hence we do that
+  // with 'mutex' unlocked.
+    timer->timer_cb.reset ();
+    timer->del_sbn = Object::DeletionSubscriptionKey ();
+
+    mutex.lock ();
+    // Keys of the deleted timer become stale.
+    ++timer->generation;
+    if (timer_pool_size < MaxPooledTimers) {
+        timer_pool.append (timer);
+        ++timer_pool_size;
+        mutex.unlock ();
+        return;
+    }
+    mutex.unlock ();
+
+    delete timer;
+}
+
+mt_mutex (mutex) void
+Timers::wheelAdd (Timer * const mt_nonnull timer)
+{
+    Uint64 due_tick = timer->due_tick;
+    if (due_tick < cur_tick)
+        due_tick = cur_tick;
+
+    Uint64 delta = due_tick - cur_tick;
+    unsigned level = 0;
+    while (level < NumLevels - 1
+           && delta >= ((Uint64) 1 << (WheelBits * (level + 1))))
+    {
+        ++level;
+    }
+
+    {
+      // Timers which are too far in the future are put into the farthest slot
+      // and get re-added when that slot is cascaded.
+        Uint64 const max_delta = ((Uint64) 1 << (WheelBits * NumLevels)) - 1;
+        if (delta > max_delta) {
+            delta = max_delta;
+            due_tick = cur_tick + max_delta;
+        }
+    }
+
+    unsigned const slot = (unsigned) (due_tick >> (WheelBits * level)) & (WheelSize - 1);
+
+    timer->level = level;
+    timer->slot  = slot;
+
+    Wheel * const wheel = &wheels [level];
+    wheel->slots [slot].append (timer);
+    wheel->occupied |= (Uint64) 1 << slot;
+
+    ++num_timers;
+}
+
+mt_mutex (mutex) void
+Timers::wheelRemove (Timer * const mt_nonnull timer)
+{
+    Wheel * const wheel = &wheels [timer->level];
+    TimerList * const list = &wheel->slots [timer->slot];
+
+    list->remove (timer);
+    if (list->isEmpty ())
+        wheel->occupied &= ~((Uint64) 1 << timer->slot);
+
+    --num_timers;
+}
+
+mt_mutex (mutex) void
+Timers::cascade ()
+{
+    for (unsigned level = 1; level < NumLevels; ++level) {
+        unsigned const shift = WheelBits * level;
+        if (cur_tick & (((Uint64) 1 << shift) - 1))
+            break;
+
+        unsigned const slot = (unsigned) (cur_tick >> shift) & (WheelSize - 1);
+        Wheel * const wheel = &wheels [level];
+        if (!(wheel->occupied & ((Uint64) 1 << slot)))
+            continue;
+
+      // A timer may get back into the same slot, hence we detach the whole
+      // list before re-adding timers.
+        TimerList * const list = &wheel->slots [slot];
+        TimerList tmp_list;
+        tmp_list.stealAppend (list->getFirst (), list->getLast ());
+        list->clear ();
+        wheel->occupied &= ~((Uint64) 1 << slot);
+
+        while (!tmp_list.isEmpty ()) {
+            Timer * const timer = tmp_list.getFirst ();
+            tmp_list.remove (timer);
+            --num_timers;
+            wheelAdd (timer);
+        }
+    }
+}
+
+mt_mutex (mutex) Uint64
+Timers::getNextTick ()
+{
+    Uint64 next_tick = (Uint64) -1;
+
+    for (unsigned level = 0; level < NumLevels; ++level) {
+        Uint64 const occupied = wheels [level].occupied;
+        if (!occupied)
+            continue;
+
+        unsigned const shift = WheelBits * level;
+        Uint64 const rotation = (Uint64) 1 << (shift + WheelBits);
+        Uint64 const base = cur_tick & ~(rotation - 1);
+
+      // Slot N of the level is due at tick (base + (N << shift)). Slots which
+      // are due before cur_tick belong to the next rotation.
+        Uint64 const first_slot = (cur_tick - base + ((Uint64) 1 << shift) - 1) >> shift;
+        Uint64 const pending = (first_slot < WheelSize ? occupied & (~(Uint64) 0 << first_slot) : 0);
+
+        Uint64 tick;
+        if (pending)
+            tick = base + ((Uint64) lowestBit (pending) << shift);
+        else
+            tick = base + rotation + ((Uint64) lowestBit (occupied) << shift);
+
+        if (tick < next_tick)
+            next_tick = tick;
+    }
+
+    return next_tick;
+}
+
 Timers::TimerKey
 Timers::addTimer_microseconds (CbDesc<TimerCallback> const &cb,
 			       Time const time_microseconds,
@@ -47,15 +237,23 @@ Timers::addTimer_microseconds (CbDesc<TimerCallback> const &cb,
 {
     logD (timers, _func, "time_microseconds: ", time_microseconds);
 
-    Timer * const timer = new (std::nothrow) Timer (this, cb);
-    assert (timer);
+    Time const cur_time = getTimeMicroseconds ();
+
+    mutex.lock ();
+    Timer * const timer = allocTimer ();
+    Uint32 const generation = timer->generation;
+    mutex.unlock ();
+
+    timer->timer_cb = cb;
     timer->periodical = periodical;
     timer->delete_after_tick = delete_after_tick;
-    timer->due_time = getTimeMicroseconds() + time_microseconds;
+    timer->interval_microseconds = time_microseconds;
+    timer->due_time = cur_time + time_microseconds;
     if (timer->due_time < time_microseconds) {
 	logW_ (_func, "Expiration time overflow");
 	timer->due_time = (Time) -1;
     }
+    timer->due_tick = timeToTick (timer->due_time);
 
     if (auto_delete && cb.coderef_container) {
         timer->del_sbn = cb.coderef_container->addDeletionCallback (
@@ -64,32 +262,25 @@ Timers::addTimer_microseconds (CbDesc<TimerCallback> const &cb,
                                                   getCoderefContainer()));
     }
 
-    logD (timers, _func, "getTimeMicroseconds(): ", getTimeMicroseconds(), ", due_time: ", timer->due_time);
+    logD (timers, _func, "getTimeMicroseconds(): ", cur_time, ", due_time: ", timer->due_time);
 
     mutex.lock ();
 
-    bool first_timer = false;
-
-    TimerChain *chain = interval_tree.lookup (time_microseconds);
-    if (!chain) {
-	chain = new (std::nothrow) TimerChain;
-        assert (chain);
-	chain->interval_microseconds = time_microseconds;
-	chain->nearest_time = timer->due_time;
-
-	if (expiration_tree.isEmpty()
-	    || expiration_tree_leftmost->nearest_time > chain->nearest_time)
-	{
-	    first_timer = true;
-	}
-
-	interval_tree.add (chain);
-	expiration_tree.add (chain);
-	expiration_tree_leftmost = expiration_tree.getLeftmost();
+    if (num_timers == 0) {
+      // Nothing to process in between, skipping idle ticks.
+        Uint64 const now_tick = cur_time / TickMicroseconds;
+        if (cur_tick < now_tick)
+            cur_tick = now_tick;
     }
 
-    timer->chain = chain;
-    chain->timer_list.append (timer);
+    timer->active = true;
+    wheelAdd (timer);
+
+    bool first_timer = false;
+    if (timer->due_time < sleep_deadline) {
+        sleep_deadline = timer->due_time;
+        first_timer = true;
+    }
 
     mutex.unlock ();
 
@@ -98,33 +289,34 @@ Timers::addTimer_microseconds (CbDesc<TimerCallback> const &cb,
 	first_added_cb.call_ ();
     }
 
-    return timer;
+    return TimerKey (timer, generation);
 }
 
 void
 Timers::restartTimer (TimerKey const mt_nonnull timer_key)
 {
     Timer * const timer = timer_key;
-    TimerChain * const chain = timer->chain;
+    Time const cur_time = getTimeMicroseconds ();
 
     mutex.lock ();
 
+    if (!checkTimerKey (timer_key)) {
+        mutex.unlock ();
+        return;
+    }
+
     assert (timer->active);
 
-    expiration_tree.remove (chain);
+    wheelRemove (timer);
 
-    chain->timer_list.remove (timer);
-    timer->due_time = getTimeMicroseconds() + chain->interval_microseconds;
-    if (timer->due_time < chain->interval_microseconds) {
+    timer->due_time = cur_time + timer->interval_microseconds;
+    if (timer->due_time < timer->interval_microseconds) {
 	logW_ (_func, "Expiration time overflow");
 	timer->due_time = (Time) -1;
     }
+    timer->due_tick = timeToTick (timer->due_time);
 
-    chain->timer_list.append (timer);
-
-    chain->nearest_time = chain->timer_list.getFirst()->due_time;
-    expiration_tree.add (chain);
-    expiration_tree_leftmost = expiration_tree.getLeftmost();
+    wheelAdd (timer);
 
     mutex.unlock ();
 }
@@ -134,6 +326,13 @@ Timers::deleteTimer (TimerKey const mt_nonnull timer_key)
 {
     Timer * const timer = timer_key;
 
+    mutex.lock ();
+    if (!checkTimerKey (timer_key)) {
+        mutex.unlock ();
+        return;
+    }
+    mutex.unlock ();
+
     if (timer->del_sbn) {
         CodeRef const code_ref = timer->timer_cb.getWeakCodeRef();
         if (!code_ref) {
@@ -151,35 +350,14 @@ Timers::deleteTimer (TimerKey const mt_nonnull timer_key)
 void
 Timers::doDeleteTimer (Timer * const timer)
 {
-    TimerChain * const chain = timer->chain;
-
     mutex.lock ();
-
     if (timer->active) {
 	timer->active = false;
-
-	expiration_tree.remove (chain);
-
-	chain->timer_list.remove (timer);
-	if (chain->timer_list.isEmpty ()) {
-	    expiration_tree_leftmost = expiration_tree.getLeftmost();
-	    interval_tree.remove (chain);
-	    mutex.unlock ();
-
-            delete chain;
-            delete timer;
-
-	    return;
-	}
-
-	chain->nearest_time = chain->timer_list.getFirst ()->due_time;
-	expiration_tree.add (chain);
-	expiration_tree_leftmost = expiration_tree.getLeftmost();
+        wheelRemove (timer);
     }
-
     mutex.unlock ();
 
-    delete timer;
+    releaseTimer (timer);
 }
 
 Time
@@ -189,112 +367,107 @@ Timers::getSleepTime_microseconds ()
 
   MutexLock l (&mutex);
 
-    TimerChain * const chain = expiration_tree_leftmost;
-    if (chain == NULL) {
-	logD (timers, _func, ": null chain");
+    if (num_timers == 0) {
+	logD (timers, _func, ": no timers");
+        sleep_deadline = (Time) -1;
 	return (Time) -1;
     }
 
-    if (chain->nearest_time <= cur_time) {
+    sleep_deadline = tickToTime (getNextTick ());
+
+    if (sleep_deadline <= cur_time) {
 	logD (timers, _func, ": now");
 	return 0;
     }
 
-    logD (timers, _func, ": nearest: ", chain->nearest_time, ", cur: ", cur_time, ", delta: ", chain->nearest_time - cur_time);
+    logD (timers, _func, ": nearest: ", sleep_deadline, ", cur: ", cur_time, ", delta: ", sleep_deadline - cur_time);
 
-    return chain->nearest_time - cur_time;
+    return sleep_deadline - cur_time;
 }
 
 void
 Timers::processTimers ()
 {
     Time const cur_time = getTimeMicroseconds ();
+    Uint64 const target_tick = cur_time / TickMicroseconds;
 
     mutex.lock ();
 
-    TimerChain *chain = expiration_tree_leftmost;
-    if (chain == NULL) {
-	mutex.unlock ();
-	return;
-    }
+    for (;;) {
+        Uint64 const tick = (num_timers ? getNextTick () : (Uint64) -1);
+        if (tick > target_tick) {
+            if (cur_tick <= target_tick)
+                cur_tick = target_tick + 1;
+
+            break;
+        }
+
+        cur_tick = tick;
+        cascade ();
+
+      // All timers in the current slot of level 0 are due, including the ones
+      // which are added by timer callbacks with zero timeout.
+        TimerList * const list = &wheels [0].slots [tick & (WheelSize - 1)];
+        while (!list->isEmpty ()) {
+            Timer * const timer = list->getFirst ();
+            assert (timer->active);
+            wheelRemove (timer);
+
+            logD (timers, _func, "due_time: ", timer->due_time, ", cur_time: ", cur_time);
+
+            bool delete_timer = false;
+            if (timer->periodical) {
+                timer->due_time += timer->interval_microseconds;
+                if (timer->due_time < timer->interval_microseconds) {
+                    logW_ (_func, "Expiration time overflow");
+                    timer->due_time = (Time) -1;
+                }
+                timer->due_tick = timeToTick (timer->due_time);
+                if (timer->due_tick <= tick) {
+                  // A timer which is already due again fires once more in this
+                  // pass, like a one-shot timer with zero timeout.
+                    if (timer->due_time > cur_time || timer->interval_microseconds == 0)
+                        timer->due_tick = tick + 1;
+                }
 
-    while (!chain->timer_list.isEmpty () && chain->nearest_time <= cur_time) {
-	Time const cur_nearest_time = chain->nearest_time;
-
-	logD (timers, _func, "cur_nearest_time: ", cur_nearest_time, ", cur_time: ", cur_time);
-
-	Timer * const timer = chain->timer_list.getFirst ();
-	assert (timer->active);
-	chain->timer_list.remove (timer);
-
-        bool delete_timer = false;
-	if (timer->periodical) {
-	    timer->due_time += chain->interval_microseconds;
-	    if (timer->due_time < chain->interval_microseconds) {
-		logW_ (_func, "Expiration time overflow");
-		timer->due_time = (Time) -1;
-	    }
-	    chain->timer_list.append (timer);
-	} else {
-	    timer->active = false;
-
-            if (timer->delete_after_tick) {
-                if (timer->del_sbn) {
-                    // TODO We create CodeRef twice: here and in call_unlocks_mutex_().
-                    //      Should do this only once for efficiency.
-                    CodeRef const code_ref = timer->timer_cb.getWeakCodeRef();
-                    // If 'code_ref' is null, then doDeleteTimer() will be called
-                    // by subscriberDeletionCallback(), which is likely just about
-                    // to be called.
-                    if (code_ref) {
-                        code_ref->removeDeletionCallback (timer->del_sbn);
+                wheelAdd (timer);
+            } else {
+                timer->active = false;
+
+                if (timer->delete_after_tick) {
+                    if (timer->del_sbn) {
+                        // TODO We create CodeRef twice: here and in call_unlocks_mutex_().
+                        //      Should do this only once for efficiency.
+                        CodeRef const code_ref = timer->timer_cb.getWeakCodeRef();
+                        // If 'code_ref' is null, then doDeleteTimer() will be called
+                        // by subscriberDeletionCallback(), which is likely just about
+                        // to be called.
+                        if (code_ref) {
+                            code_ref->removeDeletionCallback (timer->del_sbn);
+                            delete_timer = true;
+                        }
+                    } else {
                         delete_timer = true;
                     }
-                } else {
-                    delete_timer = true;
                 }
             }
-	}
-
-	bool delete_chain;
-	if (chain->timer_list.isEmpty ()) {
-	    expiration_tree.remove (chain);
-	    expiration_tree_leftmost = expiration_tree.getLeftmost();
-	    interval_tree.remove (chain);
-	    delete_chain = true;
-	} else {
-	    if (cur_nearest_time != chain->timer_list.getFirst ()->due_time) {
-		expiration_tree.remove (chain);
-		chain->nearest_time = chain->timer_list.getFirst ()->due_time;
-		expiration_tree.add (chain);
-		expiration_tree_leftmost = expiration_tree.getLeftmost();
-	    }
-	    delete_chain = false;
-	}
-
-	timer->timer_cb.call_unlocks_mutex_ (mutex);
-
-      // 'timer' might have been deleted by the user and should not be used
-      // directly anymore.
-      //
-      // We can't delete the timer ourselves here for a similar reason: its
-      // lifetime is controlled by the user, so we can't tie it to callback's
-      // weak_obj.
-
-        if (delete_timer)
-            delete timer;
 
-	if (delete_chain)
-	    delete chain;
+            timer->timer_cb.call_unlocks_mutex_ (mutex);
+
+          // 'timer' might have been deleted by the user and should not be used
+          // directly anymore.
+          //
+          // We can't delete the timer ourselves here for a similar reason: its
+          // lifetime is controlled by the user, so we can't tie it to callback's
+          // weak_obj.
 
-	mutex.lock ();
+            if (delete_timer)
+                releaseTimer (timer);
+
+            mutex.lock ();
+        }
 
-	// 'chain' might have been deleted due to user's actions in 'timer_cb' callback.
-	chain = expiration_tree_leftmost;
-	if (chain == NULL) {
-	    mutex.unlock ();
-	    return;
-	}
+        cur_tick = tick + 1;
     }
 
     mutex.unlock ();
@@ -302,14 +475,20 @@ Timers::processTimers ()
 
 Timers::Timers (Object * const coderef_container)
     : DependentCodeReferenced (coderef_container),
-      expiration_tree_leftmost (NULL)
+      num_timers (0),
+      cur_tick (getTimeMicroseconds() / TickMicroseconds),
+      sleep_deadline ((Time) -1),
+      timer_pool_size (0)
 {
 }
 
 Timers::Timers (Object * const coderef_container,
                 CbDesc<FirstTimerAddedCallback> const &first_added_cb)
     : DependentCodeReferenced (coderef_container),
-      expiration_tree_leftmost (NULL),
+      num_timers (0),
+      cur_tick (getTimeMicroseconds() / TickMicroseconds),
+      sleep_deadline ((Time) -1),
+      timer_pool_size (0),
       first_added_cb (first_added_cb)
 {
 }
@@ -318,28 +497,23 @@ Timers::~Timers ()
 {
     mutex.lock ();
 
-    {
-        ChainCleanupList chain_list;
-        {
-            IntervalTree::Iterator chain_iter (interval_tree);
-            while (!chain_iter.done ()) {
-                TimerChain * const chain = chain_iter.next ();
-                chain_list.append (chain);
-            }
-        }
-
-        ChainCleanupList::iter chain_iter (chain_list);
-        while (!chain_list.iter_done (chain_iter)) {
-            TimerChain * const chain = chain_list.iter_next (chain_iter);
-
-            IntrusiveList<Timer>::iter timer_iter (chain->timer_list);
-            while (!chain->timer_list.iter_done (timer_iter)) {
-                Timer * const timer = chain->timer_list.iter_next (timer_iter);
+    for (unsigned level = 0; level < NumLevels; ++level) {
+        for (unsigned slot = 0; slot < WheelSize; ++slot) {
+            TimerList * const list = &wheels [level].slots [slot];
+            TimerList::iter timer_iter (*list);
+            while (!list->iter_done (timer_iter)) {
+                Timer * const timer = list->iter_next (timer_iter);
                 assert (timer->active);
                 delete timer;
             }
+        }
+    }
 
-            delete chain;
+    {
+        TimerList::iter timer_iter (timer_pool);
+        while (!timer_pool.iter_done (timer_iter)) {
+            Timer * const timer = timer_pool.iter_next (timer_iter);
+            delete timer;
         }
     }
 
@@ -23,7 +23,6 @@
 
 #include <libmary/types.h>
 #include <libmary/intrusive_list.h>
-#include <libmary/intrusive_avl_tree.h>
 #include <libmary/code_referenced.h>
 #include <libmary/cb.h>
 #include <libmary/mutex.h>
@@ -31,14 +30,25 @@
 
 namespace M {
 
-// Алгоритм работы таймеров:
-// 1. Таймеры группируются по периоду срабатывания;
-// 2. Группы таймеров сортируются AVL-деревом;
-// 3. После срабатывания таймера переставляем группу по следующему таймеру
-//    с тем же интервалом;
-// 4. Два типа таймеров: одноразовые и периодические.
+// Timers are kept in a hierarchical timing wheel (see Varghese & Lauck,
+// "Hashed and Hierarchical Timing Wheels"). Time is divided into ticks of
+// TickMicroseconds. Level 0 of the wheel holds timers which expire within
+// the next WheelSize ticks, one slot per tick. Every next level covers
+// WheelSize times longer period with the same number of slots. When level 0
+// wraps around, timers from the current slot of level 1 are redistributed
+// into lower levels ("cascaded"), and so on.
 //
-// Таймеры должны быть MT-safe.
+// Adding and deleting a timer are O(1) operations. Timers expire with
+// precision of one tick: a timer never fires early, but may fire up to
+// TickMicroseconds late.
+//
+// Deleted Timer objects are reused for new timers. A TimerKey of a deleted
+// timer (e.g. of an auto-deleted timer which has fired) may thus point to
+// a timer which belongs to someone else. Keys carry the generation of the
+// timer to detect that: restartTimer() and deleteTimer() ignore stale keys
+// with a warning. Stale keys are still a bug in the caller.
+//
+// Timers are MT-safe.
 
 class Timers : public DependentCodeReferenced
 {
@@ -46,7 +56,6 @@ private:
     Mutex mutex;
 
     class Timer;
-    class TimerChain;
 
 public:
     class TimerKey
@@ -54,12 +63,14 @@ public:
         friend class Timers;
     private:
         Timer *timer;
+        // Timer::generation at the moment the timer was added.
+        Uint32 generation;
         Timer* operator -> () const { return timer; }
         operator Timer* () const { return timer; }
     public:
         operator bool () const { return timer; }
-        TimerKey (Timer * const timer) : timer (timer) {}
-        TimerKey () : timer (NULL) {}
+        TimerKey (Timer * const timer, Uint32 const generation = 0) : timer (timer), generation (generation) {}
+        TimerKey () : timer (NULL), generation (0) {}
     };
 
     typedef void (TimerCallback) (void *cb_data);
@@ -76,60 +87,84 @@ private:
 	mt_const bool periodical;
         mt_const bool delete_after_tick;
 	mt_const Cb<TimerCallback> timer_cb;
-	mt_const TimerChain *chain;
+	mt_const Time interval_microseconds;
 
 	mt_mutex (Timers::mutex) Time due_time;
+        // Expiration time rounded up to the nearest tick.
+        mt_mutex (Timers::mutex) Uint64 due_tick;
+
+        // Position of the timer in the wheel.
+        mt_mutex (Timers::mutex) unsigned level;
+        mt_mutex (Timers::mutex) unsigned slot;
+
 	mt_mutex (Timers::mutex) bool active;
 
-	Timer (Timers * const timers,
-               CbDesc<TimerCallback> const &timer_cb)
+        // Incremented every time the timer is deleted.
+        mt_mutex (Timers::mutex) Uint32 generation;
+
+	Timer (Timers * const timers)
 	    : timers (timers),
-              timer_cb (timer_cb),
-	      active (true)
+	      active (false),
+	      generation (0)
 	{
 	}
     };
 
-    class IntervalTree_name;
-    class ExpirationTree_name;
-    class ChainCleanupList_name;
+    typedef IntrusiveList<Timer> TimerList;
 
-    // A chain of timers with the same expiration interval.
-    class TimerChain : public IntrusiveAvlTree_Node<IntervalTree_name>,
-		       public IntrusiveAvlTree_Node<ExpirationTree_name>,
-                       public IntrusiveListElement<ChainCleanupList_name>
+public:
+    enum {
+        TickMicroseconds = 1000,
+        WheelBits = 6,
+        WheelSize = 1 << WheelBits,
+        NumLevels = 8,
+        // Max number of deleted Timer objects kept for reuse.
+        MaxPooledTimers = 1024
+    };
+
+private:
+    struct Wheel
     {
-    public:
-	mt_const Time interval_microseconds;
+        TimerList slots [WheelSize];
+        // Bit N is set when slots[N] is not empty.
+        Uint64 occupied;
 
-	mt_mutex (Timers::mutex) IntrusiveList<Timer> timer_list;
-	// Nearest expiration time.
-	mt_mutex (Timers::mutex) Time nearest_time;
+        Wheel () : occupied (0) {}
     };
 
-    typedef IntrusiveAvlTree< TimerChain,
-			      MemberExtractor< TimerChain const,
-					       Time const,
-					       &TimerChain::interval_microseconds >,
-			      DirectComparator<Time>,
-			      IntervalTree_name >
-	    IntervalTree;
-
-    typedef IntrusiveAvlTree< TimerChain,
-			      MemberExtractor< TimerChain const,
-					       Time const,
-					       &TimerChain::nearest_time >,
-			      DirectComparator<Time>,
-			      ExpirationTree_name >
-	    ExpirationTree;
-
-    typedef IntrusiveList< TimerChain, ChainCleanupList_name > ChainCleanupList;
-
-    // Chains sorted by interval_microseconds.
-    mt_mutex (mutex) IntervalTree interval_tree;
-    // Chains sorted by nearest_time.
-    mt_mutex (mutex) ExpirationTree expiration_tree;
-    mt_mutex (mutex) TimerChain *expiration_tree_leftmost;
+    mt_mutex (mutex) Wheel wheels [NumLevels];
+    mt_mutex (mutex) Count num_timers;
+
+    // The next tick to be processed by processTimers().
+    mt_mutex (mutex) Uint64 cur_tick;
+
+    // The moment until which the user has been told to sleep by the last call
+    // to getSleepTime_microseconds(). Adding a timer which expires earlier
+    // than that results in a call to first_added_cb.
+    mt_mutex (mutex) Time sleep_deadline;
+
+    // Deleted Timer objects ready for reuse.
+    mt_mutex (mutex) TimerList timer_pool;
+    mt_mutex (mutex) Count timer_pool_size;
+
+    mt_mutex (mutex) Timer* allocTimer ();
+
+    // Returns false if 'timer_key' refers to a deleted timer.
+    mt_mutex (mutex) bool checkTimerKey (TimerKey timer_key);
+
+    void releaseTimer (Timer * mt_nonnull timer);
+
+    mt_mutex (mutex) void wheelAdd (Timer * mt_nonnull timer);
+
+    mt_mutex (mutex) void wheelRemove (Timer * mt_nonnull timer);
+
+    // Redistributes timers from the current slots of higher levels
+    // when lower levels wrap around at cur_tick.
+    mt_mutex (mutex) void cascade ();
+
+    // Returns the nearest tick at which a timer expires or a cascade
+    // is due, or (Uint64) -1 if there are no timers.
+    mt_mutex (mutex) Uint64 getNextTick ();
 
     mt_const Cb<FirstTimerAddedCallback> first_added_cb;
 
@@ -194,8 +229,8 @@ public:
 
     void processTimers ();
 
-    // @cb is called whenever a new timer appears at the head of timer chain,
-    // i.e. when the nearest expiration time changes.
+    // @cb is called whenever a new timer expires earlier than the sleep time
+    // returned by the last call to getSleepTime_microseconds().
     mt_const void setFirstTimerAddedCallback (CbDesc<FirstTimerAddedCallback> const &cb)
     {
 	first_added_cb = cb;
@@ -203,8 +238,7 @@ public:
 
     Timers (Object *coderef_container);
 
-    // @cb is called whenever a new timer appears at the head of timer chain,
-    // i.e. when the nearest expiration time changes.
+    // See setFirstTimerAddedCallback().
      Timers (Object *coderef_container,
              CbDesc<FirstTimerAddedCallback> const &first_added_cb);
     ~Timers ();
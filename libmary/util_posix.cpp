@@ -21,6 +21,11 @@
 #include <errno.h>
 #include <unistd.h>
 #include <fcntl.h>
+#ifdef __linux__
+#include <sched.h>
+#include <sys/syscall.h>
+#include <sys/eventfd.h>
+#endif
 
 #include <libmary/log.h>
 #include <libmary/util_dev.h>
@@ -73,6 +78,57 @@ mt_throws Result posix_createNonblockingPipe (int (*fd) [2])
     return Result::Success;
 }
 
+mt_throws Result posix_createTriggerPipe (int (*fd) [2])
+{
+#ifdef __linux__
+    int const efd = eventfd (0 /* initval */, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (efd == -1) {
+        exc_throw (PosixException, errno);
+        exc_push (InternalException, InternalException::BackendError);
+        logE_ (_func, "eventfd() failed: ", errnoString (errno));
+        return Result::Failure;
+    }
+
+    (*fd) [0] = efd;
+    (*fd) [1] = efd;
+    return Result::Success;
+#else
+    return posix_createNonblockingPipe (fd);
+#endif
+}
+
+void posix_closeTriggerPipe (int (*fd) [2])
+{
+    for (int i = 0; i < 2; ++i) {
+        if ((*fd) [i] == -1)
+            continue;
+
+        if (i == 1 && (*fd) [1] == (*fd) [0]) {
+          // eventfd
+            (*fd) [1] = -1;
+            break;
+        }
+
+        for (;;) {
+            int const res = close ((*fd) [i]);
+            if (res == -1) {
+                if (errno == EINTR)
+                    continue;
+
+                logE_ (_func, "trigger_pipe[", i, "]: close() failed: ", errnoString (errno));
+            } else
+            if (res != 0) {
+                logE_ (_func, "trigger_pipe[", i, "]: close(): unexpected return value: ", res);
+            }
+
+            break;
+        }
+    }
+
+    (*fd) [0] = -1;
+    (*fd) [1] = -1;
+}
+
 mt_throws Result commonTriggerPipeWrite (int const fd)
 {
     for (;;) {
@@ -166,6 +222,138 @@ mt_throws Result commonTriggerPipeRead (int const fd)
 
     return Result::Success;
 }
+
+mt_throws Result posix_triggerPipeWrite (int const fd)
+{
+#ifdef __linux__
+    for (;;) {
+        Uint64 const val = 1;
+        ssize_t const res = write (fd, &val, sizeof (val));
+        if (res == -1) {
+            if (errno == EINTR)
+                continue;
+
+            // The counter is about to overflow, which means that there's
+            // a pending wakeup anyway.
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+	    exc_throw (PosixException, errno);
+	    exc_push (InternalException, InternalException::BackendError);
+	    logE_ (_func, "write() failed (eventfd): ", errnoString (errno));
+	    return Result::Failure;
+        } else
+	if (res != sizeof (val)) {
+	    exc_throw (InternalException, InternalException::BackendMalfunction);
+	    logE_ (_func, "write(): unexpected return value (eventfd): ", res);
+	    return Result::Failure;
+	}
+
+        break;
+    }
+
+    return Result::Success;
+#else
+    return commonTriggerPipeWrite (fd);
+#endif
+}
+
+mt_throws Result posix_triggerPipeRead (int const fd)
+{
+#ifdef __linux__
+    for (;;) {
+        // Reading resets the counter, a single read() is enough.
+        Uint64 val;
+        ssize_t const res = read (fd, &val, sizeof (val));
+        if (res == -1) {
+            if (errno == EINTR)
+                continue;
+
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+
+	    exc_throw (PosixException, errno);
+	    exc_push (InternalException, InternalException::BackendError);
+	    logE_ (_func, "read() failed (eventfd): ", errnoString (errno));
+	    return Result::Failure;
+        } else
+	if (res != sizeof (val)) {
+	    exc_throw (InternalException, InternalException::BackendMalfunction);
+	    logE_ (_func, "read(): unexpected return value (eventfd): ", res);
+	    return Result::Failure;
+	}
+
+        break;
+    }
+
+    return Result::Success;
+#else
+    return commonTriggerPipeRead (fd);
+#endif
+}
+
+mt_throws Result posix_setThreadCpu (Count const cpu)
+{
+#ifdef __linux__
+    cpu_set_t * const cpu_set = CPU_ALLOC (cpu + 1);
+    if (!cpu_set) {
+        exc_throw (InternalException, InternalException::BackendError);
+        logE_ (_func, "CPU_ALLOC() failed");
+        return Result::Failure;
+    }
+
+    Size const cpu_set_size = CPU_ALLOC_SIZE (cpu + 1);
+    CPU_ZERO_S (cpu_set_size, cpu_set);
+    CPU_SET_S (cpu, cpu_set_size, cpu_set);
+
+    int const res = sched_setaffinity (0 /* pid: calling thread */, cpu_set_size, cpu_set);
+    int const err = errno;
+    CPU_FREE (cpu_set);
+    if (res == -1) {
+        exc_throw (PosixException, err);
+        exc_push (InternalException, InternalException::BackendError);
+        logE_ (_func, "sched_setaffinity() failed (cpu ", cpu, "): ", errnoString (err));
+        return Result::Failure;
+    } else
+    if (res != 0) {
+        exc_throw (InternalException, InternalException::BackendMalfunction);
+        logE_ (_func, "sched_setaffinity(): unexpected return value: ", res);
+        return Result::Failure;
+    }
+
+    return Result::Success;
+#else
+    (void) cpu;
+    exc_throw (InternalException, InternalException::NotImplemented);
+    return Result::Failure;
+#endif
+}
+
+mt_throws Result posix_getThreadCpu (Count * const mt_nonnull ret_cpu,
+                                     Count * const mt_nonnull ret_numa_node)
+{
+#if defined (__linux__) && defined (SYS_getcpu)
+    unsigned cpu = 0;
+    unsigned node = 0;
+    // getcpu() wrapper is missing in older glibc versions.
+    long const res = syscall (SYS_getcpu, &cpu, &node, (void*) NULL);
+    if (res == -1) {
+        exc_throw (PosixException, errno);
+        exc_push (InternalException, InternalException::BackendError);
+        logE_ (_func, "getcpu() failed: ", errnoString (errno));
+        return Result::Failure;
+    }
+
+    *ret_cpu = (Count) cpu;
+    *ret_numa_node = (Count) node;
+    return Result::Success;
+#else
+    *ret_cpu = 0;
+    *ret_numa_node = 0;
+    exc_throw (InternalException, InternalException::NotImplemented);
+    return Result::Failure;
+#endif
+}
 #endif // LIBMARY_PLATFORM_WIN32
 
 mt_throws Result posix_statToFileStat (struct stat * const mt_nonnull stat_buf,
@@ -32,8 +32,30 @@ namespace M {
 #ifndef LIBMARY_PLATFORM_WIN32
 mt_throws Result posix_createNonblockingPipe (int (*fd) [2]);
 
+// Creates a wakeup channel for poll groups: (*fd)[0] is polled for input and
+// drained with posix_triggerPipeRead(), (*fd)[1] is signalled with
+// posix_triggerPipeWrite(). On Linux, this is a single eventfd object
+// ((*fd)[0] == (*fd)[1]), which coalesces wakeups in an 8-byte counter.
+// Otherwise, this is a non-blocking pipe.
+mt_throws Result posix_createTriggerPipe (int (*fd) [2]);
+
+// Closes descriptors created with posix_createTriggerPipe().
+void posix_closeTriggerPipe (int (*fd) [2]);
+
+mt_throws Result posix_triggerPipeWrite (int fd);
+mt_throws Result posix_triggerPipeRead  (int fd);
+
+// Signal and drain a non-blocking pipe.
 mt_throws Result commonTriggerPipeWrite (int fd);
 mt_throws Result commonTriggerPipeRead  (int fd);
+
+// Pins the calling thread to 'cpu'. Linux-only.
+mt_throws Result posix_setThreadCpu (Count cpu);
+
+// Returns the CPU the calling thread is running on and the NUMA node
+// of that CPU. Linux-only.
+mt_throws Result posix_getThreadCpu (Count * mt_nonnull ret_cpu,
+                                     Count * mt_nonnull ret_numa_node);
 #endif
 
 mt_throws Result posix_statToFileStat (struct stat * mt_nonnull stat_buf,
@@ -159,7 +159,7 @@ ComparisonResult compare (ConstMemory const &left,
 	return ComparisonResult::Less;
     }
 
-    int const res = memcmp (left.mem(), right.mem(), right.len());
+    int const res = memcmp (left.mem(), right.mem(), left.len());
     if (res == 0)
 	return ComparisonResult::Less;
 
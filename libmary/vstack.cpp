@@ -130,24 +130,25 @@ VStack::push_malign (Size const num_bytes,
 void
 VStack::setLevel (Level const new_level)
 {
-    if (!block_list.isEmpty ()) {
-        if (cur_block->start_level > new_level) {
-            Block * const prv_block = block_list.getPrevious (cur_block);
-
-            if (shrinking) {
-              // Deleting block.
-                delete[] cur_block->buf;
-                block_list.remove (cur_block);
-                delete cur_block;
-              // 'cur_block' is not valid anymore
-            }
-
-            cur_block = prv_block;
-        } else {
-            cur_block->height = new_level - cur_block->start_level;
+    // The new level may be several blocks below the current one,
+    // e.g. when the whole stack is cleared.
+    while (cur_block && cur_block->start_level > new_level) {
+        Block * const prv_block = block_list.getPrevious (cur_block);
+
+        if (shrinking) {
+          // Deleting block.
+            delete[] cur_block->buf;
+            block_list.remove (cur_block);
+            delete cur_block;
+          // 'cur_block' is not valid anymore
         }
+
+        cur_block = prv_block;
     }
 
+    if (cur_block)
+        cur_block->height = new_level - cur_block->start_level;
+
     level = new_level;
 }
 
@@ -0,0 +1,184 @@
+#include <libmary/libmary.h>
+
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <errno.h>
+
+
+using namespace M;
+
+
+// Compares flushing of DeferredConnectionSenderQueue with a writev() call
+// per connection and with batched io_uring writes (setBatchedFlush()).
+// Every round, each connection gets a short message, and the time spent
+// in DeferredProcessor::process() is measured.
+//
+// Usage: test__batched_flush [num_connections]
+
+namespace {
+
+Count num_conns = 10000;
+Count const num_rounds = 20;
+
+class TestConnection : public Object
+{
+public:
+    TcpConnection tcp_conn;
+    DeferredConnectionSender sender;
+
+    int peer_fd;
+
+    TestConnection ()
+        : tcp_conn (this /* coderef_container */),
+          sender   (this /* coderef_container */),
+          peer_fd  (-1)
+    {
+    }
+
+    ~TestConnection ()
+    {
+        if (peer_fd != -1)
+            close (peer_fd);
+    }
+};
+
+Ref<String> makeMessage (Count const round,
+                         Count const conn_idx)
+{
+    return makeString ("round ", round, " connection ", conn_idx, "\n");
+}
+
+bool checkReceived (TestConnection * const mt_nonnull test_conn,
+                    Count            const round,
+                    Count            const conn_idx)
+{
+    Ref<String> const expected = makeMessage (round, conn_idx);
+
+    Byte buf [256];
+    ssize_t const res = read (test_conn->peer_fd, buf, sizeof (buf));
+    if (res == -1) {
+        logE_ (_func, "connection ", conn_idx, ": read() failed: ", errnoString (errno));
+        return false;
+    }
+
+    if (!equal (ConstMemory (buf, (Size) res), expected->mem())) {
+        logE_ (_func, "connection ", conn_idx, ": unexpected data: ", ConstMemory (buf, (Size) res));
+        return false;
+    }
+
+    return true;
+}
+
+mt_throws Result runBenchmark (PagePool * const mt_nonnull page_pool,
+                               bool       const batched_flush,
+                               Time     * const mt_nonnull ret_microsec)
+{
+    *ret_microsec = 0;
+
+    DeferredProcessor deferred_processor (NULL /* coderef_container */);
+    DeferredConnectionSenderQueue dcs_queue (NULL /* coderef_container */);
+    dcs_queue.setBatchedFlush (batched_flush);
+    dcs_queue.setDeferredProcessor (&deferred_processor);
+
+    Result ret_res = Result::Success;
+
+    Ref<TestConnection> * const conns = new (std::nothrow) Ref<TestConnection> [num_conns];
+    assert (conns);
+    for (Count i = 0; i < num_conns; ++i) {
+        int fds [2];
+        if (socketpair (AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds) == -1) {
+            exc_throw (PosixException, errno);
+            logE_ (_func, "socketpair() failed: ", errnoString (errno));
+            ret_res = Result::Failure;
+            goto _return;
+        }
+
+        conns [i] = grab (new (std::nothrow) TestConnection);
+        conns [i]->tcp_conn.setFd (fds [0]);
+        conns [i]->peer_fd = fds [1];
+        conns [i]->sender.setConnection (&conns [i]->tcp_conn);
+        conns [i]->sender.setQueue (&dcs_queue);
+    }
+
+    for (Count round = 0; round < num_rounds; ++round) {
+        for (Count i = 0; i < num_conns; ++i)
+            conns [i]->sender.send (page_pool, true /* do_flush */, makeMessage (round, i)->mem());
+
+        updateTime ();
+        Time const start_microsec = getTimeMicroseconds ();
+
+        while (deferred_processor.process ());
+
+        updateTime ();
+        *ret_microsec += getTimeMicroseconds () - start_microsec;
+
+        for (Count i = 0; i < num_conns; ++i) {
+            if (!checkReceived (conns [i], round, i)) {
+                exc_throw (InternalException, InternalException::BackendMalfunction);
+                ret_res = Result::Failure;
+                goto _return;
+            }
+        }
+    }
+
+_return:
+    dcs_queue.release ();
+    delete[] conns;
+
+    return ret_res;
+}
+
+}
+
+int main (int argc, char **argv)
+{
+    libMaryInit ();
+
+    if (argc >= 2) {
+        Uint32 value;
+        if (!strToUint32_safe (argv [1], &value) || value == 0) {
+            logE_ (_func, "bad number of connections: ", argv [1]);
+            return EXIT_FAILURE;
+        }
+        num_conns = value;
+    }
+
+    {
+      // Two descriptors per connection.
+        struct rlimit rlim;
+        if (getrlimit (RLIMIT_NOFILE, &rlim) == 0
+            && rlim.rlim_cur < num_conns * 2 + 64)
+        {
+            rlim.rlim_cur = num_conns * 2 + 64;
+            if (rlim.rlim_max < rlim.rlim_cur)
+                rlim.rlim_max = rlim.rlim_cur;
+
+            if (setrlimit (RLIMIT_NOFILE, &rlim) == -1)
+                logW_ (_func, "setrlimit() failed: ", errnoString (errno));
+        }
+    }
+
+    PagePool page_pool (NULL /* coderef_container */, 4096 /* page_size */, 4096 /* min_pages */);
+
+    Time loop_microsec;
+    if (!runBenchmark (&page_pool, false /* batched_flush */, &loop_microsec)) {
+        logE_ (_func, "per-connection flush failed: ", exc->toString());
+        return EXIT_FAILURE;
+    }
+
+    Time batched_microsec;
+    if (!runBenchmark (&page_pool, true /* batched_flush */, &batched_microsec)) {
+        logE_ (_func, "batched flush failed: ", exc->toString());
+        return EXIT_FAILURE;
+    }
+
+    logI_ (_func, num_conns, " connections, ", num_rounds, " rounds");
+    logI_ (_func, "per-connection writev(): ", loop_microsec / num_rounds, " us/round");
+    logI_ (_func, "batched flush:           ", batched_microsec / num_rounds, " us/round");
+
+    logI_ (_func, "OK");
+
+    return 0;
+}
+
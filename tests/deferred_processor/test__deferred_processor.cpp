@@ -0,0 +1,170 @@
+#include <libmary/libmary.h>
+
+
+using namespace M;
+
+
+// Checks when DeferredProcessor runs tasks which are scheduled while
+// process() is running: such tasks must run during the next process() call.
+
+namespace {
+
+class TestTask
+{
+public:
+    DeferredProcessor::Task task;
+
+    Count num_runs;
+
+    // Scheduled by the callback before it returns.
+    TestTask *schedule_task;
+    // Return value of the callback.
+    bool extra_iteration;
+
+    TestTask ()
+        : num_runs        (0),
+          schedule_task   (NULL),
+          extra_iteration (false)
+    {}
+};
+
+DeferredProcessor::Registration *registration = NULL;
+
+bool taskCallback (void * const _test_task)
+{
+    TestTask * const test_task = static_cast <TestTask*> (_test_task);
+
+    ++test_task->num_runs;
+    if (test_task->schedule_task)
+        registration->scheduleTask (&test_task->schedule_task->task);
+
+    return test_task->extra_iteration;
+}
+
+void initTask (TestTask * const mt_nonnull test_task)
+{
+    test_task->task.cb = CbDesc<DeferredProcessor::TaskCallback> (taskCallback, test_task, NULL);
+}
+
+// 'expected_more' is the expected return value of process().
+bool checkProcess (DeferredProcessor * const mt_nonnull deferred_processor,
+                   TestTask          * const mt_nonnull test_task,
+                   Count               const expected_num_runs,
+                   bool                const expected_more)
+{
+    bool const more = deferred_processor->process ();
+    if (test_task->num_runs != expected_num_runs || more != expected_more) {
+        logE_ (_func, "num_runs: ", test_task->num_runs, " (expected ", expected_num_runs, "), "
+               "more: ", more, " (expected ", expected_more, ")");
+        return false;
+    }
+
+    return true;
+}
+
+bool testSelfSchedule (DeferredProcessor * const mt_nonnull deferred_processor)
+{
+    TestTask a;
+    initTask (&a);
+    a.schedule_task = &a;
+
+    registration->scheduleTask (&a.task);
+    for (Count i = 1; i <= 3; ++i) {
+        if (!checkProcess (deferred_processor, &a, i, true))
+            return false;
+    }
+
+    a.schedule_task = NULL;
+    if (!checkProcess (deferred_processor, &a, 4, false))
+        return false;
+
+    if (!checkProcess (deferred_processor, &a, 4, false))
+        return false;
+
+    logI_ (_func, "OK");
+    return true;
+}
+
+bool testExtraIteration (DeferredProcessor * const mt_nonnull deferred_processor)
+{
+    TestTask a;
+    initTask (&a);
+    a.extra_iteration = true;
+
+    registration->scheduleTask (&a.task);
+    for (Count i = 1; i <= 3; ++i) {
+        if (!checkProcess (deferred_processor, &a, i, true))
+            return false;
+    }
+
+    a.extra_iteration = false;
+    if (!checkProcess (deferred_processor, &a, 4, false))
+        return false;
+
+    logI_ (_func, "OK");
+    return true;
+}
+
+bool testScheduleOther (DeferredProcessor * const mt_nonnull deferred_processor)
+{
+    TestTask a;
+    TestTask b;
+    initTask (&a);
+    initTask (&b);
+
+    // 'b' is not scheduled yet when 'a' runs.
+    a.schedule_task = &b;
+    registration->scheduleTask (&a.task);
+    if (!checkProcess (deferred_processor, &b, 0, true))
+        return false;
+
+    if (!checkProcess (deferred_processor, &b, 1, false))
+        return false;
+
+    // 'b' is waiting for its turn when 'a' schedules it again.
+    registration->scheduleTask (&a.task);
+    registration->scheduleTask (&b.task);
+    if (!checkProcess (deferred_processor, &b, 2, true))
+        return false;
+
+    a.schedule_task = NULL;
+    if (!checkProcess (deferred_processor, &b, 3, false))
+        return false;
+
+    if (a.num_runs != 2) {
+        logE_ (_func, "a.num_runs: ", a.num_runs);
+        return false;
+    }
+
+    logI_ (_func, "OK");
+    return true;
+}
+
+}
+
+int main (void)
+{
+    libMaryInit ();
+
+    Ref<Object> const container = grab (new (std::nothrow) Object);
+    DeferredProcessor deferred_processor (container);
+
+    DeferredProcessor::Registration reg;
+    reg.setDeferredProcessor (&deferred_processor);
+    registration = &reg;
+
+    int ret = EXIT_SUCCESS;
+    if (!testSelfSchedule (&deferred_processor)
+        || !testExtraIteration (&deferred_processor)
+        || !testScheduleOther (&deferred_processor))
+    {
+        ret = EXIT_FAILURE;
+    }
+
+    reg.release ();
+
+    if (ret == EXIT_SUCCESS)
+        logI_ (_func, "OK");
+
+    return ret;
+}
@@ -0,0 +1,239 @@
+#include <libmary/libmary.h>
+
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+
+using namespace M;
+
+
+// Checks that EpollPollGroup processes at most setMaxEventsPerWakeup()
+// events per poll iteration, and that busy-polling picks up pending events
+// without blocking.
+
+namespace {
+
+Count const num_pipes = 5;
+Count const max_events_per_wakeup = 2;
+
+struct TestPipe
+{
+    int fds [2];
+    PollGroup::PollableKey key;
+    Count num_events;
+};
+
+TestPipe pipes [num_pipes];
+
+EpollPollGroup *poll_group = NULL;
+bool trigger_when_done = false;
+Count total_events = 0;
+
+Count num_iterations = 0;
+ActivePollGroup::PollIterationStats last_stats;
+
+void pipe_processEvents (Uint32   const event_flags,
+                         void   * const _pipe)
+{
+    TestPipe * const pipe = static_cast <TestPipe*> (_pipe);
+
+    if (event_flags & PollGroup::Input) {
+        ++pipe->num_events;
+        ++total_events;
+
+        Byte buf [16];
+        while (read (pipe->fds [0], buf, sizeof (buf)) > 0);
+
+        if (trigger_when_done && total_events % num_pipes == 0) {
+            if (!poll_group->trigger ())
+                logE_ (_func, "trigger() failed: ", exc->toString());
+        }
+    }
+}
+
+void pipe_setFeedback (Cb<PollGroup::Feedback> const & /* feedback */,
+                       void * /* cb_data */)
+{
+}
+
+int pipe_getFd (void * const _pipe)
+{
+    TestPipe * const pipe = static_cast <TestPipe*> (_pipe);
+    return pipe->fds [0];
+}
+
+PollGroup::Pollable const pipe_pollable = {
+    pipe_processEvents,
+    pipe_setFeedback,
+    pipe_getFd
+};
+
+void pollIterationBegin (void * /* cb_data */)
+{
+    ++num_iterations;
+}
+
+bool pollIterationEnd (void * /* cb_data */)
+{
+    return false;
+}
+
+void pollIterationStats (ActivePollGroup::PollIterationStats const * const mt_nonnull stats,
+                         void * /* cb_data */)
+{
+    last_stats = *stats;
+}
+
+ActivePollGroup::Frontend const poll_frontend = {
+    pollIterationBegin,
+    pollIterationEnd,
+    pollIterationStats
+};
+
+Count countEvents ()
+{
+    Count num_events = 0;
+    for (Count i = 0; i < num_pipes; ++i)
+        num_events += pipes [i].num_events;
+
+    return num_events;
+}
+
+bool writeToPipes ()
+{
+    for (Count i = 0; i < num_pipes; ++i) {
+        if (write (pipes [i].fds [1], "x", 1) != 1) {
+            logE_ (_func, "write() failed: ", errnoString (errno));
+            return false;
+        }
+    }
+
+    return true;
+}
+
+mt_throws Result testMaxEventsPerWakeup ()
+{
+    if (!writeToPipes ())
+        return Result::Failure;
+
+    for (Count i = 0; ; ++i) {
+        Count const prv_num_events = countEvents ();
+        if (prv_num_events == num_pipes)
+            break;
+
+        if (i == num_pipes) {
+            logE_ (_func, "missing events: ", prv_num_events, " out of ", num_pipes);
+            return Result::Failure;
+        }
+
+        if (!poll_group->poll (0 /* timeout_microsec */))
+            return Result::Failure;
+
+        Count const expected = (num_pipes - prv_num_events < max_events_per_wakeup ?
+                                        num_pipes - prv_num_events : max_events_per_wakeup);
+        if (countEvents () - prv_num_events != expected
+            || last_stats.num_events != expected)
+        {
+            logE_ (_func, "iteration ", i, ": ", countEvents () - prv_num_events, " events, "
+                   "stats: ", last_stats.num_events, ", expected ", expected);
+            return Result::Failure;
+        }
+    }
+
+    logI_ (_func, "OK");
+    return Result::Success;
+}
+
+mt_throws Result testBusyPoll ()
+{
+    for (Count i = 0; i < num_pipes; ++i)
+        pipes [i].num_events = 0;
+
+    poll_group->setBusyPoll (100000 /* busy_poll_max_microsec */);
+
+    if (!writeToPipes ())
+        return Result::Failure;
+
+    // The last event triggers the poll group so that poll() returns.
+    trigger_when_done = true;
+    Count const prv_num_iterations = num_iterations;
+    if (!poll_group->poll (10000000 /* timeout_microsec */))
+        return Result::Failure;
+
+    trigger_when_done = false;
+
+    if (countEvents () != num_pipes) {
+        logE_ (_func, "missing events: ", countEvents (), " out of ", num_pipes);
+        return Result::Failure;
+    }
+
+    // All events are pending before poll(), so every spin gets some of them,
+    // and then the trigger stops busy-polling.
+    if (num_iterations - prv_num_iterations > num_pipes + 1) {
+        logE_ (_func, "too many iterations: ", num_iterations - prv_num_iterations);
+        return Result::Failure;
+    }
+
+    if (last_stats.blocked) {
+        logE_ (_func, "unexpected blocking poll");
+        return Result::Failure;
+    }
+
+    logI_ (_func, "OK");
+    return Result::Success;
+}
+
+}
+
+int main (void)
+{
+    libMaryInit ();
+
+    int ret = EXIT_SUCCESS;
+
+    poll_group = new (std::nothrow) EpollPollGroup (NULL /* coderef_container */);
+    assert (poll_group);
+    poll_group->setMaxEventsPerWakeup (max_events_per_wakeup);
+    poll_group->setFrontend (CbDesc<ActivePollGroup::Frontend> (&poll_frontend, NULL, NULL));
+
+    if (!poll_group->open ()) {
+        logE_ (_func, "open() failed: ", exc->toString());
+        delete poll_group;
+        return EXIT_FAILURE;
+    }
+
+    for (Count i = 0; i < num_pipes; ++i) {
+        int const res = pipe (pipes [i].fds);
+        assert (res == 0);
+        fcntl (pipes [i].fds [0], F_SETFL, O_NONBLOCK);
+
+        pipes [i].num_events = 0;
+        pipes [i].key = poll_group->addPollable (
+                CbDesc<PollGroup::Pollable> (&pipe_pollable, &pipes [i], NULL));
+        assert (pipes [i].key);
+    }
+
+    if (!testMaxEventsPerWakeup ()) {
+        logE_ (_func, "testMaxEventsPerWakeup() failed");
+        ret = EXIT_FAILURE;
+    }
+
+    if (ret == EXIT_SUCCESS && !testBusyPoll ()) {
+        logE_ (_func, "testBusyPoll() failed");
+        ret = EXIT_FAILURE;
+    }
+
+    for (Count i = 0; i < num_pipes; ++i) {
+        poll_group->removePollable (pipes [i].key);
+        close (pipes [i].fds [0]);
+        close (pipes [i].fds [1]);
+    }
+
+    delete poll_group;
+
+    if (ret == EXIT_SUCCESS)
+        logI_ (_func, "OK");
+
+    return ret;
+}
@@ -0,0 +1,86 @@
+#include <libmary/libmary.h>
+
+
+using namespace M;
+
+
+namespace {
+
+Count const num_keys = 100000;
+
+StringHash<Count>::EntryKey keys [num_keys];
+
+Ref<String> makeKey (Count const i)
+{
+    return makeString ("key_", i);
+}
+
+bool checkKeys (StringHash<Count> * const mt_nonnull hash,
+                Count const from,
+                Count const to,
+                bool  const present)
+{
+    for (Count i = from; i < to; ++i) {
+        StringHash<Count>::EntryKey const key = hash->lookup (makeKey (i)->mem());
+        if (present) {
+            if (!key || key.getData() != i) {
+                logE_ (_func, "key ", i, " not found");
+                return false;
+            }
+        } else {
+            if (key) {
+                logE_ (_func, "removed key ", i, " found");
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+}
+
+int main (void)
+{
+    libMaryInit ();
+
+    StringHash<Count> hash (4 /* initial_hash_size */);
+
+    // Lookups must work while the table is being rehashed.
+    for (Count i = 0; i < num_keys; ++i) {
+        keys [i] = hash.add (makeKey (i)->mem(), i);
+        if (i % 9973 == 0) {
+            if (!checkKeys (&hash, 0, i + 1, true /* present */))
+                return EXIT_FAILURE;
+        }
+    }
+
+    if (!checkKeys (&hash, 0, num_keys, true /* present */))
+        return EXIT_FAILURE;
+
+    for (Count i = 0; i < num_keys; i += 2)
+        hash.remove (keys [i]);
+
+    for (Count i = 0; i < num_keys; ++i) {
+        if (!checkKeys (&hash, i, i + 1, i % 2 /* present */))
+            return EXIT_FAILURE;
+    }
+
+    Count num_iterated = 0;
+    {
+        StringHash<Count>::iterator iter (hash);
+        while (!iter.done()) {
+            iter.next ();
+            ++num_iterated;
+        }
+    }
+
+    if (num_iterated != num_keys / 2) {
+        logE_ (_func, "iterated ", num_iterated, " entries, expected ", num_keys / 2);
+        return EXIT_FAILURE;
+    }
+
+    logI_ (_func, "OK");
+
+    return 0;
+}
@@ -0,0 +1,676 @@
+#include <libmary/libmary.h>
+
+
+using namespace M;
+
+
+// Feeds HTTP requests to HttpServer split at every possible byte boundary,
+// both as contiguous input (processInput) and as page lists
+// (processInputPages), and checks what the frontend gets.
+// Also checks the bytes which HttpChunkedWriter puts on the wire.
+
+namespace {
+
+// Small pages make request lines and header fields span page boundaries.
+Size const page_size = 16;
+
+PagePool *page_pool;
+
+class TestReceiver : public Receiver,
+                     public DependentCodeReferenced
+{
+public:
+    void unblockInput () {}
+
+    ProcessInputResult feed (Memory const mem,
+                             Size * const mt_nonnull ret_accepted)
+    {
+        ProcessInputResult res = ProcessInputResult::Error;
+        *ret_accepted = 0;
+        frontend.call_ret<ProcessInputResult> (&res, frontend->processInput, /*(*/ mem, ret_accepted /*)*/);
+        return res;
+    }
+
+    ProcessInputResult feedPages (Memory const mem,
+                                  Size * const mt_nonnull ret_accepted)
+    {
+      // Starting with a partially filled page to shift page boundaries.
+        Size const msg_offset = mem.len() % page_size;
+
+        PagePool::PageListHead page_list;
+        {
+            Byte fill [page_size];
+            memset (fill, '#', msg_offset);
+            page_pool->getFillPages (&page_list, ConstMemory (fill, msg_offset));
+        }
+        page_pool->getFillPages (&page_list, mem);
+
+        ProcessInputResult res = ProcessInputResult::Error;
+        *ret_accepted = 0;
+        frontend.call_ret<ProcessInputResult> (&res, frontend->processInputPages, /*(*/
+                page_list.first, msg_offset, mem.len(), ret_accepted /*)*/);
+
+        page_pool->msgUnref (page_list.first);
+        return res;
+    }
+
+    TestReceiver (Object * const coderef_container)
+        : DependentCodeReferenced (coderef_container)
+    {
+    }
+};
+
+Byte out_buf [1 << 16];
+Size out_len;
+
+// Max number of message body bytes accepted at once, zero for no limit.
+Size body_accept_limit;
+
+// If set, request() reports the values of these header fields.
+char const * const *dump_header_names;
+Count num_dump_header_names;
+
+void out (ConstMemory const mem)
+{
+    if (mem.len() == 0)
+        return;
+
+    assert (out_len + mem.len() <= sizeof (out_buf));
+    memcpy (out_buf + out_len, mem.mem(), mem.len());
+    out_len += mem.len();
+}
+
+void request (HttpRequest * const mt_nonnull req,
+              void        * const /* cb_data */)
+{
+    out (req->getRequestLine());
+    out (req->hasBody() ? ConstMemory (" body\n") : ConstMemory ("\n"));
+
+    if (num_dump_header_names > 0) {
+        for (Count i = 0; i < num_dump_header_names; ++i) {
+            ConstMemory const name (dump_header_names [i], strlen (dump_header_names [i]));
+            ConstMemory const value = req->getHeader (name);
+            out (name);
+            out (value.mem() ? ConstMemory (": [") : ConstMemory (": none\n"));
+            if (value.mem()) {
+                out (value);
+                out ("]\n");
+            }
+        }
+
+        ConstMemory const if_none_match = req->getIfNoneMatch ();
+        out ("getIfNoneMatch: [");
+        out (if_none_match);
+        out ("]\n");
+    }
+}
+
+void messageBody (HttpRequest * const mt_nonnull /* req */,
+                  Memory        const mem,
+                  bool          const end_of_request,
+                  Size        * const mt_nonnull ret_accepted,
+                  void        * const /* cb_data */)
+{
+    Size len = mem.len();
+    if (body_accept_limit && len > body_accept_limit && !end_of_request)
+        len = body_accept_limit;
+
+    out (mem.region (0, len));
+    if (end_of_request)
+        out ("|\n");
+
+    *ret_accepted = len;
+}
+
+void closed (HttpRequest * const /* req */,
+             Exception   * const /* exc_ */,
+             void        * const /* cb_data */)
+{
+}
+
+HttpServer::Frontend const http_frontend = {
+    request,
+    messageBody,
+    closed
+};
+
+// Appends every message sent to it to 'out_buf'.
+class CapturingSender : public Sender,
+                        public DependentCodeReferenced
+{
+public:
+    Count num_msgs;
+    // First page of the last message.
+    PagePool::Page *last_first_page;
+
+    void sendMessage (MessageEntry * const mt_nonnull msg_entry,
+                      bool           const /* do_flush */)
+    {
+        assert (msg_entry->type == MessageEntry::Pages);
+        MessageEntry_Pages * const msg_pages = static_cast <MessageEntry_Pages*> (msg_entry);
+
+        out (ConstMemory (msg_pages->getHeaderData(), msg_pages->header_len));
+
+        PagePool::Page *page = msg_pages->getFirstPage();
+        Size offset = msg_pages->msg_offset;
+        while (page) {
+            out (page->mem().region (offset));
+            offset = 0;
+            page = page->getNextMsgPage();
+        }
+
+        ++num_msgs;
+        last_first_page = msg_pages->getFirstPage();
+
+        deleteMessageEntry (msg_entry);
+    }
+
+    mt_mutex (mutex) void sendMessage_unlocked (MessageEntry * const mt_nonnull msg_entry,
+                                                bool           const do_flush)
+        { sendMessage (msg_entry, do_flush); }
+
+    void flush () {}
+    mt_mutex (mutex) void flush_unlocked () {}
+    void closeAfterFlush () {}
+    void close () {}
+    mt_mutex (mutex) bool isClosed_unlocked () { return false; }
+    mt_mutex (mutex) SendState getSendState_unlocked () { return ConnectionReady; }
+    void lock   () { mutex.lock (); }
+    void unlock () { mutex.unlock (); }
+
+    CapturingSender (Object * const coderef_container)
+        : Sender (coderef_container),
+          DependentCodeReferenced (coderef_container),
+          num_msgs (0),
+          last_first_page (NULL)
+    {
+    }
+};
+
+// Feeds 'stream' in portions of 'step' bytes. Unaccepted data is fed again
+// along with the next portion, the way ConnectionReceiver does it.
+// *ret_error is set if HttpServer reported an error.
+Result runStream (ConstMemory const stream,
+                  Size        const step,
+                  bool        const pages,
+                  bool      * const mt_nonnull ret_error)
+{
+    *ret_error = false;
+
+    Ref<Object> const container = grab (new (std::nothrow) Object);
+    TestReceiver receiver (container);
+    HttpServer http_server (container);
+
+    IpAddress client_addr;
+    setIpAddress (ConstMemory ("127.0.0.1"), 0, &client_addr);
+    http_server.init (CbDesc<HttpServer::Frontend> (&http_frontend, NULL, container),
+                      &receiver,
+                      NULL /* sender */,
+                      NULL /* page_pool */,
+                      client_addr);
+
+    out_len = 0;
+
+    static Byte buf [1 << 16];
+    assert (stream.len() <= sizeof (buf));
+
+    Size buf_len = 0;
+    Size pos = 0;
+    for (;;) {
+        Size toread = stream.len() - pos;
+        if (toread > step)
+            toread = step;
+
+        memcpy (buf + buf_len, stream.mem() + pos, toread);
+        buf_len += toread;
+        pos += toread;
+
+        Size accepted;
+        Receiver::ProcessInputResult const res =
+                pages ? receiver.feedPages (Memory (buf, buf_len), &accepted)
+                      : receiver.feed      (Memory (buf, buf_len), &accepted);
+        if (res == Receiver::ProcessInputResult::Error) {
+            *ret_error = true;
+            return Result::Failure;
+        }
+
+        assert (accepted <= buf_len);
+        memmove (buf, buf + accepted, buf_len - accepted);
+        buf_len -= accepted;
+
+        if (pos == stream.len() && (accepted == 0 || buf_len == 0))
+            break;
+    }
+
+    if (buf_len != 0)
+        return Result::Failure;
+
+    return Result::Success;
+}
+
+bool checkStream (char const * const name,
+                  ConstMemory  const stream,
+                  ConstMemory  const expected)
+{
+    for (unsigned pages = 0; pages <= 1; ++pages) {
+        for (Size step = 1; step <= stream.len(); ++step) {
+            bool error;
+            if (!runStream (stream, step, pages, &error)) {
+                logE_ (_func, name, ": step ", step, ", pages ", pages, ": unexpected error, got:\n",
+                       ConstMemory (out_buf, out_len));
+                return false;
+            }
+
+            if (!equal (ConstMemory (out_buf, out_len), expected)) {
+                logE_ (_func, name, ": step ", step, ", pages ", pages, ": got:\n",
+                       ConstMemory (out_buf, out_len), "\nexpected:\n", expected);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+// Checks that HttpServer reports an error for 'stream' after passing
+// 'expected' to the frontend.
+bool checkStreamError (char const * const name,
+                       ConstMemory  const stream,
+                       ConstMemory  const expected)
+{
+    for (unsigned pages = 0; pages <= 1; ++pages) {
+        for (Size step = 1; step <= stream.len(); ++step) {
+            bool error;
+            runStream (stream, step, pages, &error);
+            if (!error) {
+                logE_ (_func, name, ": step ", step, ", pages ", pages, ": no error, got:\n",
+                       ConstMemory (out_buf, out_len));
+                return false;
+            }
+
+            if (!equal (ConstMemory (out_buf, out_len), expected)) {
+                logE_ (_func, name, ": step ", step, ", pages ", pages, ": got:\n",
+                       ConstMemory (out_buf, out_len), "\nexpected:\n", expected);
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+bool testContentLength ()
+{
+    body_accept_limit = 0;
+    if (!checkStream ("content-length",
+                      "POST /upload/a HTTP/1.1\r\n"
+                      "Host: www.example.com\r\n"
+                      "Content-Length: 11\r\n"
+                      "\r\n"
+                      "hello world"
+                      "GET /index.html?long_query_to_span_pages=1 HTTP/1.1\r\n"
+                      "User-Agent: test__http_server with a long value\r\n"
+                      "\r\n",
+                      "POST /upload/a HTTP/1.1 body\n"
+                      "hello world|\n"
+                      "GET /index.html?long_query_to_span_pages=1 HTTP/1.1\n"))
+    {
+        return false;
+    }
+
+    body_accept_limit = 3;
+    if (!checkStream ("content-length, partial acceptance",
+                      "POST /a HTTP/1.1\r\n"
+                      "Content-Length: 20\r\n"
+                      "\r\n"
+                      "0123456789abcdefghij"
+                      "GET /b HTTP/1.1\r\n"
+                      "\r\n",
+                      "POST /a HTTP/1.1 body\n"
+                      "0123456789abcdefghij|\n"
+                      "GET /b HTTP/1.1\n"))
+    {
+        return false;
+    }
+    body_accept_limit = 0;
+
+    return true;
+}
+
+bool testChunked ()
+{
+    body_accept_limit = 0;
+    if (!checkStream ("chunked",
+                      "POST /upload/c HTTP/1.1\r\n"
+                      "Host: www.example.com\r\n"
+                      "Transfer-Encoding: chunked\r\n"
+                      "\r\n"
+                      "5\r\n"
+                      "hello\r\n"
+                      "1A\r\n"
+                      " world, spanning the pages\r\n"
+                      "0000000000000000001\r\n"
+                      "!\r\n"
+                      "0\r\n"
+                      "\r\n"
+                      "GET /next HTTP/1.1\r\n"
+                      "\r\n",
+                      "POST /upload/c HTTP/1.1 body\n"
+                      "hello world, spanning the pages!|\n"
+                      "GET /next HTTP/1.1\n"))
+    {
+        return false;
+    }
+
+    if (!checkStream ("chunked, extensions and trailers",
+                      "POST /e HTTP/1.1\r\n"
+                      "Transfer-Encoding: chunked\r\n"
+                      "Content-Length: 1000\r\n"
+                      "\r\n"
+                      "3;name=value\r\n"
+                      "abc\r\n"
+                      "4 ; a=\"b;c\"\r\n"
+                      "defg\r\n"
+                      "0;last\r\n"
+                      "Expires: never\r\n"
+                      "X-Checksum: 0123\r\n"
+                      "\r\n"
+                      "POST /next HTTP/1.1\r\n"
+                      "Content-Length: 3\r\n"
+                      "\r\n"
+                      "xyz",
+                      "POST /e HTTP/1.1 body\n"
+                      "abcdefg|\n"
+                      "POST /next HTTP/1.1 body\n"
+                      "xyz|\n"))
+    {
+        return false;
+    }
+
+    body_accept_limit = 3;
+    if (!checkStream ("chunked, partial acceptance",
+                      "POST /p HTTP/1.1\r\n"
+                      "Transfer-Encoding: chunked\r\n"
+                      "\r\n"
+                      "10\r\n"
+                      "0123456789abcdef\r\n"
+                      "7\r\n"
+                      "ghijklm\r\n"
+                      "0\r\n"
+                      "\r\n"
+                      "GET /next HTTP/1.1\r\n"
+                      "\r\n",
+                      "POST /p HTTP/1.1 body\n"
+                      "0123456789abcdefghijklm|\n"
+                      "GET /next HTTP/1.1\n"))
+    {
+        return false;
+    }
+    body_accept_limit = 0;
+
+    if (!checkStream ("chunked, other transfer codings",
+                      "POST /g HTTP/1.1\r\n"
+                      "Transfer-Encoding: chunked\r\n"
+                      "Transfer-Encoding: gzip,\tCHUNKED \r\n"
+                      "\r\n"
+                      "2\r\n"
+                      "gz\r\n"
+                      "0\r\n"
+                      "\r\n",
+                      "POST /g HTTP/1.1 body\n"
+                      "gz|\n"))
+    {
+        return false;
+    }
+
+    // The length of a request body cannot be determined
+    // if "chunked" is not the final transfer coding.
+    if (!checkStreamError ("not chunked",
+                           "POST /n HTTP/1.1\r\n"
+                           "Content-Length: 3\r\n"
+                           "Transfer-Encoding: gzip\r\n"
+                           "\r\n"
+                           "abc",
+                           ""))
+    {
+        return false;
+    }
+
+    if (!checkStreamError ("chunked, then gzip",
+                           "POST /n HTTP/1.1\r\n"
+                           "Transfer-Encoding: chunked\r\n"
+                           "Transfer-Encoding: gzip\r\n"
+                           "\r\n"
+                           "0\r\n"
+                           "\r\n",
+                           ""))
+    {
+        return false;
+    }
+
+    if (!checkStreamError ("not chunked, suffix",
+                           "POST /n HTTP/1.1\r\n"
+                           "Transfer-Encoding: notchunked\r\n"
+                           "\r\n"
+                           "0\r\n"
+                           "\r\n",
+                           ""))
+    {
+        return false;
+    }
+
+    if (!checkStreamError ("chunked, chunk-size overflow",
+                           "POST /o HTTP/1.1\r\n"
+                           "Transfer-Encoding: chunked\r\n"
+                           "\r\n"
+                           "10000000000000000\r\n"
+                           "x\r\n",
+                           "POST /o HTTP/1.1 body\n"))
+    {
+        return false;
+    }
+
+    if (!checkStreamError ("chunked, no chunk-size",
+                           "POST /s HTTP/1.1\r\n"
+                           "Transfer-Encoding: chunked\r\n"
+                           "\r\n"
+                           ";ext\r\n",
+                           "POST /s HTTP/1.1 body\n"))
+    {
+        return false;
+    }
+
+    if (!checkStreamError ("chunked, no CRLF after chunk data",
+                           "POST /d HTTP/1.1\r\n"
+                           "Transfer-Encoding: chunked\r\n"
+                           "\r\n"
+                           "3\r\n"
+                           "abcd\r\n"
+                           "0\r\n"
+                           "\r\n",
+                           "POST /d HTTP/1.1 body\n"
+                           "abc"))
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool testHeaders ()
+{
+    char const * const header_names [] = {
+        "If-None-Match",
+        "IF-NONE-MATCH",
+        "x-custom",
+        "X-Custom",
+        "X-Empty",
+        "Accept-Language",
+        "X-Missing",
+        "X-17"
+    };
+    dump_header_names = header_names;
+    num_dump_header_names = sizeof (header_names) / sizeof (*header_names);
+
+    // 20 header fields do not fit into a single HeaderChunk.
+    bool const res =
+            checkStream ("headers",
+                         "GET /h HTTP/1.1\r\n"
+                         "if-none-match: \"first\"\r\n"
+                         "X-Custom: one\r\n"
+                         "X-Empty:\r\n"
+                         "X-3: 3\r\n"
+                         "X-4: 4\r\n"
+                         "X-5: 5\r\n"
+                         "X-6: 6\r\n"
+                         "X-7: 7\r\n"
+                         "X-8: 8\r\n"
+                         "X-9: 9\r\n"
+                         "X-10: 10\r\n"
+                         "X-11: 11\r\n"
+                         "X-12: 12\r\n"
+                         "X-13: 13\r\n"
+                         "X-14: 14\r\n"
+                         "X-15: 15\r\n"
+                         "X-16: 16\r\n"
+                         "X-17: 17\r\n"
+                         "If-None-Match: \"second\"\r\n"
+                         "x-CUSTOM: two\r\n"
+                         "\r\n",
+                         "GET /h HTTP/1.1\n"
+                         "If-None-Match: [\"second\"]\n"
+                         "IF-NONE-MATCH: [\"second\"]\n"
+                         "x-custom: [two]\n"
+                         "X-Custom: [two]\n"
+                         "X-Empty: []\n"
+                         "Accept-Language: none\n"
+                         "X-Missing: none\n"
+                         "X-17: [17]\n"
+                         "getIfNoneMatch: [\"second\"]\n");
+
+    num_dump_header_names = 0;
+    return res;
+}
+
+bool checkChunkedOutput (char const * const name,
+                         ConstMemory  const expected)
+{
+    if (!equal (ConstMemory (out_buf, out_len), expected)) {
+        logE_ (_func, name, ": got:\n", ConstMemory (out_buf, out_len), "\nexpected:\n", expected);
+        return false;
+    }
+
+    return true;
+}
+
+bool testChunkedWriter ()
+{
+    CapturingSender sender (NULL /* coderef_container */);
+    HttpChunkedWriter writer;
+    writer.init (&sender, page_pool);
+
+    out_len = 0;
+
+    writer.send ("Hello, ", false /* do_flush */);
+
+    {
+      // Chunk data spans two pages and starts at an offset.
+        PagePool::PageListHead page_list;
+        page_pool->getFillPages (&page_list, "###abcdefghijklmnopqrstuvwxyz");
+        writer.sendPages (page_list.first, 3 /* msg_offset */, false /* do_flush */);
+        if (sender.last_first_page != page_list.first) {
+            logE_ (_func, "chunk data has been copied");
+            return false;
+        }
+    }
+
+    {
+      // Empty chunks would end the message body and should be skipped.
+        writer.send (ConstMemory(), false /* do_flush */);
+
+        PagePool::PageListHead page_list;
+        page_pool->getFillPages (&page_list, "##");
+        page_pool->msgRef (page_list.first);
+        writer.sendPages (page_list.first, 2 /* msg_offset */, false /* do_flush */);
+        if (page_list.first->getRefcount() != 1) {
+            logE_ (_func, "empty chunk pages have not been released");
+            return false;
+        }
+        page_pool->msgUnref (page_list.first);
+    }
+
+    {
+        Byte data [300];
+        memset (data, 'x', sizeof (data));
+        writer.send (ConstMemory (data, sizeof (data)), false /* do_flush */);
+    }
+
+    writer.sendLastChunk ();
+
+    if (sender.num_msgs != 4) {
+        logE_ (_func, "messages sent: ", sender.num_msgs);
+        return false;
+    }
+
+    {
+        static Byte expected [1024];
+        Size len = 0;
+        {
+            ConstMemory const head = "7\r\nHello, "
+                                     "\r\n1a\r\nabcdefghijklmnopqrstuvwxyz"
+                                     "\r\n12c\r\n";
+            memcpy (expected, head.mem(), head.len());
+            len += head.len();
+        }
+        memset (expected + len, 'x', 300);
+        len += 300;
+        {
+            ConstMemory const tail = "\r\n0\r\n\r\n";
+            memcpy (expected + len, tail.mem(), tail.len());
+            len += tail.len();
+        }
+
+        if (!checkChunkedOutput ("first reply", ConstMemory (expected, len)))
+            return false;
+    }
+
+    // The writer is reused for the next reply, which should not start with CRLF.
+    out_len = 0;
+    writer.send ("second", true /* do_flush */);
+    writer.sendLastChunk ();
+    if (!checkChunkedOutput ("second reply", "6\r\nsecond\r\n0\r\n\r\n"))
+        return false;
+
+    // An empty body.
+    out_len = 0;
+    writer.sendLastChunk ();
+    if (!checkChunkedOutput ("empty reply", "0\r\n\r\n"))
+        return false;
+
+    return true;
+}
+
+}
+
+int main (void)
+{
+    libMaryInit ();
+
+    PagePool pool (NULL /* coderef_container */, page_size, 16 /* min_pages */);
+    page_pool = &pool;
+
+    if (!testContentLength ())
+        return EXIT_FAILURE;
+
+    if (!testChunked ())
+        return EXIT_FAILURE;
+
+    if (!testHeaders ())
+        return EXIT_FAILURE;
+
+    if (!testChunkedWriter ())
+        return EXIT_FAILURE;
+
+    logI_ (_func, "OK");
+    return 0;
+}
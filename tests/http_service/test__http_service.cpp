@@ -0,0 +1,308 @@
+#include <libmary/libmary.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdlib.h>
+
+
+using namespace M;
+
+
+// Checks HttpService handler lookup: longest prefix matching, default
+// handlers of namespaces, and handlers added while the service is running.
+// Also checks that a header field which does not fit into a small receive
+// buffer closes the connection.
+
+namespace {
+
+Uint16 const test_port = 8082;
+// Port of the service with a small receive buffer.
+Uint16 const small_buf_port = 8083;
+Size const small_buf_len = 256;
+
+ServerApp   *server_app   = NULL;
+HttpService *http_service = NULL;
+HttpService *small_buf_service = NULL;
+PagePool    *page_pool    = NULL;
+
+Count num_failures = 0;
+
+// Replies with the handler's name, which is passed as 'cb_data'.
+Result httpRequest (HttpRequest  * const mt_nonnull /* req */,
+                    Sender       * const mt_nonnull conn_sender,
+                    Memory const & /* msg_body */,
+                    void        ** const mt_nonnull /* ret_msg_data */,
+                    void         * const cb_data)
+{
+    ConstMemory const name ((char const *) cb_data, strlen ((char const *) cb_data));
+    conn_sender->send (page_pool,
+                       true /* do_flush */,
+                       "HTTP/1.1 200 OK\r\n"
+                       "Content-Length: ", name.len(), "\r\n"
+                       "\r\n",
+                       name);
+    return Result::Success;
+}
+
+Result httpMessageBody (HttpRequest  * const /* req */,
+                        Sender       * const mt_nonnull /* conn_sender */,
+                        Memory const & /* mem */,
+                        bool           const /* end_of_request */,
+                        Size         * const mt_nonnull ret_accepted,
+                        void         * const /* msg_data */,
+                        void         * const /* cb_data */)
+{
+    *ret_accepted = 0;
+    return Result::Success;
+}
+
+HttpService::HttpHandler const http_handler = {
+    httpRequest,
+    httpMessageBody
+};
+
+void addHandler (char const * const path,
+                 char const * const name)
+{
+    http_service->addHttpHandler (
+            CbDesc<HttpService::HttpHandler> (&http_handler, (void*) name, NULL /* coderef_container */),
+            ConstMemory (path, strlen (path)));
+}
+
+// Requests 'path' and checks that the reply body is 'expected'.
+void checkPath (int          const fd,
+                char const * const path,
+                char const * const expected)
+{
+    Ref<String> const req = makeString ("GET ", path, " HTTP/1.1\r\n"
+                                        "Host: localhost\r\n"
+                                        "\r\n");
+    if (write (fd, req->mem().mem(), req->len()) != (ssize_t) req->len()) {
+        logE_ (_func, "write() failed: ", errnoString (errno));
+        ++num_failures;
+        return;
+    }
+
+    char buf [1024];
+    Size len = 0;
+    ConstMemory body;
+    for (;;) {
+        ssize_t const res = read (fd, buf + len, sizeof (buf) - 1 - len);
+        if (res <= 0)
+            break;
+
+        len += (Size) res;
+        buf [len] = 0;
+
+        char const * const header_end = strstr (buf, "\r\n\r\n");
+        char const * const content_length = strstr (buf, "Content-Length: ");
+        if (header_end && content_length) {
+            Size const body_len = (Size) atoi (content_length + 16);
+            Size const body_offs = (Size) (header_end + 4 - buf);
+            if (len - body_offs >= body_len) {
+                body = ConstMemory (buf + body_offs, body_len);
+                break;
+            }
+        }
+    }
+
+    if (!equal (body, ConstMemory (expected, strlen (expected)))) {
+        logE_ (_func, path, ": got \"", body, "\", expected \"", expected, "\"");
+        ++num_failures;
+    }
+}
+
+// Returns -1 on failure.
+int connectToPort (Uint16 const port)
+{
+    int const fd = socket (AF_INET, SOCK_STREAM, 0);
+    assert (fd != -1);
+
+    struct sockaddr_in addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons (port);
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    if (connect (fd, (struct sockaddr*) &addr, sizeof (addr)) != 0) {
+        logE_ (_func, "connect() failed: ", errnoString (errno));
+        ++num_failures;
+        close (fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+// The connection should be closed with no reply.
+void checkLongHeaderField ()
+{
+    int const fd = connectToPort (small_buf_port);
+    if (fd == -1)
+        return;
+
+    char req [4 * small_buf_len];
+    Size const prefix_len = (Size) snprintf (req, sizeof (req), "GET /long HTTP/1.1\r\nX-Long: ");
+    memset (req + prefix_len, 'x', sizeof (req) - prefix_len - 4);
+    memcpy (req + sizeof (req) - 4, "\r\n\r\n", 4);
+    if (write (fd, req, sizeof (req)) != (ssize_t) sizeof (req)) {
+        logE_ (_func, "write() failed: ", errnoString (errno));
+        ++num_failures;
+        close (fd);
+        return;
+    }
+
+    char buf [1024];
+    ssize_t const res = read (fd, buf, sizeof (buf));
+    if (res > 0) {
+        logE_ (_func, "unexpected reply: ", ConstMemory (buf, (Size) res));
+        ++num_failures;
+    }
+
+    close (fd);
+}
+
+void clientThreadFunc (void * const /* cb_data */)
+{
+    checkLongHeaderField ();
+
+    {
+      // The service keeps serving requests which fit into the buffer.
+        int const fd = connectToPort (small_buf_port);
+        if (fd != -1) {
+            checkPath (fd, "/short", "root");
+            close (fd);
+        }
+    }
+
+    int const fd = connectToPort (test_port);
+    if (fd == -1) {
+        server_app->stop ();
+        return;
+    }
+
+    // Prefix matching.
+    checkPath (fd, "/test",    "test");
+    checkPath (fd, "/a/b/c",   "abc");
+    checkPath (fd, "/x/y",     "xy");
+
+    // Default handlers.
+    // Namespace "a" takes precedence over handler "a".
+    checkPath (fd, "/a",       "a_default");
+    checkPath (fd, "/a/b/zz",  "ab_default");
+    checkPath (fd, "/a/b/",    "ab_default");
+    checkPath (fd, "/a/q",     "a_default");
+    checkPath (fd, "/nothing", "root");
+    checkPath (fd, "/x/z",     "404 Not Found");
+
+    // The route table is re-published after addHttpHandler().
+    checkPath (fd, "/late",    "root");
+    addHandler ("late", "late");
+    addHandler ("x/", "x_default");
+    checkPath (fd, "/late",    "late");
+    checkPath (fd, "/x/z",     "x_default");
+    checkPath (fd, "/x/y",     "xy");
+    checkPath (fd, "/a/b/c",   "abc");
+
+    close (fd);
+    server_app->stop ();
+}
+
+}
+
+int main (void)
+{
+    libMaryInit ();
+
+    // Never released, the services are referenced until the process exits.
+    Object * const container = new (std::nothrow) Object;
+
+    server_app   = new (std::nothrow) ServerApp   (container, 0 /* num_threads */);
+    page_pool    = new (std::nothrow) PagePool    (container, 4096 /* page_size */, 16 /* min_pages */);
+    http_service = new (std::nothrow) HttpService (container);
+    small_buf_service = new (std::nothrow) HttpService (container);
+
+    if (!server_app->init ()) {
+        logE_ (_func, "server_app->init() failed: ", exc->toString());
+        return EXIT_FAILURE;
+    }
+
+    ServerThreadContext * const thread_ctx = server_app->getServerContext()->getMainThreadContext();
+    if (!http_service->init (thread_ctx->getPollGroup(),
+                             thread_ctx->getTimers(),
+                             thread_ctx->getDeferredProcessor(),
+                             page_pool,
+                             0     /* keepalive_timeout_microsec */,
+                             false /* no_keepalive_conns */))
+    {
+        logE_ (_func, "http_service->init() failed: ", exc->toString());
+        return EXIT_FAILURE;
+    }
+
+    small_buf_service->setRecvBufferSize (small_buf_len);
+    if (!small_buf_service->init (thread_ctx->getPollGroup(),
+                                  thread_ctx->getTimers(),
+                                  thread_ctx->getDeferredProcessor(),
+                                  page_pool,
+                                  0     /* keepalive_timeout_microsec */,
+                                  false /* no_keepalive_conns */))
+    {
+        logE_ (_func, "small_buf_service->init() failed: ", exc->toString());
+        return EXIT_FAILURE;
+    }
+
+    small_buf_service->addHttpHandler (
+            CbDesc<HttpService::HttpHandler> (&http_handler, (void*) "root", NULL /* coderef_container */),
+            ConstMemory ());
+
+    addHandler ("test",   "test");
+    addHandler ("a/b/c",  "abc");
+    addHandler ("/a/b/",  "ab_default");
+    addHandler ("a/",     "a_default");
+    addHandler ("a",      "a");
+    addHandler ("",       "root");
+    addHandler ("x/y",    "xy");
+
+    IpAddress addr;
+    if (!setIpAddress (ConstMemory ("127.0.0.1"), test_port, &addr)) {
+        logE_ (_func, "setIpAddress() failed");
+        return EXIT_FAILURE;
+    }
+
+    if (!http_service->bind (addr) || !http_service->start ()) {
+        logE_ (_func, "could not start http service: ", exc->toString());
+        return EXIT_FAILURE;
+    }
+
+    IpAddress small_buf_addr;
+    if (!setIpAddress (ConstMemory ("127.0.0.1"), small_buf_port, &small_buf_addr)) {
+        logE_ (_func, "setIpAddress() failed");
+        return EXIT_FAILURE;
+    }
+
+    if (!small_buf_service->bind (small_buf_addr) || !small_buf_service->start ()) {
+        logE_ (_func, "could not start http service: ", exc->toString());
+        return EXIT_FAILURE;
+    }
+
+    Ref<Thread> const client_thread =
+            grab (new (std::nothrow) Thread (CbDesc<Thread::ThreadFunc> (clientThreadFunc, NULL, NULL)));
+    if (!client_thread->spawn (true /* joinable */)) {
+        logE_ (_func, "spawn() failed: ", exc->toString());
+        return EXIT_FAILURE;
+    }
+
+    if (!server_app->run ())
+        logE_ (_func, "server_app->run() failed: ", exc->toString());
+
+    client_thread->join ();
+
+    if (num_failures > 0) {
+        logE_ (_func, num_failures, " failures");
+        return EXIT_FAILURE;
+    }
+
+    logI_ (_func, "OK");
+    return 0;
+}
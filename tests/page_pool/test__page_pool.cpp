@@ -0,0 +1,188 @@
+#include <libmary/libmary.h>
+
+#include <sched.h>
+
+
+using namespace M;
+
+
+namespace {
+
+PagePool *page_pool = NULL;
+
+AtomicInt num_threads_done;
+
+void threadFunc (void * const /* cb_data */)
+{
+    for (Count i = 0; i < 10000; ++i) {
+        PagePool::PageListHead page_list;
+        for (Count j = 0; j < i % 50 + 1; ++j)
+            page_pool->printToPages (&page_list, "test__page_pool: ", i, " ", j, "\n");
+
+        page_pool->msgUnref (page_list.first);
+    }
+}
+
+// Leaves pages in the thread's cache and exits while the pool
+// is being destroyed.
+void exitingThreadFunc (void * const /* cb_data */)
+{
+    threadFunc (NULL);
+    num_threads_done.inc ();
+}
+
+void unrefThreadFunc (void * const _first_page)
+{
+    page_pool->msgUnref (static_cast <PagePool::Page*> (_first_page));
+}
+
+// Checks the only thread cache of the pool, which belongs to the main thread.
+bool checkThreadCache (Count const expected_num_refills,
+                       Count const expected_num_cached_pages)
+{
+    PagePool::ThreadCacheStatistics stats;
+    Count const num_caches = page_pool->getThreadCacheStatistics (&stats, 1);
+    if (num_caches != 1
+        || stats.num_refills != expected_num_refills
+        || stats.num_cached_pages != expected_num_cached_pages)
+    {
+        logE_ (_func, "caches: ", num_caches, ", "
+               "refills: ", stats.num_refills, " (expected ", expected_num_refills, "), "
+               "cached: ", stats.num_cached_pages, " (expected ", expected_num_cached_pages, ")");
+        return false;
+    }
+
+    return true;
+}
+
+// Pages are grabbed in the main thread and released in other threads,
+// so that they never return to the main thread's cache directly.
+bool testGrabAndReleaseInDifferentThreads ()
+{
+    Size  const page_size  = 64;
+    Count const batch_size = 16;
+    Count const num_pages_per_round = 10 * batch_size;
+    Count const num_rounds = 10;
+
+    page_pool = new PagePool (NULL /* coderef_container */, page_size, 16 /* min_pages */);
+    page_pool->setThreadCacheSize (4 * batch_size, batch_size);
+    page_pool->setWatermarks (16, 1024);
+
+    for (Count i = 0; i < num_rounds; ++i) {
+        PagePool::PageListHead page_list;
+        for (Count j = 0; j < num_pages_per_round; ++j)
+            page_pool->getPages (&page_list, page_size);
+
+        Ref<Thread> const thread =
+                grab (new Thread (CbDesc<Thread::ThreadFunc> (unrefThreadFunc, page_list.first, NULL)));
+        if (!thread->spawn (true /* joinable */)) {
+            logE_ (_func, "spawn() failed: ", exc->toString());
+            return false;
+        }
+        thread->join ();
+    }
+
+    // Every single-page grab has been served from the cache,
+    // which has been refilled a batch at a time.
+    Count num_refills = num_rounds * num_pages_per_round / batch_size;
+    if (!checkThreadCache (num_refills, 0))
+        return false;
+
+    // A bulk grab takes a batch via the cache, and the rest from the depot.
+    {
+        PagePool::PageListHead page_list;
+        page_pool->getPages (&page_list, 2 * batch_size * page_size + 1);
+        ++num_refills;
+        if (!checkThreadCache (num_refills, 0))
+            return false;
+
+        page_pool->getPages (&page_list, 3 * page_size);
+        ++num_refills;
+        if (!checkThreadCache (num_refills, batch_size - 3))
+            return false;
+
+        page_pool->msgUnref (page_list.first);
+    }
+
+    PagePool::Statistics stats;
+    page_pool->getStatistics (&stats);
+    if (stats.num_busy_pages != 0) {
+        logE_ (_func, "busy pages lost");
+        return false;
+    }
+
+    delete page_pool;
+    page_pool = NULL;
+
+    logI_ (_func, "OK");
+    return true;
+}
+
+}
+
+int main (void)
+{
+    libMaryInit ();
+
+    page_pool = new PagePool (NULL /* coderef_container */, 64 /* page_size */, 16 /* min_pages */);
+
+    Count const num_threads = 4;
+    Ref<Thread> threads [num_threads];
+    for (Count i = 0; i < num_threads; ++i) {
+        threads [i] = grab (new Thread (CbDesc<Thread::ThreadFunc> (threadFunc, NULL, NULL)));
+        if (!threads [i]->spawn (true /* joinable */)) {
+            logE_ (_func, "spawn() failed: ", exc->toString());
+            return EXIT_FAILURE;
+        }
+    }
+
+    threadFunc (NULL);
+
+    for (Count i = 0; i < num_threads; ++i)
+        threads [i]->join ();
+
+    PagePool::Statistics stats;
+    page_pool->getStatistics (&stats);
+    logI_ (_func, "spare: ", stats.num_spare_pages, ", "
+           "busy: ", stats.num_busy_pages, ", "
+           "cached: ", stats.num_cached_pages, ", "
+           "thread caches: ", stats.num_thread_caches);
+
+    if (stats.num_busy_pages != 0) {
+        logE_ (_func, "busy pages lost");
+        return EXIT_FAILURE;
+    }
+
+    // Deprecated 'stats' member counts cached pages as busy.
+    if (page_pool->stats.num_spare_pages != stats.num_spare_pages
+        || page_pool->stats.num_busy_pages != stats.num_cached_pages)
+    {
+        logE_ (_func, "stats mismatch: "
+               "spare ", page_pool->stats.num_spare_pages, ", busy ", page_pool->stats.num_busy_pages);
+        return EXIT_FAILURE;
+    }
+
+    delete page_pool;
+
+    page_pool = new PagePool (NULL /* coderef_container */, 64 /* page_size */, 16 /* min_pages */);
+    for (Count i = 0; i < num_threads; ++i) {
+        threads [i] = grab (new Thread (CbDesc<Thread::ThreadFunc> (exitingThreadFunc, NULL, NULL)));
+        if (!threads [i]->spawn (true /* joinable */)) {
+            logE_ (_func, "spawn() failed: ", exc->toString());
+            return EXIT_FAILURE;
+        }
+    }
+
+    while (num_threads_done.get() != (int) num_threads)
+        sched_yield ();
+
+    delete page_pool;
+
+    for (Count i = 0; i < num_threads; ++i)
+        threads [i]->join ();
+
+    if (!testGrabAndReleaseInDifferentThreads ())
+        return EXIT_FAILURE;
+
+    return 0;
+}
@@ -110,7 +110,8 @@ test_timer_callback (void * const /* cb_data */)
 
 SelectPollGroup::Frontend const poll_frontend = {
     test_timer_callback /* pollIterationBegin */,
-    NULL /* pollIterationEnd */
+    NULL /* pollIterationEnd */,
+    NULL /* pollIterationStats */
 };
 
 Result doTest ()
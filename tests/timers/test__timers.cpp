@@ -0,0 +1,170 @@
+#include <libmary/libmary.h>
+
+#include <unistd.h>
+
+
+using namespace M;
+
+
+namespace {
+
+struct TimerData
+{
+    Time  expected_time;
+    Count num_fired;
+    bool  fired_early;
+};
+
+Timers *timers;
+
+void timerTick (void * const _data)
+{
+    TimerData * const data = static_cast <TimerData*> (_data);
+
+    ++data->num_fired;
+    if (getTimeMicroseconds() < data->expected_time)
+        data->fired_early = true;
+}
+
+void runTimers (Time const duration_microsec)
+{
+    Time const end_time = getTimeMicroseconds() + duration_microsec;
+    for (;;) {
+        updateTime ();
+        timers->processTimers ();
+
+        Time const cur_time = getTimeMicroseconds();
+        if (cur_time >= end_time)
+            break;
+
+        Time sleep_time = timers->getSleepTime_microseconds ();
+        if (sleep_time > end_time - cur_time)
+            sleep_time = end_time - cur_time;
+
+        usleep ((useconds_t) sleep_time);
+    }
+}
+
+}
+
+int main (void)
+{
+    libMaryInit ();
+    updateTime ();
+
+    timers = new (std::nothrow) Timers (NULL /* coderef_container */);
+    assert (timers);
+
+    TimerData oneshot_data   = { getTimeMicroseconds() + 50000, 0, false };
+    TimerData deleted_data   = { 0, 0, false };
+    TimerData periodic_data  = { 0, 0, false };
+    TimerData restarted_data = { 0, 0, false };
+    TimerData far_data       = { 0, 0, false };
+
+    Timers::TimerKey const oneshot_key =
+            timers->addTimer_microseconds (CbDesc<Timers::TimerCallback> (timerTick, &oneshot_data, NULL),
+                                           50000, false /* periodical */);
+    Timers::TimerKey const deleted_key =
+            timers->addTimer_microseconds (CbDesc<Timers::TimerCallback> (timerTick, &deleted_data, NULL),
+                                           30000, false /* periodical */);
+    Timers::TimerKey const periodic_key =
+            timers->addTimer_microseconds (CbDesc<Timers::TimerCallback> (timerTick, &periodic_data, NULL),
+                                           10000, true /* periodical */);
+    Timers::TimerKey const restarted_key =
+            timers->addTimer_microseconds (CbDesc<Timers::TimerCallback> (timerTick, &restarted_data, NULL),
+                                           100000, false /* periodical */);
+    Timers::TimerKey const far_key =
+            timers->addTimer (CbDesc<Timers::TimerCallback> (timerTick, &far_data, NULL),
+                              3600 * 24 * 365 /* time_seconds */, false /* periodical */, false /* auto_delete */);
+
+    timers->deleteTimer (deleted_key);
+
+    runTimers (60000);
+    timers->restartTimer (restarted_key);
+    restarted_data.expected_time = getTimeMicroseconds() + 100000;
+
+    runTimers (200000);
+
+    if (oneshot_data.num_fired != 1 || oneshot_data.fired_early) {
+        logE_ (_func, "one-shot timer: num_fired ", oneshot_data.num_fired);
+        return EXIT_FAILURE;
+    }
+
+    if (deleted_data.num_fired != 0) {
+        logE_ (_func, "deleted timer fired");
+        return EXIT_FAILURE;
+    }
+
+    // 26 ticks are expected, allowing for scheduling delays.
+    if (periodic_data.num_fired < 15 || periodic_data.num_fired > 26) {
+        logE_ (_func, "periodical timer: num_fired ", periodic_data.num_fired);
+        return EXIT_FAILURE;
+    }
+
+    if (restarted_data.num_fired != 1 || restarted_data.fired_early) {
+        logE_ (_func, "restarted timer: num_fired ", restarted_data.num_fired);
+        return EXIT_FAILURE;
+    }
+
+    if (far_data.num_fired != 0) {
+        logE_ (_func, "far timer fired");
+        return EXIT_FAILURE;
+    }
+
+    timers->deleteTimer (oneshot_key);
+    timers->deleteTimer (periodic_key);
+    timers->deleteTimer (restarted_key);
+
+    {
+        Time const sleep_time = timers->getSleepTime_microseconds ();
+        // The next wakeup is for cascading the far timer into lower levels.
+        if (sleep_time == 0 || sleep_time == (Time) -1) {
+            logE_ (_func, "unexpected sleep time ", sleep_time);
+            return EXIT_FAILURE;
+        }
+    }
+
+    timers->deleteTimer (far_key);
+
+    if (timers->getSleepTime_microseconds () != (Time) -1) {
+        logE_ (_func, "timers left");
+        return EXIT_FAILURE;
+    }
+
+    delete timers;
+
+    {
+      // The Timer object of a deleted timer is reused for the next one.
+      // The stale key of the deleted timer should not affect the new timer.
+        timers = new (std::nothrow) Timers (NULL /* coderef_container */);
+        assert (timers);
+
+        TimerData stale_data = { 0, 0, false };
+        Timers::TimerKey const stale_key =
+                timers->addTimer_microseconds (CbDesc<Timers::TimerCallback> (timerTick, &stale_data, NULL),
+                                               10000, false /* periodical */,
+                                               true /* auto_delete */, true /* delete_after_tick */);
+        runTimers (30000);
+
+        TimerData reused_data = { getTimeMicroseconds() + 20000, 0, false };
+        Timers::TimerKey const reused_key =
+                timers->addTimer_microseconds (CbDesc<Timers::TimerCallback> (timerTick, &reused_data, NULL),
+                                               20000, false /* periodical */);
+
+        timers->restartTimer (stale_key);
+        timers->deleteTimer (stale_key);
+
+        runTimers (50000);
+
+        if (stale_data.num_fired != 1 || reused_data.num_fired != 1 || reused_data.fired_early) {
+            logE_ (_func, "stale key: num_fired ", stale_data.num_fired, ", ", reused_data.num_fired);
+            return EXIT_FAILURE;
+        }
+
+        timers->deleteTimer (reused_key);
+        delete timers;
+    }
+
+    logI_ (_func, "OK");
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include <libmary/libmary.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+
+
+using namespace M;
+
+
+// Sends a message with a header and enough page data for MSG_ZEROCOPY
+// over a loopback TCP connection. Page data should be sent with zero-copy
+// writes: the pages stay referenced after the message has been received,
+// until zero-copy completion notifications are processed.
+
+namespace {
+
+Size  const page_size = 4096;
+Count const num_pages = 8;
+Size  const zerocopy_threshold = 4 * page_size;
+
+ConstMemory const header = "HTTP/1.1 200 OK\r\n\r\n";
+
+// Returns the number of pages in the list which are referenced more than once.
+Count countSharedPages (PagePool::Page *page)
+{
+    Count num_shared = 0;
+    while (page) {
+        if (page->getRefcount() > 1)
+            ++num_shared;
+
+        page = page->getNextMsgPage();
+    }
+
+    return num_shared;
+}
+
+// Connected loopback TCP sockets. Returns false on failure.
+bool makeConnection (int * const mt_nonnull ret_server_fd,
+                     int * const mt_nonnull ret_client_fd)
+{
+    int const listen_fd = socket (AF_INET, SOCK_STREAM, 0);
+    assert (listen_fd != -1);
+
+    struct sockaddr_in addr;
+    memset (&addr, 0, sizeof (addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl (INADDR_LOOPBACK);
+    socklen_t addr_len = sizeof (addr);
+    if (bind (listen_fd, (struct sockaddr*) &addr, sizeof (addr)) != 0
+        || listen (listen_fd, 1) != 0
+        || getsockname (listen_fd, (struct sockaddr*) &addr, &addr_len) != 0)
+    {
+        logE_ (_func, "could not listen: ", errnoString (errno));
+        close (listen_fd);
+        return false;
+    }
+
+    *ret_client_fd = socket (AF_INET, SOCK_STREAM, 0);
+    assert (*ret_client_fd != -1);
+    if (connect (*ret_client_fd, (struct sockaddr*) &addr, sizeof (addr)) != 0) {
+        logE_ (_func, "connect() failed: ", errnoString (errno));
+        close (*ret_client_fd);
+        close (listen_fd);
+        return false;
+    }
+
+    *ret_server_fd = accept (listen_fd, NULL, NULL);
+    close (listen_fd);
+    if (*ret_server_fd == -1) {
+        logE_ (_func, "accept() failed: ", errnoString (errno));
+        close (*ret_client_fd);
+        return false;
+    }
+
+    fcntl (*ret_server_fd, F_SETFL, O_NONBLOCK);
+    fcntl (*ret_client_fd, F_SETFL, O_NONBLOCK);
+    return true;
+}
+
+bool testMessageWithHeader (PagePool          * const mt_nonnull page_pool,
+                            DeferredProcessor * const mt_nonnull deferred_processor,
+                            TcpConnection     * const mt_nonnull tcp_conn,
+                            int                 const client_fd)
+{
+    static Byte data [num_pages * page_size];
+    for (Size i = 0; i < sizeof (data); ++i)
+        data [i] = (Byte) (i * 13 + i / page_size);
+
+    PagePool::PageListHead page_list;
+    page_pool->getFillPages (&page_list, ConstMemory (data, sizeof (data)));
+    // Our own reference to check if the sender keeps the pages referenced.
+    page_pool->msgRef (page_list.first);
+
+    ImmediateConnectionSender sender (NULL /* coderef_container */);
+    sender.setConnection (tcp_conn);
+    sender.init (deferred_processor);
+    sender.enableZeroCopy (zerocopy_threshold);
+
+    Sender::MessageEntry_Pages * const msg_pages = Sender::MessageEntry_Pages::createNew (header.len());
+    msg_pages->header_len = header.len();
+    memcpy (msg_pages->getHeaderData(), header.mem(), header.len());
+    msg_pages->page_pool = page_pool;
+    msg_pages->setFirstPage (page_list.first);
+    msg_pages->msg_offset = 0;
+    sender.sendMessage (msg_pages, true /* do_flush */);
+
+    CbDesc<PollGroup::Pollable> const pollable = tcp_conn->getPollable ();
+
+    static Byte recv_buf [sizeof (data) + 64];
+    Size const expected_len = header.len() + sizeof (data);
+    Size recv_len = 0;
+    for (Count i = 0; recv_len < expected_len; ++i) {
+        if (i == 100000) {
+            logE_ (_func, "received ", recv_len, " bytes out of ", expected_len);
+            return false;
+        }
+
+        // Completion notifications are not processed yet.
+        pollable->processEvents (PollGroup::Output, pollable.cb_data);
+
+        ssize_t const res = read (client_fd, recv_buf + recv_len, sizeof (recv_buf) - recv_len);
+        if (res > 0)
+            recv_len += (Size) res;
+        else
+        if (res == 0 || errno != EAGAIN)
+            usleep (100);
+    }
+
+    if (recv_len != expected_len
+        || memcmp (recv_buf, header.mem(), header.len()) != 0
+        || memcmp (recv_buf + header.len(), data, sizeof (data)) != 0)
+    {
+        logE_ (_func, "received data mismatch, ", recv_len, " bytes");
+        return false;
+    }
+
+    // The message has been sent in full, and zero-copy writes
+    // keep its pages referenced until completion.
+    Count const num_shared = countSharedPages (page_list.first);
+    if (num_shared != num_pages) {
+        logE_ (_func, "pages referenced by zero-copy writes: ", num_shared, " out of ", num_pages);
+        return false;
+    }
+
+    for (Count i = 0; countSharedPages (page_list.first) > 0; ++i) {
+        if (i == 100000) {
+            logE_ (_func, "no zero-copy completion");
+            return false;
+        }
+
+        pollable->processEvents (PollGroup::Error, pollable.cb_data);
+        usleep (100);
+    }
+
+    page_pool->msgUnref (page_list.first);
+
+    logI_ (_func, "OK");
+    return true;
+}
+
+}
+
+int main (void)
+{
+    libMaryInit ();
+
+    int server_fd;
+    int client_fd;
+    if (!makeConnection (&server_fd, &client_fd))
+        return EXIT_FAILURE;
+
+    PagePool page_pool (NULL /* coderef_container */, page_size, 0 /* min_pages */);
+    DeferredProcessor deferred_processor (NULL /* coderef_container */);
+
+    int ret = EXIT_SUCCESS;
+    {
+        TcpConnection tcp_conn (NULL /* coderef_container */);
+        tcp_conn.setFd (server_fd);
+
+        if (!tcp_conn.enableZeroCopy ()) {
+            logW_ (_func, "MSG_ZEROCOPY is not available, skipping the test: ", exc->toString());
+        } else
+        if (!testMessageWithHeader (&page_pool, &deferred_processor, &tcp_conn, client_fd)) {
+            ret = EXIT_FAILURE;
+        }
+    }
+
+    close (client_fd);
+
+    if (ret == EXIT_SUCCESS)
+        logI_ (_func, "OK");
+
+    return ret;
+}